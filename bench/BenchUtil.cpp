@@ -0,0 +1,93 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//Common timing, allocation counting and reporting utilities used by all benchmark suites.
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "BenchUtil.hpp"
+#include <new>
+
+
+// Allocation counting
+// The benchmark is single threaded, so a plain counter is sufficient
+
+static bool allocCounting = false;
+static long allocCount = 0;
+
+static void* countedAlloc(size_t size) {
+	if (allocCounting) {
+		allocCount++;
+	}
+	void* ptr = std::malloc(size == 0 ? 1 : size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new(size_t size) {
+	return countedAlloc(size);
+}
+void* operator new[](size_t size) {
+	return countedAlloc(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	if (allocCounting) {
+		allocCount++;
+	}
+	return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	if (allocCounting) {
+		allocCount++;
+	}
+	return std::malloc(size == 0 ? 1 : size);
+}
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+
+void benchAllocCountStart() {
+	allocCount = 0;
+	allocCounting = true;
+}
+
+long benchAllocCountStop() {
+	allocCounting = false;
+	return allocCount;
+}
+
+
+
+// Reporting
+
+void benchPrintHeader(const BenchOptions& opts, const char* title) {
+	if (opts.csv) {
+		printf("# %s\n", title);
+		printf("name,sampleRate,nsPerSample,p99BlockNs,allocsPerCall\n");
+	}
+	else {
+		printf("\n%s (block size %i, %.1f s per case)\n", title, opts.blockSize, opts.seconds);
+		printf("%-32s %8s %12s %14s %12s\n", "Case", "Rate", "ns/sample", "p99 ns/block", "allocs/call");
+	}
+}
+
+void benchPrintResult(const BenchOptions& opts, const BenchResult& res) {
+	if (opts.csv) {
+		printf("%s,%.0f,%.3f,%.0f,%.6f\n", res.name.c_str(), res.sampleRate, res.nsPerSample, res.p99BlockNs, res.allocsPerCall);
+	}
+	else {
+		printf("%-32s %8.0f %12.2f %14.0f %12.4f\n", res.name.c_str(), res.sampleRate, res.nsPerSample, res.p99BlockNs, res.allocsPerCall);
+	}
+	fflush(stdout);
+}
+
+void benchPrintNote(const BenchOptions& opts, const std::string& note) {
+	printf(opts.csv ? "# %s\n" : "  %s\n", note.c_str());
+}
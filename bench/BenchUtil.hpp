@@ -0,0 +1,87 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//Common timing, allocation counting and reporting utilities used by all benchmark suites.
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include "../src/ImpromptuModular.hpp"
+#include <chrono>
+
+
+struct BenchOptions {
+	std::vector<float> sampleRates = {48000.0f};
+	float seconds = 2.0f;// measured time per case, in simulated audio time
+	float warmupSeconds = 0.1f;
+	int blockSize = 64;
+	std::string filter;// when not empty, only run cases whose name contains this string
+	bool csv = false;
+
+	bool isSelected(const std::string& name) const {
+		return filter.empty() || name.find(filter) != std::string::npos;
+	}
+};
+
+
+struct BenchResult {
+	std::string name;
+	float sampleRate = 0.0f;
+	double nsPerSample = 0.0;
+	double p99BlockNs = 0.0;// 99th percentile of the time taken to process one block of BenchOptions::blockSize samples
+	double allocsPerCall = 0.0;
+};
+
+
+// Allocation counting (global operator new is replaced in BenchUtil.cpp)
+void benchAllocCountStart();
+long benchAllocCountStop();
+
+
+inline int64_t benchNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Collects per-block durations; storage is reserved up front so that the measurement itself does not allocate
+struct BenchBlockTimer {
+	std::vector<int64_t> blockNs;
+	int64_t totalNs = 0;
+	int64_t t0 = 0;
+
+	void reserve(size_t numBlocks) {
+		blockNs.clear();
+		blockNs.reserve(numBlocks);
+		totalNs = 0;
+	}
+	void start() {
+		t0 = benchNow();
+	}
+	void stop() {
+		int64_t dt = benchNow() - t0;
+		blockNs.push_back(dt);
+		totalNs += dt;
+	}
+	double percentile(double pct) {
+		if (blockNs.empty()) {
+			return 0.0;
+		}
+		std::vector<int64_t> sorted(blockNs);
+		std::sort(sorted.begin(), sorted.end());
+		size_t index = std::min(sorted.size() - 1, (size_t)(pct / 100.0 * (double)sorted.size()));
+		return (double)sorted[index];
+	}
+};
+
+
+void benchPrintHeader(const BenchOptions& opts, const char* title);
+void benchPrintResult(const BenchOptions& opts, const BenchResult& res);
+void benchPrintNote(const BenchOptions& opts, const std::string& note);
+
+
+// Benchmark suites, each one runs all its cases that match opts.filter
+void runModuleBenchSuite(const BenchOptions& opts);
+void runDspBenchSuite(const BenchOptions& opts);
+void runPatchBenchSuite(const BenchOptions& opts);
+void runClockSyncBenchSuite(const BenchOptions& opts);
@@ -0,0 +1,186 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//Clock sync suite: Clocked and Clkd synced to an external clock on their BPM input (Px modes), fed
+//with deterministic pulse trains, with and without the PLL tempo tracker. Reports the wobble of
+//the x4 clock (clock 1) on a steady jittered tempo, and the time taken to follow a tempo step.
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "BenchUtil.hpp"
+#include "../src/RandomStream.hpp"
+
+
+static const double syncBpm = 120.0;
+static const double syncStepBpm = 126.0;// tempo after the step
+static const double syncSteadyStart = 4.0;// seconds, wobble is measured from here to the tempo step
+static const double syncStepTime = 10.0;// seconds
+static const double syncRunTime = 16.0;// seconds
+static const double syncSettleBand = 0.005;// an interval is settled when within 0.5% of its nominal length
+
+
+struct ClockSyncCase {
+	std::string name;
+	Model* model;
+	int ppqn;
+	bool pll;
+	double jitter;// seconds, standard deviation of the pulse times
+};
+
+
+// Pulse train at syncBpm, or at syncStepBpm from stepTime, whose pulses are moved by a normal jitter (clamped to
+// +-3 standard deviations), the same for every run
+struct SyncPulseTrain {
+	RandomStream rng;
+	int ppqn;
+	double jitter;
+	double stepTime;
+	double idealTime = 0.0;
+	double pulseTime = 0.0;
+
+	SyncPulseTrain(int _ppqn, double _jitter, double _stepTime) {
+		rng.setSeed(0x5EED);
+		ppqn = _ppqn;
+		jitter = _jitter;
+		stepTime = _stepTime;
+	}
+
+	void next() {
+		idealTime += 60.0 / ((idealTime < stepTime ? syncBpm : syncStepBpm) * (double)ppqn);
+		pulseTime = idealTime + jitter * (double)clamp(rng.normal(), -3.0f, 3.0f);
+	}
+};
+
+
+struct SyncEdgeStats {
+	double sumSquares = 0.0;
+	double maxError = 0.0;
+	double sumIntervals = 0.0;
+	long count = 0;
+	double lastUnsettled = 0.0;// time of the last interval that was not within syncSettleBand after the step
+};
+
+
+// Runs the module on a pulse train and measures the intervals between the rising edges of its x4 clock
+static void runSyncModule(const ClockSyncCase& scase, float sampleRate, double jitter, double stepTime, SyncEdgeStats* stats) {
+	APP->engine->setSampleRate(sampleRate);
+	Module* module = scase.model->createModule();
+	Module::SampleRateChangeEvent srce;
+	srce.sampleRate = sampleRate;
+	srce.sampleTime = 1.0f / sampleRate;
+	module->onSampleRateChange(srce);
+
+	int bpmInputId = -1;
+	for (int i = 0; i < (int)module->inputInfos.size(); i++) {
+		if (module->inputInfos[i] && module->inputInfos[i]->name == "BPM CV / Ext clock")
+			bpmInputId = i;
+	}
+	int clockOutputId = -1;
+	for (int i = 0; i < (int)module->outputInfos.size(); i++) {
+		if (module->outputInfos[i] && module->outputInfos[i]->name == "Clock 1")
+			clockOutputId = i;
+	}
+	for (int i = 0; i < (int)module->paramQuantities.size(); i++) {
+		if (module->paramQuantities[i] && module->paramQuantities[i]->name == "Clk 1 ratio")
+			module->params[i].setValue(5.0f);// x4
+	}
+	module->inputs[bpmInputId].setChannels(1);
+	for (Output& output : module->outputs) {
+		output.setChannels(1);
+	}
+
+	json_t* rootJ = module->dataToJson();
+	json_object_set_new(rootJ, "bpmDetectionMode", json_true());
+	json_object_set_new(rootJ, "ppqn", json_integer(scase.ppqn));
+	json_object_set_new(rootJ, "bpmDetectionPll", json_boolean(scase.pll));
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+
+	Module::ProcessArgs args;
+	args.sampleRate = sampleRate;
+	args.sampleTime = 1.0f / sampleRate;
+	args.frame = 0;
+
+	SyncPulseTrain train(scase.ppqn, jitter, stepTime);
+	train.next();
+	double pulseEnd = -1.0;
+	bool lastHigh = true;
+	double lastEdge = -1.0;
+	int64_t numFrames = (int64_t)(syncRunTime * sampleRate);
+	for (; args.frame < numFrames; args.frame++) {
+		double t = (double)args.frame / sampleRate;
+		if (t >= train.pulseTime) {
+			pulseEnd = t + 0.001;
+			train.next();
+		}
+		module->inputs[bpmInputId].setVoltage(t < pulseEnd ? 10.0f : 0.0f);
+		module->process(args);
+
+		bool high = module->outputs[clockOutputId].getVoltage() > 5.0f;
+		if (high && !lastHigh) {
+			if (lastEdge >= 0.0) {
+				double nominal = 15.0 / (lastEdge < stepTime ? syncBpm : syncStepBpm);
+				double error = (t - lastEdge) - nominal;
+				if (lastEdge >= syncSteadyStart && t < stepTime) {
+					stats->sumSquares += error * error;
+					stats->maxError = std::max(stats->maxError, std::fabs(error));
+					stats->sumIntervals += t - lastEdge;
+					stats->count++;
+				}
+				if (lastEdge >= stepTime && std::fabs(error) > nominal * syncSettleBand) {
+					stats->lastUnsettled = t;
+				}
+			}
+			lastEdge = t;
+		}
+		lastHigh = high;
+	}
+	delete module;
+}
+
+
+void runClockSyncBenchSuite(const BenchOptions& opts) {
+	std::vector<ClockSyncCase> cases;
+	for (int ppqn : {4, 24}) {
+		for (int pll = 0; pll < 2; pll++) {
+			cases.push_back({string::f("Clocked-Sync-P%i-%s", ppqn, pll ? "PLL" : "Direct"), modelClocked, ppqn, pll != 0, 0.001});
+			cases.push_back({string::f("Clkd-Sync-P%i-%s", ppqn, pll ? "PLL" : "Direct"), modelClkd, ppqn, pll != 0, 0.001});
+		}
+	}
+
+	bool headerDone = false;
+	for (const ClockSyncCase& scase : cases) {
+		if (!opts.isSelected(scase.name)) {
+			continue;
+		}
+		if (!headerDone) {
+			if (opts.csv) {
+				printf("# External clock sync, x4 clock intervals at %.0f BPM with %.1f ms pulse jitter, and settling after a step to %.0f BPM\n", syncBpm, scase.jitter * 1e3, syncStepBpm);
+				printf("name,sampleRate,rmsErrorMs,maxErrorMs,bpm,settleSeconds\n");
+			}
+			else {
+				printf("\nExternal clock sync, x4 clock intervals at %.0f BPM with %.1f ms pulse jitter, and settling after a step to %.0f BPM\n", syncBpm, scase.jitter * 1e3, syncStepBpm);
+				printf("%-32s %8s %12s %12s %10s %10s\n", "Case", "Rate", "rms err ms", "max err ms", "BPM", "settle s");
+			}
+			headerDone = true;
+		}
+		for (float sampleRate : opts.sampleRates) {
+			SyncEdgeStats jittered;
+			runSyncModule(scase, sampleRate, scase.jitter, syncStepTime, &jittered);
+			SyncEdgeStats clean;
+			runSyncModule(scase, sampleRate, 0.0, syncStepTime, &clean);
+
+			double rmsMs = jittered.count > 0 ? std::sqrt(jittered.sumSquares / (double)jittered.count) * 1e3 : 0.0;
+			double bpm = jittered.count > 0 ? 15.0 * (double)jittered.count / jittered.sumIntervals : 0.0;
+			double settle = clean.lastUnsettled > 0.0 ? clean.lastUnsettled - syncStepTime : 0.0;
+			if (opts.csv) {
+				printf("%s,%.0f,%.3f,%.3f,%.3f,%.3f\n", scase.name.c_str(), sampleRate, rmsMs, jittered.maxError * 1e3, bpm, settle);
+			}
+			else {
+				printf("%-32s %8.0f %12.3f %12.3f %10.3f %10.3f\n", scase.name.c_str(), sampleRate, rmsMs, jittered.maxError * 1e3, bpm, settle);
+			}
+			fflush(stdout);
+		}
+	}
+}
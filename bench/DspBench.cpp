@@ -0,0 +1,330 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//DSP suite: cost per call of the shared dsp helpers (FundamentalUtil, etc.), outside of any module
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "BenchUtil.hpp"
+#include "../src/FundamentalUtil.hpp"
+#include "../src/FoundrySequencerKernel.hpp"
+#include "../src/SingleRandom.hpp"
+#include "../src/GatePatterns.hpp"
+
+
+// The list based random order without repeats that SingleRandom replaced, for comparison
+struct ListSingleRandom {
+	uint32_t played = 0x1;
+	std::vector<uint8_t> candidates;
+	
+	int getNext(int length, uint32_t randomValue) {
+		candidates.clear();
+		for (int i = 0; i < length; i++) {
+			if ((played & (((uint32_t)1) << i)) == 0)
+				candidates.push_back(i);
+		}
+		int ret = 0;
+		if (candidates.empty()) {
+			played = 0;
+			ret = randomValue % length;
+		}
+		else {
+			ret = candidates[randomValue % candidates.size()];
+		}
+		played |= (((uint32_t)1) << ret);
+		return ret;
+	}
+};
+
+
+// The 8x oversampled oscillator that the minBLEP VoltageControlledOscillator replaced, for comparison (digital 
+// mode only, the analog mode read lookup tables that are no longer in the tree)
+struct OversampledVco {
+	static const int OVERSAMPLE = 8;
+	static const int QUALITY = 8;
+	
+	float phase = 0.0f;
+	float freq = 0.0f;
+	float pw = 0.5f;
+
+	dsp::Decimator<OVERSAMPLE, QUALITY> sinDecimator;
+	dsp::Decimator<OVERSAMPLE, QUALITY> triDecimator;
+	dsp::Decimator<OVERSAMPLE, QUALITY> sawDecimator;
+	dsp::Decimator<OVERSAMPLE, QUALITY> sqrDecimator;
+
+	float sinBuffer[OVERSAMPLE] = {};
+	float triBuffer[OVERSAMPLE] = {};
+	float sawBuffer[OVERSAMPLE] = {};
+	float sqrBuffer[OVERSAMPLE] = {};
+
+	void setPitch(float pitchKnob, float pitchCv) {
+		freq = 261.626f * std::pow(2.0f, (std::round(pitchKnob) + pitchCv) / 12.0f);
+	}
+	
+	void process(float deltaTime) {
+		float deltaPhase = clamp(freq * deltaTime, 1e-6, 0.5f);
+		for (int i = 0; i < OVERSAMPLE; i++) {
+			sinBuffer[i] = std::sin(2.f*float(M_PI) * phase);
+			if (phase < 0.25f)
+				triBuffer[i] = 4.f * phase;
+			else if (phase < 0.75f)
+				triBuffer[i] = 2.f - 4.f * phase;
+			else
+				triBuffer[i] = -4.f + 4.f * phase;
+			if (phase < 0.5f)
+				sawBuffer[i] = 2.f * phase;
+			else
+				sawBuffer[i] = -2.f + 2.f * phase;
+			sqrBuffer[i] = (phase < pw) ? 1.f : -1.f;
+			phase += deltaPhase / OVERSAMPLE;
+			phase = eucMod(phase, 1.0f);
+		}
+	}
+	
+	float outputs() {// all four waveforms, as when all the VCO outputs are patched
+		return sinDecimator.process(sinBuffer) + triDecimator.process(triBuffer) + sawDecimator.process(sawBuffer) + sqrDecimator.process(sqrBuffer);
+	}
+};
+
+
+// Checks that SingleRandom plays every item once per cycle, and that each item is equally likely at each position
+// of a cycle (chi-square over the item x position table, which has (length - 1)^2 degrees of freedom)
+static void checkSingleRandom(const BenchOptions& opts, int length) {
+	static const int NUM_CYCLES = 20000;
+	SingleRandom<256> sr;
+	RandomStream rng;
+	std::vector<long> counts(length * length, 0);
+	std::vector<bool> seen(length);
+	for (int i = 1; i < length; i++)// first cycle: item 0 is played on reset
+		sr.getNext(length, rng.u32());
+	bool permutations = true;
+	for (int c = 0; c < NUM_CYCLES; c++) {
+		std::fill(seen.begin(), seen.end(), false);
+		for (int p = 0; p < length; p++) {
+			int item = sr.getNext(length, rng.u32());
+			if (item < 0 || item >= length || seen[item])
+				permutations = false;
+			else
+				seen[item] = true;
+			counts[item * length + p]++;
+		}
+	}
+	double expected = (double)NUM_CYCLES / (double)length;
+	double chi2 = 0.0;
+	for (long n : counts)
+		chi2 += ((double)n - expected) * ((double)n - expected) / expected;
+	double dof = (double)((length - 1) * (length - 1));
+	double z = (chi2 - dof) / std::sqrt(2.0 * dof);// about normal for these dof
+	benchPrintNote(opts, string::f("SingleRandom %d items: %s, chi-square %.0f for %.0f dof (z = %.2f)%s", length, 
+		permutations ? "one of each item per cycle" : "ITEMS REPEATED WITHIN A CYCLE", chi2, dof, z, std::fabs(z) > 4.0 ? ", NOT UNIFORM" : ""));
+}
+
+
+// The 96 slot gate masks and per pulse shifts that Foundry used before GatePatternTable, for comparison
+static const uint64_t shiftGateMaskLow[GATETYPE_TRIG + 1] = {0x0000000000FFFFFF, 0x0000FFFF0000FFFF, 0x0000FFFFFFFFFFFF, 
+	0x0000FFFF00000000, 0xFFFFFFFFFFFFFFFF, 0xFFFFFFFFFFFFFFFF, 0x000000000000FFFF, 0xFFFF000000FFFFFF, 0x0000FFFF00000000, 
+	0xFFFF000000000000, 0x0000000000000000, 0};
+static const uint64_t shiftGateMaskHigh[GATETYPE_TRIG + 1] = {0x0000000000000000, 0x000000000000FFFF, 0x0000000000000000, 
+	0x000000000000FFFF, 0x00000000000000FF, 0x00000000FFFFFFFF, 0x0000000000000000, 0x00000000000000FF, 0x0000000000000000, 
+	0x00000000000000FF, 0x000000000000FFFF, 0};
+
+static int shiftGate(int gateType, int pulsesPerStep, int pulse) {
+	uint64_t shiftAmt = ((uint64_t)pulse) * (((uint64_t)96) / ((uint64_t)pulsesPerStep));
+	if (shiftAmt >= 64)
+		return (int)((shiftGateMaskHigh[gateType] >> (shiftAmt - (uint64_t)64)) & (uint64_t)0x1);
+	return (int)((shiftGateMaskLow[gateType] >> shiftAmt) & (uint64_t)0x1);
+}
+
+
+// Checks that GatePatternTable gives the gates of the shifts above (and of the 24 slot ones, which are every 
+// fourth slot) for the original gate types, for every pulsesPerStep and pulse
+static void checkGatePatterns(const BenchOptions& opts) {
+	int mismatches = 0;
+	for (int gateType = 0; gateType < GATETYPE_TRIG; gateType++) {
+		for (int pps = 1; pps <= 96; pps++) {
+			for (int pulse = 0; pulse < pps; pulse++) {
+				if (gatePatterns96.isHigh(gateType, pps, pulse) != (shiftGate(gateType, pps, pulse) != 0))
+					mismatches++;
+				if (pps <= 24 && gatePatterns24.isHigh(gateType, pps, pulse) != (shiftGate(gateType, 96, pulse * (24 / pps) * 4) != 0))
+					mismatches++;
+			}
+		}
+	}
+	benchPrintNote(opts, string::f("GatePatternTable: %d mismatches with the per pulse shifts", mismatches));
+}
+
+
+// Times opts.seconds worth of calls at the first sample rate; kernel(i) is called once per "sample" and
+// returns a value that is accumulated so that the calls can't be optimized away
+template <typename TKernel>
+static void runDspBenchCase(const BenchOptions& opts, bool* headerDone, const std::string& name, TKernel kernel) {
+	if (!opts.isSelected(name)) {
+		return;
+	}
+	if (!*headerDone) {
+		benchPrintHeader(opts, "DSP helpers, cost per call");
+		*headerDone = true;
+	}
+	float sampleRate = opts.sampleRates[0];
+	int64_t numBlocks = std::max((int64_t)1, (int64_t)(opts.seconds * sampleRate) / opts.blockSize);
+	BenchBlockTimer timer;
+	timer.reserve(numBlocks);
+	volatile float sink = 0.0f;
+	float acc = 0.0f;
+	long allocs = 0;
+
+	int64_t i = 0;
+	for (int64_t b = 0; b < numBlocks; b++) {
+		benchAllocCountStart();
+		timer.start();
+		for (int s = 0; s < opts.blockSize; s++) {
+			acc += kernel(i);
+			i++;
+		}
+		timer.stop();
+		allocs += benchAllocCountStop();
+	}
+	sink = acc;
+	(void)sink;
+
+	BenchResult res;
+	res.name = name;
+	res.sampleRate = sampleRate;
+	res.nsPerSample = (double)timer.totalNs / (double)i;
+	res.p99BlockNs = timer.percentile(99.0);
+	res.allocsPerCall = (double)allocs / (double)i;
+	benchPrintResult(opts, res);
+}
+
+
+void runDspBenchSuite(const BenchOptions& opts) {
+	bool headerDone = false;
+	
+	// Pitch sweep over +-5 octaves, changing on every call, as with audio rate modulation
+	auto pitchAt = [](int64_t i) {
+		return (float)(i % 4096) * (10.0f / 4096.0f) - 5.0f;
+	};
+	
+	runDspBenchCase(opts, &headerDone, "exp2 std::pow", [&](int64_t i) {
+		return std::pow(2.0f, pitchAt(i));
+	});
+	runDspBenchCase(opts, &headerDone, "exp2 simd::pow float_4", [&](int64_t i) {
+		simd::float_4 v = simd::pow(2.0f, simd::float_4(pitchAt(i)) + simd::float_4(0.0f, 0.1f, 0.2f, 0.3f));
+		return v[0] + v[3];
+	});
+	runDspBenchCase(opts, &headerDone, "exp2 dsp::exp2_taylor5 float_4", [&](int64_t i) {
+		simd::float_4 v = dsp::exp2_taylor5(simd::float_4(pitchAt(i)) + simd::float_4(0.0f, 0.1f, 0.2f, 0.3f));
+		return v[0] + v[3];
+	});
+	
+	// VCO of SemiModularSynth, four voices with all four waveforms computed (digital mode, no sync), the 8x 
+	// oversampled oscillator that it replaced against one float_4 minBLEP oscillator; divide by four for a voice
+	float sampleTime = 1.0f / opts.sampleRates[0];
+	auto vcoPitchAt = [](int64_t i) {// semitones, a new note every 1024 samples over +-2 octaves
+		return (float)((i >> 10) % 48) - 24.0f;
+	};
+	OversampledVco oversampledVcos[4];
+	for (int v = 0; v < 4; v++)
+		oversampledVcos[v].pw = 0.3f;
+	runDspBenchCase(opts, &headerDone, "VCO 8x oversampled 4 voices", [&](int64_t i) {
+		float out = 0.0f;
+		for (int v = 0; v < 4; v++) {
+			oversampledVcos[v].setPitch(0.0f, vcoPitchAt(i) + (float)v * 0.07f);
+			oversampledVcos[v].process(sampleTime);
+			out += oversampledVcos[v].outputs();
+		}
+		return out;
+	});
+	VoltageControlledOscillator minBlepVco;
+	minBlepVco.setPulseWidth(0.3f);
+	runDspBenchCase(opts, &headerDone, "VCO minBLEP float_4 4 voices", [&](int64_t i) {
+		minBlepVco.setPitch(0.0f, simd::float_4(vcoPitchAt(i)) + simd::float_4(0.0f, 0.07f, 0.14f, 0.21f));
+		minBlepVco.process(sampleTime, 0.0f);
+		simd::float_4 out = minBlepVco.sinValue + minBlepVco.triValue + minBlepVco.sawValue + minBlepVco.sqrValue;
+		return out[0] + out[1] + out[2] + out[3];
+	});
+	
+	// Random generators, per value (the float_4 cases produce four values per call)
+	RandomStream rng;
+	runDspBenchCase(opts, &headerDone, "random::uniform", [&](int64_t i) {
+		return random::uniform();
+	});
+	runDspBenchCase(opts, &headerDone, "RandomStream::uniform", [&](int64_t i) {
+		return rng.uniform();
+	});
+	runDspBenchCase(opts, &headerDone, "random::normal", [&](int64_t i) {
+		return random::normal();
+	});
+	runDspBenchCase(opts, &headerDone, "RandomStream::normal", [&](int64_t i) {
+		return rng.normal();
+	});
+	runDspBenchCase(opts, &headerDone, "random::normal x4", [&](int64_t i) {
+		simd::float_4 v(random::normal(), random::normal(), random::normal(), random::normal());
+		return v[0] + v[3];
+	});
+	runDspBenchCase(opts, &headerDone, "RandomStream::normal4", [&](int64_t i) {
+		simd::float_4 v = rng.normal4();
+		return v[0] + v[3];
+	});
+	
+	// Foundry step edits on a full 32 step sequence, as done by the knobs and keys (rotations over most of the knob range, 
+	// and multi-step edits of all steps)
+	bool holdTiedNotes = true;
+	int stopAtEndOfSong = 4;
+	SequencerKernel sek(0, nullptr, &holdTiedNotes, &stopAtEndOfSong);
+	runDspBenchCase(opts, &headerDone, "Foundry rotateSeq 90 steps", [&](int64_t i) {
+		sek.rotateSeq((i & 1) != 0 ? -90 : 90);
+		return sek.getCV(0);
+	});
+	runDspBenchCase(opts, &headerDone, "Foundry gate+velocity 32 steps", [&](int64_t i) {
+		sek.setGate(0, (i & 1) != 0, 32);
+		sek.setVelocityVal(0, (int)(i & 127), 32);
+		return (float)sek.getAttribute(5).getVelocityVal();
+	});
+	runDspBenchCase(opts, &headerDone, "Foundry transposeSeq", [&](int64_t i) {
+		sek.transposeSeq((i & 1) != 0 ? -12 : 12);
+		return sek.getCV(3);
+	});
+	
+	// Random order without repeats (RNS run modes), one call per clock step
+	ListSingleRandom listRandom;
+	SingleRandom<32> stepRandom;
+	SingleRandom<99> phraseRandom;
+	SingleRandom<256> bigRandom;
+	runDspBenchCase(opts, &headerDone, "RNS list 32 steps", [&](int64_t i) {
+		return (float)listRandom.getNext(32, rng.u32());
+	});
+	runDspBenchCase(opts, &headerDone, "RNS SingleRandom 32 steps", [&](int64_t i) {
+		return (float)stepRandom.getNext(32, rng.u32());
+	});
+	runDspBenchCase(opts, &headerDone, "RNS SingleRandom 99 phrases", [&](int64_t i) {
+		return (float)phraseRandom.getNext(99, rng.u32());
+	});
+	runDspBenchCase(opts, &headerDone, "RNS SingleRandom 256 steps", [&](int64_t i) {
+		return (float)bigRandom.getNext(256, rng.u32());
+	});
+	if (opts.isSelected("RNS SingleRandom")) {
+		for (int length : {2, 7, 32, 64, 99, 128, 200, 256})
+			checkSingleRandom(opts, length);
+	}
+	
+	// Gate of each pulse of a step, for the gate types and pulses per step of a Foundry track (one call per clock pulse)
+	auto gateTypeAt = [](int64_t i) {
+		return (int)((i >> 7) % GATETYPE_TRIG);
+	};
+	auto ppsAt = [](int64_t i) {
+		return 2 + (int)((i >> 4) % 48) * 2;
+	};
+	runDspBenchCase(opts, &headerDone, "gate shifts 96 slots", [&](int64_t i) {
+		int pps = ppsAt(i);
+		return (float)shiftGate(gateTypeAt(i), pps, (int)(i % pps));
+	});
+	runDspBenchCase(opts, &headerDone, "gate GatePatternTable 96 slots", [&](int64_t i) {
+		int pps = ppsAt(i);
+		return gatePatterns96.isHigh(gateTypeAt(i), pps, (int)(i % pps)) ? 1.0f : 0.0f;
+	});
+	if (opts.isSelected("gate GatePatternTable")) {
+		checkGatePatterns(opts);
+	}
+}
@@ -0,0 +1,89 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//Runs the modules' process() outside of Rack, against a minimal engine context (no window,
+//scene or audio thread), and reports ns/sample, p99 cost per block and heap allocations per
+//process() call. Built and run with "make bench" from the plugin's directory, options are passed
+//with BENCH_ARGS="..." or by running the executable directly:
+//
+//  build/ImpromptuBench [-r rate[,rate...]] [-s seconds] [-b blockSize] [-csv] [filter]
+//
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "BenchUtil.hpp"
+
+
+static void printUsage() {
+	printf("Usage: ImpromptuBench [-r rate[,rate...]] [-s seconds] [-b blockSize] [-csv] [filter]\n");
+	printf("  -r     sample rate(s) in Hz, comma separated (default 48000)\n");
+	printf("  -s     measured seconds of audio per case (default 2)\n");
+	printf("  -b     block size in samples, used for the p99 measurement (default 64)\n");
+	printf("  -csv   machine readable output, for keeping regression baselines\n");
+	printf("  filter only run cases whose name contains this string\n");
+}
+
+
+static bool parseOptions(int argc, char** argv, BenchOptions* opts) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-r" && i + 1 < argc) {
+			opts->sampleRates.clear();
+			std::string rates = argv[++i];
+			size_t pos = 0;
+			while (pos != std::string::npos) {
+				size_t comma = rates.find(',', pos);
+				float rate = std::atof(rates.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos).c_str());
+				if (rate < 1000.0f) {
+					return false;
+				}
+				opts->sampleRates.push_back(rate);
+				pos = (comma == std::string::npos ? comma : comma + 1);
+			}
+		}
+		else if (arg == "-s" && i + 1 < argc) {
+			opts->seconds = std::atof(argv[++i]);
+			if (opts->seconds <= 0.0f) {
+				return false;
+			}
+		}
+		else if (arg == "-b" && i + 1 < argc) {
+			opts->blockSize = std::atoi(argv[++i]);
+			if (opts->blockSize < 1) {
+				return false;
+			}
+		}
+		else if (arg == "-csv") {
+			opts->csv = true;
+		}
+		else if (!arg.empty() && arg[0] != '-') {
+			opts->filter = arg;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+int main(int argc, char** argv) {
+	BenchOptions opts;
+	if (!parseOptions(argc, argv, &opts)) {
+		printUsage();
+		return 1;
+	}
+
+	// Minimal engine context: modules only need APP->engine (for the sample rate) and the random generator
+	random::init();
+	contextSet(new Context);
+	APP->engine = new engine::Engine;
+
+	runModuleBenchSuite(opts);
+	runDspBenchSuite(opts);
+	runPatchBenchSuite(opts);
+	runClockSyncBenchSuite(opts);
+
+	return 0;
+}
@@ -0,0 +1,388 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//Module suite: instantiates each Model against the stubbed engine, feeds scripted clock, gate
+//and CV inputs and measures the cost of process()
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "BenchUtil.hpp"
+
+
+enum StimulusIds {
+	STIM_CLOCK,// square wave at the case's clock rate, 0V/10V
+	STIM_GATE,// square wave at half the clock rate, phase shifted per channel
+	STIM_NOTES,// stepped pitch CV, new note on each clock period, -2V to +2V in semitones
+	STIM_LFO,// 0.5 Hz sine, -5V to +5V, phase shifted per channel
+	STIM_AUDIO,// naive saw wave at 110 Hz (times channel number), -5V to +5V
+	STIM_CONST// constant voltage given in Stimulus::value
+};
+
+
+struct Stimulus {
+	std::string inputName;// must match the name given to configInput() in the module
+	int type;
+	int channels;
+	float value;
+
+	Stimulus(std::string _inputName, int _type, int _channels = 1, float _value = 0.0f) {
+		inputName = _inputName;
+		type = _type;
+		channels = _channels;
+		value = _value;
+	}
+};
+
+
+struct ModuleBenchCase {
+	std::string name;
+	Model* model;
+	std::vector<Stimulus> stimuli;
+	float clockHz;// rate of STIM_CLOCK, notes change at this rate also
+	std::function<bool(Module*)> setup;// optional, called once after the module is created (params, dataFromJson, etc.), false skips the case
+
+	ModuleBenchCase(std::string _name, Model* _model, std::vector<Stimulus> _stimuli = {}, float _clockHz = 8.0f, std::function<bool(Module*)> _setup = nullptr) {
+		name = _name;
+		model = _model;
+		stimuli = _stimuli;
+		clockHz = _clockHz;
+		setup = _setup;
+	}
+};
+
+
+// Helpers for case setup
+
+static int findInputId(Module* module, const std::string& name) {
+	for (int i = 0; i < (int)module->inputInfos.size(); i++) {
+		if (module->inputInfos[i] && module->inputInfos[i]->name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int findParamId(Module* module, const std::string& name) {
+	for (int i = 0; i < (int)module->paramQuantities.size(); i++) {
+		if (module->paramQuantities[i] && module->paramQuantities[i]->name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Foundry in song mode, playing 16 phrases of 8 sequences with various lengths and ping-pong/pendulum/reverse run modes
+// in all 4 tracks
+static bool setupFoundrySong(Module* module) {
+	int modeParamId = findParamId(module, "Seq/song mode");
+	if (modeParamId < 0)
+		return false;
+	json_t* rootJ = module->dataToJson();
+	for (int trkn = 0; trkn < 4; trkn++) {
+		std::string ids = "id" + std::to_string(trkn) + "_";
+		json_object_set_new(rootJ, (ids + "runModeSong").c_str(), json_integer(2));// PPG
+		json_object_set_new(rootJ, (ids + "songEndIndex").c_str(), json_integer(15));
+		json_t *phrasesJ = json_array();
+		for (int phrn = 0; phrn < 16; phrn++) {
+			// seq number, and reps stored minus one
+			json_array_append_new(phrasesJ, json_integer(((phrn * 3 + trkn) % 8) | ((phrn % 3) << 8)));
+		}
+		json_object_set_new(rootJ, (ids + "phrases").c_str(), phrasesJ);
+		json_t *sequencesJ = json_array();
+		for (int seqn = 0; seqn < 8; seqn++) {
+			// length, and run mode REV, PPG or PEN
+			json_array_append_new(sequencesJ, json_integer((5 + seqn * 3) | ((1 + seqn % 3) << 8)));
+		}
+		json_object_set_new(rootJ, (ids + "sequences").c_str(), sequencesJ);
+	}
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+	module->params[modeParamId].setValue(0.0f);
+	return true;
+}
+
+// Foundry with all its tracks running (the tracks after A follow track A's clock), at the given pulses per step (stored 
+// value, see SequencerKernel::getPulsesPerStep())
+static bool setupFoundryPps(Module* module, int storedPps, int numTracks = 4) {
+	json_t* rootJ = module->dataToJson();
+	json_object_set_new(rootJ, "numTracks", json_integer(numTracks));
+	for (int trkn = 0; trkn < numTracks; trkn++) {
+		std::string ids = "id" + std::to_string(trkn) + "_";
+		json_object_set_new(rootJ, (ids + "pulsesPerStep").c_str(), json_integer(storedPps));
+	}
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+	return true;
+}
+
+// Clocked or Clkd with the given number of clocks on its poly master output
+static bool setupPolyClocks(Module* module, int channels) {
+	json_t* rootJ = module->dataToJson();
+	json_object_set_new(rootJ, "polyChannels", json_integer(channels));
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+	return true;
+}
+
+// Deterministic pseudo-random note for a given clock period and channel, so that all runs see the same stimulus
+static float benchNote(uint32_t period, int chan) {
+	uint32_t h = period * 2654435761u + (uint32_t)chan * 40503u;
+	h ^= h >> 15;
+	h *= 2246822519u;
+	h ^= h >> 13;
+	return (float)((int)(h % 49) - 24) / 12.0f;
+}
+
+
+static float stimulusVoltage(const Stimulus& stim, int chan, int64_t frame, float sampleRate, float clockHz) {
+	double t = (double)frame / sampleRate;
+	switch (stim.type) {
+		case STIM_CLOCK : {
+			double ph = t * clockHz;
+			return (ph - std::floor(ph)) < 0.5 ? 10.0f : 0.0f;
+		}
+		case STIM_GATE : {
+			double ph = t * clockHz * 0.5 + 0.25 + 0.1 * chan;
+			return (ph - std::floor(ph)) < 0.5 ? 10.0f : 0.0f;
+		}
+		case STIM_NOTES : {
+			return benchNote((uint32_t)(t * clockHz), chan);
+		}
+		case STIM_LFO : {
+			return 5.0f * std::sin(2.0 * M_PI * 0.5 * t + chan);
+		}
+		case STIM_AUDIO : {
+			double ph = t * 110.0 * (chan + 1);
+			return 10.0f * (float)(ph - std::floor(ph)) - 5.0f;
+		}
+		default : {
+			return stim.value;
+		}
+	}
+}
+
+
+static bool runModuleBenchCase(const BenchOptions& opts, const ModuleBenchCase& bcase, float sampleRate, BenchResult* res) {
+	APP->engine->setSampleRate(sampleRate);
+	Module* module = bcase.model->createModule();
+	Module::SampleRateChangeEvent srce;
+	srce.sampleRate = sampleRate;
+	srce.sampleTime = 1.0f / sampleRate;
+	module->onSampleRateChange(srce);
+
+	// all outputs are connected, so that modules that skip work on unpatched outputs still do it
+	for (Output& output : module->outputs) {
+		output.setChannels(1);
+	}
+
+	std::vector<int> inputIds;
+	for (const Stimulus& stim : bcase.stimuli) {
+		int id = findInputId(module, stim.inputName);
+		if (id < 0) {
+			benchPrintNote(opts, string::f("%s: input \"%s\" not found, case skipped", bcase.name.c_str(), stim.inputName.c_str()));
+			delete module;
+			return false;
+		}
+		module->inputs[id].setChannels(stim.channels);
+		inputIds.push_back(id);
+	}
+
+	if (bcase.setup && !bcase.setup(module)) {
+		benchPrintNote(opts, string::f("%s: a param of the case setup was not found, case skipped", bcase.name.c_str()));
+		delete module;
+		return false;
+	}
+
+	// stimulus is precomputed per block, outside of the timed region
+	int numStims = (int)bcase.stimuli.size();
+	std::vector<float> stimBuf(std::max(1, numStims) * PORT_MAX_CHANNELS * opts.blockSize);
+
+	Module::ProcessArgs args;
+	args.sampleRate = sampleRate;
+	args.sampleTime = 1.0f / sampleRate;
+	args.frame = 0;
+
+	int64_t warmupFrames = (int64_t)(opts.warmupSeconds * sampleRate);
+	int64_t numBlocks = std::max((int64_t)1, (int64_t)(opts.seconds * sampleRate) / opts.blockSize);
+	BenchBlockTimer timer;
+	timer.reserve(numBlocks);
+	long allocs = 0;
+
+	for (int64_t b = -(warmupFrames / opts.blockSize); b < numBlocks; b++) {
+		for (int s = 0; s < numStims; s++) {
+			const Stimulus& stim = bcase.stimuli[s];
+			for (int i = 0; i < opts.blockSize; i++) {
+				for (int c = 0; c < stim.channels; c++) {
+					stimBuf[(s * opts.blockSize + i) * PORT_MAX_CHANNELS + c] = stimulusVoltage(stim, c, args.frame + i, sampleRate, bcase.clockHz);
+				}
+			}
+		}
+		bool measured = (b >= 0);
+		if (measured) {
+			benchAllocCountStart();
+			timer.start();
+		}
+		for (int i = 0; i < opts.blockSize; i++) {
+			for (int s = 0; s < numStims; s++) {
+				std::memcpy(module->inputs[inputIds[s]].voltages, &stimBuf[(s * opts.blockSize + i) * PORT_MAX_CHANNELS], sizeof(float) * bcase.stimuli[s].channels);
+			}
+			module->process(args);
+			args.frame++;
+		}
+		if (measured) {
+			timer.stop();
+			allocs += benchAllocCountStop();
+		}
+	}
+
+	int64_t measuredFrames = numBlocks * opts.blockSize;
+	res->name = bcase.name;
+	res->sampleRate = sampleRate;
+	res->nsPerSample = (double)timer.totalNs / (double)measuredFrames;
+	res->p99BlockNs = timer.percentile(99.0);
+	res->allocsPerCall = (double)allocs / (double)measuredFrames;
+
+	delete module;
+	return true;
+}
+
+
+void runModuleBenchSuite(const BenchOptions& opts) {
+	// Built here rather than statically, since the models are created by static initializers in other translation units
+	std::vector<ModuleBenchCase> cases = {
+		ModuleBenchCase("AdaptiveQuantizer", modelAdaptiveQuantizer, {
+			Stimulus("CV", STIM_NOTES),
+			Stimulus("Gate", STIM_GATE),
+			Stimulus("Reference CV", STIM_NOTES),
+			Stimulus("Reference Gate", STIM_CLOCK)}),
+		ModuleBenchCase("AdaptiveQuantizer-16ch", modelAdaptiveQuantizer, {
+			Stimulus("CV", STIM_NOTES, 16),
+			Stimulus("Gate", STIM_GATE, 16),
+			Stimulus("Reference CV", STIM_NOTES),
+			Stimulus("Reference Gate", STIM_CLOCK)}),
+		// dense reference gates with CV modulated persistence, weights are updated on each note and persistence change
+		ModuleBenchCase("AdaptiveQuantizer-PersistCV", modelAdaptiveQuantizer, {
+			Stimulus("CV", STIM_NOTES),
+			Stimulus("Gate", STIM_GATE),
+			Stimulus("Reference CV", STIM_NOTES),
+			Stimulus("Reference Gate", STIM_CLOCK),
+			Stimulus("Persistence", STIM_LFO)}, 100.0f),
+		ModuleBenchCase("AdaptiveQuantizer-PersistCV-OctW", modelAdaptiveQuantizer, {
+			Stimulus("CV", STIM_NOTES),
+			Stimulus("Gate", STIM_GATE),
+			Stimulus("Reference CV", STIM_NOTES),
+			Stimulus("Reference Gate", STIM_CLOCK),
+			Stimulus("Persistence", STIM_LFO),
+			Stimulus("Octave weighting", STIM_CONST, 1, 2.5f)}, 100.0f),
+		ModuleBenchCase("AdaptiveQuantizer-WeightingAudioCV", modelAdaptiveQuantizer, {
+			Stimulus("CV", STIM_NOTES),
+			Stimulus("Gate", STIM_GATE),
+			Stimulus("Reference CV", STIM_NOTES),
+			Stimulus("Reference Gate", STIM_CLOCK),
+			Stimulus("Octave weighting", STIM_AUDIO),
+			Stimulus("Duration weighting", STIM_AUDIO)}, 100.0f),
+		ModuleBenchCase("BigButtonSeq", modelBigButtonSeq, {
+			Stimulus("Clock", STIM_CLOCK)}),
+		ModuleBenchCase("BigButtonSeq2", modelBigButtonSeq2, {
+			Stimulus("Clock", STIM_CLOCK)}),
+		ModuleBenchCase("ChordKey", modelChordKey, {
+			Stimulus("Index", STIM_LFO),
+			Stimulus("Gate", STIM_GATE)}),
+		ModuleBenchCase("ChordKeyExpander", modelChordKeyExpander),
+		ModuleBenchCase("Clocked", modelClocked),
+		ModuleBenchCase("Clocked-Poly16", modelClocked, {}, 8.0f, [](Module* m) {return setupPolyClocks(m, 16);}),
+		ModuleBenchCase("ClockedExpander", modelClockedExpander),
+		ModuleBenchCase("Clkd", modelClkd),
+		ModuleBenchCase("Clkd-Poly16", modelClkd, {}, 8.0f, [](Module* m) {return setupPolyClocks(m, 16);}),
+		ModuleBenchCase("CvPad", modelCvPad),
+		ModuleBenchCase("Foundry", modelFoundry, {
+			Stimulus("Track A clock", STIM_CLOCK),
+			Stimulus("Track A CV", STIM_NOTES)}),
+		// a clock step every 4 samples (12 kHz at 48 kHz), so that the walk through the song dominates
+		ModuleBenchCase("Foundry-Song-AudioClock", modelFoundry, {
+			Stimulus("Track A clock", STIM_CLOCK)}, 12000.0f, setupFoundrySong),
+		// same step rate of 8 Hz, with 1 and 24 clock pulses per step
+		ModuleBenchCase("Foundry-4trk-1PPQN", modelFoundry, {
+			Stimulus("Track A clock", STIM_CLOCK)}, 8.0f, [](Module* m) {return setupFoundryPps(m, 1);}),
+		ModuleBenchCase("Foundry-4trk-24PPQN", modelFoundry, {
+			Stimulus("Track A clock", STIM_CLOCK)}, 192.0f, [](Module* m) {return setupFoundryPps(m, 13);}),
+		ModuleBenchCase("Foundry-16trk-24PPQN", modelFoundry, {
+			Stimulus("Track A clock", STIM_CLOCK)}, 192.0f, [](Module* m) {return setupFoundryPps(m, 13, 16);}),
+		ModuleBenchCase("FoundryExpander", modelFoundryExpander),
+		ModuleBenchCase("FourView", modelFourView, {
+			Stimulus("CV 1", STIM_NOTES, 4)}),
+		ModuleBenchCase("GateSeq64", modelGateSeq64, {
+			Stimulus("Clock", STIM_CLOCK)}),
+		ModuleBenchCase("GateSeq64Expander", modelGateSeq64Expander),
+		ModuleBenchCase("Hotkey", modelHotkey),
+		ModuleBenchCase("Part", modelPart, {
+			Stimulus("CV", STIM_NOTES, 4),
+			Stimulus("Gate", STIM_GATE, 4)}),
+		ModuleBenchCase("PhraseSeq16", modelPhraseSeq16, {
+			Stimulus("Clock", STIM_CLOCK)}),
+		ModuleBenchCase("PhraseSeq32", modelPhraseSeq32, {
+			Stimulus("Clock", STIM_CLOCK)}),
+		ModuleBenchCase("PhraseSeqExpander", modelPhraseSeqExpander),
+		ModuleBenchCase("ProbKey", modelProbKey, {
+			Stimulus("Gate", STIM_CLOCK),
+			Stimulus("Offset", STIM_LFO)}),
+		ModuleBenchCase("ProbKey-16ch", modelProbKey, {
+			Stimulus("Gate", STIM_GATE, 16),
+			Stimulus("Offset", STIM_LFO, 16)}),
+		ModuleBenchCase("ProbKey-16ch-AudioGate", modelProbKey, {
+			Stimulus("Gate", STIM_GATE, 16),
+			Stimulus("Offset", STIM_LFO, 16)}, 4000.0f),
+		ModuleBenchCase("ProbKey-16ch-AudioGate-CV", modelProbKey, {
+			Stimulus("Gate", STIM_GATE, 16),
+			Stimulus("Offset", STIM_LFO, 16),
+			Stimulus("Squash", STIM_LFO, 16),
+			Stimulus("Density", STIM_CONST, 16, 5.0f)}, 4000.0f),
+		ModuleBenchCase("SemiModularSynth", modelSemiModularSynth),
+		ModuleBenchCase("SemiModularSynth-ADSR", modelSemiModularSynth, {
+			Stimulus("ADSR gate", STIM_GATE)}),
+		ModuleBenchCase("SemiModularSynth-VCO16ch", modelSemiModularSynth, {
+			Stimulus("VCO pitch", STIM_NOTES, 16)}),
+		ModuleBenchCase("SemiModularSynth-VCF16ch", modelSemiModularSynth, {
+			Stimulus("VCF audio", STIM_AUDIO, 16)}),
+		ModuleBenchCase("Sygen", modelSygen, {
+			Stimulus("Gate 1", STIM_GATE),
+			Stimulus("Gate 2", STIM_GATE),
+			Stimulus("Gate 3", STIM_GATE),
+			Stimulus("Gate 4", STIM_GATE)}),
+		ModuleBenchCase("Tact", modelTact),
+		ModuleBenchCase("Tact1", modelTact1),
+		ModuleBenchCase("TactG", modelTactG, {
+			Stimulus("Chain gate", STIM_GATE)}),
+		ModuleBenchCase("TwelveKey", modelTwelveKey, {
+			Stimulus("Gate", STIM_GATE),
+			Stimulus("CV", STIM_NOTES)}),
+		ModuleBenchCase("Variations", modelVariations, {
+			Stimulus("CV", STIM_NOTES),
+			Stimulus("Gate", STIM_GATE)}),
+		ModuleBenchCase("Variations-16ch-Ungated", modelVariations, {
+			Stimulus("CV", STIM_AUDIO, 16)}),
+		ModuleBenchCase("WriteSeq32", modelWriteSeq32, {
+			Stimulus("Clock", STIM_CLOCK)}),
+		ModuleBenchCase("WriteSeq64", modelWriteSeq64, {
+			Stimulus("Clock 1 and 2", STIM_CLOCK)}),
+		ModuleBenchCase("BlankPanel", modelBlankPanel),
+	};
+
+	bool headerDone = false;
+	for (float sampleRate : opts.sampleRates) {
+		for (const ModuleBenchCase& bcase : cases) {
+			if (!opts.isSelected(bcase.name)) {
+				continue;
+			}
+			if (!headerDone) {
+				benchPrintHeader(opts, "Module process() cost");
+				headerDone = true;
+			}
+			BenchResult res;
+			if (runModuleBenchCase(opts, bcase, sampleRate, &res)) {
+				benchPrintResult(opts, res);
+			}
+		}
+	}
+}
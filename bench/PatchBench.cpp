@@ -0,0 +1,243 @@
+//***********************************************************************************************
+//Headless benchmark harness for Impromptu Modular
+//
+//Patch suite: cost of saving and loading module state, as done by Rack on autosave and patch load
+//(dataToJson() plus serialization to text, and parsing plus dataFromJson()), in legacy and packed formats, and
+//the process() call that adopts the loaded data
+//See ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "BenchUtil.hpp"
+
+
+// Same flags as Rack uses when writing patch.json
+static const size_t patchJsonFlags = JSON_INDENT(2) | JSON_REAL_PRECISION(9);
+
+// Foundry dimensions
+static const int foundryTracks = 4;
+static const int foundrySeqs = 64;
+static const int foundrySteps = 32;
+
+
+static void printPatchHeader(const BenchOptions& opts, bool* headerDone) {
+	if (*headerDone) {
+		return;
+	}
+	if (opts.csv) {
+		printf("# Patch save and load, cost per operation\n");
+		printf("name,usPerOp,p99Us,allocsPerOp,jsonBytes\n");
+	}
+	else {
+		printf("\nPatch save and load, cost per operation (%.1f s per case)\n", opts.seconds);
+		printf("%-32s %12s %12s %12s %12s\n", "Case", "us/op", "p99 us", "allocs/op", "json bytes");
+	}
+	*headerDone = true;
+}
+
+
+// Repeats op() for opts.seconds of wall time (at least 5 times); op() returns the size of the json text it handled.
+// prepare() is called before each op(), outside of the timed region.
+template <typename TPrepare, typename TOp>
+static void runPatchBenchCase(const BenchOptions& opts, bool* headerDone, const std::string& name, TPrepare prepare, TOp op) {
+	if (!opts.isSelected(name)) {
+		return;
+	}
+	printPatchHeader(opts, headerDone);
+
+	prepare();
+	op();// warmup
+	BenchBlockTimer timer;
+	timer.reserve(4096);
+	long allocs = 0;
+	size_t jsonBytes = 0;
+	int64_t budgetNs = (int64_t)(opts.seconds * 1e9);
+	int numOps = 0;
+	while (numOps < 5 || (timer.totalNs < budgetNs && numOps < 4096)) {
+		prepare();
+		benchAllocCountStart();
+		timer.start();
+		jsonBytes = op();
+		timer.stop();
+		allocs += benchAllocCountStop();
+		numOps++;
+	}
+
+	double usPerOp = (double)timer.totalNs / (double)numOps * 1e-3;
+	double p99Us = timer.percentile(99.0) * 1e-3;
+	double allocsPerOp = (double)allocs / (double)numOps;
+	if (opts.csv) {
+		printf("%s,%.3f,%.3f,%.1f,%zu\n", name.c_str(), usPerOp, p99Us, allocsPerOp, jsonBytes);
+	}
+	else {
+		printf("%-32s %12.1f %12.1f %12.1f %12zu\n", name.c_str(), usPerOp, p99Us, allocsPerOp, jsonBytes);
+	}
+	fflush(stdout);
+}
+
+template <typename TOp>
+static void runPatchBenchCase(const BenchOptions& opts, bool* headerDone, const std::string& name, TOp op) {
+	runPatchBenchCase(opts, headerDone, name, []() {}, op);
+}
+
+
+// Foundry with every sequence of every track edited (all of them "dirty", so all are saved), built through
+// dataFromJson() with legacy arrays of random steps
+static Module* createDirtyFoundry() {
+	Module* module = modelFoundry->createModule();
+	json_t* rootJ = module->dataToJson();
+	for (int trkn = 0; trkn < foundryTracks; trkn++) {
+		std::string ids = "id" + std::to_string(trkn) + "_";
+		json_t *seqSavedJ = json_array();
+		json_t *cvJ = json_array();
+		json_t *attributesJ = json_array();
+		for (int seqn = 0; seqn < foundrySeqs; seqn++) {
+			json_array_append_new(seqSavedJ, json_integer(1));
+			for (int stepn = 0; stepn < foundrySteps; stepn++) {
+				json_array_append_new(cvJ, json_real((float)(random::u32() % 60) / 12.0f - 2.0f));
+				// gate, gate p and slide bits plus random velocity, gate p and slide values
+				uint32_t attribute = (random::u32() & 0x07000000) | ((random::u32() % 101) << 8) | ((random::u32() % 101) << 16) | (random::u32() % 201);
+				json_array_append_new(attributesJ, json_integer(attribute));
+			}
+		}
+		json_object_set_new(rootJ, (ids + "seqSaved").c_str(), seqSavedJ);
+		json_object_set_new(rootJ, (ids + "cv").c_str(), cvJ);
+		json_object_set_new(rootJ, (ids + "attributes").c_str(), attributesJ);
+	}
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+	return module;
+}
+
+
+static void setPackedPatchData(Module* module, bool packed) {
+	json_t* rootJ = module->dataToJson();
+	json_object_set_new(rootJ, "packedPatchData", json_boolean(packed));
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+}
+
+
+static std::string savePatchText(Module* module) {
+	json_t* rootJ = module->dataToJson();
+	char* text = json_dumps(rootJ, patchJsonFlags);
+	json_decref(rootJ);
+	std::string ret = text;
+	free(text);
+	return ret;
+}
+
+
+// Step arrays of all tracks as text, when the module saves in the legacy format
+static std::string foundryStepsText(Module* module) {
+	json_t* rootJ = module->dataToJson();
+	std::string ret;
+	for (int trkn = 0; trkn < foundryTracks; trkn++) {
+		std::string ids = "id" + std::to_string(trkn) + "_";
+		for (const char* key : {"seqSaved", "cv", "attributes"}) {
+			json_t* arrayJ = json_object_get(rootJ, (ids + key).c_str());
+			if (arrayJ) {
+				char* text = json_dumps(arrayJ, patchJsonFlags);
+				ret += text;
+				free(text);
+			}
+		}
+	}
+	json_decref(rootJ);
+	return ret;
+}
+
+
+// Cost of the process() call that adopts what dataFromJson() loaded (see JsonHandoff.hpp), which copies the
+// module's steps and song on the engine thread and resets the run state. The caches are flushed before each call,
+// since in Rack the data was just written by the UI thread, on another core.
+static void runAdoptBenchCase(const BenchOptions& opts, bool* headerDone, const std::string& name, Model* model) {
+	if (!opts.isSelected(name)) {
+		return;
+	}
+	Module* module = model->createModule();
+	Module::ProcessArgs args;
+	args.sampleRate = 48000.0f;
+	args.sampleTime = 1.0f / args.sampleRate;
+	args.frame = 0;
+	module->process(args);
+	json_t* rootJ = module->dataToJson();
+	char* text = json_dumps(rootJ, patchJsonFlags);
+	size_t jsonBytes = strlen(text);
+	free(text);
+
+	std::vector<char> cacheFlush(32 << 20);
+	runPatchBenchCase(opts, headerDone, name, [&]() {
+		module->dataFromJson(rootJ);
+		std::memset(cacheFlush.data(), (int)args.frame, cacheFlush.size());
+	}, [&]() {
+		module->process(args);
+		args.frame++;
+		return jsonBytes;
+	});
+	json_decref(rootJ);
+	delete module;
+}
+
+
+static size_t loadPatchText(Module* module, const std::string& text) {
+	json_error_t error;
+	json_t* rootJ = json_loads(text.c_str(), 0, &error);
+	if (rootJ) {
+		module->dataFromJson(rootJ);
+		json_decref(rootJ);
+	}
+	return text.size();
+}
+
+
+void runPatchBenchSuite(const BenchOptions& opts) {
+	bool headerDone = false;
+	Module* module = createDirtyFoundry();
+	std::string legacySteps = foundryStepsText(module);
+	std::string packedText;
+
+	for (int packed = 0; packed < 2; packed++) {
+		const char* format = packed ? "packed" : "legacy";
+		setPackedPatchData(module, packed != 0);
+		std::string text = savePatchText(module);
+		if (packed) {
+			packedText = text;
+		}
+
+		runPatchBenchCase(opts, &headerDone, string::f("Foundry-dirty-save-%s", format), [&]() {
+			json_t* rootJ = module->dataToJson();
+			char* saved = json_dumps(rootJ, patchJsonFlags);
+			json_decref(rootJ);
+			size_t size = strlen(saved);
+			free(saved);
+			return size;
+		});
+		runPatchBenchCase(opts, &headerDone, string::f("Foundry-dirty-load-%s", format), [&]() {
+			return loadPatchText(module, text);
+		});
+	}
+	delete module;
+
+	// a fresh module loaded from the packed blob must hold exactly the same steps as the legacy arrays
+	if (headerDone) {
+		Module* check = modelFoundry->createModule();
+		loadPatchText(check, packedText);
+		setPackedPatchData(check, false);
+		if (foundryStepsText(check) != legacySteps) {
+			benchPrintNote(opts, "Foundry: steps loaded from the packed format differ from the legacy format");
+		}
+		delete check;
+	}
+	
+	runAdoptBenchCase(opts, &headerDone, "Foundry-adopt", modelFoundry);
+	runAdoptBenchCase(opts, &headerDone, "PhraseSeq16-adopt", modelPhraseSeq16);
+	runAdoptBenchCase(opts, &headerDone, "PhraseSeq32-adopt", modelPhraseSeq32);
+	runAdoptBenchCase(opts, &headerDone, "SemiModularSynth-adopt", modelSemiModularSynth);
+	runAdoptBenchCase(opts, &headerDone, "GateSeq64-adopt", modelGateSeq64);
+	runAdoptBenchCase(opts, &headerDone, "BigButtonSeq-adopt", modelBigButtonSeq);
+	runAdoptBenchCase(opts, &headerDone, "BigButtonSeq2-adopt", modelBigButtonSeq2);
+	runAdoptBenchCase(opts, &headerDone, "WriteSeq32-adopt", modelWriteSeq32);
+	runAdoptBenchCase(opts, &headerDone, "WriteSeq64-adopt", modelWriteSeq64);
+	runAdoptBenchCase(opts, &headerDone, "CvPad-adopt", modelCvPad);
+}
@@ -78,7 +78,7 @@ struct AdaptiveQuantizer : Module {
 	bool freeze;
 	bool sampHold;
 	int resetClearsDataTable;
-	float cvOut;
+	float cvOuts[PORT_MAX_CHANNELS];// CV_INPUT/CV_OUTPUT are polyphonic, all channels quantize with the same qdist[]
 	float chordOut[5];
 	int8_t notes[DTSIZE] = {};// contains note numbers from 0 to 11 (chromatic pitches)
 	int8_t octs[DTSIZE] = {};// contains octave number for notes
@@ -93,17 +93,24 @@ struct AdaptiveQuantizer : Module {
 	int numPitch;// must update target when changes
 	int persistence;// must update weights when changes
 	int offset;// must update weights when changes
-	float octw;// must update weights when changes
+	float octw;// must update octRatios and weights when changes
 	float durw;// must update weights when changes
 	float weights[12];// must update target when changes; weights are 0 to 1
 	int weightAges[12];// follows weights, 0 when no weight, > 0 to indicate youngest age for each notes
-	std::vector<WeightAndIndex> sortedWeights;// follows weights[]
+	std::vector<WeightAndIndex> sortedWeights;// follows weights[], only the first max(numPitch, 5) entries are sorted
 	int targets;// aka target pitches, must follow weights and numPitch, must call updateRanges() when changed, bit0 = C, bit11 = B
 	int qdist[12];// number of semitones distance (offset) in order to quantize; must follow targets
 	long infoDataTable;// 0 when no info (i.e. just weights), positive downward step counter timer when showing data fill status
 	bool pending;
 	float pendingCv;
 	long durationCount;
+	// persistence window, as a circular range of data table indexes, with per note event counts kept up to date 
+	// as the window slides (see moveWindow()); used by updateWeights() when no weighting is active
+	bool windowValid = false;// when false, counts are rebuilt on next move
+	int windowStart;// data table index of oldest event in the window
+	int windowLength;
+	int windowCounts[12];
+	float octRatios[7];// octave weighting ratio for octaves -3 to 3 (others are clamped), follows octw, see updateOctRatios()
 
 	// No need to save, no reset
 	RefreshCounter refresh;
@@ -114,7 +121,7 @@ struct AdaptiveQuantizer : Module {
 	Trigger freezeTrigger;
 	Trigger sampHoldTrigger;
 	// Trigger sampHoldCvTrigger;
-	Trigger liveGateTrigger;
+	Trigger liveGateTriggers[PORT_MAX_CHANNELS];
 	Trigger intervalModeTrigger;
 	TriggerRiseFall refGateTrigger;
 
@@ -201,7 +208,9 @@ struct AdaptiveQuantizer : Module {
 		freeze = false;
 		sampHold = false;
 		resetClearsDataTable = 1;// 0 means not cleared, 1 means cleared, 2 means copy last n events to start of data table
-		cvOut = 0.0f;
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+			cvOuts[c] = 0.0f;
+		}
 		for (int i = 0; i < 5; i++) {
 			chordOut[i] = 0.0f;
 		}
@@ -217,12 +226,14 @@ struct AdaptiveQuantizer : Module {
 		// duration: no need to clear
 		head = 0;
 		full = false;
+		windowValid = false;
 	}
 	void resetNonJson() {
 		numPitch = getNumPitch();
 		persistence = getPersistence();
 		offset = getOffset();
 		octw = getOctw();
+		updateOctRatios();
 		durw = getDurw();
 		updateWeights();// weights[], weightAges[], sortedWeights, targets, qdist[]
 		infoDataTable = 0l;
@@ -258,6 +269,7 @@ struct AdaptiveQuantizer : Module {
 		}
 		
 		full = false;
+		windowValid = false;
 		
 		// restore preserved events at start of data table
 		for (head = 0; head < actualPrimed; head++) {
@@ -291,8 +303,13 @@ struct AdaptiveQuantizer : Module {
 		// resetClearsDataTable
 		json_object_set_new(rootJ, "resetClearsDataTable", json_integer(resetClearsDataTable));
 		
-		// cvOut
-		json_object_set_new(rootJ, "cvOut", json_real(cvOut));
+		// cvOut (channel 0, kept for older versions) and cvOuts
+		json_object_set_new(rootJ, "cvOut", json_real(cvOuts[0]));
+		json_t *cvOutsJ = json_array();
+		for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+			json_array_insert_new(cvOutsJ, c, json_real(cvOuts[c]));
+		}
+		json_object_set_new(rootJ, "cvOuts", cvOutsJ);
 
 		// chordOut
 		json_t *chordOutJ = json_array();
@@ -346,6 +363,8 @@ struct AdaptiveQuantizer : Module {
 
 
 	void dataFromJson(json_t *rootJ) override {
+		windowValid = false;
+		
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ) {
@@ -381,10 +400,21 @@ struct AdaptiveQuantizer : Module {
 			resetClearsDataTable = json_integer_value(resetClearsDataTableJ);
 		}
 
-		// cvOut
-		json_t *cvOutJ = json_object_get(rootJ, "cvOut");
-		if (cvOutJ) {
-			cvOut = json_number_value(cvOutJ);
+		// cvOuts, or cvOut for patches saved before polyphony
+		json_t *cvOutsJ = json_object_get(rootJ, "cvOuts");
+		if (cvOutsJ && json_is_array(cvOutsJ)) {
+			for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+				json_t *cvOutsArrayJ = json_array_get(cvOutsJ, c);
+				if (cvOutsArrayJ) {
+					cvOuts[c] = json_number_value(cvOutsArrayJ);
+				}
+			}
+		}
+		else {
+			json_t *cvOutJ = json_object_get(rootJ, "cvOut");
+			if (cvOutJ) {
+				cvOuts[0] = json_number_value(cvOutJ);
+			}
 		}
 
 		// chordOut
@@ -537,6 +567,7 @@ struct AdaptiveQuantizer : Module {
 			float newOctw = getOctw();
 			if (octw != newOctw) {
 				octw = newOctw;
+				updateOctRatios();
 				updateWeights();
 			}
 			
@@ -566,8 +597,7 @@ struct AdaptiveQuantizer : Module {
 				else {// if (refGateEdge == -1) {
 					// falling edge
 					if (pending) {
-						enterNote(pendingCv, ((float)durationCount) * args.sampleTime);
-						updateWeights();
+						enterNote(pendingCv, ((float)durationCount) * args.sampleTime);// also updates weights
 						pending = false;
 						durationCount = 0;
 					}
@@ -582,7 +612,9 @@ struct AdaptiveQuantizer : Module {
 		if (resetTrigger.process(params[RESET_PARAM].getValue() + inputs[RESET_INPUT].getVoltage())) {
 			resetLight = 1.0f;
 			freeze = false;
-			cvOut = 0.0f;
+			for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+				cvOuts[c] = 0.0f;
+			}
 			for (int i = 0; i < 5; i++) {
 				chordOut[i] = 0.0f;
 			}
@@ -601,21 +633,41 @@ struct AdaptiveQuantizer : Module {
 		
 		//********** Outputs and lights **********
 		
-		// Gate and CV outputs
-		bool liveGateRise = liveGateTrigger.process(inputs[GATE_INPUT].getVoltage());
-		if (thru) {
-			// 12TET quantizing
-			cvOut = std::round(inputs[CV_INPUT].getVoltage() * 12.0f) / 12.0f;
-		}	
-		else if (!sampHold || liveGateRise) {
-			// cvOut
-			if (targets != 0) {
-				// AQ quantizing
-				cvOut = aqQuantize(inputs[CV_INPUT].getVoltage());
+		// Gate and CV outputs (polyphonic)
+		int cvChannels = std::max(1, inputs[CV_INPUT].getChannels());
+		int gateChannels = std::max(1, inputs[GATE_INPUT].getChannels());
+		int liveGateRises = 0;// bit c is set when channel c's gate rises, the gate is mono or poly
+		for (int c = 0; c < std::max(cvChannels, gateChannels); c++) {
+			float gate = inputs[GATE_INPUT].getPolyVoltage(c);
+			if (liveGateTriggers[c].process(gate)) {
+				liveGateRises |= (0x1 << c);
 			}
+			if (c < gateChannels) {
+				outputs[GATE_OUTPUT].setVoltage(targets != 0 ? gate : 0.0f, c);
+			}
+		}
+		bool liveGateRise = (liveGateRises & 0x1) != 0;// channel 0, for the chord output
+		for (int c = 0; c < cvChannels; c += 4) {
+			simd::float_4 inCv = inputs[CV_INPUT].getVoltageSimd<simd::float_4>(c);
+			simd::float_4 outCv = simd::float_4::load(&cvOuts[c]);
+			if (thru) {
+				// 12TET quantizing
+				outCv = roundHalfAway(inCv * 12.0f) / 12.0f;
+			}	
+			else if (targets != 0) {
+				// AQ quantizing, in sample and hold mode only the channels whose gate rose are updated
+				int updateMask = sampHold ? (liveGateRises >> c) & 0xF : 0xF;
+				if (updateMask != 0) {
+					outCv = simd::ifelse(simd::movemaskInverse<simd::float_4>(updateMask), aqQuantize(inCv), outCv);
+				}
+			}
+			outCv.store(&cvOuts[c]);
+		}
+		outputs[GATE_OUTPUT].setChannels(gateChannels);
+		outputs[CV_OUTPUT].setChannels(cvChannels);
+		for (int c = 0; c < cvChannels; c++) {
+			outputs[CV_OUTPUT].setVoltage(cvOuts[c], c);
 		}
-		outputs[GATE_OUTPUT].setVoltage(targets != 0 ? inputs[GATE_INPUT].getVoltage() : 0.0f);
-		outputs[CV_OUTPUT].setVoltage(cvOut);
 		
 		// Chord output
 		if (!sampHold || liveGateRise) {
@@ -696,6 +748,26 @@ struct AdaptiveQuantizer : Module {
 		return (float)(noteIn + dist) / 12.0f;
 	}
 	
+	// Four channels at once, same result as aqQuantize(float) on each lane; the qdist[] lookup is done per lane
+	simd::float_4 aqQuantize(simd::float_4 inCv) {
+		simd::float_4 noteInFloat = inCv * 12.0f;
+		simd::float_4 noteIn = roundHalfAway(noteInFloat);
+		simd::float_4 noteIn12 = noteIn - 12.0f * simd::floor(noteIn / 12.0f);
+		simd::float_4 dist;
+		for (int i = 0; i < 4; i++) {
+			dist[i] = (float)qdist[clamp((int)noteIn12[i], 0, 11)];
+		}
+		// "greater than" is used so that perfectly equidistant 6 half-step quantizations goes low
+		dist = simd::ifelse((dist == -6.0f) & (noteInFloat > noteIn), 6.0f, dist);
+		return (noteIn + dist) / 12.0f;
+	}
+	
+	// Like std::round(), halfway cases are rounded away from zero
+	static simd::float_4 roundHalfAway(simd::float_4 x) {
+		simd::float_4 xt = simd::trunc(x);
+		return xt + simd::ifelse(simd::fabs(x - xt) >= 0.5f, simd::sgn(x), 0.0f);
+	}
+	
 	
 	void enterNote(float cv, float gateDuration) {
 		// dependants: weights
@@ -710,6 +782,11 @@ struct AdaptiveQuantizer : Module {
 			}
 		}
 
+		if (windowValid && isInWindow(head)) {
+			// overwriting an event that is in the persistence window (when full)
+			windowCounts[notes[head]]--;
+			windowCounts[newNote]++;
+		}
 		notes[head] = newNote;
 		octs[head] = newOct;
 		intervals[head] = (!full && head == 0) ? 0 : notes[head] - notes[eucMod(head - 1, DTSIZE)];// intervals in -11 to 11
@@ -764,6 +841,15 @@ struct AdaptiveQuantizer : Module {
 	}
 	
 	
+	void updateOctRatios() {
+		// same normalization as done per event before, for each possible clamped octave
+		for (int i = 0; i < 7; i++) {
+			float normalized = clamp( ((float)i) / 6.0f, 0.0f, 1.0f);
+			octRatios[i] = convertNormalizedToWeightingRatio(normalized, octw);
+		}
+	}
+	
+	
 	void updateWeights() { 
 		// depends on: data table and many knobs (persistence, offset, weightings)
 		// dependants: targets
@@ -779,6 +865,37 @@ struct AdaptiveQuantizer : Module {
 				weights[i] = 0.0f;
 			}
 		}
+		else if (octw == 0.0f && durw == 0.0f) {
+			// no weighting: weighted freqs are the event counts in the window, kept incrementally, 
+			// identical to the sums of 1.0f done in the general case below
+			int start;
+			int length;
+			getPersistWindow(&start, &length);
+			moveWindow(start, length);
+			
+			// ages, from the newest event, stopping once all the notes in the window have been seen
+			int numNotesInWindow = 0;
+			float maxWeightedFreq = 0.0f;
+			for (int i = 0; i < 12; i++) {
+				if (windowCounts[i] > 0) {
+					numNotesInWindow++;
+				}
+				maxWeightedFreq = std::max(maxWeightedFreq, (float)windowCounts[i]);
+			}
+			for (int i = 0; i < length && numNotesInWindow > 0; i++) {
+				int note = notes[eucMod(start + length - 1 - i, DTSIZE)];
+				if (weightAges[note] == 0) {
+					weightAges[note] = i + 1;
+					numNotesInWindow--;
+				}
+			}
+			
+			// convert weightedFreqs to normalized weights
+			for (int i = 0; i < 12; i++) {
+				float w = (maxWeightedFreq <= 0.0f ? 0.0f : (float)windowCounts[i] / maxWeightedFreq);
+				weights[i] = w;
+			}
+		}
 		else {
 			float weightedFreq[12] = {};
 			float maxDuration = 0.0f;
@@ -797,6 +914,11 @@ struct AdaptiveQuantizer : Module {
 				}
 			}
 			
+			// duration weighting normalization, same for all events in the window
+			bool durWeighting = maxDuration > 0.0f && durw != 0.0f;
+			float avgDuration = sumDuration / (float)numPersistEvents;
+			float maxDeltaDuration = std::max(avgDuration, maxDuration - avgDuration);
+			
 			// calc freqs
 			for (int i = 0; i < numPersistEvents; i++) {
 				int dti = eucMod(head - 1 - i - offset, DTSIZE);
@@ -805,13 +927,11 @@ struct AdaptiveQuantizer : Module {
 				}
 				weightedFreq[notes[dti]] += 1.0f;
 				// apply duration weighting
-				if (maxDuration > 0.0f && durw != 0.0f) {
+				if (durWeighting) {
 					// original version:
 					// float durWeightOffset = clamp(durw * (2.0f * durations[dti] / maxDuration - 1.0f), -1.0f, 1.0f);
 					// weightedFreq[notes[dti]] += durWeightOffset;
 					// new version:
-					float avgDuration = sumDuration / (float)numPersistEvents;
-					float maxDeltaDuration = std::max(avgDuration, maxDuration - avgDuration);
 					float normalized = (durations[dti] - avgDuration) / maxDeltaDuration;// range here is -1 to +1 when symmetrical delta;
 					normalized = normalized * 0.5f + 0.5f;
 					float ratio = convertNormalizedToWeightingRatio(normalized, durw);
@@ -822,10 +942,8 @@ struct AdaptiveQuantizer : Module {
 					// original version:
 					// float octWeightOffset = clamp(octw * ((float)octs[dti]) / 3.0f, -1.0f, 1.0f);
 					// weightedFreq[notes[dti]] = clamp(weightedFreq[notes[dti]] + octWeightOffset, 0.0f, 2.0f);
-					// new version:
-					float normalized = clamp( ((float)(octs[dti] + 3)) / 6.0f, 0.0f, 1.0f);
-					float ratio = convertNormalizedToWeightingRatio(normalized, octw);
-					weightedFreq[notes[dti]] *= ratio;
+					// new version (ratios precomputed in octRatios[]):
+					weightedFreq[notes[dti]] *= octRatios[clamp((int)octs[dti], -3, 3) + 3];
 				}
 			}
 
@@ -848,6 +966,69 @@ struct AdaptiveQuantizer : Module {
 	}
 	
 	
+	void getPersistWindow(int* start, int* length) {
+		// same events as visited by the loops in updateWeights(): from age offset, persistence events 
+		// towards older ones, stopping at the first event when the data table is not full
+		int numEvents = full ? DTSIZE : head;
+		int numPersistEvents = std::min(persistence, numEvents);
+		int newest = eucMod(head - 1 - offset, DTSIZE);
+		if (full) {
+			*length = numPersistEvents;
+		}
+		else {
+			*length = (newest >= head ? 0 : std::min(numPersistEvents, newest + 1));
+		}
+		*start = eucMod(newest - *length + 1, DTSIZE);
+	}
+	
+	
+	bool isInWindow(int dti) {
+		return eucMod(dti - windowStart, DTSIZE) < windowLength;
+	}
+	
+	
+	void moveWindow(int newStart, int newLength) {
+		// updates windowCounts[] by only visiting the events that enter or leave the window, when that is 
+		// cheaper than recounting
+		if (windowValid && windowLength > 0 && newLength > 0) {
+			// in unwrapped coordinates relative to windowStart
+			int lo2 = eucMod(newStart - windowStart, DTSIZE);
+			if (lo2 > DTSIZE / 2) {
+				lo2 -= DTSIZE;
+			}
+			int hi1 = windowLength;
+			int hi2 = lo2 + newLength;
+			int cost = std::abs(lo2) + std::abs(hi2 - hi1);
+			if (lo2 < hi1 && hi2 > 0 && cost < newLength) {
+				for (int x = 0; x < lo2; x++) {
+					windowCounts[notes[eucMod(windowStart + x, DTSIZE)]]--;
+				}
+				for (int x = lo2; x < 0; x++) {
+					windowCounts[notes[eucMod(windowStart + x, DTSIZE)]]++;
+				}
+				for (int x = hi2; x < hi1; x++) {
+					windowCounts[notes[eucMod(windowStart + x, DTSIZE)]]--;
+				}
+				for (int x = hi1; x < hi2; x++) {
+					windowCounts[notes[eucMod(windowStart + x, DTSIZE)]]++;
+				}
+				windowStart = newStart;
+				windowLength = newLength;
+				return;
+			}
+		}
+		for (int i = 0; i < 12; i++) {
+			windowCounts[i] = 0;
+		}
+		for (int x = 0; x < newLength; x++) {
+			windowCounts[notes[eucMod(newStart + x, DTSIZE)]]++;
+		}
+		windowStart = newStart;
+		windowLength = newLength;
+		windowValid = true;
+	}
+	
+	
 	void updateTargets() {
 		// depends on: weights, numPitch
 		// dependants: qdist
@@ -856,7 +1037,24 @@ struct AdaptiveQuantizer : Module {
 			sortedWeights[k].i = k;
 		}
 		
-		std::sort(sortedWeights.begin(), sortedWeights.end(), weightComp);
+		// partial selection of the largest weights, only the first numSorted entries are used (targets and chord output);
+		// ties keep index order on every platform, since a later entry only wins when strictly larger and the skipped ones are shifted, not swapped
+		int numSorted = std::max(numPitch, 5);
+		for (int k = 0; k < numSorted; k++) {
+			int best = k;
+			for (int j = k + 1; j < 12; j++) {
+				if (weightComp(sortedWeights[j], sortedWeights[best])) {
+					best = j;
+				}
+			}
+			if (best != k) {
+				WeightAndIndex bestWeight = sortedWeights[best];
+				for (int j = best; j > k; j--) {
+					sortedWeights[j] = sortedWeights[j - 1];
+				}
+				sortedWeights[k] = bestWeight;
+			}
+		}
 		int newTargets = 0;
 		for (int k = 0; k < numPitch; k++) {
 			if (sortedWeights[k].w <= 0.0f) break;
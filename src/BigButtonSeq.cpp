@@ -14,9 +14,27 @@
 
 
 #include "ImpromptuModular.hpp"
+#include "JsonHandoff.hpp"
 
 
-struct BigButtonSeq : Module {
+// Banks and gates of BigButtonSeq, i.e. what dataFromJson() loads
+struct BigButtonSeqData {
+	// Need to save, with reset
+	int bank[6];
+	uint64_t gates[6][2];// channel , bank
+	
+	
+	void init() {
+		for (int c = 0; c < 6; c++) {
+			bank[c] = 0;
+			gates[c][0] = 0;
+			gates[c][1] = 0;
+		}
+	}
+};
+
+
+struct BigButtonSeq : Module, BigButtonSeqData {// banks and gates are in BigButtonSeqData
 	enum ParamIds {
 		CHAN_PARAM,
 		LEN_PARAM,
@@ -64,8 +82,6 @@ struct BigButtonSeq : Module {
 	
 	// Need to save, with reset
 	int indexStep;
-	int bank[6];
-	uint64_t gates[6][2];// channel , bank
 	int metronomeDiv;
 	bool writeFillsToMemory;
 	bool quantizeBig;
@@ -80,6 +96,7 @@ struct BigButtonSeq : Module {
 	
 	// No need to save, no reset
 	RefreshCounter refresh;	
+	JsonHandoff<BigButtonSeqData> jsonHandoff;// banks and gates loaded by dataFromJson(), adopted by process()
 	float bigLight = 0.0f;
 	float metronomeLightStart = 0.0f;
 	float metronomeLightDiv = 0.0f;
@@ -151,11 +168,7 @@ struct BigButtonSeq : Module {
 	
 	void onReset() override final {
 		indexStep = 0;
-		for (int c = 0; c < 6; c++) {
-			bank[c] = 0;
-			gates[c][0] = 0;
-			gates[c][1] = 0;
-		}
+		BigButtonSeqData::init();
 		metronomeDiv = 4;
 		writeFillsToMemory = false;
 		quantizeBig = true;
@@ -180,6 +193,10 @@ struct BigButtonSeq : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// banks and gates are those loaded by dataFromJson() when process() has not adopted them yet
+		BigButtonSeqData* pendingData = jsonHandoff.peekPending();
+		BigButtonSeqData* sd = (pendingData != nullptr ? pendingData : this);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
@@ -192,7 +209,7 @@ struct BigButtonSeq : Module {
 		// bank
 		json_t *bankJ = json_array();
 		for (int c = 0; c < 6; c++)
-			json_array_insert_new(bankJ, c, json_integer(bank[c]));
+			json_array_insert_new(bankJ, c, json_integer(sd->bank[c]));
 		json_object_set_new(rootJ, "bank", bankJ);
 
 		// gates
@@ -200,7 +217,7 @@ struct BigButtonSeq : Module {
 		for (int c = 0; c < 6; c++)
 			for (int b = 0; b < 8; b++) {// bank to store is like to uint64_t to store, so go to 8
 				// first to get stored is 16 lsbits of bank 0, then next 16 bits,... to 16 msbits of bank 1
-				unsigned int intValue = (unsigned int) ( (uint64_t)0xFFFF & (gates[c][b/4] >> (uint64_t)(16 * (b % 4))) );
+				unsigned int intValue = (unsigned int) ( (uint64_t)0xFFFF & (sd->gates[c][b/4] >> (uint64_t)(16 * (b % 4))) );
 				json_array_insert_new(gatesJ, b + (c << 3) , json_integer(intValue));
 			}
 		json_object_set_new(rootJ, "gates", gatesJ);
@@ -217,11 +234,18 @@ struct BigButtonSeq : Module {
 		// nextStepHits
 		json_object_set_new(rootJ, "nextStepHits", json_boolean(nextStepHits));
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
 		return rootJ;
 	}
 
 
 	void dataFromJson(json_t *rootJ) override {
+		// banks and gates are parsed into the handoff buffer, process() adopts them when they are all there
+		BigButtonSeqData* sd = jsonHandoff.beginWrite();
+		sd->init();
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -244,7 +268,7 @@ struct BigButtonSeq : Module {
 			{
 				json_t *bankArrayJ = json_array_get(bankJ, c);
 				if (bankArrayJ)
-					bank[c] = json_integer_value(bankArrayJ);
+					sd->bank[c] = json_integer_value(bankArrayJ);
 			}
 
 		// gates
@@ -258,8 +282,8 @@ struct BigButtonSeq : Module {
 					if (gateJ)
 						bank8ints[b] = (uint64_t) json_integer_value(gateJ);
 				}
-				gates[c][0] = bank8ints[0] | (bank8ints[1] << (uint64_t)16) | (bank8ints[2] << (uint64_t)32) | (bank8ints[3] << (uint64_t)48);
-				gates[c][1] = bank8ints[4] | (bank8ints[5] << (uint64_t)16) | (bank8ints[6] << (uint64_t)32) | (bank8ints[7] << (uint64_t)48);
+				sd->gates[c][0] = bank8ints[0] | (bank8ints[1] << (uint64_t)16) | (bank8ints[2] << (uint64_t)32) | (bank8ints[3] << (uint64_t)48);
+				sd->gates[c][1] = bank8ints[4] | (bank8ints[5] << (uint64_t)16) | (bank8ints[6] << (uint64_t)32) | (bank8ints[7] << (uint64_t)48);
 			}
 		}
 		
@@ -283,7 +307,7 @@ struct BigButtonSeq : Module {
 		if (nextStepHitsJ)
 			nextStepHits = json_is_true(nextStepHitsJ);
 
-		resetNonJson();
+		jsonHandoff.endWrite();// process() adopts the banks and gates, then calls resetNonJson()
 	}
 
 	
@@ -291,6 +315,11 @@ struct BigButtonSeq : Module {
 		double sampleTime = 1.0 / args.sampleRate;
 		static const float lightTime = 0.1f;
 		
+		// Banks and gates loaded by dataFromJson()
+		if (jsonHandoff.adopt(this)) {
+			resetNonJson();
+		}
+		
 		
 		//********** Buttons, knobs, switches and inputs **********
 		
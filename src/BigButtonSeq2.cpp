@@ -16,9 +16,37 @@
 
 #include "ImpromptuModular.hpp"
 #include "Interop.hpp"
+#include "PackedData.hpp"
+#include "JsonHandoff.hpp"
+#include "SingleRandom.hpp"
+#include "RandomStream.hpp"
 
 
-struct BigButtonSeq2 : Module {
+// Banks, gates and CVs of BigButtonSeq2, i.e. what dataFromJson() loads
+struct BigButtonSeq2Data {
+	// Need to save, with reset
+	int bank[6];
+	uint64_t gates[6][2][2];// channel , bank , 64x2 page for 128
+	float cv[6][2][128];// channel , bank , indexStep
+	RandomStream::State rngState;// stream loaded with the banks, the module itself plays its own rng
+	
+	
+	void init() {
+		for (int c = 0; c < 6; c++) {
+			bank[c] = 0;
+			for (int b = 0; b < 2; b++) {
+				gates[c][b][0] = 0;
+				gates[c][b][1] = 0;
+				for (int s = 0; s < 128; s++)
+					cv[c][b][s] = 0.0f;
+			}
+		}
+		rngState = RandomStream::State();
+	}
+};
+
+
+struct BigButtonSeq2 : Module, BigButtonSeq2Data {// banks, gates and CVs are in BigButtonSeq2Data
 	enum ParamIds {
 		CHAN_PARAM,
 		LEN_PARAM,
@@ -66,23 +94,28 @@ struct BigButtonSeq2 : Module {
 		NUM_LIGHTS
 	};
 	
+	// Constants
+	static const uint8_t packedVersion = 1;// format of the packed "cvData" blob
+	
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	bool packedPatchData = false;// CVs saved as one packed blob instead of json arrays
+	RandomStream rng;// random step order and gate toggles of the Rnd knob
 
 	
 	// Need to save, with reset
 	int indexStep;
-	int bank[6];
-	uint64_t gates[6][2][2];// channel , bank , 64x2 page for 128
-	float cv[6][2][128];// channel , bank , indexStep
 	int metronomeDiv = 4;
 	bool writeFillsToMemory;
 	bool quantizeBig;
 	bool nextStepHits;
 	bool sampleAndHold;
+	bool randomStepOrder;// steps are played in random order, without repeats until all steps of the length are played (RNS run mode)
 	
 	// No need to save, with reset
+	SingleRandom<128> singleStepRandom;
+	int randomNextStep;// next step in random order, drawn ahead for "Big and Del on next step", -1 when not drawn yet
 	long clockIgnoreOnReset;
 	double lastPeriod;//2.0 when not seen yet (init or stopped clock and went greater than 2s, which is max period supported for time-snap)
 	double clockTime;//clock time counter (time since last clock)
@@ -92,6 +125,7 @@ struct BigButtonSeq2 : Module {
 
 	// No need to save, no reset
 	RefreshCounter refresh;	
+	JsonHandoff<BigButtonSeq2Data> jsonHandoff;// banks, gates, CVs and random stream loaded by dataFromJson(), adopted by process()
 	float bigLight = 0.0f;
 	float metronomeLightStart = 0.0f;
 	float metronomeLightDiv = 0.0f;
@@ -121,6 +155,13 @@ struct BigButtonSeq2 : Module {
 	inline void writeCV(int _chan, int _step, float cvValue) {cv[_chan][bank[_chan]][_step] = cvValue;}
 	inline void writeCV(int _chan, int bnk, int _step, float cvValue) {cv[_chan][bnk][_step] = cvValue;}
 	inline void sampleOutput(int _chan) {sampleHoldBuf[_chan] = cv[_chan][bank[_chan]][indexStep];}
+	int calcNextStep() {// step that the next clock moves to
+		if (!randomStepOrder)
+			return (indexStep + 1 < length ? indexStep + 1 : 0);
+		if (randomNextStep < 0 || randomNextStep >= length)// not drawn yet, or the length was reduced since
+			randomNextStep = singleStepRandom.getNext(length, rng.u32());
+		return randomNextStep;
+	}
 	inline int calcChan() {
 		float chanInputValue = inputs[CHAN_INPUT].getVoltage() / 10.0f * (6.0f - 1.0f);
 		return (int) clamp(std::round(params[CHAN_PARAM].getValue() + chanInputValue), 0.0f, (6.0f - 1.0f));		
@@ -177,22 +218,19 @@ struct BigButtonSeq2 : Module {
 	
 	void onReset() override final {
 		indexStep = 0;
-		for (int c = 0; c < 6; c++) {
-			bank[c] = 0;
-			for (int b = 0; b < 2; b++) {
-				clearGates(c, b);
-				for (int s = 0; s < 128; s++)
-					writeCV(c, b, s, 0.0f);
-			}
-		}
+		BigButtonSeq2Data::init();
 		metronomeDiv = 4;
 		writeFillsToMemory = false;
 		quantizeBig = true;
 		nextStepHits = false;
 		sampleAndHold = false;
+		randomStepOrder = false;
+		rng.deterministic = false;
 		resetNonJson();
 	}
 	void resetNonJson() {
+		singleStepRandom.init();
+		randomNextStep = -1;
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
 		lastPeriod = 2.0;
 		clockTime = 0.0;
@@ -213,19 +251,30 @@ struct BigButtonSeq2 : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// banks, gates and CVs are those loaded by dataFromJson() when process() has not adopted them yet
+		BigButtonSeq2Data* pendingData = jsonHandoff.peekPending();
+		BigButtonSeq2Data* sd = (pendingData != nullptr ? pendingData : this);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
 		// panelContrast
 		json_object_set_new(rootJ, "panelContrast", json_real(panelContrast));
 
+		// packedPatchData
+		json_object_set_new(rootJ, "packedPatchData", json_boolean(packedPatchData));
+
+		// rng
+		RandomStream::State savedRngState = (pendingData != nullptr && pendingData->rngState.loaded ? pendingData->rngState : rng.getState());
+		json_object_set_new(rootJ, "rng", RandomStream::stateToJson(savedRngState));
+
 		// indexStep
 		json_object_set_new(rootJ, "indexStep", json_integer(indexStep));
 
 		// bank
 		json_t *bankJ = json_array();
 		for (int c = 0; c < 6; c++)
-			json_array_insert_new(bankJ, c, json_integer(bank[c]));
+			json_array_insert_new(bankJ, c, json_integer(sd->bank[c]));
 		json_object_set_new(rootJ, "bank", bankJ);
 
 		// gates LS64
@@ -233,7 +282,7 @@ struct BigButtonSeq2 : Module {
 		for (int c = 0; c < 6; c++)
 			for (int b = 0; b < 8; b++) {// bank to store is like uint64_t to store, so go to 8
 				// first to get stored is 16 lsbits of bank 0, then next 16 bits,... to 16 msbits of bank 1
-				unsigned int intValue = (unsigned int) ( (uint64_t)0xFFFF & (gates[c][b/4][0] >> (uint64_t)(16 * (b % 4))) );
+				unsigned int intValue = (unsigned int) ( (uint64_t)0xFFFF & (sd->gates[c][b/4][0] >> (uint64_t)(16 * (b % 4))) );
 				json_array_insert_new(gatesLJ, b + (c << 3) , json_integer(intValue));
 			}
 		json_object_set_new(rootJ, "gatesL", gatesLJ);
@@ -242,27 +291,42 @@ struct BigButtonSeq2 : Module {
 		for (int c = 0; c < 6; c++)
 			for (int b = 0; b < 8; b++) {// bank to store is like uint64_t to store, so go to 8
 				// first to get stored is 16 lsbits of bank 0, then next 16 bits,... to 16 msbits of bank 1
-				unsigned int intValue = (unsigned int) ( (uint64_t)0xFFFF & (gates[c][b/4][1] >> (uint64_t)(16 * (b % 4))) );
+				unsigned int intValue = (unsigned int) ( (uint64_t)0xFFFF & (sd->gates[c][b/4][1] >> (uint64_t)(16 * (b % 4))) );
 				json_array_insert_new(gatesMJ, b + (c << 3) , json_integer(intValue));
 			}
 		json_object_set_new(rootJ, "gatesM", gatesMJ);
 
-		// CV bank 0
-		json_t *cv0J = json_array();
-		for (int c = 0; c < 6; c++) {
-			for (int s = 0; s < 128; s++) {
-				json_array_insert_new(cv0J, s + c * 128, json_real(cv[c][0][s]));
+		if (packedPatchData) {
+			// CV banks 0 and 1
+			PackedWriter writer;
+			writer.bytes.reserve(6 * 2 * 128 * 4);
+			for (int c = 0; c < 6; c++) {
+				for (int b = 0; b < 2; b++) {
+					for (int s = 0; s < 128; s++) {
+						writer.f32(sd->cv[c][b][s]);
+					}
+				}
 			}
+			packedToJson(rootJ, "cvData", packedVersion, writer);
 		}
-		json_object_set_new(rootJ, "cv0", cv0J);
-		// CV bank 1
-		json_t *cv1J = json_array();
-		for (int c = 0; c < 6; c++) {
-			for (int s = 0; s < 128; s++) {
-				json_array_insert_new(cv1J, s + c * 128, json_real(cv[c][1][s]));
+		else {
+			// CV bank 0
+			json_t *cv0J = json_array();
+			for (int c = 0; c < 6; c++) {
+				for (int s = 0; s < 128; s++) {
+					json_array_insert_new(cv0J, s + c * 128, json_real(sd->cv[c][0][s]));
+				}
+			}
+			json_object_set_new(rootJ, "cv0", cv0J);
+			// CV bank 1
+			json_t *cv1J = json_array();
+			for (int c = 0; c < 6; c++) {
+				for (int s = 0; s < 128; s++) {
+					json_array_insert_new(cv1J, s + c * 128, json_real(sd->cv[c][1][s]));
+				}
 			}
+			json_object_set_new(rootJ, "cv1", cv1J);
 		}
-		json_object_set_new(rootJ, "cv1", cv1J);
 
 		// metronomeDiv
 		json_object_set_new(rootJ, "metronomeDiv", json_integer(metronomeDiv));
@@ -279,11 +343,21 @@ struct BigButtonSeq2 : Module {
 		// sampleAndHold
 		json_object_set_new(rootJ, "sampleAndHold", json_boolean(sampleAndHold));
 
+		// randomStepOrder
+		json_object_set_new(rootJ, "randomStepOrder", json_boolean(randomStepOrder));
+
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
 		return rootJ;
 	}
 
 
 	void dataFromJson(json_t *rootJ) override {
+		// banks, gates and CVs are parsed into the handoff buffer, process() adopts them when they are all there
+		BigButtonSeq2Data* sd = jsonHandoff.beginWrite();
+		sd->init();
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -294,6 +368,14 @@ struct BigButtonSeq2 : Module {
 		if (panelContrastJ)
 			panelContrast = json_number_value(panelContrastJ);
 
+		// packedPatchData
+		json_t *packedPatchDataJ = json_object_get(rootJ, "packedPatchData");
+		if (packedPatchDataJ)
+			packedPatchData = json_is_true(packedPatchDataJ);
+
+		// rng
+		sd->rngState = RandomStream::stateFromJson(json_object_get(rootJ, "rng"));
+
 		// indexStep
 		json_t *indexStepJ = json_object_get(rootJ, "indexStep");
 		if (indexStepJ)
@@ -306,7 +388,7 @@ struct BigButtonSeq2 : Module {
 			{
 				json_t *bankArrayJ = json_array_get(bankJ, c);
 				if (bankArrayJ)
-					bank[c] = json_integer_value(bankArrayJ);
+					sd->bank[c] = json_integer_value(bankArrayJ);
 			}
 
 		// gates LS64
@@ -320,8 +402,8 @@ struct BigButtonSeq2 : Module {
 					if (gateLJ)
 						bank8intsL[b] = (uint64_t) json_integer_value(gateLJ);
 				}
-				gates[c][0][0] = bank8intsL[0] | (bank8intsL[1] << (uint64_t)16) | (bank8intsL[2] << (uint64_t)32) | (bank8intsL[3] << (uint64_t)48);
-				gates[c][1][0] = bank8intsL[4] | (bank8intsL[5] << (uint64_t)16) | (bank8intsL[6] << (uint64_t)32) | (bank8intsL[7] << (uint64_t)48);
+				sd->gates[c][0][0] = bank8intsL[0] | (bank8intsL[1] << (uint64_t)16) | (bank8intsL[2] << (uint64_t)32) | (bank8intsL[3] << (uint64_t)48);
+				sd->gates[c][1][0] = bank8intsL[4] | (bank8intsL[5] << (uint64_t)16) | (bank8intsL[6] << (uint64_t)32) | (bank8intsL[7] << (uint64_t)48);
 			}
 		}
 		// gates MS64
@@ -335,30 +417,44 @@ struct BigButtonSeq2 : Module {
 					if (gateMJ)
 						bank8intsM[b] = (uint64_t) json_integer_value(gateMJ);
 				}
-				gates[c][0][1] = bank8intsM[0] | (bank8intsM[1] << (uint64_t)16) | (bank8intsM[2] << (uint64_t)32) | (bank8intsM[3] << (uint64_t)48);
-				gates[c][1][1] = bank8intsM[4] | (bank8intsM[5] << (uint64_t)16) | (bank8intsM[6] << (uint64_t)32) | (bank8intsM[7] << (uint64_t)48);
+				sd->gates[c][0][1] = bank8intsM[0] | (bank8intsM[1] << (uint64_t)16) | (bank8intsM[2] << (uint64_t)32) | (bank8intsM[3] << (uint64_t)48);
+				sd->gates[c][1][1] = bank8intsM[4] | (bank8intsM[5] << (uint64_t)16) | (bank8intsM[6] << (uint64_t)32) | (bank8intsM[7] << (uint64_t)48);
 			}
 		}
 		
-		// CV bank 0
-		json_t *cv0J = json_object_get(rootJ, "cv0");
-		if (cv0J) {
-			for (int c = 0; c < 6; c++)
-				for (int s = 0; s < 128; s++) {
-					json_t *cv0ArrayJ = json_array_get(cv0J, s + c * 128);
-					if (cv0ArrayJ)
-						cv[c][0][s] = json_number_value(cv0ArrayJ);
+		std::vector<uint8_t> payload;
+		if (packedFromJson(rootJ, "cvData", packedVersion, &payload) && payload.size() == 6 * 2 * 128 * 4) {
+			// CV banks 0 and 1
+			PackedReader reader(payload);
+			for (int c = 0; c < 6; c++) {
+				for (int b = 0; b < 2; b++) {
+					for (int s = 0; s < 128; s++) {
+						sd->cv[c][b][s] = reader.f32();
+					}
 				}
+			}
 		}
-		// CV bank 1
-		json_t *cv1J = json_object_get(rootJ, "cv1");
-		if (cv1J) {
-			for (int c = 0; c < 6; c++)
-				for (int s = 0; s < 128; s++) {
-					json_t *cv1ArrayJ = json_array_get(cv1J, s + c * 128);
-					if (cv1ArrayJ)
-						cv[c][1][s] = json_number_value(cv1ArrayJ);
-				}
+		else {// no valid packed blob, use the legacy arrays
+			// CV bank 0
+			json_t *cv0J = json_object_get(rootJ, "cv0");
+			if (cv0J) {
+				for (int c = 0; c < 6; c++)
+					for (int s = 0; s < 128; s++) {
+						json_t *cv0ArrayJ = json_array_get(cv0J, s + c * 128);
+						if (cv0ArrayJ)
+							sd->cv[c][0][s] = json_number_value(cv0ArrayJ);
+					}
+			}
+			// CV bank 1
+			json_t *cv1J = json_object_get(rootJ, "cv1");
+			if (cv1J) {
+				for (int c = 0; c < 6; c++)
+					for (int s = 0; s < 128; s++) {
+						json_t *cv1ArrayJ = json_array_get(cv1J, s + c * 128);
+						if (cv1ArrayJ)
+							sd->cv[c][1][s] = json_number_value(cv1ArrayJ);
+					}
+			}
 		}
 		
 		// metronomeDiv
@@ -385,8 +481,13 @@ struct BigButtonSeq2 : Module {
 		json_t *sampleAndHoldJ = json_object_get(rootJ, "sampleAndHold");
 		if (sampleAndHoldJ)
 			sampleAndHold = json_is_true(sampleAndHoldJ);
+
+		// randomStepOrder
+		json_t *randomStepOrderJ = json_object_get(rootJ, "randomStepOrder");
+		if (randomStepOrderJ)
+			randomStepOrder = json_is_true(randomStepOrderJ);
 		
-		resetNonJson();
+		jsonHandoff.endWrite();// process() adopts the banks, gates and CVs, then calls resetNonJson()
 	}
 
 	
@@ -436,6 +537,12 @@ struct BigButtonSeq2 : Module {
 		double sampleTime = 1.0 / args.sampleRate;
 		static const float lightTime = 0.1f;
 		
+		// Banks, gates, CVs and random stream loaded by dataFromJson()
+		if (jsonHandoff.adopt(this)) {
+			rng.setState(rngState);
+			resetNonJson();
+		}
+		
 		
 		//********** Buttons, knobs, switches and inputs **********
 		
@@ -448,7 +555,7 @@ struct BigButtonSeq2 : Module {
 			if (bigTrigger.process(params[BIG_PARAM].getValue() + inputs[BIG_INPUT].getVoltage())) {
 				bigLight = 1.0f;
 				if (nextStepHits) {
-					int nextStep = (indexStep + 1) % length;
+					int nextStep = calcNextStep();
 					setGate(channel, nextStep);// bank is global
 					if (inputs[CV_INPUT].isConnected()) {
 						writeCV(channel, nextStep, inputs[CV_INPUT].getVoltage());
@@ -496,7 +603,7 @@ struct BigButtonSeq2 : Module {
 			// Del button
 			if (params[DEL_PARAM].getValue() + inputs[DEL_INPUT].getVoltage() > 0.5f) {
 				if (nextStepHits) {
-					int nextStep = (indexStep + 1) % length;
+					int nextStep = calcNextStep();
 					clearGate(channel, nextStep);// bank is global
 					cv[channel][bank[channel]][nextStep] = 0.0f;
 				}
@@ -521,7 +628,8 @@ struct BigButtonSeq2 : Module {
 		// Clock
 		if (clockIgnoreOnReset == 0l) {			
 			if (clockTrigger.process(inputs[CLK_INPUT].getVoltage() + params[CLOCK_PARAM].getValue())) {
-				if ((++indexStep) >= length) indexStep = 0;
+				indexStep = calcNextStep();
+				randomNextStep = -1;
 				
 				// Fill button
 				fillPressed = (params[FILL_PARAM].getValue() + inputs[FILL_INPUT].getVoltage()) > 0.5f;// used in clock block and others
@@ -545,7 +653,7 @@ struct BigButtonSeq2 : Module {
 				// Random (toggle gate according to probability knob)
 				float rnd01 = params[RND_PARAM].getValue() / 100.0f + inputs[RND_INPUT].getVoltage() / 10.0f;
 				if (rnd01 > 0.0f) {
-					if (random::uniform() < rnd01)// random::uniform is [0.0, 1.0), see include/util/common.hpp
+					if (rng.uniform() < rnd01)// uniform is [0.0, 1.0)
 						toggleGate(channel, indexStep);
 				}
 				lastPeriod = clockTime > 2.0 ? 2.0 : clockTime;
@@ -558,6 +666,8 @@ struct BigButtonSeq2 : Module {
 		if (resetTrigger.process(params[RESET_PARAM].getValue() + inputs[RESET_INPUT].getVoltage())) {
 			clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * args.sampleRate);
 			indexStep = 0;
+			singleStepRandom.init();
+			randomNextStep = -1;
 			//outPulse.trigger(0.001f);
 			outLightPulse.trigger(0.02f);
 			metronomeLightStart = 1.0f;
@@ -765,6 +875,10 @@ struct BigButtonSeq2Widget : ModuleWidget {
 		
 		menu->addChild(createBoolPtrMenuItem("Big and Del on next step", "", &module->nextStepHits));
 
+		menu->addChild(createBoolPtrMenuItem("Random step order (no repeats)", "", &module->randomStepOrder));
+
+		menu->addChild(createBoolPtrMenuItem("Same random values on every load", "", &module->rng.deterministic));
+
 		menu->addChild(createSubmenuItem("Metronome light", "", [=](Menu* menu) {
 			menu->addChild(createCheckMenuItem("Every clock", "",
 				[=]() {return module->metronomeDiv == 1;},
@@ -787,6 +901,8 @@ struct BigButtonSeq2Widget : ModuleWidget {
 				[=]() {module->metronomeDiv = 1000;}
 			));
 		}));	
+
+		menu->addChild(createBoolPtrMenuItem("Compact patch data", "", &module->packedPatchData));
 	}	
 	
 	
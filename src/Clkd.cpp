@@ -13,86 +13,27 @@
 #include "ClockedCommon.hpp"
 
 
-class Clock {
-	// The -1.0 step is used as a reset state every period so that 
-	//   lengths can be re-computed; it will stay at -1.0 when a clock is inactive.
-	// a clock frame is defined as "length * iterations + syncWait", and
-	//   for master, syncWait does not apply and iterations = 1
+class ClkdClock : public PhaseClock {
+	// single period clocks (no swing)
 
-	
-	double step = 0.0;// -1.0 when stopped, [0 to period[ for clock steps 
-	double remainder = 0.0;
-	double length = 0.0;// period
-	double sampleTime = 0.0;
-	int iterations = 0;// run this many periods before going into sync if sub-clock
-	Clock* syncSrc = nullptr; // only subclocks will have this set to master clock
-	static constexpr double guard = 0.0005;// in seconds, region for sync to occur right before end of length of last iteration; sub clocks must be low during this period
-	bool *resetClockOutputsHigh = nullptr;
 	bool *trigOut = nullptr;
+	bool edgesTrigOut = false;
 	
 	public:
 	
-	Clock(Clock* clkGiven, bool *resetClockOutputsHighPtr, bool *trigOutPtr) {
-		syncSrc = clkGiven;
-		resetClockOutputsHigh = resetClockOutputsHighPtr;
+	ClkdClock(ClkdClock* clkGiven, bool *resetClockOutputsHighPtr, bool *trigOutPtr) : PhaseClock(clkGiven, resetClockOutputsHighPtr) {
 		trigOut = trigOutPtr;
-		reset();
-	}
-	
-	void reset(double _remainder = 0.0) {
-		step = -1.0;
-		remainder = _remainder;
-	}
-	bool isReset() {
-		return step == -1.0;
-	}
-	double getStep() {
-		return step;
-	}
-	void start() {
-		step = remainder;
-	}
-	
-	void setup(double lengthGiven, int iterationsGiven, double sampleTimeGiven) {
-		length = lengthGiven;
-		iterations = iterationsGiven;
-		sampleTime = sampleTimeGiven;
-	}
-
-	void stepClock() {// here the clock was output on step "step", this function is called near end of module::process()
-		if (step >= 0.0) {// if active clock
-			step += sampleTime;
-			if ( (syncSrc != nullptr) && (iterations == 1) && (step > (length - guard)) ) {// if in sync region
-				if (syncSrc->isReset()) {
-					reset();
-				}// else nothing needs to be done, just wait and step stays the same
-			}
-			else {
-				if (step >= length) {// reached end iteration
-					iterations--;
-					step -= length;
-					if (iterations <= 0) {
-						double newRemainder = (syncSrc == nullptr ? step : 0.0);// don't calc remainders for subclocks since they sync to master
-						reset(newRemainder);// frame done
-					}
-				}
-			}
-		}
-	}
-	
-	void applyNewLength(double lengthStretchFactor) {
-		if (step != -1.0)
-			step *= lengthStretchFactor;
-		length *= lengthStretchFactor;
 	}
 	
 	int isHigh() {
-		if (step >= 0.0) {
-			if (*trigOut)
-				return (step <= 0.001f) ? 1 : 0;
-			return (step < (length * 0.5)) ? 1 : 0;
+		if (isReset())
+			return (*resetClockOutputsHigh) ? 1 : 0;
+		if (edgesChanged || *trigOut != edgesTrigOut) {
+			edgesTrigOut = *trigOut;
+			// high when step <= 1ms in trigger mode, else when step < length / 2
+			setEdges(edgesTrigOut ? ticksFloor(0.001f) + 1 : (length + 1) / 2, NO_EDGE, NO_EDGE);
 		}
-		return (*resetClockOutputsHigh) ? 1 : 0;
+		return getLevel();
 	}	
 };
 
@@ -104,7 +45,7 @@ struct Clkd : Module {
 	
 	struct BpmParam : ParamQuantity {
 		std::string getDisplayValueString() override {
-			return module->inputs[BPM_INPUT].isConnected() ? "Ext." : ParamQuantity::getDisplayValueString();
+			return static_cast<Clkd*>(module)->isBpmInputActive() ? "Ext." : ParamQuantity::getDisplayValueString();
 		}
 	};
 
@@ -158,25 +99,31 @@ struct Clkd : Module {
 	bool resetClockOutputsHigh;
 	bool momentaryRunInput;// true = trigger (original rising edge only version), false = level sensitive (emulated with rising and falling detection)
 	bool forceCvOnBpmOut;
+	bool bpmDetectionPll;// tempo of the external clock is tracked by extClockPll instead of each pulse's interval
 	int displayIndex;
 	bool trigOuts[4];// output triggers when true, one for each clock output, master is index 0. 
 	float bpmInputScale;// -1.0f to 1.0f
 	float bpmInputOffset;// -10.0f to 10.0f
+	PolyClocks polyClocks;
+	ClockBusSubscriber clockBusSubscriber;// source 0 when subscribed, reset, run and BPM inputs follow the clock master when unpatched
 
 	// No need to save, with reset
 	long editingBpmMode;// 0 when no edit bpmMode, downward step counter timer when edit, negative upward when show can't edit ("--") 
 	double sampleRate;
 	double sampleTime;
-	std::vector<Clock> clk;// size 4
+	std::vector<ClkdClock> clk;// size MAX_POLY_CLOCKS, the clocks after index 3 are the extra clocks of the poly master output
 	float bufferedKnobs[4];// must be before ratiosDoubled, master is index 3, ratio knobs are 0 to 2
 	bool syncRatios[3];
 	int ratiosDoubled[3];
+	int polyChannels;// channels of the master clock output, follows polyClocks.channels on master clock resets
+	int polyRatiosDoubled[MAX_POLY_CLOCKS];// indexes 0 to 3 unused
 	int extPulseNumber;// 0 to ppqn - 1
 	double extIntervalTime;// also used for auto mode change to P24 (2nd use of this member variable)
 	double timeoutTime;
+	ExtClockPll extClockPll;
 	float newMasterLength;
 	float masterLength;
-	float clkOutputs[4];
+	float clkOutputs[MAX_POLY_CLOCKS];
 	
 	// No need to save, no reset
 	bool scheduledReset = false;
@@ -195,22 +142,20 @@ struct Clkd : Module {
 	dsp::PulseGenerator runPulse;
 
 	
+	int64_t getMasterTicks() {
+		// lengths from the BPM knob are 60.0f / an integer BPM: take those in double, so that the master does not
+		//   drift from the BPM by the rounding of the float length (about 5 samples per hour)
+		double bpm = std::round(60.0 / (double)masterLength);
+		if (60.0f / (float)bpm == masterLength)
+			return PhaseClock::toTicks(60.0 / bpm, sampleRate);
+		return PhaseClock::toTicks(masterLength, sampleRate);
+	}
+	
+	
 	int getRatioDoubled(int ratioKnobIndex) {
 		// ratioKnobIndex is 0 to 2 for ratio knobs
 		// returns a positive ratio for mult, negative ratio for div (0 never returned)
-		bool isDivision = false;
-		int i = (int) std::round( bufferedKnobs[ratioKnobIndex] );// [ -(numRatios-1) ; (numRatios-1) ]
-		if (i < 0) {
-			i *= -1;
-			isDivision = true;
-		}
-		if (i >= numRatios) {
-			i = numRatios - 1;
-		}
-		int ret = (int) (ratioValues[i] * 2.0f + 0.5f);
-		if (isDivision) 
-			return -1l * ret;
-		return ret;
+		return ratioDoubledFromIndex((int) std::round( bufferedKnobs[ratioKnobIndex] ));// [ -(numRatios-1) ; (numRatios-1) ]
 	}
 	
 	
@@ -249,10 +194,10 @@ struct Clkd : Module {
 		configBypass(RUN_INPUT, RUN_OUTPUT);
 		configBypass(BPM_INPUT, BPM_OUTPUT);
 
-		clk.reserve(4);
-		clk.push_back(Clock(nullptr, &resetClockOutputsHigh, &trigOuts[0]));
-		for (int i = 1; i < 4; i++) {
-			clk.push_back(Clock(&clk[0], &resetClockOutputsHigh, &trigOuts[i]));		
+		clk.reserve(MAX_POLY_CLOCKS);
+		clk.push_back(ClkdClock(nullptr, &resetClockOutputsHigh, &trigOuts[0]));
+		for (int i = 1; i < MAX_POLY_CLOCKS; i++) {
+			clk.push_back(ClkdClock(&clk[0], &resetClockOutputsHigh, &trigOuts[i < 4 ? i : 0]));// extra clocks follow the trigger setting of the master		
 		}
 		onReset();
 		
@@ -268,12 +213,15 @@ struct Clkd : Module {
 		resetClockOutputsHigh = true;
 		momentaryRunInput = true;
 		forceCvOnBpmOut = false;
+		bpmDetectionPll = false;
 		displayIndex = 0;// show BPM (knob 0) by default
 		for (int i = 0; i < 4; i++) {
 			trigOuts[i] = false;
 		}
 		bpmInputScale = 1.0f;
 		bpmInputOffset = 0.0f;
+		polyClocks.init();
+		clockBusSubscriber.init();
 		resetNonJson(false);
 	}
 	void resetNonJson(bool delayed) {// delay thread sensitive parts (i.e. schedule them so that process() will do them)
@@ -294,27 +242,32 @@ struct Clkd : Module {
 	void resetClkd(bool hardReset) {// set hardReset to true to revert learned BPM to 120 in sync mode, or else when false, learned bmp will stay persistent
 		sampleRate = (double)(APP->engine->getSampleRate());
 		sampleTime = 1.0 / sampleRate;
-		for (int i = 0; i < 4; i++) {
+		for (int i = 0; i < MAX_POLY_CLOCKS; i++) {
 			clk[i].reset();
 			clkOutputs[i] = resetClockOutputsHigh ? 10.0f : 0.0f;
+		}
+		for (int i = 0; i < 4; i++) {
 			bufferedKnobs[i] = params[RATIO_PARAMS + i].getValue();// must be done before the getRatioDoubled() a few lines down
 		}
 		for (int i = 0; i < 3; i++) {
 			syncRatios[i] = false;
 			ratiosDoubled[i] = getRatioDoubled(i);
 		}
+		polyChannels = 1;
+		updatePolyClocks();
 		extPulseNumber = -1;
+		extClockPll.reset();
 		extIntervalTime = 0.0;// also used for auto mode change to P24 (2nd use of this member variable)
 		timeoutTime = 2.0 / ppqn + 0.1;// worst case. This is a double period at 30 BPM (4s), divided by the expected number of edges in the double period 
 									   //   which is 2*ppqn, plus epsilon. This timeoutTime is only used for timingout the 2nd clock edge
-		if (inputs[BPM_INPUT].isConnected()) {
-			if (bpmDetectionMode) {
+		if (isBpmInputActive()) {
+			if (bpmDetectionMode && inputs[BPM_INPUT].isConnected()) {
 				if (hardReset) {
 					newMasterLength = 0.5f;// 120 BPM
 				}
 			}
 			else {
-				newMasterLength = 0.5f / std::pow(2.0f, inputs[BPM_INPUT].getVoltage());// bpm = 120*2^V, T = 60/bpm = 60/(120*2^V) = 0.5/2^V
+				newMasterLength = 0.5f / std::pow(2.0f, clockBusSubscriber.getBpm(inputs[BPM_INPUT]));// bpm = 120*2^V, T = 60/bpm = 60/(120*2^V) = 0.5/2^V
 			}
 		}
 		else {
@@ -354,6 +307,9 @@ struct Clkd : Module {
 		
 		// forceCvOnBpmOut
 		json_object_set_new(rootJ, "forceCvOnBpmOut", json_boolean(forceCvOnBpmOut));
+
+		// bpmDetectionPll
+		json_object_set_new(rootJ, "bpmDetectionPll", json_boolean(bpmDetectionPll));
 		
 		// displayIndex
 		json_object_set_new(rootJ, "displayIndex", json_integer(displayIndex));
@@ -370,6 +326,12 @@ struct Clkd : Module {
 		// bpmInputOffset
 		json_object_set_new(rootJ, "bpmInputOffset", json_real(bpmInputOffset));
 
+		// polyChannels and polyRatios
+		polyClocks.dataToJson(rootJ);
+
+		// clockBusSource
+		clockBusSubscriber.dataToJson(rootJ);
+
 		// clockMaster (stores a valid (non-negative) id when we are the master, -1 when we are not)
 		json_object_set_new(rootJ, "clockMaster", json_integer(clockMaster.id == id ? id : -1));
 		
@@ -446,6 +408,11 @@ struct Clkd : Module {
 		if (forceCvOnBpmOutJ)
 			forceCvOnBpmOut = json_is_true(forceCvOnBpmOutJ);
 
+		// bpmDetectionPll
+		json_t *bpmDetectionPllJ = json_object_get(rootJ, "bpmDetectionPll");
+		if (bpmDetectionPllJ)
+			bpmDetectionPll = json_is_true(bpmDetectionPllJ);
+
 		// displayIndex
 		json_t *displayIndexJ = json_object_get(rootJ, "displayIndex");
 		if (displayIndexJ)
@@ -472,6 +439,12 @@ struct Clkd : Module {
 		if (bpmInputOffsetJ)
 			bpmInputOffset = json_number_value(bpmInputOffsetJ);
 
+		// polyChannels and polyRatios
+		polyClocks.dataFromJson(rootJ);
+
+		// clockBusSource
+		clockBusSubscriber.dataFromJson(rootJ);
+
 		resetNonJson(true);
 
 		// clockMaster
@@ -485,6 +458,20 @@ struct Clkd : Module {
 	}
 	
 
+	void updatePolyClocks() {// extra clocks that are new or whose ratio changed are reset, so that they restart with the master clock
+		polyClocks.changed = false;
+		for (int c = 4; c < MAX_POLY_CLOCKS; c++) {
+			int ratioDoubled = ratioDoubledFromIndex(polyClocks.ratios[c]);
+			if (c >= polyChannels || ratioDoubled != polyRatiosDoubled[c]) {
+				polyRatiosDoubled[c] = ratioDoubled;
+				clk[c].reset();
+				clkOutputs[c] = resetClockOutputsHigh ? 10.0f : 0.0f;
+			}
+		}
+		polyChannels = polyClocks.channels;
+	}
+
+
 	void toggleRun(void) {
 		if (!(bpmDetectionMode && inputs[BPM_INPUT].isConnected()) || running) {// toggle when not BPM detect, turn off only when BPM detect (allows turn off faster than timeout if don't want any trailing beats after stoppage). If allow manually start in bpmDetectionMode   the clock will not know which pulse is the 1st of a ppqn set, so only allow stop
 			running = !running;
@@ -519,7 +506,14 @@ struct Clkd : Module {
 	}		
 	
 
+	bool isBpmInputActive() {// patched, or following the clock master on the clock bus
+		return inputs[BPM_INPUT].isConnected() || clockBusSubscriber.follows(inputs[BPM_INPUT]);
+	}
+	
+
 	void process(const ProcessArgs &args) override {
+		clockBusSubscriber.update(id, args.frame);
+
 		// Scheduled reset
 		if (scheduledReset) {
 			resetClkd(false);		
@@ -531,8 +525,8 @@ struct Clkd : Module {
 			toggleRun();
 		}
 		// Run input
-		if (inputs[RUN_INPUT].isConnected()) {
-			int state = runInputTrigger.process(inputs[RUN_INPUT].getVoltage());
+		if (inputs[RUN_INPUT].isConnected() || clockBusSubscriber.follows(inputs[RUN_INPUT])) {
+			int state = runInputTrigger.process(clockBusSubscriber.getRun(inputs[RUN_INPUT]));
 			if (state != 0) {
 				if (momentaryRunInput) {
 					if (state == 1) {
@@ -549,7 +543,7 @@ struct Clkd : Module {
 
 
 		// Reset (has to be near top because it sets steps to 0, and 0 not a real step (clock section will move to 1 before reaching outputs)
-		if (resetTrigger.process(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue())) {
+		if (resetTrigger.process(clockBusSubscriber.getReset(inputs[RESET_INPUT]) + params[RESET_PARAM].getValue())) {
 			resetLight = 1.0f;
 			resetPulse.trigger(0.001f);
 			resetClkd(false);	
@@ -612,11 +606,11 @@ struct Clkd : Module {
 	
 		// BPM input and knob
 		newMasterLength = masterLength;
-		if (inputs[BPM_INPUT].isConnected()) { 
+		if (isBpmInputActive()) { 
 			bool trigBpmInValue = bpmDetectTrigger.process(inputs[BPM_INPUT].getVoltage());
 			
 			// BPM Detection method
-			if (bpmDetectionMode) {
+			if (bpmDetectionMode && inputs[BPM_INPUT].isConnected()) {// the clock bus carries a BPM CV
 				// rising edge detect
 				if (trigBpmInValue) {
 					if (!running) {
@@ -634,11 +628,18 @@ struct Clkd : Module {
 						}
 					}
 					if (running) {
+						extClockPll.pulse(ppqn);
 						extPulseNumber++;
 						if (extPulseNumber >= ppqn)
 							extPulseNumber = 0;
 						if (extPulseNumber == 0)// if first pulse, start interval timer
 							extIntervalTime = 0.0;
+						else if (bpmDetectionPll && extClockPll.isLocked()) {
+							// stretch so that the master ends on the estimated time of the first pulse of the next frame
+							double timeLeft = extClockPll.timeToPulse(ppqn - extPulseNumber);
+							newMasterLength = clamp(clk[0].getStep() + timeLeft, masterLengthMin / 1.5f, masterLengthMax * 1.5f);
+							timeoutTime = extIntervalTime + extClockPll.timeToPulse(1) + 0.1;
+						}
 						else {
 							// all other ppqn pulses except the first one. now we have an interval upon which to plan a stretch 
 							double timeLeft = extIntervalTime * (double)(ppqn - extPulseNumber) / ((double)extPulseNumber);
@@ -650,6 +651,7 @@ struct Clkd : Module {
 				}
 				if (running) {
 					extIntervalTime += sampleTime;
+					extClockPll.step(sampleTime);
 					if (extIntervalTime > timeoutTime) {
 						running = false;
 						runPulse.trigger(0.001f);
@@ -665,7 +667,7 @@ struct Clkd : Module {
 			}
 			// BPM CV method
 			else {// bpmDetectionMode not active
-				float bpmCV = inputs[BPM_INPUT].getVoltage() * bpmInputScale + bpmInputOffset;
+				float bpmCV = clockBusSubscriber.getBpm(inputs[BPM_INPUT]) * bpmInputScale + bpmInputOffset;
 				newMasterLength = clamp(0.5f / std::pow(2.0f, bpmCV), masterLengthMin, masterLengthMax);// bpm = 120*2^V, T = 60/bpm = 60/(120*2^V) = 0.5/2^V
 				// no need to round since this clocked's master's BPM knob is a snap knob thus already rounded, and with passthru approach, no cumul error
 				
@@ -701,7 +703,7 @@ struct Clkd : Module {
 		}
 		if (newMasterLength != masterLength) {
 			double lengthStretchFactor = ((double)newMasterLength) / ((double)masterLength);
-			for (int i = 0; i < 4; i++) {
+			for (int i = 0; i < MAX_POLY_CLOCKS; i++) {
 				clk[i].applyNewLength(lengthStretchFactor);
 			}
 			masterLength = newMasterLength;
@@ -723,7 +725,10 @@ struct Clkd : Module {
 						syncRatios[i] = false;
 					}
 				}
-				clk[0].setup(masterLength, 1, sampleTime);// must call setup before start. length = period
+				if (polyClocks.changed) {
+					updatePolyClocks();
+				}
+				clk[0].setup(getMasterTicks(), 1, sampleRate);// must call setup before start. length = period
 				clk[0].start();
 			}
 			clkOutputs[0] = clk[0].isHigh() ? 10.0f : 0.0f;		
@@ -731,36 +736,44 @@ struct Clkd : Module {
 			// Sub clocks
 			for (int i = 1; i < 4; i++) {
 				if (clk[i].isReset()) {
-					double length;
-					int iterations;
-					int ratioDoubled = ratiosDoubled[i - 1];
-					if (ratioDoubled < 0) { // if div 
-						ratioDoubled *= -1;
-						length = masterLength * ((double)ratioDoubled) / 2.0;
-						iterations = 1l + (ratioDoubled % 2);		
-					}
-					else {// mult 
-						length = (2.0f * masterLength) / ((double)ratioDoubled);
-						iterations = ratioDoubled / (2l - (ratioDoubled % 2l));							
-					}
-					clk[i].setup(length, iterations, sampleTime);
+					clk[i].setupRatio(getMasterTicks(), ratiosDoubled[i - 1], sampleRate);
 					clk[i].start();
 				}
 				clkOutputs[i] = clk[i].isHigh() ? 10.0f : 0.0f;
 			}
+			
+			// Extra clocks of the poly master output
+			for (int c = 4; c < polyChannels; c++) {
+				if (clk[c].isReset()) {
+					clk[c].setupRatio(getMasterTicks(), polyRatiosDoubled[c], sampleRate);
+					clk[c].start();
+				}
+				clkOutputs[c] = clk[c].isHigh() ? 10.0f : 0.0f;
+			}
 
 			// Step clocks
-			for (int i = 0; i < 4; i++)
+			int numClocks = std::max(4, polyChannels);
+			for (int i = 0; i < numClocks; i++)
 				clk[i].stepClock();
 		}
+		else if (polyClocks.changed) {
+			updatePolyClocks();
+		}
 		
 		// outputs
 		for (int i = 0; i < 4; i++) {
 			outputs[CLK_OUTPUTS + i].setVoltage(clkOutputs[i]);
 		}
+		outputs[CLK_OUTPUTS + 0].setChannels(polyChannels);
+		for (int c = 1; c < polyChannels; c++) {
+			outputs[CLK_OUTPUTS + 0].setVoltage(clkOutputs[c], c);
+		}
 		outputs[RESET_OUTPUT].setVoltage((resetPulse.process((float)sampleTime) ? 10.0f : 0.0f));
 		outputs[RUN_OUTPUT].setVoltage((runPulse.process((float)sampleTime) ? 10.0f : 0.0f));
-		outputs[BPM_OUTPUT].setVoltage( (inputs[BPM_INPUT].isConnected() && !forceCvOnBpmOut) ? inputs[BPM_INPUT].getVoltage() : log2f(0.5f / masterLength));
+		outputs[BPM_OUTPUT].setVoltage( (isBpmInputActive() && !forceCvOnBpmOut) ? clockBusSubscriber.getBpm(inputs[BPM_INPUT]) : log2f(0.5f / masterLength));
+		if (clockMaster.id == id) {
+			clockBus.publish(id, args.frame, &outputs[CLK_OUTPUTS], outputs[RESET_OUTPUT].getVoltage(), outputs[RUN_OUTPUT].getVoltage(), log2f(0.5f / masterLength));
+		}
 			
 		
 		// lights
@@ -913,9 +926,17 @@ struct ClkdWidget : ModuleWidget {
 		));
 
 		menu->addChild(createBoolPtrMenuItem("BPM output is CV when ext sync", "", &module->forceCvOnBpmOut));
+		menu->addChild(createBoolPtrMenuItem("Smooth ext clock tempo (PLL)", "", &module->bpmDetectionPll));
+
+		menu->addChild(createBoolMenuItem("Follow clock master on clock bus", "",
+			[=]() {return module->clockBusSubscriber.source >= 0;},
+			[=](bool follow) {module->clockBusSubscriber.source = (follow ? 0 : -1);}
+		));
 
 		createBPMCVInputMenu(menu, &module->bpmInputScale, &module->bpmInputOffset);
 
+		createPolyClocksMenu(menu, &module->polyClocks);
+
 		menu->addChild(createSubmenuItem("Send triggers (instead of gates)", "", [=](Menu* menu) {
 			menu->addChild(createBoolPtrMenuItem("Master clk", "", &(module->trigOuts[0])));
 			menu->addChild(createBoolPtrMenuItem("Clock 1", "", &(module->trigOuts[1])));
@@ -13,85 +13,33 @@
 #include "ClockedCommon.hpp"
 
 
-class Clock {
-	// The -1.0 step is used as a reset state every double-period so that 
-	//   lengths can be re-computed; it will stay at -1.0 when a clock is inactive.
-	// a clock frame is defined as "length * iterations + syncWait", and
-	//   for master, syncWait does not apply and iterations = 1
+class Clock : public PhaseClock {
+	// double period clocks (*2 is because of swing, so we do groups of 2 periods)
 
-	
-	double step = 0.0;// -1.0 when stopped, [0 to 2*period[ for clock steps (*2 is because of swing, so we do groups of 2 periods)
-	double remainder = 0.0;
-	double length = 0.0;// double period
-	double sampleTime = 0.0;
-	int iterations = 0;// run this many double periods before going into sync if sub-clock
-	Clock* syncSrc = nullptr; // only subclocks will have this set to master clock
-	static constexpr double guard = 0.0005;// in seconds, region for sync to occur right before end of length of last iteration; sub clocks must be low during this period
-	bool *resetClockOutputsHigh = nullptr;
+	float swingParam = 0.0f;
+	float pulseWidth = 0.5f;
 	
 	public:
 	
-	Clock(Clock* clkGiven, bool *resetClockOutputsHighPtr) {
-		syncSrc = clkGiven;
-		resetClockOutputsHigh = resetClockOutputsHighPtr;
-		reset();
-	}
+	Clock(Clock* clkGiven, bool *resetClockOutputsHighPtr) : PhaseClock(clkGiven, resetClockOutputsHighPtr) {}
 	
-	void reset(double _remainder = 0.0) {
-		step = -1.0;
-		remainder = _remainder;
-	}
-	bool isReset() {
-		return step == -1.0;
-	}
-	double getStep() {
-		return step;
-	}
-	void start() {
-		step = remainder;
-	}
-	
-	void setup(double lengthGiven, int iterationsGiven, double sampleTimeGiven) {
-		length = lengthGiven;
-		iterations = iterationsGiven;
-		sampleTime = sampleTimeGiven;
-	}
-
-	void stepClock() {// here the clock was output on step "step", this function is called near end of module::process()
-		if (step >= 0.0) {// if active clock
-			step += sampleTime;
-			if ( (syncSrc != nullptr) && (iterations == 1) && (step > (length - guard)) ) {// if in sync region
-				if (syncSrc->isReset()) {
-					reset();
-				}// else nothing needs to be done, just wait and step stays the same
-			}
-			else {
-				if (step >= length) {// reached end iteration
-					iterations--;
-					step -= length;
-					if (iterations <= 0) {
-						double newRemainder = (syncSrc == nullptr ? step : 0.0);// don't calc remainders for subclocks since they sync to master
-						reset(newRemainder);// frame done
-					}
-				}
-			}
+	void setPulse(float swingParamGiven, float pulseWidthGiven) {
+		if (swingParamGiven != swingParam || pulseWidthGiven != pulseWidth) {
+			swingParam = swingParamGiven;
+			pulseWidth = pulseWidthGiven;
+			edgesChanged = true;
 		}
 	}
 	
-	void applyNewLength(double lengthStretchFactor) {
-		if (step != -1.0)
-			step *= lengthStretchFactor;
-		length *= lengthStretchFactor;
-	}
-	
-	int isHigh(float swingParam, float pulseWidth) {
+	int isHigh() {
 		// last 0.5ms (guard time) must be low so that sync mechanism will work properly (i.e. no missed pulses)
 		//   this will automatically be the case, since code below disallows any pulses or inter-pulse times less than 1ms
-		int high = 0;
-		if (step >= 0.0) {
+		if (isReset())
+			return (*resetClockOutputsHigh) ? 1 : 0;
+		if (edgesChanged) {
 			// all following values are in seconds
 			float onems = 0.001f;
-			float period = (float)length / 2.0f;
+			float period = (float)((double)length / ticksPerSecond) / 2.0f;
 			float swing = (period - 2.0f * onems) * swingParam;// swingParam is [-1 : 1]
 			float p2min = onems;
 			float p2max = period - onems - std::fabs(swing);
@@ -104,14 +52,10 @@ class Clock {
 			double p3 = (double)(period + swing);
 			double p4 = ((double)(period + swing)) + p2;
 			
-			if (step <= p2)
-				high = 1;
-			else if ((step >= p3) && (step <= p4))
-				high = 2;
+			// high (1) when step <= p2, high (2) when p3 <= step <= p4
+			setEdges(ticksFloor(p2) + 1, ticksCeil(p3), ticksFloor(p4) + 1);
 		}
-		else if (*resetClockOutputsHigh)
-			high = 1;
-		return high;
+		return getLevel();
 	}	
 };
 
@@ -119,75 +63,6 @@ class Clock {
 //*****************************************************************************
 
 
-class ClockDelay {
-	long stepCounter;
-	int lastWriteValue;
-	bool readState;
-	long stepRise1;
-	long stepFall1;
-	long stepRise2;
-	long stepFall2;
-	
-	public:
-	
-	ClockDelay() {
-		reset(true);
-	}
-	
-	void setup() {
-	}
-	
-	void reset(bool resetClockOutputsHigh) {
-		stepCounter = 0l;
-		lastWriteValue = 0;
-		readState = resetClockOutputsHigh;
-		stepRise1 = 0l;
-		stepFall1 = 0l;
-		stepRise2 = 0l;
-		stepFall2 = 0l;
-	}
-	
-	void write(int value) {
-		if (value == 1) {// first pulse is high
-			if (lastWriteValue == 0) // if got rise 1
-				stepRise1 = stepCounter;
-		}
-		else if (value == 2) {// second pulse is high
-			if (lastWriteValue == 0) // if got rise 2
-				stepRise2 = stepCounter;
-		}
-		else {// value = 0 (pulse is low)
-			if (lastWriteValue == 1) // if got fall 1
-				stepFall1 = stepCounter;
-			else if (lastWriteValue == 2) // if got fall 2
-				stepFall2 = stepCounter;
-		}
-		
-		lastWriteValue = value;
-	}
-	
-	bool read(long delaySamples) {
-		long delayedStepCounter = stepCounter - delaySamples;
-		if (delayedStepCounter == stepRise1 || delayedStepCounter == stepRise2)
-			readState = true;
-		else if (delayedStepCounter == stepFall1 || delayedStepCounter == stepFall2)
-			readState = false;
-		stepCounter++;
-		if (stepCounter > 1e8) {// keep within long's bounds (could go higher or could allow negative)
-			stepCounter -= 1e8;// 192000 samp/s * 2s * 64 * (3/4) = 18.4 Msamp
-			stepRise1 -= 1e8;
-			stepFall1 -= 1e8;
-			stepRise2 -= 1e8;
-			stepFall2 -= 1e8;
-		}
-		return readState;
-	}
-};
-
-
-//*****************************************************************************
-
-
 struct Clocked : Module {
 	
 	struct BpmParam : ParamQuantity {
@@ -254,27 +129,32 @@ struct Clocked : Module {
 	bool resetClockOutputsHigh;
 	bool momentaryRunInput;// true = trigger (original rising edge only version), false = level sensitive (emulated with rising and falling detection)
 	bool forceCvOnBpmOut;
+	bool bpmDetectionPll;// tempo of the external clock is tracked by extClockPll instead of each pulse's interval
 	float bpmInputScale;// -1.0f to 1.0f
 	float bpmInputOffset;// -10.0f to 10.0f
+	PolyClocks polyClocks;
 
 	// No need to save, with reset
 	long editingBpmMode;// 0 when no edit bpmMode, downward step counter timer when edit, negative upward when show can't edit ("--") 
 	double sampleRate;
 	double sampleTime;
-	std::vector<Clock> clk;// size 4
-	ClockDelay delay[3];// only channels 1 to 3 have delay
+	std::vector<Clock> clk;// size MAX_POLY_CLOCKS, the clocks after index 3 are the extra clocks of the poly master output
+	ClockEdgeSchedule delay[3];// only channels 1 to 3 have delay
 	float bufferedRatioKnobs[4];// 0 = mast bpm knob, 1..3 is ratio knobs
 	bool syncRatios[4];// 0 index unused
 	int ratiosDoubled[4];// 0 index unused
+	int polyChannels;// channels of the master clock output, follows polyClocks.channels on master clock resets
+	int polyRatiosDoubled[MAX_POLY_CLOCKS];// indexes 0 to 3 unused
 	int extPulseNumber;// 0 to ppqn * 2 - 1
 	double extIntervalTime;// also used for auto mode change to P24 (2nd use of this member variable)
 	double timeoutTime;
+	ExtClockPll extClockPll;
 	float pulseWidth[4];
 	float swingAmount[4];
-	long delaySamples[4];
+	int64_t delaySamples[4];
 	float newMasterLength;
 	float masterLength;
-	float clkOutputs[4];
+	float clkOutputs[MAX_POLY_CLOCKS];
 	
 	// No need to save, no reset
 	bool scheduledReset = false;
@@ -293,22 +173,20 @@ struct Clocked : Module {
 	dsp::PulseGenerator runPulse;
 
 	
+	int64_t getMasterTicks() {
+		// lengths from the BPM knob are 120.0f / an integer BPM: take those in double, so that the master does not
+		//   drift from the BPM by the rounding of the float length (about 5 samples per hour)
+		double bpm = std::round(120.0 / (double)masterLength);
+		if (120.0f / (float)bpm == masterLength)
+			return PhaseClock::toTicks(120.0 / bpm, sampleRate);
+		return PhaseClock::toTicks(masterLength, sampleRate);
+	}
+	
+	
 	int getRatioDoubled(int ratioKnobIndex) {
 		// ratioKnobIndex ranges from 1 to 3 for the ratio knobs (do not call with 0)
 		// returns a positive ratio for mult, negative ratio for div (0 never returned)
-		bool isDivision = false;
-		int i = (int) std::round( bufferedRatioKnobs[ratioKnobIndex] );// [ -(numRatios-1) ; (numRatios-1) ]
-		if (i < 0) {
-			i *= -1;
-			isDivision = true;
-		}
-		if (i >= numRatios) {
-			i = numRatios - 1;
-		}
-		int ret = (int) (ratioValues[i] * 2.0f + 0.5f);
-		if (isDivision) 
-			return -1l * ret;
-		return ret;
+		return ratioDoubledFromIndex((int) std::round( bufferedRatioKnobs[ratioKnobIndex] ));// [ -(numRatios-1) ; (numRatios-1) ]
 	}
 	
 	void updatePulseSwingDelay() {
@@ -328,17 +206,22 @@ struct Clocked : Module {
 				swingAmount[i] += (messagesFromExpander[i + 4] / 5.0f);
 				swingAmount[i] = clamp(swingAmount[i], -1.0f, 1.0f);
 			}
+			
+			clk[i].setPulse(swingAmount[i], pulseWidth[i]);
+		}
+		for (int c = 4; c < MAX_POLY_CLOCKS; c++) {// extra clocks follow the swing and pulse width of the master
+			clk[c].setPulse(swingAmount[0], pulseWidth[0]);
 		}
 
 		// Delay
-		delaySamples[0] = 0ul;
+		delaySamples[0] = 0;
 		for (int i = 1; i < 4; i++) {	
 			int delayKnobIndex = (int)(params[DELAY_PARAMS + i].getValue() + 0.5f);
 			float delayFraction = delayValues[delayKnobIndex];
 			float ratioValue = ((float)ratiosDoubled[i]) / 2.0f;
 			if (ratioValue < 0)
 				ratioValue = 1.0f / (-1.0f * ratioValue);
-			delaySamples[i] = (long)(masterLength * delayFraction * sampleRate / (ratioValue * 2.0));
+			delaySamples[i] = (int64_t)(masterLength * delayFraction * sampleRate / (ratioValue * 2.0));
 		}				
 	}
 
@@ -394,9 +277,9 @@ struct Clocked : Module {
 		configBypass(RUN_INPUT, RUN_OUTPUT);
 		configBypass(BPM_INPUT, BPM_OUTPUT);
 
-		clk.reserve(4);
+		clk.reserve(MAX_POLY_CLOCKS);
 		clk.push_back(Clock(nullptr, &resetClockOutputsHigh));
-		for (int i = 1; i < 4; i++) {
+		for (int i = 1; i < MAX_POLY_CLOCKS; i++) {
 			clk.push_back(Clock(&clk[0], &resetClockOutputsHigh));		
 		}
 		onReset();
@@ -414,8 +297,10 @@ struct Clocked : Module {
 		resetClockOutputsHigh = true;
 		momentaryRunInput = true;
 		forceCvOnBpmOut = false;
+		bpmDetectionPll = false;
 		bpmInputScale = 1.0f;
 		bpmInputOffset = 0.0f;
+		polyClocks.init();
 		resetNonJson(false);
 	}
 	void resetNonJson(bool delayed) {// delay thread sensitive parts (i.e. schedule them so that process() will do them)
@@ -446,8 +331,11 @@ struct Clocked : Module {
 			ratiosDoubled[i] = (i == 0 ? 1 : getRatioDoubled(i));
 			clkOutputs[i] = resetClockOutputsHigh ? 10.0f : 0.0f;
 		}
+		polyChannels = 1;
+		updatePolyClocks();
 		updatePulseSwingDelay();
 		extPulseNumber = -1;
+		extClockPll.reset();
 		extIntervalTime = 0.0;// also used for auto mode change to P24 (2nd use of this member variable)
 		timeoutTime = 2.0 / ppqn + 0.1;// worst case. This is a double period at 30 BPM (4s), divided by the expected number of edges in the double period 
 									   //   which is 2*ppqn, plus epsilon. This timeoutTime is only used for timingout the 2nd clock edge
@@ -501,6 +389,9 @@ struct Clocked : Module {
 		
 		// forceCvOnBpmOut
 		json_object_set_new(rootJ, "forceCvOnBpmOut", json_boolean(forceCvOnBpmOut));
+
+		// bpmDetectionPll
+		json_object_set_new(rootJ, "bpmDetectionPll", json_boolean(bpmDetectionPll));
 		
 		// bpmInputScale
 		json_object_set_new(rootJ, "bpmInputScale", json_real(bpmInputScale));
@@ -508,6 +399,9 @@ struct Clocked : Module {
 		// bpmInputOffset
 		json_object_set_new(rootJ, "bpmInputOffset", json_real(bpmInputOffset));
 
+		// polyChannels and polyRatios
+		polyClocks.dataToJson(rootJ);
+
 		// clockMaster
 		json_object_set_new(rootJ, "clockMaster", json_boolean(clockMaster.id == id));
 		
@@ -599,6 +493,11 @@ struct Clocked : Module {
 		if (forceCvOnBpmOutJ)
 			forceCvOnBpmOut = json_is_true(forceCvOnBpmOutJ);
 
+		// bpmDetectionPll
+		json_t *bpmDetectionPllJ = json_object_get(rootJ, "bpmDetectionPll");
+		if (bpmDetectionPllJ)
+			bpmDetectionPll = json_is_true(bpmDetectionPllJ);
+
 		// bpmInputScale
 		json_t *bpmInputScaleJ = json_object_get(rootJ, "bpmInputScale");
 		if (bpmInputScaleJ)
@@ -609,6 +508,9 @@ struct Clocked : Module {
 		if (bpmInputOffsetJ)
 			bpmInputOffset = json_number_value(bpmInputOffsetJ);
 
+		// polyChannels and polyRatios
+		polyClocks.dataFromJson(rootJ);
+
 		resetNonJson(true);
 		
 		// clockMaster
@@ -620,6 +522,19 @@ struct Clocked : Module {
 		}
 	}
 
+	void updatePolyClocks() {// extra clocks that are new or whose ratio changed are reset, so that they restart with the master clock
+		polyClocks.changed = false;
+		for (int c = 4; c < MAX_POLY_CLOCKS; c++) {
+			int ratioDoubled = ratioDoubledFromIndex(polyClocks.ratios[c]);
+			if (c >= polyChannels || ratioDoubled != polyRatiosDoubled[c]) {
+				polyRatiosDoubled[c] = ratioDoubled;
+				clk[c].reset();
+				clkOutputs[c] = resetClockOutputsHigh ? 10.0f : 0.0f;
+			}
+		}
+		polyChannels = polyClocks.channels;
+	}
+
 	void toggleRun(void) {
 		if (!(bpmDetectionMode && inputs[BPM_INPUT].isConnected()) || running) {// toggle when not BPM detect, turn off only when BPM detect (allows turn off faster than timeout if don't want any trailing beats after stoppage). If allow manually start in bpmDetectionMode   the clock will not know which pulse is the 1st of a ppqn set, so only allow stop
 			running = !running;
@@ -761,11 +676,18 @@ struct Clocked : Module {
 						}
 					}
 					if (running) {
+						extClockPll.pulse(ppqn);
 						extPulseNumber++;
 						if (extPulseNumber >= ppqn * 2)// *2 because working with double_periods
 							extPulseNumber = 0;
 						if (extPulseNumber == 0)// if first pulse, start interval timer
 							extIntervalTime = 0.0;
+						else if (bpmDetectionPll && extClockPll.isLocked()) {
+							// stretch so that the master ends on the estimated time of the first pulse of the next frame
+							double timeLeft = extClockPll.timeToPulse(ppqn * 2 - extPulseNumber);
+							newMasterLength = clamp(clk[0].getStep() + timeLeft, masterLengthMin / 1.5f, masterLengthMax * 1.5f);
+							timeoutTime = extIntervalTime + extClockPll.timeToPulse(1) + 0.1;
+						}
 						else {
 							// all other ppqn pulses except the first one. now we have an interval upon which to plan a stretch 
 							double timeLeft = extIntervalTime * (double)(ppqn * 2 - extPulseNumber) / ((double)extPulseNumber);
@@ -777,6 +699,7 @@ struct Clocked : Module {
 				}
 				if (running) {
 					extIntervalTime += sampleTime;
+					extClockPll.step(sampleTime);
 					if (extIntervalTime > timeoutTime) {
 						running = false;
 						runPulse.trigger(0.001f);
@@ -828,7 +751,7 @@ struct Clocked : Module {
 		}
 		if (newMasterLength != masterLength) {
 			double lengthStretchFactor = ((double)newMasterLength) / ((double)masterLength);
-			for (int i = 0; i < 4; i++) {
+			for (int i = 0; i < MAX_POLY_CLOCKS; i++) {
 				clk[i].applyNewLength(lengthStretchFactor);
 			}
 			masterLength = newMasterLength;
@@ -850,45 +773,56 @@ struct Clocked : Module {
 						syncRatios[i] = false;
 					}
 				}
-				clk[0].setup(masterLength, 1, sampleTime);// must call setup before start. length = double_period
+				if (polyClocks.changed) {
+					updatePolyClocks();
+				}
+				clk[0].setup(getMasterTicks(), 1, sampleRate);// must call setup before start. length = double_period
 				clk[0].start();
 			}
-			clkOutputs[0] = clk[0].isHigh(swingAmount[0], pulseWidth[0]) ? 10.0f : 0.0f;		
+			clkOutputs[0] = clk[0].isHigh() ? 10.0f : 0.0f;		
 			
 			// Sub clocks
 			for (int i = 1; i < 4; i++) {
 				if (clk[i].isReset()) {
-					double length;
-					int iterations;
-					int ratioDoubled = ratiosDoubled[i];
-					if (ratioDoubled < 0) { // if div 
-						ratioDoubled *= -1;
-						length = masterLength * ((double)ratioDoubled) / 2.0;
-						iterations = 1l + (ratioDoubled % 2);		
-					}
-					else {// mult 
-						length = (2.0f * masterLength) / ((double)ratioDoubled);
-						iterations = ratioDoubled / (2l - (ratioDoubled % 2l));							
-					}
-					clk[i].setup(length, iterations, sampleTime);
+					clk[i].setupRatio(getMasterTicks(), ratiosDoubled[i], sampleRate);
 					clk[i].start();
 				}
-				delay[i - 1].write(clk[i].isHigh(swingAmount[i], pulseWidth[i]));
-				clkOutputs[i] = delay[i - 1].read(delaySamples[i]) ? 10.0f : 0.0f;
+				delay[i - 1].write(clk[i].isHigh(), delaySamples[i]);
+				clkOutputs[i] = delay[i - 1].read() ? 10.0f : 0.0f;
+			}
+			
+			// Extra clocks of the poly master output (no delay)
+			for (int c = 4; c < polyChannels; c++) {
+				if (clk[c].isReset()) {
+					clk[c].setupRatio(getMasterTicks(), polyRatiosDoubled[c], sampleRate);
+					clk[c].start();
+				}
+				clkOutputs[c] = clk[c].isHigh() ? 10.0f : 0.0f;
 			}
 
 			// Step clocks
-			for (int i = 0; i < 4; i++)
+			int numClocks = std::max(4, polyChannels);
+			for (int i = 0; i < numClocks; i++)
 				clk[i].stepClock();
 		}
+		else if (polyClocks.changed) {
+			updatePolyClocks();
+		}
 		
 		// outputs
 		for (int i = 0; i < 4; i++) {
 			outputs[CLK_OUTPUTS + i].setVoltage(clkOutputs[i]);
 		}
+		outputs[CLK_OUTPUTS + 0].setChannels(polyChannels);
+		for (int c = 1; c < polyChannels; c++) {
+			outputs[CLK_OUTPUTS + 0].setVoltage(clkOutputs[c], c);
+		}
 		outputs[RESET_OUTPUT].setVoltage((resetPulse.process((float)sampleTime) ? 10.0f : 0.0f));
 		outputs[RUN_OUTPUT].setVoltage((runPulse.process((float)sampleTime) ? 10.0f : 0.0f));
 		outputs[BPM_OUTPUT].setVoltage( (inputs[BPM_INPUT].isConnected() && !forceCvOnBpmOut) ? inputs[BPM_INPUT].getVoltage() : log2f(1.0f / masterLength));
+		if (clockMaster.id == id) {
+			clockBus.publish(id, args.frame, &outputs[CLK_OUTPUTS], outputs[RESET_OUTPUT].getVoltage(), outputs[RUN_OUTPUT].getVoltage(), log2f(1.0f / masterLength));
+		}
 			
 		
 		// lights
@@ -1077,9 +1011,12 @@ struct ClockedWidget : ModuleWidget {
 		));
 		
 		menu->addChild(createBoolPtrMenuItem("BPM output is CV when ext sync", "", &module->forceCvOnBpmOut));
+		menu->addChild(createBoolPtrMenuItem("Smooth ext clock tempo (PLL)", "", &module->bpmDetectionPll));
 
 		createBPMCVInputMenu(menu, &module->bpmInputScale, &module->bpmInputOffset);
 
+		createPolyClocksMenu(menu, &module->polyClocks);
+
 		menu->addChild(new MenuSeparator());
 		menu->addChild(createMenuLabel("Actions"));
 		
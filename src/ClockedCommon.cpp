@@ -70,3 +70,93 @@ void createBPMCVInputMenu(ui::Menu* menu, float* bpmInputScale, float* bpmInputO
 	menu->addChild(bpmcvItem);
 }
 
+
+
+void PolyClocks::dataToJson(json_t *rootJ) {
+	// polyChannels
+	json_object_set_new(rootJ, "polyChannels", json_integer(channels));
+
+	// polyRatios (of the extra clocks)
+	json_t *polyRatiosJ = json_array();
+	for (int c = 4; c < MAX_POLY_CLOCKS; c++)
+		json_array_insert_new(polyRatiosJ, c - 4, json_integer(ratios[c]));
+	json_object_set_new(rootJ, "polyRatios", polyRatiosJ);
+}
+
+
+void PolyClocks::dataFromJson(json_t *rootJ) {
+	// polyChannels
+	json_t *polyChannelsJ = json_object_get(rootJ, "polyChannels");
+	if (polyChannelsJ)
+		channels = clamp((int)json_integer_value(polyChannelsJ), 1, MAX_POLY_CLOCKS);
+
+	// polyRatios (of the extra clocks)
+	json_t *polyRatiosJ = json_object_get(rootJ, "polyRatios");
+	if (polyRatiosJ) {
+		for (int c = 4; c < MAX_POLY_CLOCKS; c++) {
+			json_t *polyRatiosArrayJ = json_array_get(polyRatiosJ, c - 4);
+			if (polyRatiosArrayJ)
+				ratios[c] = clamp((int)json_integer_value(polyRatiosArrayJ), (numRatios - 1) * -1, numRatios - 1);
+		}
+	}
+	
+	changed = true;
+}
+
+
+void createPolyClocksMenu(ui::Menu* menu, PolyClocks* polyClocks) {
+	struct PolyRatioQuantity : Quantity {
+		PolyClocks* polyClocks = NULL;
+		int channel = 0;
+		
+		PolyRatioQuantity(PolyClocks* _polyClocks, int _channel) {
+			polyClocks = _polyClocks;
+			channel = _channel;
+		}
+		void setValue(float value) override {
+			int ratio = (int)std::round(math::clamp(value, getMinValue(), getMaxValue()));
+			if (ratio != polyClocks->ratios[channel]) {
+				polyClocks->ratios[channel] = ratio;
+				polyClocks->changed = true;
+			}
+		}
+		float getValue() override {
+			return (float)polyClocks->ratios[channel];
+		}
+		float getMinValue() override {return (float)(numRatios - 1) * -1.0f;}
+		float getMaxValue() override {return (float)(numRatios - 1);}
+		float getDefaultValue() override {return 0.0f;}
+		std::string getDisplayValueString() override {
+			int ratioDoubled = ratioDoubledFromIndex(polyClocks->ratios[channel]);
+			std::string ratioStr = (std::abs(ratioDoubled) % 2) == 1 ? string::f("%i.5", std::abs(ratioDoubled) / 2) : string::f("%i", std::abs(ratioDoubled) / 2);
+			return (ratioDoubled < 0 ? "/" : "x") + ratioStr;
+		}
+		std::string getLabel() override {return string::f("Channel %i", channel + 1);}
+	};
+	struct PolyRatioSlider : ui::Slider {
+		PolyRatioSlider(PolyClocks* polyClocks, int channel) {
+			quantity = new PolyRatioQuantity(polyClocks, channel);
+		}
+		~PolyRatioSlider() {
+			delete quantity;
+		}
+	};
+
+	menu->addChild(createSubmenuItem("Poly master output", "", [=](Menu* menu) {
+		menu->addChild(createSubmenuItem("Channels", string::f("%i", polyClocks->channels), [=](Menu* menu) {
+			for (int c = 1; c <= MAX_POLY_CLOCKS; c++) {
+				menu->addChild(createCheckMenuItem(c == 1 ? "1 (mono)" : string::f("%i", c), "",
+					[=]() {return polyClocks->channels == c;},
+					[=]() {polyClocks->channels = c;
+						   polyClocks->changed = true;}
+				));
+			}
+		}));
+		menu->addChild(createMenuLabel("Channels 2-4: ratio knob clocks"));
+		for (int c = 4; c < MAX_POLY_CLOCKS; c++) {
+			PolyRatioSlider *ratioSlider = new PolyRatioSlider(polyClocks, c);
+			ratioSlider->box.size.x = 200.0f;
+			menu->addChild(ratioSlider);
+		}
+	}));
+}
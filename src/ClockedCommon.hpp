@@ -5,6 +5,7 @@
 #pragma once
 
 #include "ImpromptuModular.hpp"
+#include "PhaseClock.hpp"
 
 static const int numRatios = 35;
 static const float ratioValues[numRatios] = {1, 1.5, 2, 2.5, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 19, 23, 24, 29, 31, 32, 37, 41, 43, 47, 48, 53, 59, 61, 64, 96};
@@ -17,6 +18,110 @@ static const unsigned int ON_START_INT_RST_MSK = 0x2;
 static const unsigned int ON_STOP_EXT_RST_MSK = 0x4;
 static const unsigned int ON_START_EXT_RST_MSK = 0x8;
 
+static const int MAX_POLY_CLOCKS = 16;// channels of the master clock output when polyphonic
+
+
+static inline int ratioDoubledFromIndex(int ratioIndex) {
+	// ratioIndex is a ratio knob value [ -(numRatios-1) ; (numRatios-1) ]
+	// returns a positive ratio for mult, negative ratio for div (0 never returned)
+	bool isDivision = false;
+	if (ratioIndex < 0) {
+		ratioIndex *= -1;
+		isDivision = true;
+	}
+	if (ratioIndex >= numRatios) {
+		ratioIndex = numRatios - 1;
+	}
+	int ret = (int) (ratioValues[ratioIndex] * 2.0f + 0.5f);
+	if (isDivision) 
+		return -1l * ret;
+	return ret;
+}
+
+
+struct PolyClocks {
+	// The master clock output can carry up to 16 clocks: channel 1 is the master clock, channels 2 to 4 are the 
+	//   clocks of the ratio knobs (as on their own outputs), and channels 5 and up are extra sub-clocks whose 
+	//   ratios are set in the menu. Changes are applied by process() on the next reset of the master clock, 
+	//   so that the new clocks start in sync with it.
+	
+	// Need to save
+	int channels;// 1 when the master clock output is mono
+	int ratios[MAX_POLY_CLOCKS];// ratio knob values of the extra clocks, indexes 0 to 3 are unused
+	
+	// No need to save
+	bool changed;
+	
+	void init() {
+		static const int defaultRatios[MAX_POLY_CLOCKS] = {0, 0, 0, 0, 2, 4, 5, 7, 9, 13, 17, -2, -4, -5, -9, -17};
+		channels = 1;
+		for (int c = 0; c < MAX_POLY_CLOCKS; c++) {
+			ratios[c] = defaultRatios[c];
+		}
+		changed = true;
+	}
+	
+	void dataToJson(json_t *rootJ);
+	void dataFromJson(json_t *rootJ);
+};
+
+
+class ExtClockPll {
+	// Tempo tracker for the BPM detection modes (Px) when bpmDetectionPll is set: a second order loop (alpha-beta filter,
+	//   the steady state of a Kalman filter for a steady tempo with jittered pulses) estimates the period and the phase 
+	//   of the pulses on the BPM input, and the master length follows these estimates instead of the raw intervals.
+	// The first pulses are fitted by least squares (gains 2(2k-1)/(k(k+1)) and 6/(k(k+1)) on the k-th pulse), so the
+	//   loop locks on the second pulse, then the gains settle to alpha = 2/(ppqn+2) and beta = alpha^2/(2-alpha), so 
+	//   that the loop averages over about a beat of pulses whatever the ppqn. A pulse more than half a period early or 
+	//   late (tempo jump, missed or extra pulse) restarts the fit. See ClockSyncBench.cpp for the measured jitter and
+	//   latency.
+
+	int fitPulses = 0;// pulses in the fit, 0 when no pulse yet
+	double period = 0.0;// seconds between pulses
+	double sinceEstimate = 0.0;// seconds since the estimated time of the last pulse
+
+	public:
+
+	void reset() {
+		fitPulses = 0;
+		period = 0.0;
+		sinceEstimate = 0.0;
+	}
+
+	void step(double sampleTime) {
+		sinceEstimate += sampleTime;
+	}
+
+	void pulse(int ppqn) {
+		if (fitPulses == 0) {// first pulse, only the phase is known
+			fitPulses = 1;
+			sinceEstimate = 0.0;
+			return;
+		}
+		double error = sinceEstimate - period;// positive when the pulse is late
+		if (fitPulses == 1 || std::fabs(error) > 0.5 * period) {// (re)start the fit with the last interval
+			period = sinceEstimate;
+			fitPulses = 2;
+			sinceEstimate = 0.0;
+			return;
+		}
+		if (fitPulses < 1000)
+			fitPulses++;
+		double k = (double)fitPulses;
+		double alpha = 2.0 / (double)(ppqn + 2);
+		double beta = alpha * alpha / (2.0 - alpha);
+		period += std::max(beta, 6.0 / (k * (k + 1.0))) * error;
+		sinceEstimate = error * (1.0 - std::max(alpha, 2.0 * (2.0 * k - 1.0) / (k * (k + 1.0))));
+	}
+
+	bool isLocked() {
+		return fitPulses >= 2;
+	}
+	double timeToPulse(int pulses) {// seconds from now to the estimated time of the pulse that is the given number of pulses after the last one
+		return period * (double)pulses - sinceEstimate;
+	}
+};
+
 
 	
 struct RatioParam : ParamQuantity {
@@ -219,4 +324,5 @@ struct AutopatchItem : MenuItem {
 };
 
 void createBPMCVInputMenu(ui::Menu* menu, float* bpmInputScale, float* bpmInputOffset);
+void createPolyClocksMenu(ui::Menu* menu, PolyClocks* polyClocks);
 
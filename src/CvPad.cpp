@@ -10,9 +10,41 @@
 
 
 #include "ImpromptuModular.hpp"
+#include "JsonHandoff.hpp"
 
 
-struct CvPad : Module {
+// Pad CVs and read heads of CvPad, i.e. what dataFromJson() loads
+struct CvPadData {
+	// constants
+	static const int N_BANKS = 8;
+	static const int N_PADS = 16;
+	static const int read1_16 = 0;// index into readHeads[7]
+	static const int read2_8 = 1;// index into readHeads[7]
+	static const int read4_4 = 3;// index into readHeads[7]
+	typedef float cvsArray[N_BANKS][N_PADS];
+	
+	// Need to save, with reset
+	cvsArray cvs;
+	int readHeads[7];// values are 0-15 for all heads, for example, in 4x4 mode, last readHead (read4_4 + 3) is 12-15
+	
+	
+	void init() {
+		for (int b = 0; b < N_BANKS; b++) {
+			for (int p = 0; p < N_PADS; p++) {
+				cvs[b][p] = 0.0f;
+			}
+		}
+		readHeads[read1_16] = 0;
+		readHeads[read2_8 + 0] = 0;
+		readHeads[read2_8 + 1] = 8;
+		for (int i = 0; i < 4; i++) {
+			readHeads[read4_4 + i] = i * 4;
+		}
+	}
+};
+
+
+struct CvPad : Module, CvPadData {// pad CVs and read heads are in CvPadData
 	enum ParamIds {
 		ENUMS(PAD_PARAMS, 16),// touch pads
 		BANK_PARAM,
@@ -41,21 +73,11 @@ struct CvPad : Module {
 		NUM_LIGHTS
 	};
 		
-	// constants
-	static const int N_BANKS = 8;
-	static const int N_PADS = 16;
-	static const int read1_16 = 0;// index into readHeads[7]
-	static const int read2_8 = 1;// index into readHeads[7]
-	static const int read4_4 = 3;// index into readHeads[7]
-	typedef float cvsArray[N_BANKS][N_PADS];
-		
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
 	
 	// Need to save, with reset
-	cvsArray cvs;
-	int readHeads[7];// values are 0-15 for all heads, for example, in 4x4 mode, last readHead (read4_4 + 3) is 12-15
 	int writeHead;
 	bool highSensitivityCvKnob;
 
@@ -65,6 +87,7 @@ struct CvPad : Module {
 	
 	// No need to save, no reset
 	RefreshCounter refresh;
+	JsonHandoff<CvPadData> jsonHandoff;// pad CVs and read heads loaded by dataFromJson(), adopted by process()
 	int bank = 0;
 	float cvKnobValue = 0.0f;
 	Trigger padTriggers[N_PADS];
@@ -134,17 +157,7 @@ struct CvPad : Module {
 
 	
 	void onReset() override final {
-		for (int b = 0; b < N_BANKS; b++) {
-			for (int p = 0; p < N_PADS; p++) {
-				cvs[b][p] = 0.0f;
-			}
-		}
-		readHeads[read1_16] = 0;
-		readHeads[read2_8 + 0] = 0;
-		readHeads[read2_8 + 1] = 8;
-		for (int i = 0; i < 4; i++) {
-			readHeads[read4_4 + i] = i * 4;
-		}
+		CvPadData::init();
 		writeHead = 0;
 		highSensitivityCvKnob = true;
 		resetNonJson();
@@ -167,6 +180,10 @@ struct CvPad : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// pad CVs and read heads are those loaded by dataFromJson() when process() has not adopted them yet
+		CvPadData* pendingData = jsonHandoff.peekPending();
+		CvPadData* sd = (pendingData != nullptr ? pendingData : this);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
@@ -177,7 +194,7 @@ struct CvPad : Module {
 		json_t *cvsJ = json_array();
 		for (int b = 0; b < N_BANKS; b++) {
 			for (int p = 0; p < N_PADS; p++) {
-				json_array_insert_new(cvsJ, b * N_PADS + p, json_real(cvs[b][p]));
+				json_array_insert_new(cvsJ, b * N_PADS + p, json_real(sd->cvs[b][p]));
 			}
 		}
 		json_object_set_new(rootJ, "cvs", cvsJ);
@@ -185,7 +202,7 @@ struct CvPad : Module {
 		// readHeads
 		json_t *readHeadsJ = json_array();
 		for (int i = 0; i < 7; i++) {
-			json_array_insert_new(readHeadsJ, i, json_integer(readHeads[i]));
+			json_array_insert_new(readHeadsJ, i, json_integer(sd->readHeads[i]));
 		}
 		json_object_set_new(rootJ, "readHeads", readHeadsJ);
 
@@ -195,11 +212,18 @@ struct CvPad : Module {
 		// highSensitivityCvKnob
 		json_object_set_new(rootJ, "highSensitivityCvKnob", json_boolean(highSensitivityCvKnob));
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
 		return rootJ;
 	}
 
 	
 	void dataFromJson(json_t *rootJ) override {
+		// pad CVs and read heads are parsed into the handoff buffer, process() adopts them when they are all there
+		CvPadData* sd = jsonHandoff.beginWrite();
+		sd->init();
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -217,7 +241,7 @@ struct CvPad : Module {
 				for (int p = 0; p < N_PADS; p++) {
 					json_t *cvsArrayJ = json_array_get(cvsJ, b * N_PADS + p);
 					if (cvsArrayJ)
-						cvs[b][p] = json_number_value(cvsArrayJ);
+						sd->cvs[b][p] = json_number_value(cvsArrayJ);
 				}
 		}
 
@@ -227,7 +251,7 @@ struct CvPad : Module {
 			for (int i = 0; i < 7; i++) {
 				json_t *readHeadsArrayJ = json_array_get(readHeadsJ, i);
 				if (readHeadsArrayJ)
-					readHeads[i] = json_number_value(readHeadsArrayJ);
+					sd->readHeads[i] = json_number_value(readHeadsArrayJ);
 			}
 		}
 
@@ -241,12 +265,17 @@ struct CvPad : Module {
 		if (highSensitivityCvKnobJ)
 			highSensitivityCvKnob = json_is_true(highSensitivityCvKnobJ);
 		
-		resetNonJson();
+		jsonHandoff.endWrite();// process() adopts the pad CVs and read heads, then calls resetNonJson()
 	}
 
 	
 	void process(const ProcessArgs &args) override {		
 		
+		// Pad CVs and read heads loaded by dataFromJson()
+		if (jsonHandoff.adopt(this)) {
+			resetNonJson();
+		}
+		
 		bank = calcBank();
 		int config = calcConfig();
 		
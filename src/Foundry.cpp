@@ -85,8 +85,8 @@ struct Foundry : Module {
 	};
 	
 	// Expander
-	static const int messageSize = 	Sequencer::NUM_TRACKS + // VEL_INPUTS with connected
-									Sequencer::NUM_TRACKS + // SEQCV_INPUTS with connected
+	static const int messageSize = 	Sequencer::MAX_TRACKS + // VEL_INPUTS with connected, one per track (the channels of the polyphonic inputs)
+									Sequencer::MAX_TRACKS + // SEQCV_INPUTS with connected, idem
 									1 + // TRKCV_INPUT with connected
 									7 + // GATECV_INPUT, GATEPCV_INPUT, TIEDCV_INPUT, SLIDECV_INPUT, WRITE_SRC_INPUT, LEFTCV_INPUT, RIGHTCV_INPUT
 									2; // SYNC_SEQCV_PARAM, WRITEMODE_PARAM
@@ -99,6 +99,7 @@ struct Foundry : Module {
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	bool packedPatchData = false;// step data saved as one packed blob per track instead of json arrays
 	
 	// Need to save, with reset
 	int velocityMode;
@@ -117,6 +118,7 @@ struct Foundry : Module {
 	int stopAtEndOfSong;// 0 to 3 is YES stop on song end of that track, 4 is NO (off)
 	Sequencer seq;
 	int mergeTracks;// 0 = none, 1 = merge A with B, 2 = merge A with B and C, 3 = merge A with All
+	ClockBusSubscriber clockBusSubscriber;// unpatched run, reset and track A clock inputs can follow the clock master
 
 	// No need to save, with reset
 	bool editingSequence;
@@ -161,7 +163,7 @@ struct Foundry : Module {
 	Trigger endTrigger;
 	Trigger repLenTrigger;
 	Trigger attachedTrigger;
-	Trigger seqCVTriggers[Sequencer::NUM_TRACKS];
+	Trigger seqCVTriggers[Sequencer::MAX_TRACKS];
 	Trigger selTrigger;
 	Trigger allTrigger;
 	Trigger velEditTrigger;
@@ -185,7 +187,7 @@ struct Foundry : Module {
 		rightExpander.consumerMessage = rightMessages[1];
 		
 		// must init those that have no-connect info to non-connected, or else mother may read 0.0 init value if ever refresh limiters make it such that after a connection of expander the mother reads before the first pass through the expander's writing code, and this may do something undesired (ex: change track in Foundry on expander connected while track CV jack is empty)
-		for (int i = 0; i < (Sequencer::NUM_TRACKS * 2 + 1); i++) {
+		for (int i = 0; i < (Sequencer::MAX_TRACKS * 2 + 1); i++) {
 			rightMessages[1][i] = std::numeric_limits<float>::quiet_NaN();
 		}
 
@@ -264,6 +266,7 @@ struct Foundry : Module {
 		velocityBipol = false;
 		autostepLen = false;
 		multiTracks = false;
+		clockBusSubscriber.init();
 		autoseq = false;
 		holdTiedNotes = true;
 		showSharp = true;
@@ -315,6 +318,9 @@ struct Foundry : Module {
 		// panelContrast
 		json_object_set_new(rootJ, "panelContrast", json_real(panelContrast));
 
+		// packedPatchData
+		json_object_set_new(rootJ, "packedPatchData", json_boolean(packedPatchData));
+
 		// velocityMode
 		json_object_set_new(rootJ, "velocityMode", json_integer(velocityMode));
 
@@ -358,11 +364,14 @@ struct Foundry : Module {
 		json_object_set_new(rootJ, "stopAtEndOfSong", json_integer(stopAtEndOfSong));
 
 		// seq
-		seq.dataToJson(rootJ);
+		seq.dataToJson(rootJ, packedPatchData);
 		
 		// mergeTracks
 		json_object_set_new(rootJ, "mergeTracks", json_integer(mergeTracks));
 
+		// clockBusSource
+		clockBusSubscriber.dataToJson(rootJ);
+
 		return rootJ;
 	}
 	
@@ -381,6 +390,11 @@ struct Foundry : Module {
 		if (panelContrastJ)
 			panelContrast = json_number_value(panelContrastJ);
 
+		// packedPatchData
+		json_t *packedPatchDataJ = json_object_get(rootJ, "packedPatchData");
+		if (packedPatchDataJ)
+			packedPatchData = json_is_true(packedPatchDataJ);
+
 		// velocityMode
 		json_t *velocityModeJ = json_object_get(rootJ, "velocityMode");
 		if (velocityModeJ)
@@ -406,6 +420,9 @@ struct Foundry : Module {
 		if (autoseqJ)
 			autoseq = json_is_true(autoseqJ);
 
+		// clockBusSource
+		clockBusSubscriber.dataFromJson(rootJ);
+
 		// holdTiedNotes
 		json_t *holdTiedNotesJ = json_object_get(rootJ, "holdTiedNotes");
 		if (holdTiedNotesJ)
@@ -452,14 +469,14 @@ struct Foundry : Module {
 			stopAtEndOfSong = json_integer_value(stopAtEndOfSongJ);
 
 		// seq
-		seq.dataFromJson(rootJ, isEditingSequence());
+		seq.dataFromJson(rootJ);
 		
 		// mergeTracks
 		json_t *mergeTracksJ = json_object_get(rootJ, "mergeTracks");
 		if (mergeTracksJ)
 			mergeTracks = json_integer_value(mergeTracksJ);
-
-		resetNonJson(false);// no need to propagate initRun calls in seq, since seq.dataFromJson() has initRun() in it
+		
+		// process() adopts the steps and song, then calls resetNonJson()
 	}
 
 
@@ -484,6 +501,7 @@ struct Foundry : Module {
 	
 	
 	void emptyIoSteps(IoStep* ioSteps, int seqLen) {
+		seq.beginEdit();// one undo action for the whole paste
 		seq.setLength(seqLen, false);
 		
 		// populate steps in the sequencer
@@ -512,6 +530,7 @@ struct Foundry : Module {
 				seq.toggleTied(i);
 			}
 		}
+		seq.endEdit();
 	}
 	
 	
@@ -522,11 +541,19 @@ struct Foundry : Module {
 		bool expanderPresent = (rightExpander.module && rightExpander.module->model == modelFoundryExpander);
 		float *messagesFromExpander = static_cast<float*>(rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
 		
+		// Steps and song loaded by dataFromJson()
+		if (seq.adoptJson(isEditingSequence())) {
+			resetNonJson(false);// no need to propagate initRun calls in seq, since seq.adoptJson() has initRun() in it
+		}
+		
 		
 		//********** Buttons, knobs, switches and inputs **********
 		
+		// Clock bus, read by the run, clock and reset inputs
+		clockBusSubscriber.update(id, args.frame);
+		
 		// Run button
-		if (runningTrigger.process(params[RUN_PARAM].getValue() + inputs[RUNCV_INPUT].getVoltage())) {// no input refresh here, don't want to introduce startup skew
+		if (runningTrigger.process(params[RUN_PARAM].getValue() + clockBusSubscriber.getRun(inputs[RUNCV_INPUT]))) {// no input refresh here, don't want to introduce startup skew
 			running = !running;
 			if (running) {
 				if (resetOnRun) {
@@ -539,6 +566,8 @@ struct Foundry : Module {
 		}
 
 		if (refresh.processInputs()) {
+			seq.invalidateOutputs();// outputs are recalculated after edits, see Sequencer::calcOutputs()
+			
 			// Seq / song switch
 			bool newEditingSequence = isEditingSequence();
 			if (newEditingSequence != editingSequence) {
@@ -550,11 +579,12 @@ struct Foundry : Module {
 		
 			// Track CV input
 			if (expanderPresent) {
-				float trkCVin = messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0];
+				float trkCVin = messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 0];
 				if (!std::isnan(trkCVin)) {
-					int newTrk = (int)( trkCVin * (2.0f * (float)Sequencer::NUM_TRACKS - 1.0f) / 10.0f + 0.5f );
-					seq.setTrackIndexEdit(abs(newTrk));
-					multiTracks = (newTrk > 3);
+					int numTracks = seq.getNumTracks();
+					int newTrk = abs((int)( trkCVin * (2.0f * (float)numTracks - 1.0f) / 10.0f + 0.5f ));
+					seq.setTrackIndexEdit(newTrk);
+					multiTracks = (newTrk >= numTracks);
 				}
 			}
 			
@@ -635,7 +665,8 @@ struct Foundry : Module {
 			if (writeTrig) {
 				if (editingSequence) {
 					int multiStepsCount = multiSteps ? cpSeqLength : 1;
-					for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+					seq.beginWriteInputEdit();// one undo action for all tracks, and for the writes that follow until another edit
+					for (int trkn = 0; trkn < seq.getNumTracks(); trkn++) {
 						if (trkn == seq.getTrackIndexEdit() || multiTracks) {
 							if (expanderPresent && ((writeMode & 0x1) == 0)) {	// must be before seq.writeCV() below, so that editing CV2 can be grabbed
 								float velCVin = messagesFromExpander[0 + trkn];
@@ -646,14 +677,17 @@ struct Foundry : Module {
 									seq.setVelocityVal(trkn, clamp(intVel, 0, 200), multiStepsCount, false);
 								}
 							}
-							if (inputs[CV_INPUTS + trkn].isConnected() && ((writeMode & 0x2) == 0)) {
-								seq.writeCV(trkn, clamp(inputs[CV_INPUTS + trkn].getVoltage(), -10.0f, 10.0f), multiStepsCount, sampleRate, false);
+							Input* cvInput = &inputs[CV_INPUTS + trkn % Sequencer::NUM_TRACKS];// the tracks after D are on the channels of the input of their column
+							int chan = trkn / Sequencer::NUM_TRACKS;
+							if (chan < cvInput->getChannels() && ((writeMode & 0x2) == 0)) {
+								seq.writeCV(trkn, clamp(cvInput->getVoltage(chan), -10.0f, 10.0f), multiStepsCount, sampleRate, false);
 							}
 						}
 					}
+					seq.endEdit();
 					seq.setEditingGateKeyLight(-1);
 					if (params[AUTOSTEP_PARAM].getValue() > 0.5f) {
-						bool seqConnected = (expanderPresent && !std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + seq.getTrackIndexEdit()]));
+						bool seqConnected = (expanderPresent && !std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + seq.getTrackIndexEdit()]));
 						seq.autostep(autoseq && !seqConnected, autostepLen, multiTracks);
 					}
 				}
@@ -661,10 +695,10 @@ struct Foundry : Module {
 			// Left and right CV inputs in expander module
 			if (expanderPresent) {
 				int delta = 0;
-				if (leftTrigger.process(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 5])) {
+				if (leftTrigger.process(messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 5])) {
 					delta = -1;
 				}
-				if (rightTrigger.process(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 6])) {
+				if (rightTrigger.process(messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 6])) {
 					delta = +1;
 				}
 				if (delta != 0) {
@@ -790,18 +824,18 @@ struct Foundry : Module {
 
 			// Track Inc/Dec buttons
 			if (trackIncTrigger.process(params[TRACKUP_PARAM].getValue())) {
-				if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0])) {
+				if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 0])) {
 					seq.incTrackIndexEdit();
 				}
 			}
 			if (trackDecTrigger.process(params[TRACKDOWN_PARAM].getValue())) {
-				if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0])) {
+				if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 0])) {
 					seq.decTrackIndexEdit();
 				}
 			}
 			// All button
 			if (allTrigger.process(params[ALLTRACKS_PARAM].getValue())) {
-				if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 0])) {
+				if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 0])) {
 					if (!attached) {
 						multiTracks = !multiTracks;
 					}
@@ -835,7 +869,7 @@ struct Foundry : Module {
 			
 			// Write mode button
 			if (expanderPresent) {
-				if (writeModeTrigger.process(messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 7 + 1] + messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 4])) {//WRITE_SRC_INPUT
+				if (writeModeTrigger.process(messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 7 + 1] + messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 4])) {//WRITE_SRC_INPUT
 					if (editingSequence) {
 						if (++writeMode > 2)
 							writeMode =0;
@@ -896,13 +930,13 @@ struct Foundry : Module {
 					else {// DISP_NORMAL
 						if (editingSequence) {
 							int activeTrack = seq.getTrackIndexEdit();
-							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + activeTrack])) {
+							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + activeTrack])) {
 								seq.moveSeqIndexEdit(deltaSeqKnob);
 								if (multiTracks) {
 									int newSeq = seq.getSeqIndexEdit();
-									for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+									for (int trkn = 0; trkn < seq.getNumTracks(); trkn++) {
 										if (trkn == activeTrack) continue;
-										if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + trkn])) {
+										if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + trkn])) {
 											seq.setSeqIndexEdit(newSeq, trkn);
 										}
 									}
@@ -989,13 +1023,13 @@ struct Foundry : Module {
 			}
 			
 			// Gate, GateProb, Slide and Tied buttons
-			if (gate1Trigger.process(params[GATE_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 0] : 0.0f))) {
+			if (gate1Trigger.process(params[GATE_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 0] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					seq.toggleGate(multiSteps ? cpSeqLength : 1, multiTracks);
 				}
 			}		
-			if (gateProbTrigger.process(params[GATE_PROB_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 1] : 0.0f))) {
+			if (gateProbTrigger.process(params[GATE_PROB_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 1] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					if (seq.toggleGateP(multiSteps ? cpSeqLength : 1, multiTracks)) 
@@ -1004,7 +1038,7 @@ struct Foundry : Module {
 						velEditMode = 1;
 				}
 			}		
-			if (slideTrigger.process(params[SLIDE_BTN_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 3] : 0.0f))) {
+			if (slideTrigger.process(params[SLIDE_BTN_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 3] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					if (seq.toggleSlide(multiSteps ? cpSeqLength : 1, multiTracks))
@@ -1013,7 +1047,7 @@ struct Foundry : Module {
 						velEditMode = 2;
 				}
 			}		
-			if (tiedTrigger.process(params[TIE_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 2] : 0.0f))) {
+			if (tiedTrigger.process(params[TIE_PARAM].getValue() + (expanderPresent ? messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 2] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					seq.toggleTied(multiSteps ? cpSeqLength : 1, multiTracks);// will clear other attribs if new state is on
@@ -1026,8 +1060,8 @@ struct Foundry : Module {
 		
 		// Seq CV input
 		if (expanderPresent) {
-			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				float seqCVin = messagesFromExpander[Sequencer::NUM_TRACKS + trkn];
+			for (int trkn = 0; trkn < seq.getNumTracks(); trkn++) {
+				float seqCVin = messagesFromExpander[Sequencer::MAX_TRACKS + trkn];
 				if (!std::isnan(seqCVin)) {
 					int newSeq = -1;
 					if (seqCVmethod == 0) {// 0-10 V
@@ -1042,7 +1076,7 @@ struct Foundry : Module {
 						newSeq = clamp(seq.getSeqIndexEdit(trkn) + 1, 0, SequencerKernel::MAX_SEQS - 1);
 					}
 					if (newSeq >= 0) {
-						if (messagesFromExpander[Sequencer::NUM_TRACKS * 2 + 1 + 7] > 0.5f && running)
+						if (messagesFromExpander[Sequencer::MAX_TRACKS * 2 + 1 + 7] > 0.5f && running)
 							seq.requestDelayedSeqChange(trkn, newSeq);
 						else
 							seq.setSeqIndexEdit(newSeq, trkn);				
@@ -1058,8 +1092,10 @@ struct Foundry : Module {
 		if (running && clockIgnoreOnReset == 0l) {
 			bool clockTrigged[Sequencer::NUM_TRACKS];
 			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				clockTrigged[trkn] = clockTriggers[trkn].process(inputs[CLOCK_INPUTS + trkn].getVoltage());
-				if (clockTrigged[clkInSources[trkn]]) {
+				clockTrigged[trkn] = clockTriggers[trkn].process(trkn == 0 ? clockBusSubscriber.getClock(inputs[CLOCK_INPUTS + 0]) : inputs[CLOCK_INPUTS + trkn].getVoltage());
+			}
+			for (int trkn = 0; trkn < seq.getNumTracks(); trkn++) {
+				if (clockTrigged[clkInSources[trkn % Sequencer::NUM_TRACKS]]) {// a track is clocked by the clock input of its column
 					bool stopRequested = seq.clockStep(trkn, editingSequence);
 					if (stopRequested) {
 						running = false;
@@ -1071,13 +1107,15 @@ struct Foundry : Module {
 		}
 				
 		// Reset
-		if (resetTrigger.process(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue())) {
+		if (resetTrigger.process(clockBusSubscriber.getReset(inputs[RESET_INPUT]) + params[RESET_PARAM].getValue())) {
 			initRun(true);
 			resetLight = 1.0f;
 			displayState = DISP_NORMAL;
 			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
 				clockTriggers[trkn].reset();	
-				if (expanderPresent && !std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + trkn]) && seqCVmethod == 2)
+			}
+			for (int trkn = 0; trkn < seq.getNumTracks(); trkn++) {
+				if (expanderPresent && !std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + trkn]) && seqCVmethod == 2)
 					seq.setSeqIndexEdit(0, trkn);
 			}
 		}
@@ -1089,75 +1127,33 @@ struct Foundry : Module {
 		
 		
 		// CV, gate and velocity outputs
-		float cvOut[Sequencer::NUM_TRACKS];
-		float gateOut[Sequencer::NUM_TRACKS];
-		float velOut[Sequencer::NUM_TRACKS];
-		for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-			cvOut[trkn] = (seq.calcCvOutputAndDecSlideStepsRemain(trkn, running, editingSequence));
-			bool retriggingOnReset = (clockIgnoreOnReset != 0l && retrigGatesOnReset);
-			gateOut[trkn] = (seq.calcGateOutput(trkn, running && !retriggingOnReset, clockTriggers[clkInSources[trkn]], sampleRate));
-			velOut[trkn] = (seq.calcVelOutput(trkn, running && !retriggingOnReset, editingSequence) - (velocityBipol ? 5.0f : 0.0f));			
-		}
-		if (mergeTracks == 0) {
-			outputs[CV_OUTPUTS + 0].setChannels(1);
-			outputs[GATE_OUTPUTS + 0].setChannels(1);
-			outputs[VEL_OUTPUTS + 0].setChannels(1);
-			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				outputs[CV_OUTPUTS + trkn].setVoltage(cvOut[trkn]);
-				outputs[GATE_OUTPUTS + trkn].setVoltage(gateOut[trkn]);
-				outputs[VEL_OUTPUTS + trkn].setVoltage(velOut[trkn]);			
-			}
-		}
-		else if (mergeTracks == 1) {
-			outputs[CV_OUTPUTS + 0].setChannels(2);
-			outputs[GATE_OUTPUTS + 0].setChannels(2);
-			outputs[VEL_OUTPUTS + 0].setChannels(2);
-			outputs[CV_OUTPUTS + 1].setVoltage(0.0f);
-			outputs[GATE_OUTPUTS + 1].setVoltage(0.0f);
-			outputs[VEL_OUTPUTS + 1].setVoltage(0.0f);
-			for (int trkn = 0; trkn < 2; trkn++) {
-				outputs[CV_OUTPUTS + 0].setVoltage(cvOut[trkn], trkn);
-				outputs[GATE_OUTPUTS + 0].setVoltage(gateOut[trkn], trkn);
-				outputs[VEL_OUTPUTS + 0].setVoltage(velOut[trkn], trkn);			
-			}
-			for (int trkn = 2; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				outputs[CV_OUTPUTS + trkn].setVoltage(cvOut[trkn]);
-				outputs[GATE_OUTPUTS + trkn].setVoltage(gateOut[trkn]);
-				outputs[VEL_OUTPUTS + trkn].setVoltage(velOut[trkn]);			
-			}
-		}
-		else if (mergeTracks == 2) {
-			outputs[CV_OUTPUTS + 0].setChannels(3);
-			outputs[GATE_OUTPUTS + 0].setChannels(3);
-			outputs[VEL_OUTPUTS + 0].setChannels(3);
-			for (int trkn = 1; trkn < 3; trkn++) {
-				outputs[CV_OUTPUTS + trkn].setVoltage(0.0f);
-				outputs[GATE_OUTPUTS + trkn].setVoltage(0.0f);
-				outputs[VEL_OUTPUTS + trkn].setVoltage(0.0f);			
-			}
-			for (int trkn = 0; trkn < 3; trkn++) {
-				outputs[CV_OUTPUTS + 0].setVoltage(cvOut[trkn], trkn);
-				outputs[GATE_OUTPUTS + 0].setVoltage(gateOut[trkn], trkn);
-				outputs[VEL_OUTPUTS + 0].setVoltage(velOut[trkn], trkn);			
-			}
-			outputs[CV_OUTPUTS + 3].setVoltage(cvOut[3]);
-			outputs[GATE_OUTPUTS + 3].setVoltage(gateOut[3]);
-			outputs[VEL_OUTPUTS + 3].setVoltage(velOut[3]);			
+		// Tracks A to D are on their own outputs, and the tracks after D are on the channels of the outputs of their 
+		// column (track E is the second channel of the track A outputs, and so on); the tracks of the columns 
+		// merged into track A are on the track A outputs, in track order
+		int numTracks = seq.getNumTracks();
+		int channels[Sequencer::NUM_TRACKS] = {};
+		bool retriggingOnReset = (clockIgnoreOnReset != 0l && retrigGatesOnReset);
+		for (int trkn = 0; trkn < numTracks; trkn++) {
+			int col = trkn % Sequencer::NUM_TRACKS;
+			int outn = (col <= mergeTracks ? 0 : col);
+			float cvOut;
+			float gateOut;
+			float velOut;
+			seq.calcOutputs(trkn, running, retriggingOnReset, editingSequence, clockTriggers[clkInSources[col]], sampleRate, &cvOut, &gateOut, &velOut);
+			outputs[CV_OUTPUTS + outn].setVoltage(cvOut, channels[outn]);
+			outputs[GATE_OUTPUTS + outn].setVoltage(gateOut, channels[outn]);
+			outputs[VEL_OUTPUTS + outn].setVoltage(velOut - (velocityBipol ? 5.0f : 0.0f), channels[outn]);
+			channels[outn]++;
 		}
-		else {
-			outputs[CV_OUTPUTS + 0].setChannels(4);
-			outputs[GATE_OUTPUTS + 0].setChannels(4);
-			outputs[VEL_OUTPUTS + 0].setChannels(4);
-			for (int trkn = 1; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				outputs[CV_OUTPUTS + trkn].setVoltage(0.0f);
-				outputs[GATE_OUTPUTS + trkn].setVoltage(0.0f);
-				outputs[VEL_OUTPUTS + trkn].setVoltage(0.0f);			
-			}
-			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				outputs[CV_OUTPUTS + 0].setVoltage(cvOut[trkn], trkn);
-				outputs[GATE_OUTPUTS + 0].setVoltage(gateOut[trkn], trkn);
-				outputs[VEL_OUTPUTS + 0].setVoltage(velOut[trkn], trkn);			
+		for (int outn = 0; outn < Sequencer::NUM_TRACKS; outn++) {
+			if (channels[outn] == 0) {// merged into track A
+				outputs[CV_OUTPUTS + outn].setVoltage(0.0f);
+				outputs[GATE_OUTPUTS + outn].setVoltage(0.0f);
+				outputs[VEL_OUTPUTS + outn].setVoltage(0.0f);
 			}
+			outputs[CV_OUTPUTS + outn].setChannels(std::max(channels[outn], 1));
+			outputs[GATE_OUTPUTS + outn].setChannels(std::max(channels[outn], 1));
+			outputs[VEL_OUTPUTS + outn].setChannels(std::max(channels[outn], 1));
 		}
 
 
@@ -1206,8 +1202,9 @@ struct Foundry : Module {
 
 					// Run cursor (green)
 					if (running) {
-						for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-							bool trknIsUsed = outputs[CV_OUTPUTS + trkn].isConnected() || outputs[GATE_OUTPUTS + trkn].isConnected() || outputs[VEL_OUTPUTS + trkn].isConnected() || (mergeTracks > 0 && trkn <= mergeTracks);
+						for (int trkn = 0; trkn < seq.getNumTracks(); trkn++) {
+							int col = trkn % Sequencer::NUM_TRACKS;
+							bool trknIsUsed = outputs[CV_OUTPUTS + col].isConnected() || outputs[GATE_OUTPUTS + col].isConnected() || outputs[VEL_OUTPUTS + col].isConnected() || (mergeTracks > 0 && col <= mergeTracks);
 							if (stepn == seq.getStepIndexRun(trkn) && trknIsUsed) 
 								green = 0.42f;	
 						}
@@ -1285,11 +1282,15 @@ struct Foundry : Module {
 							}
 						}
 						else {
-							int modeLightIndex = attributesVisual.getGateType();
+							int modeLightIndex = gateTypeToKeyIndex(attributesVisual.getGateType());
 							if (i != modeLightIndex) {// show dim note if gatetype is different than note
 								green = 0.0f;
 								red = (i == keyLightIndex ? 0.32f : 0.0f);
 							}
+							else if (isExtGateType(attributesVisual.getGateType())) {// ratchet and Euclidean gate types show dimmed
+								green *= 0.4f;
+								red *= 0.4f;
+							}
 						}
 					}
 					else {
@@ -1349,7 +1350,7 @@ struct Foundry : Module {
 			
 			// CV writing lights (CV only, CV2 done below for exp panel)
 			for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-				lights[WRITECV_LIGHTS + trkn].setBrightness((editingSequence && ((writeMode & 0x2) == 0) && (multiTracks || seq.getTrackIndexEdit() == trkn)) ? 1.0f : 0.0f);
+				lights[WRITECV_LIGHTS + trkn].setBrightness((editingSequence && ((writeMode & 0x2) == 0) && (multiTracks || seq.getTrackIndexEdit() % Sequencer::NUM_TRACKS == trkn)) ? 1.0f : 0.0f);
 			}	
 			
 			
@@ -1373,7 +1374,7 @@ struct Foundry : Module {
 				messagesToExpander[2] = (((writeMode & 0x2) == 0) && editingSequence) ? 1.0f : 0.0f;// lights[WRITE_SEL_LIGHTS + 0].setBrightness()
 				messagesToExpander[3] = (((writeMode & 0x1) == 0) && editingSequence) ? 1.0f : 0.0f;// lights[WRITE_SEL_LIGHTS + 1].setBrightness()
 				for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
-					messagesToExpander[4 + trkn] = (editingSequence && ((writeMode & 0x1) == 0) && (multiTracks || seq.getTrackIndexEdit() == trkn)) ? 1.0f : 0.0f;
+					messagesToExpander[4 + trkn] = (editingSequence && ((writeMode & 0x1) == 0) && (multiTracks || seq.getTrackIndexEdit() % Sequencer::NUM_TRACKS == trkn)) ? 1.0f : 0.0f;
 				}	
 				rightExpander.module->leftExpander.messageFlipRequested = true;
 			}
@@ -1402,8 +1403,34 @@ struct Foundry : Module {
 };
 
 
+struct FoundryEditAction : history::ModuleAction {
+	// edits [firstAction : finalAction] of the edit journal of a Foundry (see EditJournal)
+	uint32_t firstAction;
+	uint32_t finalAction;
+	
+	FoundryEditAction(int64_t _moduleId, uint32_t _firstAction, uint32_t _finalAction) {
+		moduleId = _moduleId;
+		firstAction = _firstAction;
+		finalAction = _finalAction;
+		name = "edit Foundry";
+	}
+	void undo() override {
+		Foundry* module = dynamic_cast<Foundry*>(APP->engine->getModule(moduleId));
+		if (module)
+			module->seq.undoEdit(firstAction);
+	}
+	void redo() override {
+		Foundry* module = dynamic_cast<Foundry*>(APP->engine->getModule(moduleId));
+		if (module)
+			module->seq.redoEdit(finalAction);
+	}
+};
+
+
 
 struct FoundryWidget : ModuleWidget {
+	uint32_t lastEditActionPushed = 0;
+	
 	template <int NUMCHAR>
 	struct DisplayWidget : TransparentWidget {// a centered display, must derive from this
 		Foundry *module = nullptr;
@@ -1624,12 +1651,12 @@ struct FoundryWidget : ModuleWidget {
 							int activeTrack = module->seq.getTrackIndexEdit();
 							bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelFoundryExpander);
 							const float *messagesFromExpander = static_cast<float*>(module->rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
-							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + activeTrack])) {
+							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + activeTrack])) {
 								module->seq.setSeqIndexEdit(totalNum - 1, activeTrack);
 								if (module->multiTracks) {
-									for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+									for (int trkn = 0; trkn < module->seq.getNumTracks(); trkn++) {
 										if (trkn == activeTrack) continue;
-										if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + trkn])) {
+										if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + trkn])) {
 											module->seq.setSeqIndexEdit(totalNum - 1, trkn);
 										}
 									}
@@ -1901,7 +1928,19 @@ struct FoundryWidget : ModuleWidget {
 		menu->addChild(createBoolPtrMenuItem("AutoStep write bounded by seq length", "", &module->autostepLen));
 		
 		menu->addChild(createBoolPtrMenuItem("AutoSeq when writing via CV inputs", "", &module->autoseq));
+
+		createClockBusMenu(menu, &module->clockBusSubscriber);
 	
+		menu->addChild(createSubmenuItem("Tracks", "", [=](Menu* menu) {
+			for (int numTracks = Sequencer::NUM_TRACKS; numTracks <= Sequencer::MAX_TRACKS; numTracks += Sequencer::NUM_TRACKS) {
+				std::string label = numTracks == Sequencer::NUM_TRACKS ? "4 (A to D)" : string::f("%i (A to %c, polyphonic outputs)", numTracks, numTracks - 1 + 'A');
+				menu->addChild(createCheckMenuItem(label, "",
+					[=]() {return module->seq.getNumTracks() == numTracks;},
+					[=]() {module->seq.setNumTracks(numTracks, module->editingSequence);}
+				));
+			}
+		}));
+
 		menu->addChild(createSubmenuItem("Poly merge into track A outputs", "", [=](Menu* menu) {
 			menu->addChild(createCheckMenuItem("None", "",
 				[=]() {return module->mergeTracks == 0;},
@@ -1921,6 +1960,13 @@ struct FoundryWidget : ModuleWidget {
 			));
 		}));			
 		
+		menu->addChild(createBoolPtrMenuItem("Compact patch data", "", &module->packedPatchData));
+
+		menu->addChild(createBoolMenuItem("Same random values on every load", "",
+			[=]() {return module->seq.isRandomDeterministic();},
+			[=](bool deterministic) {module->seq.setRandomDeterministic(deterministic);}
+		));
+		
 		menu->addChild(new MenuSeparator());
 		menu->addChild(createMenuLabel("Actions"));
 		
@@ -1931,8 +1977,32 @@ struct FoundryWidget : ModuleWidget {
 		menu->addChild(expItem);	
 	}	
 		
+	// Edit knobs: the edits they make are journaled by the sequencer (see FoundryEditAction), so they must not also push
+	// Rack's ParamChange, whose undo would only move the endless knob
+	struct EditKnob : IMMediumKnobInf {
+		void onDragStart(const event::DragStart &e) override {
+			ParamQuantity* paramQuantity = getParamQuantity();
+			if (paramQuantity)
+				static_cast<Foundry*>(paramQuantity->module)->seq.sealKnobEdits();// a new turn of the knob is a new undo action
+			IMMediumKnobInf::onDragStart(e);
+		}
+		void onDragEnd(const event::DragEnd &e) override {
+			// as Knob::onDragEnd(), without the history action
+			if (e.button != GLFW_MOUSE_BUTTON_LEFT)
+				return;
+			if (settings::knobMode == settings::KNOB_MODE_LINEAR || settings::knobMode == settings::KNOB_MODE_SCALED_LINEAR)
+				APP->window->cursorUnlock();
+			ParamWidget::onDragEnd(e);
+		}
+		void resetKnob() {
+			// as ParamWidget::onDoubleClick(), without the history action
+			ParamQuantity* paramQuantity = getParamQuantity();
+			if (paramQuantity)
+				paramQuantity->reset();
+		}
+	};
 	// Velocity edit knob
-	struct VelocityKnob : IMMediumKnobInf {
+	struct VelocityKnob : EditKnob {
 		VelocityKnob() {};		
 		void onDoubleClick(const event::DoubleClick &e) override {
 			ParamQuantity* paramQuantity = getParamQuantity();
@@ -1953,11 +2023,11 @@ struct FoundryWidget : ModuleWidget {
 					}
 				}
 			}
-			ParamWidget::onDoubleClick(e);
+			resetKnob();
 		}
 	};
 	// Sequence edit knob
-	struct SequenceKnob : IMMediumKnobInf {
+	struct SequenceKnob : EditKnob {
 		SequenceKnob() {};		
 		void onDoubleClick(const event::DoubleClick &e) override {
 			ParamQuantity* paramQuantity = getParamQuantity();
@@ -1980,10 +2050,10 @@ struct FoundryWidget : ModuleWidget {
 				}
 				else {// DISP_NORMAL
 					if (module->editingSequence) {
-						for (int trkn = 0; trkn < Sequencer::NUM_TRACKS; trkn++) {
+						for (int trkn = 0; trkn < module->seq.getNumTracks(); trkn++) {
 							bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelFoundryExpander);
 							const float *messagesFromExpander = static_cast<float*>(module->rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
-							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::NUM_TRACKS + trkn])) {
+							if (!expanderPresent || std::isnan(messagesFromExpander[Sequencer::MAX_TRACKS + trkn])) {
 								if (module->multiTracks || (trkn == module->seq.getTrackIndexEdit())) {
 									module->seq.setSeqIndexEdit(0, trkn);
 								}
@@ -1996,11 +2066,11 @@ struct FoundryWidget : ModuleWidget {
 					}
 				}	
 			}
-			ParamWidget::onDoubleClick(e);
+			resetKnob();
 		}
 	};
 	// Phrase edit knob
-	struct PhraseKnob : IMMediumKnobInf {
+	struct PhraseKnob : EditKnob {
 		PhraseKnob() {};		
 		void onDoubleClick(const event::DoubleClick &e) override {
 			ParamQuantity* paramQuantity = getParamQuantity();
@@ -2033,7 +2103,7 @@ struct FoundryWidget : ModuleWidget {
 					}
 				}
 			}
-			ParamWidget::onDoubleClick(e);
+			resetKnob();
 		}
 	};
 		
@@ -2298,6 +2368,18 @@ struct FoundryWidget : ModuleWidget {
 		addInput(createDynamicPortCentered<IMPort>(VecPx(columnRulerB11, rowRulerBHigh), true, module, Foundry::RUNCV_INPUT, mode));
 		addInput(createDynamicPortCentered<IMPort>(VecPx(columnRulerB11, rowRulerBLow), true, module, Foundry::RESET_INPUT, mode));	
 	}
+	
+	void step() override {
+		if (module) {
+			// one undo action per frame for the edits journaled since the last one
+			uint32_t lastEditAction = static_cast<Foundry*>(module)->seq.getLastEditAction();
+			if (lastEditAction != lastEditActionPushed) {
+				APP->history->push(new FoundryEditAction(module->id, lastEditActionPushed + 1, lastEditAction));
+				lastEditActionPushed = lastEditAction;
+			}
+		}
+		Widget::step();
+	}
 };
 
 Model *modelFoundry = createModel<Foundry, FoundryWidget>("Foundry");
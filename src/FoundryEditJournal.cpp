@@ -0,0 +1,221 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Undo/redo journal of Foundry edits, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "FoundryEditJournal.hpp"
+
+
+bool EditJournal::tryLock() {
+	bool expected = false;
+	if (!locked.compare_exchange_strong(expected, true, std::memory_order_acquire))
+		return false;
+	owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	if (clearRequest.exchange(false, std::memory_order_relaxed)) {
+		first = applied = last = topStart = 0;// action numbers keep increasing, so that old ones are not mistaken for new ones
+		topMergeKey = 0;
+	}
+	return true;
+}
+void EditJournal::lock() {
+	while (!tryLock())
+		std::this_thread::yield();// an edit is being recorded, that's a copy and a compare of the edited data
+}
+void EditJournal::unlock() {
+	owner.store(std::thread::id(), std::memory_order_relaxed);
+	locked.store(false, std::memory_order_release);
+}
+
+
+void EditJournal::beginEdit(uint32_t _mergeKey) {
+	if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+		depth++;// nested edit, part of the outer one
+		return;
+	}
+	if (!tryLock())
+		return;// the other thread is recording or undoing, this edit is not journaled
+	depth = 1;
+	mergeKey = _mergeKey;
+	for (int trkn = 0; trkn < numTracks; trkn++) {
+		SequencerKernelData* sd = tracks[trkn];
+		TrackWindow* w = &window[trkn];
+		int seqn = sd->seqIndexEdit;
+		w->seqn = seqn;
+		w->sequence = sd->sequences[seqn];
+		std::memcpy(w->cv, sd->cv[seqn], sizeof(w->cv));
+		w->attributes = sd->attributes[seqn];
+		std::memcpy(w->phrases, sd->phrases, sizeof(w->phrases));
+		w->runModeSong = sd->runModeSong;
+		w->songBeginIndex = sd->songBeginIndex;
+		w->songEndIndex = sd->songEndIndex;
+		w->pulsesPerStep = sd->pulsesPerStep;
+		w->delay = sd->delay;
+	}
+}
+void EditJournal::endEdit() {
+	if (owner.load(std::memory_order_relaxed) != std::this_thread::get_id())
+		return;// beginEdit() could not lock
+	if (--depth > 0)
+		return;
+	record();
+	unlock();
+}
+
+
+void EditJournal::record() {
+	// the edited sequence is the one that was being edited in beginEdit(), autostep can move to the next one
+	bool sealed = sealRequest.exchange(false, std::memory_order_relaxed);
+	bool merge = mergeKey != 0 && mergeKey == topMergeKey && !sealed;
+	uint64_t end = applied;// entries go from here, this drops the actions that were undone (unless nothing changed)
+	Entry entry;
+	entry.action = merge ? nextAction - 1 : nextAction;
+	entry.oldCV = entry.newCV = 0.0f;
+
+	for (int trkn = 0; trkn < numTracks; trkn++) {
+		SequencerKernelData* sd = tracks[trkn];
+		TrackWindow* w = &window[trkn];
+		int seqn = w->seqn;
+		entry.track = (uint8_t)trkn;
+		entry.step = 0;
+
+		// steps
+		entry.kind = KIND_STEP;
+		entry.index = (uint8_t)seqn;
+		for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
+			uint32_t oldAttrib = (uint32_t)w->attributes.getAttribute(stepn);
+			uint32_t newAttrib = (uint32_t)sd->attributes[seqn].getAttribute(stepn);
+			if (oldAttrib != newAttrib || w->cv[stepn] != sd->cv[seqn][stepn]) {
+				entry.step = (uint8_t)stepn;
+				entry.oldValue = oldAttrib;
+				entry.newValue = newAttrib;
+				entry.oldCV = w->cv[stepn];
+				entry.newCV = sd->cv[seqn][stepn];
+				append(entry, merge, &end);
+			}
+		}
+		entry.step = 0;
+		entry.oldCV = entry.newCV = 0.0f;
+
+		// sequence attributes
+		entry.kind = KIND_SEQ;
+		entry.oldValue = (uint32_t)w->sequence.getSeqAttrib();
+		entry.newValue = (uint32_t)sd->sequences[seqn].getSeqAttrib();
+		if (entry.oldValue != entry.newValue)
+			append(entry, merge, &end);
+
+		// song
+		entry.kind = KIND_PHRASE;
+		for (int phrn = 0; phrn < MAX_PHRASES; phrn++) {
+			entry.index = (uint8_t)phrn;
+			entry.oldValue = (uint32_t)w->phrases[phrn].getPhraseJson();
+			entry.newValue = (uint32_t)sd->phrases[phrn].getPhraseJson();
+			if (entry.oldValue != entry.newValue)
+				append(entry, merge, &end);
+		}
+		entry.index = 0;
+		const int songKinds[5] = {KIND_RUN_MODE_SONG, KIND_BEGIN, KIND_END, KIND_PULSES_PER_STEP, KIND_DELAY};
+		const int oldSongValues[5] = {w->runModeSong, w->songBeginIndex, w->songEndIndex, w->pulsesPerStep, w->delay};
+		const int newSongValues[5] = {sd->runModeSong, sd->songBeginIndex, sd->songEndIndex, sd->pulsesPerStep, sd->delay};
+		for (int i = 0; i < 5; i++) {
+			if (oldSongValues[i] != newSongValues[i]) {
+				entry.kind = (uint8_t)songKinds[i];
+				entry.oldValue = (uint32_t)oldSongValues[i];
+				entry.newValue = (uint32_t)newSongValues[i];
+				append(entry, merge, &end);
+			}
+		}
+	}
+
+	if (end == applied)
+		return;// nothing changed
+	if (!merge) {
+		topStart = applied;
+		nextAction++;
+		lastAction.store(entry.action, std::memory_order_release);
+	}
+	applied = last = end;
+	topMergeKey = mergeKey;
+}
+
+
+void EditJournal::append(const Entry& entry, bool merge, uint64_t* end) {
+	if (merge) {// the newest action already has an entry for this value when the knob went over it before
+		for (uint64_t i = topStart; i < *end; i++) {
+			Entry* e = &entries[i % CAPACITY];
+			if (e->track == entry.track && e->kind == entry.kind && e->index == entry.index && e->step == entry.step) {
+				e->newValue = entry.newValue;
+				e->newCV = entry.newCV;
+				return;
+			}
+		}
+	}
+	if (*end - first >= CAPACITY) {// full, drop the oldest action (an action is always much smaller than CAPACITY)
+		uint32_t oldest = entries[first % CAPACITY].action;
+		while (first < *end && entries[first % CAPACITY].action == oldest)
+			first++;
+	}
+	entries[(*end)++ % CAPACITY] = entry;
+}
+
+
+void EditJournal::apply(const Entry& entry, bool redo) {
+	SequencerKernelData* sd = tracks[entry.track];
+	uint32_t value = redo ? entry.newValue : entry.oldValue;
+	switch (entry.kind) {
+		case KIND_STEP :
+			sd->cv[entry.index][entry.step] = redo ? entry.newCV : entry.oldCV;
+			sd->attributes[entry.index].setAttribute(entry.step, value);
+			sd->dirty[entry.index] = 1;
+		break;
+		case KIND_SEQ :
+			sd->sequences[entry.index].setSeqAttrib(value);
+		break;
+		case KIND_PHRASE :
+			sd->phrases[entry.index].setPhraseJson(value);
+		break;
+		case KIND_RUN_MODE_SONG :
+			sd->runModeSong = (int)value;
+		break;
+		case KIND_BEGIN :
+			sd->songBeginIndex = (int)value;
+		break;
+		case KIND_END :
+			sd->songEndIndex = (int)value;
+		break;
+		case KIND_PULSES_PER_STEP :
+			sd->pulsesPerStep = (int)value;
+		break;
+		default :// KIND_DELAY
+			sd->delay = (int)value;
+	}
+}
+
+
+bool EditJournal::undo(uint32_t firstAction) {
+	lock();
+	bool undone = false;
+	if (first < last && firstAction >= entries[first % CAPACITY].action) {// else firstAction was dropped or cleared
+		while (applied > first && entries[(applied - 1) % CAPACITY].action >= firstAction) {
+			applied--;
+			apply(entries[applied % CAPACITY], false);
+			undone = true;
+		}
+	}
+	topMergeKey = 0;
+	unlock();
+	return undone;
+}
+bool EditJournal::redo(uint32_t finalAction) {
+	lock();
+	bool redone = false;
+	while (applied < last && entries[applied % CAPACITY].action <= finalAction) {
+		apply(entries[applied % CAPACITY], true);
+		applied++;
+		redone = true;
+	}
+	topMergeKey = 0;
+	unlock();
+	return redone;
+}
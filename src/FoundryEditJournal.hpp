@@ -0,0 +1,111 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Undo/redo journal of Foundry edits, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include "FoundrySequencerKernel.hpp"
+#include <atomic>
+#include <thread>
+
+
+// Records Foundry edits as compact deltas (old and new value of each step, sequence, phrase and song setting that
+// changed) in a ring buffer allocated once, so that undo and redo replay only what an edit changed instead of
+// swapping whole-module json snapshots.
+//
+// An edit is bracketed by beginEdit() and endEdit(), which can be nested; beginEdit() copies the edited sequence
+// and the song of each track, and endEdit() records the differences as one action. Edits happen on the engine
+// thread (buttons, keys, knobs, write input) and on the UI thread (display typing, knob double-clicks, paste),
+// and the journal is locked while an edit is recorded: an edit that finds it locked by the other thread is
+// simply not recorded, so process() never waits. Undo and redo are called on the UI thread, and wait.
+
+class EditJournal {
+	public:
+
+	static const int MAX_TRACKS = 16;
+	static const int CAPACITY = 4096;// entries, the oldest actions are dropped when full
+
+
+	private:
+
+	static const int MAX_STEPS = SequencerKernelData::MAX_STEPS;
+	static const int MAX_PHRASES = SequencerKernelData::MAX_PHRASES;
+
+	enum EntryKinds {KIND_STEP, KIND_SEQ, KIND_PHRASE, KIND_RUN_MODE_SONG, KIND_BEGIN, KIND_END, KIND_PULSES_PER_STEP, KIND_DELAY};
+
+	struct Entry {
+		uint32_t action;// entries of an action are contiguous, action numbers increase
+		uint8_t track;
+		uint8_t kind;
+		uint8_t index;// sequence (KIND_STEP, KIND_SEQ) or phrase (KIND_PHRASE)
+		uint8_t step;
+		uint32_t oldValue;// packed step attributes, sequence attributes, phrase (json value) or song setting
+		uint32_t newValue;
+		float oldCV;// KIND_STEP only
+		float newCV;
+	};
+
+	struct TrackWindow {// what an edit can change in a track, copied by beginEdit()
+		int seqn;
+		SeqAttributes sequence;
+		float cv[MAX_STEPS];
+		SeqStepAttributes attributes;
+		Phrase phrases[MAX_PHRASES];
+		int runModeSong;
+		int songBeginIndex;
+		int songEndIndex;
+		int pulsesPerStep;
+		int delay;
+	};
+
+	SequencerKernelData* tracks[MAX_TRACKS] = {};
+	int numTracks = 0;
+	std::vector<Entry> entries;// ring buffer, indexed modulo CAPACITY
+	uint64_t first = 0;// oldest entry
+	uint64_t applied = 0;// one past the newest entry that is applied, entries from here on can be redone
+	uint64_t last = 0;// one past the newest entry
+	uint64_t topStart = 0;// first entry of the newest action
+	uint32_t nextAction = 1;
+	uint32_t mergeKey = 0;// of the edit being recorded
+	uint32_t topMergeKey = 0;// of the newest action when it can still take more edits, 0 when not
+	TrackWindow window[MAX_TRACKS];
+	int depth = 0;// beginEdit() nesting of the thread that holds the lock
+	std::atomic<bool> locked;
+	std::atomic<std::thread::id> owner;
+	std::atomic<bool> clearRequest;
+	std::atomic<bool> sealRequest;
+	std::atomic<uint32_t> lastAction;// newest action recorded, 0 when none
+
+
+	public:
+
+	EditJournal() : locked(false), owner(std::thread::id()), clearRequest(false), sealRequest(false), lastAction(0) {
+		entries.resize(CAPACITY);
+	}
+	void addTrack(SequencerKernelData* sd) {// in track order, before any edit
+		tracks[numTracks++] = sd;
+	}
+
+	// mergeKey: knob edits that turn the same value of the same step or phrase give the same non-zero key, and
+	// consecutive ones with the same key are merged into one action, until seal() is called
+	void beginEdit(uint32_t _mergeKey);
+	void endEdit();
+	void seal() {sealRequest.store(true, std::memory_order_relaxed);}// ends the merging of knob edits (knob grabbed)
+	void clear() {clearRequest.store(true, std::memory_order_relaxed);}// drops all actions, done on the next lock
+
+	uint32_t getLastAction() {return lastAction.load(std::memory_order_acquire);}
+	bool undo(uint32_t firstAction);// undoes all applied actions from firstAction onward, returns true if any was
+	bool redo(uint32_t finalAction);// redoes all undone actions up to finalAction, returns true if any was
+
+
+	private:
+
+	bool tryLock();
+	void lock();
+	void unlock();
+	void record();
+	void append(const Entry& entry, bool merge, uint64_t* end);
+	void apply(const Entry& entry, bool redo);
+};// class EditJournal
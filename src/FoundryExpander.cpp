@@ -85,12 +85,18 @@ struct FoundryExpander : Module {
 		if (motherPresent) {
 			// To Mother
 			float *messagesToMother = static_cast<float*>(leftExpander.module->rightExpander.producerMessage);
-			int i = 0;
-			for (; i < GATECV_INPUT; i++) {
-				messagesToMother[i] = (inputs[i].isConnected() ? inputs[i].getVoltage() : std::numeric_limits<float>::quiet_NaN());
+			// one message per track for the CV2 and seq# inputs, the tracks after D are on the channels of the input of their column
+			for (int trkn = 0; trkn < Sequencer::MAX_TRACKS; trkn++) {
+				int chan = trkn / Sequencer::NUM_TRACKS;
+				Input* velInput = &inputs[VEL_INPUTS + trkn % Sequencer::NUM_TRACKS];
+				Input* seqInput = &inputs[SEQCV_INPUTS + trkn % Sequencer::NUM_TRACKS];
+				messagesToMother[trkn] = (chan < velInput->getChannels() ? velInput->getVoltage(chan) : std::numeric_limits<float>::quiet_NaN());
+				messagesToMother[Sequencer::MAX_TRACKS + trkn] = (chan < seqInput->getChannels() ? seqInput->getVoltage(chan) : std::numeric_limits<float>::quiet_NaN());
 			}
-			for (; i < NUM_INPUTS; i++) {
-				messagesToMother[i] = inputs[i].getVoltage();
+			int i = Sequencer::MAX_TRACKS * 2;
+			messagesToMother[i++] = (inputs[TRKCV_INPUT].isConnected() ? inputs[TRKCV_INPUT].getVoltage() : std::numeric_limits<float>::quiet_NaN());
+			for (int inputn = GATECV_INPUT; inputn < NUM_INPUTS; inputn++) {
+				messagesToMother[i++] = inputs[inputn].getVoltage();
 			}
 			messagesToMother[i++] = params[SYNC_SEQCV_PARAM].getValue();
 			messagesToMother[i++] = params[WRITEMODE_PARAM].getValue();
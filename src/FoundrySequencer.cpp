@@ -8,10 +8,15 @@
 
 Sequencer::Sequencer(bool* _holdTiedNotesPtr, int* _velocityModePtr, int* _stopAtEndOfSongPtr) {
 	velocityModePtr = _velocityModePtr;
-	sek.reserve(4);
+	sek.reserve(MAX_TRACKS);
 	sek.push_back(SequencerKernel(0, nullptr, _holdTiedNotesPtr, _stopAtEndOfSongPtr));
-	for (int trkn = 1; trkn < NUM_TRACKS; trkn++) {
-		sek.push_back(SequencerKernel(trkn, &sek[0], _holdTiedNotesPtr, _stopAtEndOfSongPtr));
+	for (int trkn = 1; trkn < MAX_TRACKS; trkn++) {// only the panel tracks can stop on song end
+		sek.push_back(SequencerKernel(trkn, &sek[0], _holdTiedNotesPtr, trkn < NUM_TRACKS ? _stopAtEndOfSongPtr : nullptr));
+	}
+	uint64_t seed = random::u64();
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
+		sek[trkn].seedRandom(seed);// one seed per module, one stream per track
+		editJournal.addTrack(&sek[trkn]);
 	}
 	onReset(false);
 }
@@ -21,14 +26,17 @@ void Sequencer::onReset(bool editingSequence) {
 	stepIndexEdit = 0;
 	phraseIndexEdit = 0;
 	trackIndexEdit = 0;
-	for (int trkn = 0; trkn < NUM_TRACKS; trkn++) {
+	numTracks = NUM_TRACKS;
+	numUsedTracks = NUM_TRACKS;
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
 		sek[trkn].onReset(editingSequence);
 	}
+	editJournal.clear();
 	resetNonJson(editingSequence, false);// no need to propagate initRun calls in kernels, since sek[trkn].onReset() have initRun() in them
 }
 void Sequencer::resetNonJson(bool editingSequence, bool propagateInitRun) {
 	editingType = 0ul;
-	for (int trkn = 0; trkn < NUM_TRACKS; trkn++) {
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
 		editingGate[trkn] = 0ul;
 	}
 	seqCPbuf.reset();
@@ -37,117 +45,187 @@ void Sequencer::resetNonJson(bool editingSequence, bool propagateInitRun) {
 }
 void Sequencer::initRun(bool editingSequence, bool propagateInitRun) {
 	initDelayedSeqNumberRequest();
+	invalidateOutputs();
 	if (propagateInitRun) {
-		for (int trkn = 0; trkn < NUM_TRACKS; trkn++)
+		for (int trkn = 0; trkn < MAX_TRACKS; trkn++)// also the tracks not played, so that they start in step when added
 			sek[trkn].initRun(editingSequence);
 	}
 }
 void Sequencer::initDelayedSeqNumberRequest() {
-	for (int trkn = 0; trkn < NUM_TRACKS; trkn++) {
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
 		delayedSeqNumberRequest[trkn] = -1;
 	}
 }
 
 
-void Sequencer::dataToJson(json_t *rootJ) {
+void Sequencer::dataToJson(json_t *rootJ, bool packed) {
+	Data* pendingData = jsonHandoff.peekPending();// not adopted yet by process(), this is what the patch holds
+	
 	// stepIndexEdit
-	json_object_set_new(rootJ, "stepIndexEdit", json_integer(stepIndexEdit));
+	json_object_set_new(rootJ, "stepIndexEdit", json_integer(pendingData ? pendingData->stepIndexEdit : stepIndexEdit));
 
 	// phraseIndexEdit
-	json_object_set_new(rootJ, "phraseIndexEdit", json_integer(phraseIndexEdit));
+	json_object_set_new(rootJ, "phraseIndexEdit", json_integer(pendingData ? pendingData->phraseIndexEdit : phraseIndexEdit));
 
 	// trackIndexEdit
-	json_object_set_new(rootJ, "trackIndexEdit", json_integer(trackIndexEdit));
+	json_object_set_new(rootJ, "trackIndexEdit", json_integer(pendingData ? pendingData->trackIndexEdit : trackIndexEdit));
+
+	// numTracks
+	int savedNumTracks = pendingData ? pendingData->numTracks : numTracks;
+	json_object_set_new(rootJ, "numTracks", json_integer(savedNumTracks));
 
-	for (int trkn = 0; trkn < NUM_TRACKS; trkn++)
-		sek[trkn].dataToJson(rootJ);
+	// the played tracks, and those after them that were edited (so that reducing the number of tracks keeps them)
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
+		SequencerKernelData* sd = pendingData ? &pendingData->sekData[trkn] : &sek[trkn];
+		if (pendingData ? trkn >= pendingData->numLoadedTracks : trkn >= numUsedTracks)
+			break;// init state
+		if (trkn < savedNumTracks || !sd->isInit())
+			sek[trkn].dataToJson(rootJ, packed, sd);
+	}
+	
+	if (pendingData)
+		jsonHandoff.endPeek();
 }
 
 
-void Sequencer::dataFromJson(json_t *rootJ, bool editingSequence) {
+void Sequencer::dataFromJson(json_t *rootJ) {
+	Data* sd = jsonHandoff.beginWrite();
+	sd->stepIndexEdit = 0;
+	sd->phraseIndexEdit = 0;
+	sd->trackIndexEdit = 0;
+	sd->numTracks = NUM_TRACKS;
+	
 	// stepIndexEdit
 	json_t *stepIndexEditJ = json_object_get(rootJ, "stepIndexEdit");
 	if (stepIndexEditJ)
-		stepIndexEdit = json_integer_value(stepIndexEditJ);
+		sd->stepIndexEdit = json_integer_value(stepIndexEditJ);
 	
 	// phraseIndexEdit
 	json_t *phraseIndexEditJ = json_object_get(rootJ, "phraseIndexEdit");
 	if (phraseIndexEditJ)
-		phraseIndexEdit = json_integer_value(phraseIndexEditJ);
+		sd->phraseIndexEdit = json_integer_value(phraseIndexEditJ);
 	
 	// trackIndexEdit
 	json_t *trackIndexEditJ = json_object_get(rootJ, "trackIndexEdit");
 	if (trackIndexEditJ)
-		trackIndexEdit = json_integer_value(trackIndexEditJ);
+		sd->trackIndexEdit = json_integer_value(trackIndexEditJ);
+	
+	// numTracks
+	json_t *numTracksJ = json_object_get(rootJ, "numTracks");
+	if (numTracksJ)
+		sd->numTracks = clamp((int)json_integer_value(numTracksJ), NUM_TRACKS, MAX_TRACKS);
+	if (sd->trackIndexEdit >= sd->numTracks)
+		sd->trackIndexEdit = 0;
+	
+	sd->numLoadedTracks = 0;
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
+		sd->sekData[trkn].init();
+		if (sek[trkn].dataFromJson(rootJ, &sd->sekData[trkn]))// tracks not in the patch stay initialized
+			sd->numLoadedTracks = trkn + 1;
+		else if (sd->sekData[0].rngState.hasPosition) {
+			// same seed as track A, as given by seedRandom(), from the start of the stream of the track
+			sd->sekData[trkn].rngState = sd->sekData[0].rngState;
+			sd->sekData[trkn].rngState.stream = trkn;
+			sd->sekData[trkn].rngState.counter = 0;
+		}
+		else
+			sd->sekData[trkn].rngState = sd->sekData[0].rngState;// deterministic setting only
+	}
+	sd->numLoadedTracks = std::max(sd->numLoadedTracks, sd->numTracks);
 	
-	for (int trkn = 0; trkn < NUM_TRACKS; trkn++)
-		sek[trkn].dataFromJson(rootJ, editingSequence);
+	jsonHandoff.endWrite();// adoptJson() is called by process()
+}
+bool Sequencer::adoptJson(bool editingSequence) {
+	const Data* loaded = jsonHandoff.beginAdopt();
+	if (loaded == nullptr)
+		return false;
+	stepIndexEdit = loaded->stepIndexEdit;
+	phraseIndexEdit = loaded->phraseIndexEdit;
+	trackIndexEdit = loaded->trackIndexEdit;
+	numTracks = loaded->numTracks;
+	for (int trkn = 0; trkn < MAX_TRACKS; trkn++) {
+		if (trkn < loaded->numLoadedTracks)
+			sek[trkn].adoptJson(loaded->sekData[trkn], editingSequence);
+		else// not in the patch, only those that may have been edited are initialized
+			sek[trkn].adoptInitJson(loaded->sekData[trkn].rngState, trkn >= numUsedTracks, editingSequence);
+	}
+	numUsedTracks = loaded->numLoadedTracks;
+	jsonHandoff.endAdopt();
+	editJournal.clear();// the journaled edits were made on the data that was replaced
 	
-	resetNonJson(editingSequence, false);// no need to propagate initRun calls in kernels, since sek[trkn].dataFromJson() have initRun() in them
+	resetNonJson(editingSequence, false);// no need to propagate initRun calls in kernels, since sek[trkn].adoptJson() have initRun() in them
+	return true;
 }
 
 
 void Sequencer::setVelocityVal(int trkn, int intVel, int multiStepsCount, bool multiTracks) {
+	Edit edit(this);
 	sek[trkn].setVelocityVal(stepIndexEdit, intVel, multiStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trkn) continue;
 			sek[i].setVelocityVal(stepIndexEdit, intVel, multiStepsCount);
 		}
 	}
 }
 void Sequencer::setLength(int length, bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setLength(length);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setLength(length);
 		}
 	}
 }
 void Sequencer::setPhraseReps(int reps, bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setPhraseReps(phraseIndexEdit, reps);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPhraseReps(phraseIndexEdit, reps);
 		}
 	}		
 }
 void Sequencer::setPhraseSeqNum(int seqn, bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setPhraseSeqNum(phraseIndexEdit, seqn);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPhraseSeqNum(phraseIndexEdit, seqn);
 		}
 	}	
 }
 void Sequencer::setBegin(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setBegin(phraseIndexEdit);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setBegin(phraseIndexEdit);
 		}
 	}
 }
 void Sequencer::setEnd(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setEnd(phraseIndexEdit);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setEnd(phraseIndexEdit);
 		}
 	}
 }
 bool Sequencer::setGateType(int keyn, int multiSteps, float sampleRate, bool autostepClick, bool multiTracks) {// Third param is for right-click autostep. Returns success
-	int newMode = keyIndexToGateTypeEx(keyn);
+	Edit edit(this);
+	int newMode = keyIndexToGateTypeEx(keyn, (APP->window->getMods() & GLFW_MOD_ALT) != 0);
 	if (newMode == -1) 
 		return false;
 	sek[trackIndexEdit].setGateType(stepIndexEdit, newMode, multiSteps);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setGateType(stepIndexEdit, newMode, multiSteps);
 		}
@@ -164,90 +242,100 @@ bool Sequencer::setGateType(int keyn, int multiSteps, float sampleRate, bool aut
 
 
 void Sequencer::initSlideVal(int multiStepsCount, bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setSlideVal(stepIndexEdit, StepAttributes::INIT_SLIDE, multiStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setSlideVal(stepIndexEdit, StepAttributes::INIT_SLIDE, multiStepsCount);
 		}
 	}		
 }
 void Sequencer::initGatePVal(int multiStepsCount, bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setGatePVal(stepIndexEdit, StepAttributes::INIT_PROB, multiStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setGatePVal(stepIndexEdit, StepAttributes::INIT_PROB, multiStepsCount);
 		}
 	}		
 }
 void Sequencer::initVelocityVal(int multiStepsCount, bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setVelocityVal(stepIndexEdit, StepAttributes::INIT_VELOCITY, multiStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setVelocityVal(stepIndexEdit, StepAttributes::INIT_VELOCITY, multiStepsCount);
 		}
 	}		
 }
 void Sequencer::initPulsesPerStep(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].initPulsesPerStep();
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].initPulsesPerStep();
 		}
 	}		
 }
 void Sequencer::initDelay(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].initDelay();
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].initDelay();
 		}
 	}		
 }
 void Sequencer::initRunModeSong(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setRunModeSong(SequencerKernel::MODE_FWD);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setRunModeSong(SequencerKernel::MODE_FWD);
 		}
 	}		
 }
 void Sequencer::initRunModeSeq(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setRunModeSeq(SequencerKernel::MODE_FWD);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setRunModeSeq(SequencerKernel::MODE_FWD);
 		}
 	}		
 }
 void Sequencer::initLength(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setLength(SequencerKernel::MAX_STEPS);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setLength(SequencerKernel::MAX_STEPS);
 		}
 	}		
 }
 void Sequencer::initPhraseReps(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setPhraseReps(phraseIndexEdit, 1);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPhraseReps(phraseIndexEdit, 1);
 		}
 	}		
 }
 void Sequencer::initPhraseSeqNum(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].setPhraseSeqNum(phraseIndexEdit, 0);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPhraseSeqNum(phraseIndexEdit, 0);
 		}
@@ -259,10 +347,11 @@ void Sequencer::copySequence(int countCP) {
 	sek[trackIndexEdit].copySequence(&seqCPbuf, startCP, countCP);
 }
 void Sequencer::pasteSequence(bool multiTracks) {
+	Edit edit(this);
 	int startCP = stepIndexEdit;
 	sek[trackIndexEdit].pasteSequence(&seqCPbuf, startCP);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].pasteSequence(&seqCPbuf, startCP);
 		}
@@ -272,9 +361,10 @@ void Sequencer::copySong(int startCP, int countCP) {
 	sek[trackIndexEdit].copySong(&songCPbuf, startCP, countCP);
 }
 void Sequencer::pasteSong(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].pasteSong(&songCPbuf, phraseIndexEdit);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].pasteSong(&songCPbuf, phraseIndexEdit);
 		}
@@ -282,12 +372,13 @@ void Sequencer::pasteSong(bool multiTracks) {
 }
 
 void Sequencer::writeCV(int trkn, float cvVal, int multiStepsCount, float sampleRate, bool multiTracks) {
+	Edit edit(this);
 	sek[trkn].writeCV(stepIndexEdit, cvVal, multiStepsCount);
 	editingGateCV[trkn] = cvVal;
 	editingGateCV2[trkn] = sek[trkn].getAttribute(stepIndexEdit).getVelocityVal();
 	editingGate[trkn] = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trkn) continue;
 			sek[i].writeCV(stepIndexEdit, cvVal, multiStepsCount);
 		}
@@ -298,7 +389,7 @@ void Sequencer::autostep(bool autoseq, bool autostepLen, bool multiTracks) {
 	if (stepIndexEdit == 0 && autoseq) {
 		sek[trackIndexEdit].modSeqIndexEdit(1);
 		if (multiTracks) {
-			for (int i = 0; i < NUM_TRACKS; i++) {
+			for (int i = 0; i < numTracks; i++) {
 				if (i == trackIndexEdit) continue;
 				sek[i].modSeqIndexEdit(1);
 			}
@@ -307,6 +398,7 @@ void Sequencer::autostep(bool autoseq, bool autostepLen, bool multiTracks) {
 }	
 
 bool Sequencer::applyNewOctave(int octn, int multiSteps, float sampleRate, bool multiTracks) { // returns true if tied
+	Edit edit(this);
 	StepAttributes stepAttrib = sek[trackIndexEdit].getAttribute(stepIndexEdit);
 	if (stepAttrib.getTied())
 		return true;
@@ -315,7 +407,7 @@ bool Sequencer::applyNewOctave(int octn, int multiSteps, float sampleRate, bool
 	editingGate[trackIndexEdit] = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 	editingGateKeyLight = -1;
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].applyNewOctave(stepIndexEdit, octn, multiSteps);
 		}
@@ -323,6 +415,7 @@ bool Sequencer::applyNewOctave(int octn, int multiSteps, float sampleRate, bool
 	return false;
 }
 bool Sequencer::applyNewKey(int keyn, int multiSteps, float sampleRate, bool autostepClick, bool multiTracks) { // returns true if tied
+	Edit edit(this);
 	bool ret = false;
 	StepAttributes stepAttrib = sek[trackIndexEdit].getAttribute(stepIndexEdit);
 	if (stepAttrib.getTied()) {
@@ -337,7 +430,7 @@ bool Sequencer::applyNewKey(int keyn, int multiSteps, float sampleRate, bool aut
 		editingGate[trackIndexEdit] = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 		editingGateKeyLight = -1;
 		if (multiTracks) {
-			for (int i = 0; i < NUM_TRACKS; i++) {
+			for (int i = 0; i < numTracks; i++) {
 				if (i == trackIndexEdit) continue;
 				sek[i].applyNewKey(stepIndexEdit, keyn, multiSteps);
 			}
@@ -354,7 +447,7 @@ bool Sequencer::applyNewKey(int keyn, int multiSteps, float sampleRate, bool aut
 
 void Sequencer::moveStepIndexEditWithEditingGate(int delta, bool writeTrig, float sampleRate) {
 	moveStepIndexEdit(delta, false);
-	for (int trkn = 0; trkn < NUM_TRACKS; trkn++) {
+	for (int trkn = 0; trkn < numTracks; trkn++) {
 		StepAttributes stepAttrib = sek[trkn].getAttribute(stepIndexEdit);
 		if (!stepAttrib.getTied()) {// play if non-tied step
 			if (!writeTrig) {// in case autostep when simultaneous writeCV and stepCV (keep what was done in Write Input block above)
@@ -370,149 +463,165 @@ void Sequencer::moveStepIndexEditWithEditingGate(int delta, bool writeTrig, floa
 
 
 void Sequencer::modSlideVal(int deltaVelKnob, int mutliStepsCount, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_SLIDE_VAL, multiTracks));
 	int sVal = sek[trackIndexEdit].modSlideVal(stepIndexEdit, deltaVelKnob, mutliStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setSlideVal(stepIndexEdit, sVal, mutliStepsCount);
 		}
 	}		
 }
 void Sequencer::modGatePVal(int deltaVelKnob, int mutliStepsCount, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_GATEP_VAL, multiTracks));
 	int gpVal = sek[trackIndexEdit].modGatePVal(stepIndexEdit, deltaVelKnob, mutliStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setGatePVal(stepIndexEdit, gpVal, mutliStepsCount);
 		}
 	}		
 }
 void Sequencer::modVelocityVal(int deltaVelKnob, int mutliStepsCount, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_VELOCITY_VAL, multiTracks));
 	int upperLimit = ((*velocityModePtr) == 0 ? 200 : 127);
 	int vVal = sek[trackIndexEdit].modVelocityVal(stepIndexEdit, deltaVelKnob, upperLimit, mutliStepsCount);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setVelocityVal(stepIndexEdit, vVal, mutliStepsCount);
 		}
 	}		
 }
 void Sequencer::modRunModeSong(int deltaPhrKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_RUN_MODE_SONG, multiTracks));
 	int newRunMode = sek[trackIndexEdit].modRunModeSong(deltaPhrKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setRunModeSong(newRunMode);
 		}
 	}		
 }
 void Sequencer::modPulsesPerStep(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_PPS, multiTracks));
 	int newPPS = sek[trackIndexEdit].modPulsesPerStep(deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPulsesPerStep(newPPS);
 		}
 	}		
 }
 void Sequencer::modDelay(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_DELAY, multiTracks));
 	int newDelay = sek[trackIndexEdit].modDelay(deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setDelay(newDelay);
 		}
 	}		
 }
 void Sequencer::modRunModeSeq(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_RUN_MODE_SEQ, multiTracks));
 	int newRunMode = sek[trackIndexEdit].modRunModeSeq(deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setRunModeSeq(newRunMode);
 		}
 	}		
 }
 void Sequencer::modLength(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_LENGTH, multiTracks));
 	int newLength = sek[trackIndexEdit].modLength(deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setLength(newLength);
 		}
 	}		
 }
 void Sequencer::modPhraseReps(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_PHRASE_REPS, multiTracks));
 	int newReps = sek[trackIndexEdit].modPhraseReps(phraseIndexEdit, deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPhraseReps(phraseIndexEdit, newReps);
 		}
 	}		
 }
 void Sequencer::modPhraseSeqNum(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_PHRASE_SEQ_NUM, multiTracks));
 	int newSeqn = sek[trackIndexEdit].modPhraseSeqNum(phraseIndexEdit, deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].setPhraseSeqNum(phraseIndexEdit, newSeqn);
 		}
 	}		
 }
 void Sequencer::transposeSeq(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_TRANSPOSE, multiTracks));
 	sek[trackIndexEdit].transposeSeq(deltaSeqKnob);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].transposeSeq(deltaSeqKnob);
 		}
 	}		
 }
 void Sequencer::unTransposeSeq(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].unTransposeSeq();
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].unTransposeSeq();
 		}
 	}		
 }
 void Sequencer::rotateSeq(int deltaSeqKnob, bool multiTracks) {
+	Edit edit(this, knobMergeKey(KNOB_EDIT_ROTATE, multiTracks));
 	sek[trackIndexEdit].rotateSeq(deltaSeqKnob);
 	if (stepIndexEdit < getLength())
 		moveStepIndexEdit(deltaSeqKnob, true);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].rotateSeq(deltaSeqKnob);
 		}
 	}		
 }
 void Sequencer::unRotateSeq(bool multiTracks) {
+	Edit edit(this);
 	sek[trackIndexEdit].unRotateSeq();
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;
 			sek[i].unRotateSeq();
 		}
 	}		
 }
 void Sequencer::toggleGate(int multiSteps, bool multiTracks) {
+	Edit edit(this);
 	bool newGate = sek[trackIndexEdit].toggleGate(stepIndexEdit, multiSteps);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;			
 			sek[i].setGate(stepIndexEdit, newGate, multiSteps);
 		}
 	}		
 }
 bool Sequencer::toggleGateP(int multiSteps, bool multiTracks) { // returns true if tied
+	Edit edit(this);
 	if (sek[trackIndexEdit].getAttribute(stepIndexEdit).getTied())
 		return true;
 	bool newGateP = sek[trackIndexEdit].toggleGateP(stepIndexEdit, multiSteps);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;			
 			sek[i].setGateP(stepIndexEdit, newGateP, multiSteps);
 		}
@@ -520,11 +629,12 @@ bool Sequencer::toggleGateP(int multiSteps, bool multiTracks) { // returns true
 	return false;
 }
 bool Sequencer::toggleSlide(int multiSteps, bool multiTracks) { // returns true if tied
+	Edit edit(this);
 	if (sek[trackIndexEdit].getAttribute(stepIndexEdit).getTied())
 		return true;
 	bool newSlide = sek[trackIndexEdit].toggleSlide(stepIndexEdit, multiSteps);
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;			
 			sek[i].setSlide(stepIndexEdit, newSlide, multiSteps);
 		}
@@ -532,9 +642,10 @@ bool Sequencer::toggleSlide(int multiSteps, bool multiTracks) { // returns true
 	return false;
 }
 void Sequencer::toggleTied(int multiSteps, bool multiTracks) {
+	Edit edit(this);
 	bool newTied = sek[trackIndexEdit].toggleTied(stepIndexEdit, multiSteps);// will clear other attribs if new state is on
 	if (multiTracks) {
-		for (int i = 0; i < NUM_TRACKS; i++) {
+		for (int i = 0; i < numTracks; i++) {
 			if (i == trackIndexEdit) continue;			
 			sek[i].setTied(stepIndexEdit, newTied, multiSteps);
 		}
@@ -543,6 +654,7 @@ void Sequencer::toggleTied(int multiSteps, bool multiTracks) {
 
 
 bool Sequencer::clockStep(int trkn, bool editingSequence) {// returns true to signal that run should be turned off
+	invalidateOutputs();// all tracks, since track A can move the phrase of the others
 	int phraseChangeOrStop = sek[trkn].clockStep(editingSequence, delayedSeqNumberRequest[trkn]);
 	
 	if (phraseChangeOrStop == 2)// kernel request that run should be turned off 
@@ -555,7 +667,7 @@ bool Sequencer::clockStep(int trkn, bool editingSequence) {// returns true to si
 	}
 	else {
 		if (trkn == 0 && phraseChangeOrStop == 1) {
-			for (int tkbcd = 1; tkbcd < NUM_TRACKS; tkbcd++) {// check for song run mode slaving
+			for (int tkbcd = 1; tkbcd < numTracks; tkbcd++) {// check for song run mode slaving
 				if (sek[tkbcd].getRunModeSong() == SequencerKernel::MODE_TKA) {
 					sek[tkbcd].setPhraseIndexRun(sek[0].getPhraseIndexRun());
 					// The code below is to make it such that stepIndexRun should re-init upon phraseChange
@@ -572,3 +684,32 @@ bool Sequencer::clockStep(int trkn, bool editingSequence) {// returns true to si
 	}
 	return false;
 }
+
+
+void Sequencer::calcOutputs(int trkn, bool running, bool retriggingOnReset, bool editingSequence, Trigger clockTrigger, float sampleRate, float* cvOut, float* gateOut, float* velOut) {
+	// The outputs only change on events: clock steps, edits (the module calls invalidateOutputs() when it processes 
+	// its user inputs), end of a trigger, and clock input edges when the gate follows the clock. They are calculated
+	// on those events and held in between. Slides are calculated on every sample until the end of their ramp.
+	bool gateRunning = running && !retriggingOnReset;
+	int modes = (running ? 0x1 : 0x0) | (retriggingOnReset ? 0x2 : 0x0) | (editingSequence ? 0x4 : 0x0);
+	if (outputHold[trkn] == 0ul || modes != outputHeldModes[trkn] || sek[trkn].isSliding()) {
+		bool sliding = sek[trkn].isSliding();
+		cvOutHeld[trkn] = calcCvOutputAndDecSlideStepsRemain(trkn, running, editingSequence);
+		gateOutHeld[trkn] = calcGateOutput(trkn, gateRunning, clockTrigger, sampleRate);
+		velOutHeld[trkn] = calcVelOutput(trkn, gateRunning, editingSequence);
+		gateFollowsClock[trkn] = gateRunning && sek[trkn].isGateFollowingClock();
+		if (sliding)
+			outputHold[trkn] = 0ul;// the sample after the last one of the ramp must also be calculated
+		else
+			outputHold[trkn] = gateRunning ? sek[trkn].calcGateHoldSamples(sampleRate) : ULONG_MAX;
+		outputHeldModes[trkn] = modes;
+	}
+	else {
+		outputHold[trkn]--;
+		if (gateFollowsClock[trkn])
+			gateOutHeld[trkn] = (clockTrigger.isHigh() ? 10.0f : 0.0f);
+	}
+	*cvOut = cvOutHeld[trkn];
+	*gateOut = gateOutHeld[trkn];
+	*velOut = velOutHeld[trkn];
+}
@@ -5,36 +5,72 @@
 #pragma once
 
 #include "FoundrySequencerKernel.hpp"
+#include "JsonHandoff.hpp"
+#include "FoundryEditJournal.hpp"
 
 
 class Sequencer {
 	public: 
 	
 	// Sequencer dimensions
-	static const int NUM_TRACKS = 4;
+	static const int NUM_TRACKS = 4;// tracks with their own jacks on the panel (A to D), and the default number of tracks
+	static const int MAX_TRACKS = 16;// the tracks after D are only on the polyphonic outputs
 	static constexpr float gateTime = 0.4f;// seconds
 
+	struct Data {// what dataFromJson() loads for process() to adopt (see JsonHandoff.hpp)
+		int stepIndexEdit;
+		int phraseIndexEdit;
+		int trackIndexEdit;
+		int numTracks;
+		int numLoadedTracks;// sekData after this one are not in the patch, their steps and song are in the init state
+		SequencerKernelData sekData[MAX_TRACKS];// only the rngState of those not loaded is set
+	};
+
 
 	private:
 	
+	static_assert(MAX_TRACKS <= EditJournal::MAX_TRACKS, "edit journal too small");
+	
+	// Knob edits, consecutive ones of the same kind on the same step or phrase are merged into one undo action
+	enum KnobEditIds {KNOB_EDIT_NONE, KNOB_EDIT_SLIDE_VAL, KNOB_EDIT_GATEP_VAL, KNOB_EDIT_VELOCITY_VAL, KNOB_EDIT_RUN_MODE_SONG, KNOB_EDIT_PPS, KNOB_EDIT_DELAY, 
+		KNOB_EDIT_RUN_MODE_SEQ, KNOB_EDIT_LENGTH, KNOB_EDIT_PHRASE_REPS, KNOB_EDIT_PHRASE_SEQ_NUM, KNOB_EDIT_TRANSPOSE, KNOB_EDIT_ROTATE};
+	static const uint32_t WRITE_INPUT_MERGE_KEY = 0xF;// write input edits, no knobMergeKey() has 0xF in its knob id bits
+	static_assert(KNOB_EDIT_ROTATE < 0xF, "knob ids must not reach the write input merge key");
+
+	struct Edit {// the edits made during the lifetime of an Edit are one undo action (see EditJournal)
+		EditJournal* journal;
+		Edit(Sequencer* seq, uint32_t mergeKey = 0) : journal(&seq->editJournal) {journal->beginEdit(mergeKey);}
+		~Edit() {journal->endEdit();}
+	};
+	
 	// Need to save, with reset
 	int stepIndexEdit;
 	int phraseIndexEdit;
 	int trackIndexEdit;
-	std::vector<SequencerKernel> sek;// size 4
+	int numTracks;// in [NUM_TRACKS : MAX_TRACKS], the kernels after that are kept but not played
+	int numUsedTracks;// at least numTracks, the kernels after this one are known to be in their init state (not played or edited since)
+	std::vector<SequencerKernel> sek;// size MAX_TRACKS
 	
 	// No need to save, with reset
 	unsigned long editingType;// similar to editingGate, but just for showing remnant gate type (nothing played); uses editingGateKeyLight
-	unsigned long editingGate[NUM_TRACKS];// 0 when no edit gate, downward step counter timer when edit gate
-	int delayedSeqNumberRequest[NUM_TRACKS];
+	unsigned long editingGate[MAX_TRACKS];// 0 when no edit gate, downward step counter timer when edit gate
+	int delayedSeqNumberRequest[MAX_TRACKS];
+	unsigned long outputHold[MAX_TRACKS];// number of samples for which the held outputs of a track stay valid, 0 means recalculate
 	SeqCPbuffer seqCPbuf;
 	SongCPbuffer songCPbuf;
 	
 	// No need to save, no reset
+	JsonHandoff<Data> jsonHandoff;
+	EditJournal editJournal;
 	int* velocityModePtr = nullptr;
-	float editingGateCV[NUM_TRACKS] = {};// this goes with editingGate (output this only when editingGate > 0)
-	int editingGateCV2[NUM_TRACKS] = {};// this goes with editingGate (output this only when editingGate > 0)
+	float editingGateCV[MAX_TRACKS] = {};// this goes with editingGate (output this only when editingGate > 0)
+	int editingGateCV2[MAX_TRACKS] = {};// this goes with editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight = 0;// this goes with editingGate (use this only when editingGate > 0)
+	float cvOutHeld[MAX_TRACKS] = {};// outputs calculated on the last event, see calcOutputs()
+	float gateOutHeld[MAX_TRACKS] = {};
+	float velOutHeld[MAX_TRACKS] = {};
+	bool gateFollowsClock[MAX_TRACKS] = {};
+	int outputHeldModes[MAX_TRACKS] = {};// running, retriggingOnReset and editingSequence when the outputs were calculated
 	
 	
 	public: 
@@ -45,8 +81,25 @@ class Sequencer {
 	void onRandomize(bool editingSequence) {sek[trackIndexEdit].onRandomize(editingSequence);}
 	void initRun(bool editingSequence, bool propagateInitRun);
 	void initDelayedSeqNumberRequest();
-	void dataToJson(json_t *rootJ);
-	void dataFromJson(json_t *rootJ, bool editingSequence);
+	void dataToJson(json_t *rootJ, bool packed);
+	void dataFromJson(json_t *rootJ);
+	bool adoptJson(bool editingSequence);
+	
+	
+	// Undo and redo of edits: edits of the mutators below are journaled by themselves, beginEdit() and endEdit() 
+	// make one action of several calls. undoEdit() and redoEdit() are called by the UI thread, with a range of 
+	// actions from getLastEditAction()
+	void beginEdit() {editJournal.beginEdit(0);}
+	void beginWriteInputEdit() {editJournal.beginEdit(WRITE_INPUT_MERGE_KEY);}// consecutive writes are one action, as for knob edits
+	void endEdit() {editJournal.endEdit();}
+	void sealKnobEdits() {editJournal.seal();}// a knob was grabbed, its edits start a new action
+	uint32_t getLastEditAction() {return editJournal.getLastAction();}
+	void undoEdit(uint32_t firstAction) {
+		editJournal.undo(firstAction);
+	}
+	void redoEdit(uint32_t finalAction) {
+		editJournal.redo(finalAction);
+	}
 
 
 	int getStepIndexEdit() {return stepIndexEdit;}
@@ -54,6 +107,8 @@ class Sequencer {
 	int getSeqIndexEdit(int trkn) {return sek[trkn].getSeqIndexEdit();}
 	int getPhraseIndexEdit() {return phraseIndexEdit;}
 	int getTrackIndexEdit() {return trackIndexEdit;}
+	int getNumTracks() {return numTracks;}
+	bool isRandomDeterministic() {return sek[0].isRandomDeterministic();}
 	int getStepIndexRun(int trkn) {return sek[trkn].getStepIndexRun();}
 	int getLength() {return sek[trackIndexEdit].getLength();}
 	float getCV(bool editingSequence) {
@@ -68,7 +123,7 @@ class Sequencer {
 		return sek[trackIndexEdit].getAttribute(editingSequence);
 	}
 	StepAttributes getAttribute(bool editingSequence, int stepn) {return sek[trackIndexEdit].getAttributei(editingSequence, stepn);}
-	int keyIndexToGateTypeEx(int keyn) {return sek[trackIndexEdit].keyIndexToGateTypeEx(keyn);}
+	int keyIndexToGateTypeEx(int keyn, bool extended = false) {return sek[trackIndexEdit].keyIndexToGateTypeEx(keyn, extended);}
 	int getPulsesPerStep() {return sek[trackIndexEdit].getPulsesPerStep();}
 	int getDelay() {return sek[trackIndexEdit].getDelay();}
 	int getRunModeSong() {return sek[trackIndexEdit].getRunModeSong();}
@@ -95,11 +150,27 @@ class Sequencer {
 		}
 	}
 	void setSeqIndexEdit(int _seqIndexEdit, int trkn) {
+		if (_seqIndexEdit != sek[trkn].getSeqIndexEdit())
+			outputHold[trkn] = 0ul;// can be set on every sample by the seq CV input
 		sek[trkn].setSeqIndexEdit(_seqIndexEdit);
 	}
 	void setPhraseIndexEdit(int _phraseIndexEdit) {phraseIndexEdit = _phraseIndexEdit;}
 	void bringPhraseIndexRunToEdit() {sek[trackIndexEdit].setPhraseIndexRun(phraseIndexEdit);}
-	void setTrackIndexEdit(int _trackIndexEdit) {trackIndexEdit = _trackIndexEdit % NUM_TRACKS;}
+	void setTrackIndexEdit(int _trackIndexEdit) {trackIndexEdit = _trackIndexEdit % numTracks;}
+	void setRandomDeterministic(bool deterministic) {
+		for (int trkn = 0; trkn < MAX_TRACKS; trkn++)
+			sek[trkn].setRandomDeterministic(deterministic);
+	}
+	void setNumTracks(int _numTracks, bool editingSequence) {
+		_numTracks = clamp(_numTracks, NUM_TRACKS, MAX_TRACKS);
+		for (int trkn = numTracks; trkn < _numTracks; trkn++)// the added tracks start from the beginning, as after a reset
+			sek[trkn].initRun(editingSequence);
+		numTracks = _numTracks;
+		numUsedTracks = std::max(numUsedTracks, numTracks);
+		if (trackIndexEdit >= numTracks)
+			trackIndexEdit = 0;
+		invalidateOutputs();
+	}
 	void setVelocityVal(int trkn, int intVel, int multiStepsCount, bool multiTracks);
 	void setLength(int length, bool multiTracks);
 	void setPhraseReps(int reps, bool multiTracks);
@@ -122,12 +193,12 @@ class Sequencer {
 	
 	
 	void incTrackIndexEdit() {
-		if (trackIndexEdit < (NUM_TRACKS - 1)) trackIndexEdit++;
+		if (trackIndexEdit < (numTracks - 1)) trackIndexEdit++;
 		else trackIndexEdit = 0;
 	}
 	void decTrackIndexEdit() {
 		if (trackIndexEdit > 0) trackIndexEdit--;
-		else trackIndexEdit = NUM_TRACKS - 1;
+		else trackIndexEdit = numTracks - 1;
 	}
 	
 	int getLengthSeqCPbuf() {return seqCPbuf.storedLength;}
@@ -138,10 +209,12 @@ class Sequencer {
 	
 	
 	void writeCV(int stepn, float cvVal) {
+		Edit edit(this);
 		sek[trackIndexEdit].writeCV(stepn, cvVal, 1);
 	}
 	void writeCV(int trkn, float cvVal, int multiStepsCount, float sampleRate, bool multiTracks);
 	void writeAttribNoTies(int stepn, const StepAttributes &stepAttrib) {// does not handle tied notes
+		Edit edit(this);
 		sek[trackIndexEdit].writeAttribNoTies(stepn, stepAttrib);
 	}
 	void autostep(bool autoseq, bool autostepLen, bool multiTracks);
@@ -183,6 +256,7 @@ class Sequencer {
 	bool toggleSlide(int multiSteps, bool multiTracks); // returns true if tied
 	void toggleTied(int multiSteps, bool multiTracks);
 	void toggleTied(int stepn) {
+		Edit edit(this);
 		sek[trackIndexEdit].toggleTied(stepn, 1);// will clear other attribs if new state is on
 	}
 
@@ -195,6 +269,11 @@ class Sequencer {
 		sek[trkn].decSlideStepsRemain();
 		return cvout;
 	}
+	void invalidateOutputs() {
+		for (int trkn = 0; trkn < MAX_TRACKS; trkn++)
+			outputHold[trkn] = 0ul;
+	}
+	void calcOutputs(int trkn, bool running, bool retriggingOnReset, bool editingSequence, Trigger clockTrigger, float sampleRate, float* cvOut, float* gateOut, float* velOut);
 	float calcGateOutput(int trkn, bool running, Trigger clockTrigger, float sampleRate) {
 		if (running) 
 			return (sek[trkn].calcGate(clockTrigger, sampleRate) ? 10.0f : 0.0f);
@@ -234,9 +313,12 @@ class Sequencer {
 	
 	
 	void stepEditingGate() {// also steps editingType 
-		for (int trkn = 0; trkn < NUM_TRACKS; trkn++) {
-			if (editingGate[trkn] > 0ul)
+		for (int trkn = 0; trkn < numTracks; trkn++) {
+			if (editingGate[trkn] > 0ul) {
 				editingGate[trkn]--;
+				if (editingGate[trkn] == 0ul)
+					outputHold[trkn] = 0ul;
+			}
 		}
 		if (editingType > 0ul)
 			editingType--;
@@ -250,8 +332,18 @@ class Sequencer {
 	bool clockStep(int trkn, bool editingSequence);// returns true to signal that run should be turned off
 	
 	void process() {
-		for (int trkn = 0; trkn < NUM_TRACKS; trkn++)
+		for (int trkn = 0; trkn < numTracks; trkn++)
 			sek[trkn].process();
 	}
 	
+	
+	private:
+	
+	uint32_t knobMergeKey(int knobEditId, bool multiTracks) {
+		uint32_t key = (uint32_t)knobEditId | ((uint32_t)phraseIndexEdit << 9) | ((uint32_t)sek[trackIndexEdit].getSeqIndexEdit() << 16) | 
+			((uint32_t)trackIndexEdit << 22) | (multiTracks ? 0x80000000 : 0x0);
+		if (knobEditId <= KNOB_EDIT_VELOCITY_VAL)// step values (rotations move the edited step)
+			key |= ((uint32_t)stepIndexEdit << 4);
+		return key;
+	}
 };// class Sequencer 
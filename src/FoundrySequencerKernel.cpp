@@ -9,30 +9,9 @@
 const std::string SequencerKernel::modeLabels[NUM_MODES] = {"FWD", "REV", "PPG", "PEN", "BRN", "RND", "TKA", "RNS"};
 
 
-const uint64_t SequencerKernel::advGateHitMaskLow[NUM_GATES] = 
-{0x0000000000FFFFFF, 0x0000FFFF0000FFFF, 0x0000FFFFFFFFFFFF, 0x0000FFFF00000000, 0xFFFFFFFFFFFFFFFF, 0xFFFFFFFFFFFFFFFF, 
-//				25%					TRI		  			50%					T23		  			75%					FUL		
- 0x000000000000FFFF, 0xFFFF000000FFFFFF, 0x0000FFFF00000000, 0xFFFF000000000000, 0x0000000000000000, 0};
-//  			TR1 				DUO		  			TR2 	     		D2		  			TR3  TRIG		
-const uint64_t SequencerKernel::advGateHitMaskHigh[NUM_GATES] = 
-{0x0000000000000000, 0x000000000000FFFF, 0x0000000000000000, 0x000000000000FFFF, 0x00000000000000FF, 0x00000000FFFFFFFF, 
-//				25%					TRI		  			50%					T23		  			75%					FUL		
- 0x0000000000000000, 0x00000000000000FF, 0x0000000000000000, 0x00000000000000FF, 0x000000000000FFFF, 0};
-//  			TR1 				DUO		  			TR2 	     		D2		  			TR3  TRIG		
-
-
-SequencerKernel::SequencerKernel(int _id, SequencerKernel *_masterKernel, bool* _holdTiedNotesPtr, int* _stopAtEndOfSongPtr) {
-	id = _id;
-	ids = "id" + std::to_string(id) + "_";
-	masterKernel = _masterKernel;
-	holdTiedNotesPtr = _holdTiedNotesPtr;
-	stopAtEndOfSongPtr = _stopAtEndOfSongPtr;
-	onReset(false);
-}
-
-void SequencerKernel::onReset(bool editingSequence) {
-	initPulsesPerStep();
-	initDelay();
+void SequencerKernelData::init() {
+	pulsesPerStep = 1;
+	delay = 0;
 	// reset song content
 	runModeSong = MODE_FWD;
 	songBeginIndex = 0;
@@ -45,11 +24,48 @@ void SequencerKernel::onReset(bool editingSequence) {
 		sequences[seqn].init(MAX_STEPS, MODE_FWD);
 		for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
 			cv[seqn][stepn] = INIT_CV;
-			attributes[seqn][stepn].init();
 		}
+		attributes[seqn].init();
 		dirty[seqn] = 0;
 	}
 	seqIndexEdit = 0;
+	rngState = RandomStream::State();
+}
+bool SequencerKernelData::isInit() {
+	if (pulsesPerStep != 1 || delay != 0 || runModeSong != MODE_FWD || songBeginIndex != 0 || songEndIndex != 0 || seqIndexEdit != 0)
+		return false;
+	for (int phrn = 0; phrn < MAX_PHRASES; phrn++) {
+		if (phrases[phrn].getPhraseJson() != 0)// 0 is the init phrase, see Phrase::getPhraseJson()
+			return false;
+	}
+	SeqAttributes initSequence;
+	initSequence.init(MAX_STEPS, MODE_FWD);
+	SeqStepAttributes initAttributes;
+	initAttributes.init();
+	for (int seqn = 0; seqn < MAX_SEQS; seqn++) {
+		if (sequences[seqn].getSeqAttrib() != initSequence.getSeqAttrib())
+			return false;
+		for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
+			if (cv[seqn][stepn] != INIT_CV || attributes[seqn].getAttribute(stepn) != initAttributes.getAttribute(stepn))
+				return false;
+		}
+	}
+	return true;
+}
+
+
+SequencerKernel::SequencerKernel(int _id, SequencerKernel *_masterKernel, bool* _holdTiedNotesPtr, int* _stopAtEndOfSongPtr) {
+	id = _id;
+	ids = "id" + std::to_string(id) + "_";
+	masterKernel = _masterKernel;
+	holdTiedNotesPtr = _holdTiedNotesPtr;
+	stopAtEndOfSongPtr = _stopAtEndOfSongPtr;
+	onReset(false);
+}
+
+void SequencerKernel::onReset(bool editingSequence) {
+	init();
+	rng.deterministic = false;
 	resetNonJson(editingSequence);
 }
 void SequencerKernel::resetNonJson(bool editingSequence) {
@@ -74,92 +90,127 @@ void SequencerKernel::onRandomize(bool editingSequence) {
 	sequences[seqIndexEdit].randomize(MAX_STEPS, NUM_MODES);// code below uses lengths so this must be randomized first
 	for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
 		cv[seqIndexEdit][stepn] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
-		attributes[seqIndexEdit][stepn].randomize();
+		StepAttributes stepAttrib;
+		stepAttrib.randomize();
+		attributes[seqIndexEdit].set(stepn, stepAttrib);
 	}
 	dirty[seqIndexEdit] = 1;
 	initRun(editingSequence);
 }
 	
 
-void SequencerKernel::dataToJson(json_t *rootJ) {
+void SequencerKernel::dataToJson(json_t *rootJ, bool packed, SequencerKernelData* sd) {
 	// pulsesPerStep
-	json_object_set_new(rootJ, (ids + "pulsesPerStep").c_str(), json_integer(pulsesPerStep));
+	json_object_set_new(rootJ, (ids + "pulsesPerStep").c_str(), json_integer(sd->pulsesPerStep));
 
 	// delay
-	json_object_set_new(rootJ, (ids + "delay").c_str(), json_integer(delay));
+	json_object_set_new(rootJ, (ids + "delay").c_str(), json_integer(sd->delay));
 
 	// runModeSong
-	json_object_set_new(rootJ, (ids + "runModeSong").c_str(), json_integer(runModeSong));
+	json_object_set_new(rootJ, (ids + "runModeSong").c_str(), json_integer(sd->runModeSong));
 
 	// songBeginIndex
-	json_object_set_new(rootJ, (ids + "songBeginIndex").c_str(), json_integer(songBeginIndex));
+	json_object_set_new(rootJ, (ids + "songBeginIndex").c_str(), json_integer(sd->songBeginIndex));
 
 	// songEndIndex
-	json_object_set_new(rootJ, (ids + "songEndIndex").c_str(), json_integer(songEndIndex));
+	json_object_set_new(rootJ, (ids + "songEndIndex").c_str(), json_integer(sd->songEndIndex));
 
 	// phrases 
 	json_t *phrasesJ = json_array();
 	for (int i = 0; i < MAX_PHRASES; i++)
-		json_array_insert_new(phrasesJ, i, json_integer(phrases[i].getPhraseJson()));
+		json_array_insert_new(phrasesJ, i, json_integer(sd->phrases[i].getPhraseJson()));
 	json_object_set_new(rootJ, (ids + "phrases").c_str(), phrasesJ);
 
 	// sequences (attributes of a seqs)
 	json_t *sequencesJ = json_array();
 	for (int i = 0; i < MAX_SEQS; i++)
-		json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
+		json_array_insert_new(sequencesJ, i, json_integer(sd->sequences[i].getSeqAttrib()));
 	json_object_set_new(rootJ, (ids + "sequences").c_str(), sequencesJ);
 
 	// CV and attributes (and dirty)
-	json_t *seqSavedJ = json_array();		
-	json_t *cvJ = json_array();
-	json_t *attributesJ = json_array();
-	for (int seqnRead = 0, seqnWrite = 0; seqnRead < MAX_SEQS; seqnRead++) {
-		if (dirty[seqnRead] == 0) {
-			json_array_insert_new(seqSavedJ, seqnRead, json_integer(0));
+	if (packed) {
+		PackedWriter writer;
+		writer.bytes.reserve(MAX_SEQS * (1 + MAX_STEPS * 8));
+		for (int seqn = 0; seqn < MAX_SEQS; seqn++) {
+			writer.u8(sd->dirty[seqn] != 0 ? 1 : 0);
+			if (sd->dirty[seqn] != 0) {
+				for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
+					writer.f32(sd->cv[seqn][stepn]);
+					writer.u32((uint32_t)sd->attributes[seqn].getAttribute(stepn));
+				}
+			}
 		}
-		else {
-			json_array_insert_new(seqSavedJ, seqnRead, json_integer(1));
-			for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
-				json_array_insert_new(cvJ, stepn + (seqnWrite * MAX_STEPS), json_real(cv[seqnRead][stepn]));
-				json_array_insert_new(attributesJ, stepn + (seqnWrite * MAX_STEPS), json_integer(attributes[seqnRead][stepn].getAttribute()));
+		packedToJson(rootJ, ids + "stepData", packedVersion, writer);
+	}
+	else {
+		json_t *seqSavedJ = json_array();		
+		json_t *cvJ = json_array();
+		json_t *attributesJ = json_array();
+		for (int seqnRead = 0, seqnWrite = 0; seqnRead < MAX_SEQS; seqnRead++) {
+			if (sd->dirty[seqnRead] == 0) {
+				json_array_insert_new(seqSavedJ, seqnRead, json_integer(0));
+			}
+			else {
+				json_array_insert_new(seqSavedJ, seqnRead, json_integer(1));
+				for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
+					json_array_insert_new(cvJ, stepn + (seqnWrite * MAX_STEPS), json_real(sd->cv[seqnRead][stepn]));
+					json_array_insert_new(attributesJ, stepn + (seqnWrite * MAX_STEPS), json_integer(sd->attributes[seqnRead].getAttribute(stepn)));
+				}
+				seqnWrite++;
 			}
-			seqnWrite++;
 		}
+		json_object_set_new(rootJ, (ids + "seqSaved").c_str(), seqSavedJ);
+		json_object_set_new(rootJ, (ids + "cv").c_str(), cvJ);
+		json_object_set_new(rootJ, (ids + "attributes").c_str(), attributesJ);
 	}
-	json_object_set_new(rootJ, (ids + "seqSaved").c_str(), seqSavedJ);
-	json_object_set_new(rootJ, (ids + "cv").c_str(), cvJ);
-	json_object_set_new(rootJ, (ids + "attributes").c_str(), attributesJ);
 
 	// seqIndexEdit
-	json_object_set_new(rootJ, (ids + "seqIndexEdit").c_str(), json_integer(seqIndexEdit));
+	json_object_set_new(rootJ, (ids + "seqIndexEdit").c_str(), json_integer(sd->seqIndexEdit));
+
+	// rng
+	RandomStream::State savedRngState = (sd != this && sd->rngState.loaded ? sd->rngState : rng.getState());
+	json_object_set_new(rootJ, (ids + "rng").c_str(), RandomStream::stateToJson(savedRngState));
 }
 
 
-void SequencerKernel::dataFromJson(json_t *rootJ, bool editingSequence) {
+bool SequencerKernel::dataFromJson(json_t *rootJ, SequencerKernelData* sd) {
+	// tracks that are not saved have none of their keys in the patch
+	bool found = false;
+	const char* key;
+	json_t* valueJ;
+	json_object_foreach(rootJ, key, valueJ) {
+		if (std::strncmp(key, ids.c_str(), ids.size()) == 0) {
+			found = true;
+			break;
+		}
+	}
+	if (!found)
+		return false;
+	
 	// pulsesPerStep
 	json_t *pulsesPerStepJ = json_object_get(rootJ, (ids + "pulsesPerStep").c_str());
 	if (pulsesPerStepJ)
-		pulsesPerStep = json_integer_value(pulsesPerStepJ);
+		sd->pulsesPerStep = json_integer_value(pulsesPerStepJ);
 
 	// delay
 	json_t *delayJ = json_object_get(rootJ, (ids + "delay").c_str());
 	if (delayJ)
-		delay = json_integer_value(delayJ);
+		sd->delay = json_integer_value(delayJ);
 
 	// runModeSong
 	json_t *runModeSongJ = json_object_get(rootJ, (ids + "runModeSong").c_str());
 	if (runModeSongJ)
-		runModeSong = json_integer_value(runModeSongJ);
+		sd->runModeSong = json_integer_value(runModeSongJ);
 			
 	// songBeginIndex
 	json_t *songBeginIndexJ = json_object_get(rootJ, (ids + "songBeginIndex").c_str());
 	if (songBeginIndexJ)
-		songBeginIndex = json_integer_value(songBeginIndexJ);
+		sd->songBeginIndex = json_integer_value(songBeginIndexJ);
 			
 	// songEndIndex
 	json_t *songEndIndexJ = json_object_get(rootJ, (ids + "songEndIndex").c_str());
 	if (songEndIndexJ)
-		songEndIndex = json_integer_value(songEndIndexJ);
+		sd->songEndIndex = json_integer_value(songEndIndexJ);
 
 	// phrases
 	json_t *phrasesJ = json_object_get(rootJ, (ids + "phrases").c_str());
@@ -168,7 +219,7 @@ void SequencerKernel::dataFromJson(json_t *rootJ, bool editingSequence) {
 		{
 			json_t *phrasesArrayJ = json_array_get(phrasesJ, i);
 			if (phrasesArrayJ)
-				phrases[i].setPhraseJson(json_integer_value(phrasesArrayJ));
+				sd->phrases[i].setPhraseJson(json_integer_value(phrasesArrayJ));
 		}
 	
 	// sequences (attributes of a seqs)
@@ -178,13 +229,13 @@ void SequencerKernel::dataFromJson(json_t *rootJ, bool editingSequence) {
 		{
 			json_t *sequencesArrayJ = json_array_get(sequencesJ, i);
 			if (sequencesArrayJ)
-				sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
+				sd->sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
 		}			
 	}		
 	
-	// CV and attributes (and dirty)
+	// CV and attributes (and dirty), from the legacy arrays when there is no valid packed blob
 	json_t *seqSavedJ = json_object_get(rootJ, (ids + "seqSaved").c_str());
-	if (seqSavedJ) {
+	if (!stepDataFromPacked(rootJ, sd) && seqSavedJ) {
 		int seqSaved[MAX_SEQS];
 		int i;
 		for (i = 0; i < MAX_SEQS; i++)
@@ -204,20 +255,20 @@ void SequencerKernel::dataFromJson(json_t *rootJ, bool editingSequence) {
 						for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
 							json_t *cvArrayJ = json_array_get(cvJ, stepn + (seqnComp * MAX_STEPS));
 							if (cvArrayJ)
-								cv[seqnFull][stepn] = json_number_value(cvArrayJ);
+								sd->cv[seqnFull][stepn] = json_number_value(cvArrayJ);
 							json_t *attributesArrayJ = json_array_get(attributesJ, stepn + (seqnComp * MAX_STEPS));
 							if (attributesArrayJ)
-								attributes[seqnFull][stepn].setAttribute(json_integer_value(attributesArrayJ));
+								sd->attributes[seqnFull].setAttribute(stepn, json_integer_value(attributesArrayJ));
 						}
-						dirty[seqnFull] = 1;
+						sd->dirty[seqnFull] = 1;
 						seqnComp++;
 					}
 					else {
 						for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
-							cv[seqnFull][stepn] = INIT_CV;
-							attributes[seqnFull][stepn].init();
+							sd->cv[seqnFull][stepn] = INIT_CV;
 						}
-						dirty[seqnFull] = 0;
+						sd->attributes[seqnFull].init();
+						sd->dirty[seqnFull] = 0;
 					}	
 				}
 			}
@@ -227,28 +278,71 @@ void SequencerKernel::dataFromJson(json_t *rootJ, bool editingSequence) {
 	// seqIndexEdit
 	json_t *seqIndexEditJ = json_object_get(rootJ, (ids + "seqIndexEdit").c_str());
 	if (seqIndexEditJ)
-		seqIndexEdit = json_integer_value(seqIndexEditJ);
+		sd->seqIndexEdit = json_integer_value(seqIndexEditJ);
 	
+	// rng
+	sd->rngState = RandomStream::stateFromJson(json_object_get(rootJ, (ids + "rng").c_str()));
+	return true;
+}
+void SequencerKernel::adoptJson(const SequencerKernelData& loaded, bool editingSequence) {// engine thread
+	*static_cast<SequencerKernelData*>(this) = loaded;
+	rng.setState(loaded.rngState);
+	resetNonJson(editingSequence);
+}
+void SequencerKernel::adoptInitJson(const RandomStream::State& loadedRngState, bool isAlreadyInit, bool editingSequence) {// engine thread
+	// for a track that is not in the patch, without copying a whole SequencerKernelData
+	if (!isAlreadyInit)
+		init();
+	rng.setState(loadedRngState);
 	resetNonJson(editingSequence);
 }
 
 
+bool SequencerKernel::stepDataFromPacked(json_t *rootJ, SequencerKernelData* sd) {
+	std::vector<uint8_t> payload;
+	if (!packedFromJson(rootJ, ids + "stepData", packedVersion, &payload))
+		return false;
+	
+	// check the layout before overwriting anything: one dirty byte per sequence, followed by its steps when dirty
+	size_t pos = 0;
+	int seqn = 0;
+	for (; seqn < MAX_SEQS && pos < payload.size(); seqn++)
+		pos += (payload[pos] != 0 ? 1 + MAX_STEPS * 8 : 1);
+	if (seqn != MAX_SEQS || pos != payload.size()) {
+		WARN("Packed data \"%sstepData\" has a bad layout, using legacy data", ids.c_str());
+		return false;
+	}
+	
+	PackedReader reader(payload);
+	for (seqn = 0; seqn < MAX_SEQS; seqn++) {
+		sd->dirty[seqn] = reader.u8();
+		if (sd->dirty[seqn] == 0) {
+			sd->attributes[seqn].init();
+		}
+		for (int stepn = 0; stepn < MAX_STEPS; stepn++) {
+			if (sd->dirty[seqn] != 0) {
+				sd->cv[seqn][stepn] = reader.f32();
+				sd->attributes[seqn].setAttribute(stepn, reader.u32());
+			}
+			else {
+				sd->cv[seqn][stepn] = INIT_CV;
+			}
+		}
+	}
+	return reader.isComplete();
+}
+
+
 void SequencerKernel::setGate(int stepn, bool newGate, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setGate(newGate);
+	attributes[seqIndexEdit].setGates(SeqStepAttributes::rangeMask(stepn, count), newGate);
 	dirty[seqIndexEdit] = 1;
 }
 void SequencerKernel::setGateP(int stepn, bool newGateP, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setGateP(newGateP);
+	attributes[seqIndexEdit].setGatePs(SeqStepAttributes::rangeMask(stepn, count), newGateP);
 	dirty[seqIndexEdit] = 1;
 }
 void SequencerKernel::setSlide(int stepn, bool newSlide, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setSlide(newSlide);
+	attributes[seqIndexEdit].setSlides(SeqStepAttributes::rangeMask(stepn, count), newSlide);
 	dirty[seqIndexEdit] = 1;
 }
 void SequencerKernel::setTied(int stepn, bool newTied, int count) {
@@ -265,27 +359,19 @@ void SequencerKernel::setTied(int stepn, bool newTied, int count) {
 }
 
 void SequencerKernel::setGatePVal(int stepn, int gatePval, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setGatePVal(gatePval);
+	attributes[seqIndexEdit].setGatePVals(stepn, count, gatePval);
 	dirty[seqIndexEdit] = 1;
 }
 void SequencerKernel::setSlideVal(int stepn, int slideVal, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setSlideVal(slideVal);
+	attributes[seqIndexEdit].setSlideVals(stepn, count, slideVal);
 	dirty[seqIndexEdit] = 1;
 }
 void SequencerKernel::setVelocityVal(int stepn, int velocity, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setVelocityVal(velocity);
+	attributes[seqIndexEdit].setVelocityVals(stepn, count, velocity);
 	dirty[seqIndexEdit] = 1;
 }
 void SequencerKernel::setGateType(int stepn, int gateType, int count) {
-	int endi = std::min((int)MAX_STEPS, stepn + count);
-	for (int i = stepn; i < endi; i++)
-		attributes[seqIndexEdit][i].setGateType(gateType);
+	attributes[seqIndexEdit].setGateTypes(stepn, count, gateType);
 	dirty[seqIndexEdit] = 1;
 }
 
@@ -310,7 +396,7 @@ float SequencerKernel::applyNewKey(int stepn, int newKeyIndex, int count) {// do
 void SequencerKernel::writeCV(int stepn, float newCV, int count) {// does not overwrite tied steps
 	int endi = std::min((int)MAX_STEPS, stepn + count);
 	for (int i = stepn; i < endi; i++) {
-		if (!attributes[seqIndexEdit][i].getTied()) {
+		if (!attributes[seqIndexEdit].getTied(i)) {
 			cv[seqIndexEdit][i] = newCV;
 			propagateCVtoTied(seqIndexEdit, i);
 		}
@@ -323,8 +409,8 @@ void SequencerKernel::copySequence(SeqCPbuffer* seqCPbuf, int startCP, int count
 	countCP = std::min(countCP, (int)MAX_STEPS - startCP);
 	for (int i = 0, stepn = startCP; i < countCP; i++, stepn++) {
 		seqCPbuf->cvCPbuffer[i] = cv[seqIndexEdit][stepn];
-		seqCPbuf->attribCPbuffer[i] = attributes[seqIndexEdit][stepn];
 	}
+	SeqStepAttributes::copySteps(&seqCPbuf->attribCPbuffer, 0, &attributes[seqIndexEdit], startCP, countCP);
 	seqCPbuf->seqAttribCPbuffer = sequences[seqIndexEdit];
 	seqCPbuf->storedLength = countCP;
 }
@@ -332,8 +418,8 @@ void SequencerKernel::pasteSequence(SeqCPbuffer* seqCPbuf, int startCP) {
 	int countCP = std::min(seqCPbuf->storedLength, (int)MAX_STEPS - startCP);
 	for (int i = 0, stepn = startCP; i < countCP; i++, stepn++) {
 		cv[seqIndexEdit][stepn] = seqCPbuf->cvCPbuffer[i];
-		attributes[seqIndexEdit][stepn] = seqCPbuf->attribCPbuffer[i];
 	}
+	SeqStepAttributes::copySteps(&attributes[seqIndexEdit], startCP, &seqCPbuf->attribCPbuffer, 0, countCP);
 	if (startCP == 0 && countCP == MAX_STEPS)
 		sequences[seqIndexEdit] = seqCPbuf->seqAttribCPbuffer;
 	dirty[seqIndexEdit] = 1;
@@ -392,7 +478,7 @@ int SequencerKernel::clockStep(bool editingSequence, int delayedSeqNumberRequest
 					int oldPhraseIndexRun = phraseIndexRun;
 					bool songLoopOver = movePhraseIndexRun(false);// false means normal (not init)
 					// check for end of song if needed
-					if (songLoopOver && (id == *stopAtEndOfSongPtr)) {
+					if (songLoopOver && isStopTrack()) {
 						phraseChangeOrStop = 2;
 						stepIndexRun = oldStepIndexRun;
 						phraseIndexRun = oldPhraseIndexRun;
@@ -423,8 +509,10 @@ int SequencerKernel::clockStep(bool editingSequence, int delayedSeqNumberRequest
 }
 
 
-int SequencerKernel::keyIndexToGateTypeEx(int keyIndex) {// return -1 when invalid gate type given current pps setting
+int SequencerKernel::keyIndexToGateTypeEx(int keyIndex, bool extended) {// return -1 when invalid gate type given current pps setting; extended is an alt-click
 	int ppsFiltered = getPulsesPerStep();// must use method
+	if (extended)
+		return gatePatterns96.keyIndexToExtGateType(keyIndex, ppsFiltered);
 	int ret = keyIndex;
 	
 	if (keyIndex == 1 || keyIndex == 3 || keyIndex == 6 || keyIndex == 8 || keyIndex == 10) {// black keys
@@ -457,9 +545,9 @@ void SequencerKernel::transposeSeq(int delta) {
 	
 	delta = tVal - oldTransposeOffset;
 	if (delta != 0) { 
-		float offsetCV = ((float)(delta))/12.0f;
-		for (int stepn = 0; stepn < MAX_STEPS; stepn++) 
-			cv[seqIndexEdit][stepn] += offsetCV;
+		simd::float_4 offsetCV = ((float)(delta))/12.0f;
+		for (int stepn = 0; stepn < MAX_STEPS; stepn += 4) 
+			(simd::float_4::load(&cv[seqIndexEdit][stepn]) + offsetCV).store(&cv[seqIndexEdit][stepn]);
 	}
 	dirty[seqIndexEdit] = 1;
 }
@@ -475,61 +563,42 @@ void SequencerKernel::rotateSeq(int delta) {
 	if (delta == 0) 
 		return;// if end of range, no transpose to do
 	
-	if (delta > 0 && delta < 201) {// Rotate right, 201 is safety (account for a delta of 2*99 when min to max in one shot)
-		for (int i = delta; i > 0; i--) {
-			rotateSeqByOne(seqIndexEdit, true);
-		}
-	}
-	if (delta < 0 && delta > -201) {// Rotate left, 201 is safety (account for a delta of 2*99 when min to max in one shot)
-		for (int i = delta; i < 0; i++) {
-			rotateSeqByOne(seqIndexEdit, false);
+	if (delta > -201 && delta < 201) {// 201 is safety (account for a delta of 2*99 when min to max in one shot)
+		// positive delta rotates right, all steps are moved at once instead of one rotation by one step per delta
+		int length = sequences[seqIndexEdit].getLength();
+		int rot = delta % length;
+		if (rot < 0)
+			rot += length;
+		if (rot != 0) {
+			float* cvSeq = cv[seqIndexEdit];
+			std::rotate(cvSeq, cvSeq + length - rot, cvSeq + length);
+			attributes[seqIndexEdit].rotate(length, rot);
 		}
 	}
 	dirty[seqIndexEdit] = 1;
 }	
 
 
-void SequencerKernel::rotateSeqByOne(int seqn, bool directionRight) {// caller sets dirty[] to 1
-	float rotCV;
-	StepAttributes rotAttributes;
-	int iStart = 0;
-	int iEnd = sequences[seqn].getLength() - 1;
-	int iRot = iStart;
-	int iDelta = 1;
-	if (directionRight) {
-		iRot = iEnd;
-		iDelta = -1;
-	}
-	rotCV = cv[seqn][iRot];
-	rotAttributes = attributes[seqn][iRot];
-	for ( ; ; iRot += iDelta) {
-		if (iDelta == 1 && iRot >= iEnd) break;
-		if (iDelta == -1 && iRot <= iStart) break;
-		cv[seqn][iRot] = cv[seqn][iRot + iDelta];
-		attributes[seqn][iRot] = attributes[seqn][iRot + iDelta];
-	}
-	cv[seqn][iRot] = rotCV;
-	attributes[seqn][iRot] = rotAttributes;
-}
-
-
 void SequencerKernel::activateTiedStep(int seqn, int stepn) {// caller sets dirty[] to 1
-	attributes[seqn][stepn].setTied(true);
+	StepAttributes stepAttrib = attributes[seqn].get(stepn);
+	stepAttrib.setTied(true);
+	attributes[seqn].set(stepn, stepAttrib);
 	if (stepn > 0) {
 		propagateCVtoTied(seqn, stepn - 1);
 	
 		if (*holdTiedNotesPtr) {// new method
-			attributes[seqn][stepn].setGate(true);
-			for (unsigned int i = stepn; i < MAX_STEPS && attributes[seqn][i].getTied(); i++) {
-				attributes[seqn][i].setGateType(attributes[seqn][i - 1].getGateType());
-				attributes[seqn][i - 1].setGateType(5);
-				attributes[seqn][i - 1].setGate(true);
+			attributes[seqn].setGates(SeqStepAttributes::rangeMask(stepn, 1), true);
+			for (unsigned int i = stepn; i < MAX_STEPS && attributes[seqn].getTied(i); i++) {
+				attributes[seqn].setGateTypes(i, 1, attributes[seqn].getGateType(i - 1));
+				attributes[seqn].setGateTypes(i - 1, 1, 5);
+				attributes[seqn].setGates(SeqStepAttributes::rangeMask(i - 1, 1), true);
 			}
 		}
 		else {// old method
 			// if (stepn > 0) {
-				attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-				attributes[seqn][stepn].setTied(true);
+				stepAttrib = attributes[seqn].get(stepn - 1);
+				stepAttrib.setTied(true);
+				attributes[seqn].set(stepn, stepAttrib);
 			// }
 		}
 	}
@@ -537,12 +606,12 @@ void SequencerKernel::activateTiedStep(int seqn, int stepn) {// caller sets dirt
 
 
 void SequencerKernel::deactivateTiedStep(int seqn, int stepn) {// caller sets dirty[] to 1
-	attributes[seqn][stepn].setTied(false);
+	attributes[seqn].setTieds(SeqStepAttributes::rangeMask(stepn, 1), false);
 	if (*holdTiedNotesPtr && stepn != 0) {// new method
-		int lastGateType = attributes[seqn][stepn].getGateType();
-		for (int i = stepn + 1; i < MAX_STEPS && attributes[seqn][i].getTied(); i++)
-			lastGateType = attributes[seqn][i].getGateType();
-		attributes[seqn][stepn - 1].setGateType(lastGateType);
+		int lastGateType = attributes[seqn].getGateType(stepn);
+		for (int i = stepn + 1; i < MAX_STEPS && attributes[seqn].getTied(i); i++)
+			lastGateType = attributes[seqn].getGateType(i);
+		attributes[seqn].setGateTypes(stepn - 1, 1, lastGateType);
 	}
 	//else old method, nothing to do
 }
@@ -564,32 +633,28 @@ void SequencerKernel::calcGateCode(bool editingSequence) {
 	//   false = last prob says turn gate off (used by current and consecutive tied steps)
 	
 	int seqn = editingSequence ? seqIndexEdit : phrases[phraseIndexRun].getSeqNum();
-	StepAttributes attribute = attributes[seqn][stepIndexRun];
+	const SeqStepAttributes& seqAttribs = attributes[seqn];
 	int ppsFiltered = getPulsesPerStep();// must use method
-	int gateType = attribute.getGateType();
+	int gateType = seqAttribs.getGateType(stepIndexRun);
 	
 	// calc: ** lastProbGateEnable ** decision only when first ppqn of a non-tied step
-	if (ppqnCount == 0 && !attribute.getTied()) {
-		lastProbGateEnable = !attribute.getGateP() || (random::uniform() < ((float)attribute.getGatePVal() / 100.0f));// random::uniform is [0.0, 1.0), see include/util/common.hpp
+	if (ppqnCount == 0 && !seqAttribs.getTied(stepIndexRun)) {
+		lastProbGateEnable = !seqAttribs.getGateP(stepIndexRun) || (rng.uniform() < ((float)seqAttribs.getGatePVal(stepIndexRun) / 100.0f));// uniform is [0.0, 1.0)
 	}
 	
 	// calc: ** gateType ** 
-	if (!attribute.getGate() || !lastProbGateEnable) {
+	if (!seqAttribs.getGate(stepIndexRun) || !lastProbGateEnable) {
 		gateCode = 0;
 	}
 	else if (ppsFiltered == 1 && gateType == 0) {
 		gateCode = 2;// clock high pulse
 	}
 	else {
-		if (gateType == 11) {
+		if (gateType == GATETYPE_TRIG) {
 			gateCode = (ppqnCount == 0 ? 3 : 0);// trig on first ppqnCount
 		}
 		else {
-			uint64_t shiftAmt = ((uint64_t)ppqnCount) * (((uint64_t)96) / ((uint64_t)ppsFiltered));
-			if (shiftAmt >= 64)
-				gateCode = (int)((advGateHitMaskHigh[gateType] >> (shiftAmt - (uint64_t)64)) & (uint64_t)0x1);
-			else
-				gateCode = (int)((advGateHitMaskLow[gateType] >> shiftAmt) & (uint64_t)0x1);
+			gateCode = gatePatterns96.isHigh(gateType, ppsFiltered, ppqnCount) ? 1 : 0;
 		}
 	}
 }
@@ -698,7 +763,7 @@ bool SequencerKernel::moveStepIndexRun(bool init, bool editingSequence) {
 			if (init)
 				stepIndexRun = 0;
 			else {
-				stepIndexRun += (random::u32() % 3) - 1;
+				stepIndexRun += (rng.u32() % 3) - 1;
 				if (stepIndexRun > endStep)
 					stepIndexRun = 0;
 				if (stepIndexRun < 0)
@@ -715,7 +780,7 @@ bool SequencerKernel::moveStepIndexRun(bool init, bool editingSequence) {
 			if (init)
 				stepIndexRun = 0;
 			else {
-				stepIndexRun = (random::u32() % (endStep + 1));
+				stepIndexRun = (rng.u32() % (endStep + 1));
 				stepIndexRunHistory--;
 				if (stepIndexRunHistory <= 0x6000)
 					crossBoundary = true;
@@ -729,7 +794,7 @@ bool SequencerKernel::moveStepIndexRun(bool init, bool editingSequence) {
 			if (init)
 				stepIndexRun = 0;
 			else {
-				stepIndexRun = singleStepRandom.getNext(endStep + 1);//(random::u32() % (endStep + 1));
+				stepIndexRun = singleStepRandom.getNext(endStep + 1, rng.u32());//(rng.u32() % (endStep + 1));
 				stepIndexRunHistory--;
 				if (stepIndexRunHistory <= 0x8000)
 					crossBoundary = true;
@@ -848,7 +913,7 @@ void SequencerKernel::movePhraseIndexRandomSingle(bool init) {
 		phraseIndexRun = (tpi == 0 ? songBeginIndex : tempPhraseIndexes[0]);
 	}
 	else {	
-		phraseIndexRun = tempPhraseIndexes[singlePhraseRandom.getNext(tpi)];// tempPhraseIndexes[randomValue % tpi];
+		phraseIndexRun = tempPhraseIndexes[singlePhraseRandom.getNext(tpi, rng.u32())];// tempPhraseIndexes[randomValue % tpi];
 	}
 }
 
@@ -917,12 +982,12 @@ bool SequencerKernel::movePhraseIndexRun(bool init) {
 		
 		case MODE_BRN :// brownian random; history base is 0x5000
 			phraseIndexRunHistory = 0x5000;
-			movePhraseIndexBrownian(init, random::u32());// no crossBoundary
+			movePhraseIndexBrownian(init, rng.u32());// no crossBoundary
 		break;
 		
 		case MODE_RND :// random; history base is 0x6000
 			phraseIndexRunHistory = 0x6000;
-			movePhraseIndexRandom(init, random::u32());// no crossBoundary
+			movePhraseIndexRandom(init, rng.u32());// no crossBoundary
 		break;
 		
 		case MODE_RNS :// random single phrase; history base is 0x8000
@@ -950,8 +1015,8 @@ bool SequencerKernel::movePhraseIndexRun(bool init) {
 void SeqCPbuffer::reset() {		
 	for (int stepn = 0; stepn < SequencerKernel::MAX_STEPS; stepn++) {
 		cvCPbuffer[stepn] = 0.0f;
-		attribCPbuffer[stepn].init();
 	}
+	attribCPbuffer.init();
 	seqAttribCPbuffer.init(SequencerKernel::MAX_STEPS, SequencerKernel::MODE_FWD);
 	storedLength = SequencerKernel::MAX_STEPS;// number of steps that contain actual cp data
 }
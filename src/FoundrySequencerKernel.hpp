@@ -5,6 +5,11 @@
 #pragma once
 
 #include "ImpromptuModular.hpp"
+#include "RandomStream.hpp"
+#include "PackedData.hpp"
+#include "SingleRandom.hpp"
+#include "GatePatterns.hpp"
+#include <climits>
 
 
 class StepAttributes {
@@ -63,6 +68,151 @@ class StepAttributes {
 //*****************************************************************************
 
 
+class SeqStepAttributes {
+	// step attributes of one sequence, stored by field: one bit per step for the gate, gate p, slide and tied flags,
+	// and one byte per step for the values, so that multi-step edits and rotations are done a word at a time.
+	// StepAttributes is still used to pass the attributes of a single step, and for the patch format.
+
+	public:
+
+	static const int NUM_STEPS = 32;// number of bits in a flags word
+
+
+	private:
+
+	uint32_t gates;
+	uint32_t gatePs;
+	uint32_t slides;
+	uint32_t tieds;
+	uint8_t gateTypes[NUM_STEPS];
+	uint8_t velocityVals[NUM_STEPS];
+	uint8_t gatePVals[NUM_STEPS];
+	uint8_t slideVals[NUM_STEPS];
+
+	static uint32_t setBits(uint32_t word, uint32_t mask, bool state) {return state ? (word | mask) : (word & ~mask);}
+	static uint32_t rotateBits(uint32_t word, int length, int delta) {
+		// rotates the first length bits to the right (toward higher steps) by delta in [1 : length - 1]
+		uint32_t lengthMask = rangeMask(0, length);
+		uint32_t field = word & lengthMask;
+		return (word & ~lengthMask) | (((field << delta) | (field >> (length - delta))) & lengthMask);
+	}
+	static uint32_t copyBits(uint32_t dst, int dstStep, uint32_t src, int srcStep, int count) {
+		uint32_t field = (src >> srcStep) & rangeMask(0, count);
+		return (dst & ~rangeMask(dstStep, count)) | (field << dstStep);
+	}
+
+
+	public:
+
+	static uint32_t rangeMask(int stepn, int count) {// bits of steps [stepn : stepn + count - 1], clipped to NUM_STEPS
+		if (count <= 0 || stepn >= NUM_STEPS)
+			return 0;
+		uint32_t mask = (count >= NUM_STEPS ? 0xFFFFFFFF : ((((uint32_t)1) << count) - 1));
+		return mask << stepn;
+	}
+
+	void init() {
+		StepAttributes stepAttrib;
+		stepAttrib.init();
+		fill(0, NUM_STEPS, stepAttrib);
+	}
+
+	StepAttributes get(int stepn) const {
+		uint32_t bit = ((uint32_t)1) << stepn;
+		StepAttributes stepAttrib;
+		stepAttrib.setAttribute(
+			((gates & bit) != 0 ? StepAttributes::ATT_MSK_GATE : 0ul) |
+			((gatePs & bit) != 0 ? StepAttributes::ATT_MSK_GATEP : 0ul) |
+			((slides & bit) != 0 ? StepAttributes::ATT_MSK_SLIDE : 0ul) |
+			((tieds & bit) != 0 ? StepAttributes::ATT_MSK_TIED : 0ul) |
+			(((unsigned long)gateTypes[stepn]) << StepAttributes::gateTypeShift) |
+			(((unsigned long)velocityVals[stepn]) << StepAttributes::velocityShift) |
+			(((unsigned long)gatePVals[stepn]) << StepAttributes::gatePValShift) |
+			(((unsigned long)slideVals[stepn]) << StepAttributes::slideValShift) );
+		return stepAttrib;
+	}
+	unsigned long getAttribute(int stepn) const {return get(stepn).getAttribute();}
+	bool getGate(int stepn) const {return (gates & (((uint32_t)1) << stepn)) != 0;}
+	bool getGateP(int stepn) const {return (gatePs & (((uint32_t)1) << stepn)) != 0;}
+	bool getSlide(int stepn) const {return (slides & (((uint32_t)1) << stepn)) != 0;}
+	bool getTied(int stepn) const {return (tieds & (((uint32_t)1) << stepn)) != 0;}
+	int getGateType(int stepn) const {return gateTypes[stepn];}
+	int getVelocityVal(int stepn) const {return velocityVals[stepn];}
+	int getGatePVal(int stepn) const {return gatePVals[stepn];}
+	int getSlideVal(int stepn) const {return slideVals[stepn];}
+
+	void set(int stepn, StepAttributes stepAttrib) {fill(stepn, 1, stepAttrib);}
+	void setAttribute(int stepn, unsigned long attribute) {// packed value as in StepAttributes::getAttribute()
+		StepAttributes stepAttrib;
+		stepAttrib.setAttribute(attribute);
+		set(stepn, stepAttrib);
+	}
+	void fill(int stepn, int count, StepAttributes stepAttrib) {// all steps in [stepn : stepn + count - 1] (clipped) get stepAttrib
+		count = std::min(count, NUM_STEPS - stepn);
+		if (count <= 0)
+			return;
+		uint32_t mask = rangeMask(stepn, count);
+		gates = setBits(gates, mask, stepAttrib.getGate());
+		gatePs = setBits(gatePs, mask, stepAttrib.getGateP());
+		slides = setBits(slides, mask, stepAttrib.getSlide());
+		tieds = setBits(tieds, mask, stepAttrib.getTied());
+		std::memset(&gateTypes[stepn], stepAttrib.getGateType(), count);
+		std::memset(&velocityVals[stepn], stepAttrib.getVelocityVal(), count);
+		std::memset(&gatePVals[stepn], stepAttrib.getGatePVal(), count);
+		std::memset(&slideVals[stepn], stepAttrib.getSlideVal(), count);
+	}
+
+	// bulk setters, the mask is made with rangeMask() and the byte ranges are clipped like rangeMask()
+	void setGates(uint32_t mask, bool state) {gates = setBits(gates, mask, state);}
+	void setGatePs(uint32_t mask, bool state) {gatePs = setBits(gatePs, mask, state);}
+	void setSlides(uint32_t mask, bool state) {slides = setBits(slides, mask, state);}
+	void setTieds(uint32_t mask, bool state) {tieds = setBits(tieds, mask, state);}
+	void setGateTypes(int stepn, int count, int gateType) {fillBytes(gateTypes, stepn, count, gateType);}
+	void setVelocityVals(int stepn, int count, int velocity) {fillBytes(velocityVals, stepn, count, velocity);}
+	void setGatePVals(int stepn, int count, int gatePVal) {fillBytes(gatePVals, stepn, count, gatePVal);}
+	void setSlideVals(int stepn, int count, int slideVal) {fillBytes(slideVals, stepn, count, slideVal);}
+	static void fillBytes(uint8_t* bytes, int stepn, int count, int value) {
+		count = std::min(count, NUM_STEPS - stepn);
+		if (count > 0)
+			std::memset(&bytes[stepn], value, count);
+	}
+
+	void rotate(int length, int delta) {
+		// rotates the first length steps to the right (toward higher steps) by delta, negative delta rotates left
+		if (length <= 1)
+			return;
+		delta %= length;
+		if (delta < 0)
+			delta += length;
+		if (delta == 0)
+			return;
+		gates = rotateBits(gates, length, delta);
+		gatePs = rotateBits(gatePs, length, delta);
+		slides = rotateBits(slides, length, delta);
+		tieds = rotateBits(tieds, length, delta);
+		for (uint8_t* bytes : {gateTypes, velocityVals, gatePVals, slideVals})
+			std::rotate(bytes, bytes + length - delta, bytes + length);
+	}
+
+	static void copySteps(SeqStepAttributes* dst, int dstStep, const SeqStepAttributes* src, int srcStep, int count) {
+		// count must be such that both ranges are within NUM_STEPS
+		if (count <= 0)
+			return;
+		dst->gates = copyBits(dst->gates, dstStep, src->gates, srcStep, count);
+		dst->gatePs = copyBits(dst->gatePs, dstStep, src->gatePs, srcStep, count);
+		dst->slides = copyBits(dst->slides, dstStep, src->slides, srcStep, count);
+		dst->tieds = copyBits(dst->tieds, dstStep, src->tieds, srcStep, count);
+		std::memcpy(&dst->gateTypes[dstStep], &src->gateTypes[srcStep], count);
+		std::memcpy(&dst->velocityVals[dstStep], &src->velocityVals[srcStep], count);
+		std::memcpy(&dst->gatePVals[dstStep], &src->gatePVals[srcStep], count);
+		std::memcpy(&dst->slideVals[dstStep], &src->slideVals[srcStep], count);
+	}
+};// class SeqStepAttributes
+
+
+//*****************************************************************************
+
+
 class Phrase {
 	// a phrase is a sequence number and a number of repetitions; it is used to make a song
 	unsigned long phrase = 0ul;
@@ -137,83 +287,42 @@ class SeqAttributes {
 };// class SeqAttributes
 
 
+//*****************************************************************************
+// SequencerKernelData
 //*****************************************************************************
 
 
-class SingleStepRandom {
-	uint32_t played = 0;// bit field that says if a given item was already played, max 32 steps
-	std::vector<uint8_t> candidates;
-	
-	public:
-	
-	void init() {played = 0x1;}// we always start on (reset to) first step, so mark it as played
-	
-	int getNext(int length) {
-		// get a random unplayed step within length, if none, reset all and choose one randomly
-		int retStep = 0;
-		
-		candidates.clear();
-		for (int i = 0; i < length; i++) {
-			if ( (played & (0x1 << i)) == 0) {
-				candidates.push_back(i);
-			}
-		}
-		if (candidates.empty()) {
-			played = 0;
-			retStep = random::u32() % length;
-		}
-		else {
-			retStep = candidates[random::u32() % candidates.size()];
-		}
-		played |= (0x1 << retStep);
-		
-		return retStep;
-	}
-};// class SingleStepRandom
+// Steps and song of a track. SequencerKernel plays its own, dataFromJson() parses into a separate copy that 
+// process() then adopts (see JsonHandoff.hpp)
 
+struct SequencerKernelData {
+	// Sequencer kernel dimensions
+	static const int MAX_STEPS = 32;// must be a power of two (some multi select loops have bitwise "& (MAX_STEPS - 1)")
+	static_assert(MAX_STEPS == SeqStepAttributes::NUM_STEPS, "step attributes have one bit per step in a flags word");
+	static const int MAX_SEQS = 64;
+	static const int MAX_PHRASES = 99;// maximum value is 99 (index value is 0 to 98; disp will be 1 to 99)
 
-class SinglePhraseRandom {
-	uint64_t played0 = 0, played1 = 0;// bit field that says if a given item was already played, max 128 phrases
-	std::vector<uint8_t> candidates;
-	
-	public:
-	
-	void init() {played0 = 0x1, played1 = 0;}// we always start on (reset to) first phrase, so mark it as played
+	// Run modes
+	enum RunModeIds {MODE_FWD, MODE_REV, MODE_PPG, MODE_PEN, MODE_BRN, MODE_RND, MODE_TKA, MODE_RNS, NUM_MODES};
+
+	static constexpr float INIT_CV = 0.0f;
+
+	int pulsesPerStep;// stored range is [1:49] so must ALWAYS read thgouth getPulsesPerStep(). Must do this because of knob
+	int delay;
+	int runModeSong;	
+	int songBeginIndex;
+	int songEndIndex;
+	Phrase phrases[MAX_PHRASES];// This is the song (series of phases; a phrase is a sequence number and a repetition value)	
+	SeqAttributes sequences[MAX_SEQS];
+	float cv[MAX_SEQS][MAX_STEPS];// [-3.0 : 3.917].
+	SeqStepAttributes attributes[MAX_SEQS];
+	char dirty[MAX_SEQS];
+	int seqIndexEdit;
+	RandomStream::State rngState;// stream loaded with the steps, the kernel itself plays its own rng
 	
-	int getNext(int length) {
-		// get a random unplayed index in tempPhraseIndexes[] within length, if none, reset all and choose one randomly
-		int tpiIndex = 0;
-		
-		candidates.clear();
-		for (int i = 0; i < length; i++) {
-			if (i < 64) {
-				if ( (played0 & (0x1 << i)) == 0) {
-					candidates.push_back(i);
-				}
-			}
-			else {
-				if ( (played1 & (0x1 << (i - 64))) == 0) {
-					candidates.push_back(i);
-				}
-			}
-		}
-		if (candidates.empty()) {
-			played0 = 0, played1 = 0;
-			tpiIndex = random::u32() % length;
-		}
-		else {
-			tpiIndex = candidates[random::u32() % candidates.size()];
-		}
-		if (tpiIndex < 64) {
-			played0 |= (0x1 << tpiIndex);
-		}
-		else {
-			played1 |= (0x1 << (tpiIndex - 64));
-		}
-		
-		return tpiIndex;
-	}
-};// class SinglePhraseRandom
+	void init();
+	bool isInit();// same steps and song as after init(), rngState is not compared
+};// struct SequencerKernelData
 
 
 //*****************************************************************************
@@ -224,52 +333,30 @@ class SinglePhraseRandom {
 struct SeqCPbuffer;
 struct SongCPbuffer;
 
-class SequencerKernel {
+class SequencerKernel : public SequencerKernelData {// steps and song are in SequencerKernelData
 	public: 
 
-	// Sequencer kernel dimensions
-	static const int MAX_STEPS = 32;// must be a power of two (some multi select loops have bitwise "& (MAX_STEPS - 1)")
-	static const int MAX_SEQS = 64;
-	static const int MAX_PHRASES = 99;// maximum value is 99 (index value is 0 to 98; disp will be 1 to 99)
-
-	// Run modes
-	enum RunModeIds {MODE_FWD, MODE_REV, MODE_PPG, MODE_PEN, MODE_BRN, MODE_RND, MODE_TKA, MODE_RNS, NUM_MODES};
 	static const std::string modeLabels[NUM_MODES];
 	
 	
 	private:
 	
-	// Gate types
-	static const int NUM_GATES = 12;	
-	static const uint64_t advGateHitMaskLow[NUM_GATES];		
-	static const uint64_t advGateHitMaskHigh[NUM_GATES];
-
 	// Constants
-	static constexpr float INIT_CV = 0.0f;
+	static const uint8_t packedVersion = 1;// format of the packed "stepData" blob
 
 	
-	// Need to save, with reset
-	int pulsesPerStep;// stored range is [1:49] so must ALWAYS read thgouth getPulsesPerStep(). Must do this because of knob
-	int delay;
-	int runModeSong;	
-	int songBeginIndex;
-	int songEndIndex;
-	Phrase phrases[MAX_PHRASES];// This is the song (series of phases; a phrase is a sequence number and a repetition value)	
-	SeqAttributes sequences[MAX_SEQS];
-	float cv[MAX_SEQS][MAX_STEPS];// [-3.0 : 3.917].
-	StepAttributes attributes[MAX_SEQS][MAX_STEPS];
-	char dirty[MAX_SEQS];
-	int seqIndexEdit;
+	// Need to save, no reset
+	RandomStream rng;// all run-time random decisions (run modes, gate probabilities), one stream per track
 	
 	// No need to save, with reset
 	unsigned long clockPeriod;// counts number of step() calls upward from last clock (reset after clock processed)
 	int phraseIndexRun;
 	unsigned long phraseIndexRunHistory;
-	SinglePhraseRandom singlePhraseRandom;
+	SingleRandom<MAX_PHRASES> singlePhraseRandom;
 	bool moveStepIndexRunIgnore;
 	int stepIndexRun;
 	unsigned long stepIndexRunHistory;
-	SingleStepRandom singleStepRandom;
+	SingleRandom<MAX_STEPS> singleStepRandom;
 	int ppqnCount;
 	int ppqnLeftToSkip;// used in clock delay
 	int gateCode;// 0 = Low for current pulse of step, 1 = High for current pulse of step, 2 = Clk high pulse, 3 = 1ms trig
@@ -280,9 +367,9 @@ class SequencerKernel {
 	// No need to save, no reset
 	int id = 0;
 	std::string ids;
-	SequencerKernel *masterKernel = nullptr;// nullptr for track 0, used for grouped run modes (tracks B,C,D follow A when random, for example)
+	SequencerKernel *masterKernel = nullptr;// nullptr for track 0, used for grouped run modes (the other tracks follow A when random, for example)
 	bool* holdTiedNotesPtr = nullptr;
-	int* stopAtEndOfSongPtr = nullptr;
+	int* stopAtEndOfSongPtr = nullptr;// nullptr for the tracks that cannot stop the song
 	
 	
 	
@@ -295,8 +382,14 @@ class SequencerKernel {
 	void initRun(bool editingSequence);
 	void initPulsesPerStep() {pulsesPerStep = 1;}
 	void initDelay() {delay = 0;}
-	void dataToJson(json_t *rootJ);
-	void dataFromJson(json_t *rootJ, bool editingSequence);
+	void seedRandom(uint64_t seed) {rng.setSeed(seed, id);}
+	bool isRandomDeterministic() {return rng.deterministic;}
+	void setRandomDeterministic(bool deterministic) {rng.deterministic = deterministic;}
+	void dataToJson(json_t *rootJ, bool packed, SequencerKernelData* sd);// sd is this kernel or data loaded for it
+	bool dataFromJson(json_t *rootJ, SequencerKernelData* sd);// returns false when the patch has no such track
+	bool stepDataFromPacked(json_t *rootJ, SequencerKernelData* sd);
+	void adoptJson(const SequencerKernelData& loaded, bool editingSequence);
+	void adoptInitJson(const RandomStream::State& loadedRngState, bool isAlreadyInit, bool editingSequence);
 
 
 	int getSeqIndexEdit() {return seqIndexEdit;}
@@ -324,8 +417,8 @@ class SequencerKernel {
 	StepAttributes getAttribute(int stepn) {return getAttributei(true, stepn);}
 	StepAttributes getAttributei(bool editingSequence, int stepn) {
 		if (editingSequence)
-			return attributes[seqIndexEdit][stepn];
-		return attributes[phrases[phraseIndexRun].getSeqNum()][stepn];
+			return attributes[seqIndexEdit].get(stepn);
+		return attributes[phrases[phraseIndexRun].getSeqNum()].get(stepn);
 	}
 	
 	void setSeqIndexEdit(int _seqIndexEdit) {seqIndexEdit = _seqIndexEdit;}
@@ -388,19 +481,19 @@ class SequencerKernel {
 		return delay;
 	}
 	int modGatePVal(int stepn, int delta, int count) {
-		int pVal = attributes[seqIndexEdit][stepn].getGatePVal();
+		int pVal = attributes[seqIndexEdit].getGatePVal(stepn);
 		pVal = clamp(pVal + delta, 0, 100);
 		setGatePVal(stepn, pVal, count);
 		return pVal;
 	}		
 	int modSlideVal(int stepn, int delta, int count) {
-		int sVal = attributes[seqIndexEdit][stepn].getSlideVal();
+		int sVal = attributes[seqIndexEdit].getSlideVal(stepn);
 		sVal = clamp(sVal + delta, 0, 100);
 		setSlideVal(stepn, sVal, count);
 		return sVal;
 	}		
 	int modVelocityVal(int stepn, int delta, int upperLimit, int count) {
-		int vVal = attributes[seqIndexEdit][stepn].getVelocityVal();
+		int vVal = attributes[seqIndexEdit].getVelocityVal(stepn);
 		vVal = clamp(vVal + delta, 0, upperLimit);
 		setVelocityVal(stepn, vVal, count);
 		return vVal;
@@ -408,22 +501,22 @@ class SequencerKernel {
 	void modSeqIndexEdit(int delta) {seqIndexEdit = clamp(seqIndexEdit + delta, 0, MAX_SEQS - 1);}
 	void decSlideStepsRemain() {if (slideStepsRemain > 0ul) slideStepsRemain--;}	
 	bool toggleGate(int stepn, int count) {
-		bool newGate = !attributes[seqIndexEdit][stepn].getGate();
+		bool newGate = !attributes[seqIndexEdit].getGate(stepn);
 		setGate(stepn, newGate, count);
 		return newGate;
 	}
 	bool toggleGateP(int stepn, int count) {
-		bool newGateP = !attributes[seqIndexEdit][stepn].getGateP();
+		bool newGateP = !attributes[seqIndexEdit].getGateP(stepn);
 		setGateP(stepn, newGateP, count);
 		return newGateP;
 	}
 	bool toggleSlide(int stepn, int count) {
-		bool newSlide = !attributes[seqIndexEdit][stepn].getSlide();
+		bool newSlide = !attributes[seqIndexEdit].getSlide(stepn);
 		setSlide(stepn, newSlide, count);
 		return newSlide;
 	}	
 	bool toggleTied(int stepn, int count) {
-		bool newTied = !attributes[seqIndexEdit][stepn].getTied();
+		bool newTied = !attributes[seqIndexEdit].getTied(stepn);
 		setTied(stepn, newTied, count);
 		return newTied;
 	}	
@@ -431,7 +524,7 @@ class SequencerKernel {
 	float applyNewKey(int stepn, int newKeyIndex, int count);
 	void writeCV(int stepn, float newCV, int count);
 	void writeAttribNoTies(int stepn, const StepAttributes &stepAttrib) {// does not handle tied notes
-		attributes[seqIndexEdit][stepn] = stepAttrib;
+		attributes[seqIndexEdit].set(stepn, stepAttrib);
 	}
 	
 	float calcSlideOffset() {return (slideStepsRemain > 0ul ? (slideCVdelta * (float)slideStepsRemain) : 0.0f);}
@@ -445,6 +538,18 @@ class SequencerKernel {
 		// here gateCode is 3, meaning trigger
 		return clockPeriod < (unsigned long) (sampleRate * 0.01f);
 	}
+	// used by Sequencer to hold the outputs between events: calcGate() only changes on clock steps, except when it 
+	// follows the clock input (gateCode 2), and at the end of a trigger (gateCode 3)
+	bool isGateFollowingClock() {return ppqnLeftToSkip == 0 && gateCode == 2;}
+	unsigned long calcGateHoldSamples(float sampleRate) {// number of samples after this one for which calcGate() is unchanged
+		if (ppqnLeftToSkip == 0 && gateCode == 3) {
+			unsigned long trigSamples = (unsigned long) (sampleRate * 0.01f);
+			if (clockPeriod < trigSamples)
+				return trigSamples - 1ul - clockPeriod;
+		}
+		return ULONG_MAX;
+	}
+	bool isSliding() {return slideStepsRemain > 0ul;}
 	
 
 	void copySequence(SeqCPbuffer* seqCPbuf, int startCP, int countCP);
@@ -456,7 +561,7 @@ class SequencerKernel {
 	void process() {
 		clockPeriod++;
 	}
-	int keyIndexToGateTypeEx(int keyIndex);
+	int keyIndexToGateTypeEx(int keyIndex, bool extended = false);
 	void transposeSeq(int delta);
 	void unTransposeSeq() {
 		transposeSeq(getTransposeOffset() * -1);
@@ -469,9 +574,8 @@ class SequencerKernel {
 	
 	private:
 	
-	void rotateSeqByOne(int seqn, bool directionRight);
 	void propagateCVtoTied(int seqn, int stepn) {
-		for (unsigned int i = stepn + 1; i < MAX_STEPS && attributes[seqn][i].getTied(); i++)
+		for (unsigned int i = stepn + 1; i < MAX_STEPS && attributes[seqn].getTied(i); i++)
 			cv[seqn][i] = cv[seqn][i - 1];	
 	}
 	void activateTiedStep(int seqn, int stepn);
@@ -485,12 +589,13 @@ class SequencerKernel {
 	void movePhraseIndexRandomSingle(bool init);	
 	void movePhraseIndexBrownian(bool init, uint32_t randomValue);	
 	bool movePhraseIndexRun(bool init);
+	bool isStopTrack() {return stopAtEndOfSongPtr != nullptr && id == *stopAtEndOfSongPtr;}// run stops on song end of this track
 };// class SequencerKernel 
 
 
 struct SeqCPbuffer {
 	float cvCPbuffer[SequencerKernel::MAX_STEPS];// copy paste buffer for CVs
-	StepAttributes attribCPbuffer[SequencerKernel::MAX_STEPS];
+	SeqStepAttributes attribCPbuffer;
 	SeqAttributes seqAttribCPbuffer;
 	int storedLength;// number of steps that contain actual cp data
 	
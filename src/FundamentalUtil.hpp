@@ -9,19 +9,26 @@
 
 #include "rack.hpp"
 #include "ImpromptuModular.hpp"
+#include "RandomStream.hpp"
 
 
-extern float sawTable[2048];// see end of file
-extern float triTable[2048];// see end of file
+// From Fundamental VCF
+// T is float for a single filter, or simd::float_4 for four independent filters (one per lane)
 
+// Pade approximant of tanh, clamped where it reaches +-1
+template <typename T>
+inline T clipTanh(T x) {
+	x = clamp(x, -3.f, 3.f);
+	return x * (27.f + x * x) / (27.f + 9.f * x * x);
+}
 
-// From Fundamental VCF
+template <typename T>
 struct LadderFilter {
-	float omega0;
-	float resonance = 1.0f;
-	float state[4];
-	float lowpass = 0.0f;
-	float highpass = 0.0f;
+	T omega0;
+	T resonance = 1.0f;
+	T state[4];
+	T lowpass = 0.0f;
+	T highpass = 0.0f;
 	
 	LadderFilter() {
 		reset();
@@ -32,62 +39,79 @@ struct LadderFilter {
 			state[i] = 0.f;
 		}
 	}
-	void setCutoff(float cutoff) {
+	void setCutoff(T cutoff) {
 		omega0 = 2.f*float(M_PI) * cutoff;
 	}
-	void process(float input, float dt);
+	void process(T input, T dt) {
+		dsp::stepRK4(T(0.f), dt, state, 4, [&](T t, const T x[], T dxdt[]) {
+			T inputc = clipTanh(input - resonance * x[3]);
+			T yc0 = clipTanh(x[0]);
+			T yc1 = clipTanh(x[1]);
+			T yc2 = clipTanh(x[2]);
+			T yc3 = clipTanh(x[3]);
+
+			dxdt[0] = omega0 * (inputc - yc0);
+			dxdt[1] = omega0 * (yc0 - yc1);
+			dxdt[2] = omega0 * (yc1 - yc2);
+			dxdt[3] = omega0 * (yc2 - yc3);
+		});
+
+		lowpass = state[3];
+		// TODO This is incorrect when `resonance > 0`. Is the math wrong?
+		highpass = clipTanh((input - resonance*state[3]) - 4.f * state[0] + 6.f*state[1] - 4.f*state[2] + state[3]);
+	}
 };
 
 
 // From Fundamental VCO.cpp
-//template <int OVERSAMPLE, int QUALITY>
-static const int OVERSAMPLE = 8;
-static const int QUALITY = 8;
+// Four oscillators, one per simd lane, band-limited with minBLEP (no oversampling). Only the waveforms
+// whose ...Enabled flag is set are computed, the others keep their last value
 struct VoltageControlledOscillator {
 	bool analog = false;
 	bool soft = false;
-	float lastSyncValue = 0.0f;
-	float phase = 0.0f;
-	float freq;
-	float pw = 0.5f;
-	float pitch;
 	bool syncEnabled = false;
-	bool syncDirection = false;
-
-	dsp::Decimator<OVERSAMPLE, QUALITY> sinDecimator;
-	dsp::Decimator<OVERSAMPLE, QUALITY> triDecimator;
-	dsp::Decimator<OVERSAMPLE, QUALITY> sawDecimator;
-	dsp::Decimator<OVERSAMPLE, QUALITY> sqrDecimator;
-	dsp::RCFilter sqrFilter;
+	bool sinEnabled = true;
+	bool triEnabled = true;
+	bool sawEnabled = true;
+	bool sqrEnabled = true;
+	int channels = 4;// number of lanes in use, discontinuities are only inserted for those
+	simd::float_4 lastSyncValue = 0.0f;
+	simd::float_4 phase = 0.0f;
+	simd::float_4 freq = 0.0f;
+	simd::float_4 lastPitch = -1000.0f;// freq is only recomputed when the pitch changes
+	simd::float_4 pw = 0.5f;
+	simd::float_4 syncDirection = 1.0f;
+
+	dsp::MinBlepGenerator<16, 16, simd::float_4> sinMinBlep;
+	dsp::MinBlepGenerator<16, 16, simd::float_4> triMinBlep;
+	dsp::MinBlepGenerator<16, 16, simd::float_4> sawMinBlep;
+	dsp::MinBlepGenerator<16, 16, simd::float_4> sqrMinBlep;
+	dsp::TRCFilter<simd::float_4> sqrFilter;
 
 	// For analog detuning effect
-	float pitchSlew = 0.0f;
+	RandomStream* rng = nullptr;// owners without their own stream leave it at nullptr and use the global generator
+	simd::float_4 pitchSlew = 0.0f;
 	int pitchSlewIndex = 0;
 
-	float sinBuffer[OVERSAMPLE] = {};
-	float triBuffer[OVERSAMPLE] = {};
-	float sawBuffer[OVERSAMPLE] = {};
-	float sqrBuffer[OVERSAMPLE] = {};
+	simd::float_4 sinValue = 0.0f;
+	simd::float_4 triValue = 0.0f;
+	simd::float_4 sawValue = 0.0f;
+	simd::float_4 sqrValue = 0.0f;
 
-	void setPitch(float pitchKnob, float pitchCv);
-	void setPulseWidth(float pulseWidth);
-	void process(float deltaTime, float syncValue);
+	void setPitch(float pitchKnob, simd::float_4 pitchCv);
+	void setPulseWidth(simd::float_4 pulseWidth);
+	void process(float deltaTime, simd::float_4 syncValue);
 
-	float sin() {
-		return sinDecimator.process(sinBuffer);
-	}
-	float tri() {
-		return triDecimator.process(triBuffer);
-	}
-	float saw() {
-		return sawDecimator.process(sawBuffer);
-	}
-	float sqr() {
-		return sqrDecimator.process(sqrBuffer);
-	}
-	float light() {
-		return std::sin(2*float(M_PI) * phase);
+	// Naive waveforms, as a function of phase
+	simd::float_4 sin(simd::float_4 phase);
+	simd::float_4 tri(simd::float_4 phase);
+	simd::float_4 saw(simd::float_4 phase);
+	simd::float_4 sqr(simd::float_4 phase) {
+		return simd::ifelse(phase < pw, 1.0f, -1.0f);
 	}
+	
+	private:
+	void insertDiscontinuities(dsp::MinBlepGenerator<16, 16, simd::float_4>* minBlep, int laneMask, simd::float_4 crossing, simd::float_4 jump);
 };
 
 
@@ -0,0 +1,61 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Advanced gate type patterns shared by the sequencers, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+
+#include "GatePatterns.hpp"
+
+
+static const uint32_t gateTypeMasks24[GATETYPE_TRIG + 1] =
+{0x00003F, 0x0F0F0F, 0x000FFF, 0x0F0F00, 0x03FFFF, 0xFFFFFF, 0x00000F, 0x03F03F, 0x000F00, 0x03F000, 0x0F0000, 0};
+//	  25%		TRI		  50%		T23		  75%		FUL		  TR1 		DUO		  TR2 	     D2		  TR3  TRIG
+
+
+static const int euclidHitsSubdivs[NUM_GATE_TYPES - GATETYPE_RT4][2] = {{4, 4}, {3, 8}, {5, 8}, {5, 16}};
+//	  RT4		E38		E58		E516
+
+
+static bool referenceSlot(int gateType, int slot) {// slot in [0 : 95]
+	if (isExtGateType(gateType)) {// hits spread evenly over the subdivisions of the step, each on for half of its subdivision
+		int hits = euclidHitsSubdivs[gateType - GATETYPE_RT4][0];
+		int subdivisions = euclidHitsSubdivs[gateType - GATETYPE_RT4][1];
+		int subSlots = 96 / subdivisions;
+		int subn = slot / subSlots;
+		return ((subn * hits) % subdivisions) < hits && (slot % subSlots) < (subSlots >> 1);
+	}
+	return ((gateTypeMasks24[gateType] >> (slot >> 2)) & 0x1) != 0;// 24 slot masks, each slot is four of the 96
+}
+
+
+template <int RESOLUTION>
+GatePatternTable<RESOLUTION>::GatePatternTable() {
+	for (int gateType = 0; gateType < NUM_GATE_TYPES; gateType++) {
+		patterns[gateType][0].bits[0] = patterns[gateType][0].bits[1] = 0;// unused
+		playable[gateType][0] = false;
+		for (int pps = 1; pps <= RESOLUTION; pps++) {
+			GatePattern* pattern = &patterns[gateType][pps];
+			pattern->bits[0] = pattern->bits[1] = 0;
+			int risingEdges = 0;
+			bool lastHigh = false;
+			for (int pulse = 0; pulse < pps; pulse++) {
+				int slot = pulse * (RESOLUTION / pps) * (96 / RESOLUTION);
+				bool high = referenceSlot(gateType, slot);
+				if (high) {
+					pattern->bits[pulse >> 6] |= ((uint64_t)0x1) << (pulse & 0x3F);
+					if (!lastHigh)
+						risingEdges++;
+				}
+				lastHigh = high;
+			}
+			// a hit merged with its neighbour, or a last hit that runs into the next step, would be lost
+			playable[gateType][pps] = !isExtGateType(gateType) ||
+				(risingEdges == euclidHitsSubdivs[gateType - GATETYPE_RT4][0] && !lastHigh);
+		}
+	}
+}
+
+
+const GatePatternTable<24> gatePatterns24;
+const GatePatternTable<96> gatePatterns96;
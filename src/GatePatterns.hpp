@@ -0,0 +1,69 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Advanced gate type patterns shared by the sequencers, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+
+// The advanced gate types are patterns over a step of 96 slots, and pulse n of a step with pulsesPerStep pulses
+// plays slot n * (RESOLUTION / pulsesPerStep) of the pattern, where RESOLUTION is the number of slots the
+// sequencer divides a step into (24 for PhraseSeq16/32, SemiModularSynth and GateSeq64, 96 for Foundry). A
+// GatePatternTable holds the resulting on/off bits of every gate type for every pulsesPerStep, computed once, so
+// that the gate of a pulse is a table read instead of shifts and divisions, and so that new gate types (ratchets,
+// Euclidean subdivisions) cost the same as the original ones.
+//
+// The ids are those stored in the step attributes (4 bits). The trigger gate type has no pattern, since it is a
+// fixed length trigger on the first pulse of the step that the sequencers produce themselves.
+//
+// The ratchet and Euclidean gate types have no gate key of their own: they are selected by alt-clicking the first
+// four gate keys (C, C#, D, D#), and are shown dimmed on those keys. They can only be selected at the pulses per step
+// that give each of their hits a gate of its own.
+
+enum GateTypeIds {
+	GATETYPE_25, GATETYPE_TRI, GATETYPE_50, GATETYPE_T23, GATETYPE_75, GATETYPE_FUL,
+	GATETYPE_TR1, GATETYPE_DUO, GATETYPE_TR2, GATETYPE_D2, GATETYPE_TR3, GATETYPE_TRIG,
+	GATETYPE_RT4, GATETYPE_E38, GATETYPE_E58, GATETYPE_E516,// ratchet of 4, Euclidean 3 in 8, 5 in 8 and 5 in 16
+	NUM_GATE_TYPES
+};
+
+inline bool isExtGateType(int gateType) {return gateType >= GATETYPE_RT4;}
+inline int gateTypeToKeyIndex(int gateType) {return isExtGateType(gateType) ? gateType - GATETYPE_RT4 : gateType;}
+
+
+struct GatePattern {
+	uint64_t bits[2];// bit n is the gate of pulse n of the step
+
+	bool isHigh(int pulse) const {return ((bits[(pulse >> 6) & 0x1] >> (pulse & 0x3F)) & (uint64_t)0x1) != 0;}
+};
+
+
+template <int RESOLUTION>
+class GatePatternTable {
+	static_assert(96 % RESOLUTION == 0, "a slot of RESOLUTION must be whole slots of the 96 slot patterns");
+
+	GatePattern patterns[NUM_GATE_TYPES][RESOLUTION + 1];// indexed by [gateType][pulsesPerStep]
+	bool playable[NUM_GATE_TYPES][RESOLUTION + 1];// ratchet and Euclidean gate types: one gate per hit, always true for the others
+
+
+	public:
+
+	GatePatternTable();
+
+	// gateType in [0 : NUM_GATE_TYPES - 1], pulsesPerStep in [1 : RESOLUTION]
+	const GatePattern& getPattern(int gateType, int pulsesPerStep) const {return patterns[gateType][pulsesPerStep];}
+	bool isHigh(int gateType, int pulsesPerStep, int pulse) const {return patterns[gateType][pulsesPerStep].isHigh(pulse);}
+
+	// gate type of an alt-clicked gate key, -1 when the key has none or it is not playable at pulsesPerStep
+	int keyIndexToExtGateType(int keyIndex, int pulsesPerStep) const {
+		int gateType = GATETYPE_RT4 + keyIndex;
+		return (keyIndex >= 0 && gateType < NUM_GATE_TYPES && playable[gateType][pulsesPerStep]) ? gateType : -1;
+	}
+};
+
+
+extern const GatePatternTable<24> gatePatterns24;
+extern const GatePatternTable<96> gatePatterns96;
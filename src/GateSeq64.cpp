@@ -13,9 +13,11 @@
 
 
 #include "GateSeq64Util.hpp"
+#include "PackedData.hpp"
+#include "JsonHandoff.hpp"
 
 
-struct GateSeq64 : Module {
+struct GateSeq64 : Module, GateSeq64Data {// steps and song are in GateSeq64Data
 	enum ParamIds {
 		ENUMS(STEP_PARAMS, 64),
 		MODES_PARAM,
@@ -60,30 +62,26 @@ struct GateSeq64 : Module {
 
 	// Constants
 	enum DisplayStateIds {DISP_GATE, DISP_LENGTH, DISP_MODES};
-	static const int MAX_SEQS = 32;
+	static const uint8_t packedVersion = 1;// format of the packed "stepData" blob
 	static const int blinkNumInit = 15;// init number of blink cycles for cursor
 	static constexpr float editingPhraseSongRunningTime = 4.0f;// seconds
 
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	bool packedPatchData = false;// steps saved as one packed blob instead of json arrays
 	
 	// Need to save, with reset
 	bool autoseq;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-D5#, 2 is TrigIncr
-	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
 	bool running;
-	int runModeSong;
 	int stepIndexEdit;
 	int phraseIndexEdit;	
 	int sequence;
-	int phrases;// 1 to 64
-	StepAttributesGS attributes[MAX_SEQS][64];
-	SeqAttributesGS sequences[MAX_SEQS];
-	int phrase[64];// This is the song (series of phases; a phrase is a patten number)
 	bool resetOnRun;
 	bool stopAtEndOfSong;
 	bool lock;
+	ClockBusSubscriber clockBusSubscriber;// unpatched run, clock and reset inputs can follow the clock master
 
 	// No need to save, with reset
 	int displayState;
@@ -110,8 +108,8 @@ struct GateSeq64 : Module {
 	int gateCode[4];
 
 	// No need to save, no reset
-	int stepConfigSync = 0;// 0 means no sync requested, 1 means synchronous read of lengths requested
 	RefreshCounter refresh;
+	JsonHandoff<GateSeq64Data> jsonHandoff;// steps and song loaded by dataFromJson(), adopted by process()
 	float resetLight = 0.0f;
 	int sequenceKnob = 0;
 	Trigger modesTrigger;
@@ -130,7 +128,6 @@ struct GateSeq64 : Module {
 	Trigger seqCVTrigger;
 	dsp::BooleanTrigger editingSequenceTrigger;
 	HoldDetect modeHoldDetect;
-	SeqAttributesGS seqAttribBuffer[MAX_SEQS];// buffer for dataFromJson for thread safety
 	int lastStep = 0;// for mouse painting
 	bool lastValue = false;// for mouse painting
 
@@ -206,9 +203,6 @@ struct GateSeq64 : Module {
 			configOutput(GATE_OUTPUTS + i, string::f("Track %i gate", i + 1));
 		}
 
-		for (int i = 0; i < MAX_SEQS; i++) {
-			seqAttribBuffer[i].init(16, MODE_FWD);
-		}
 		onReset();
 		
 		loadThemeAndContrastFromDefault(&panelTheme, &panelContrast);
@@ -216,30 +210,20 @@ struct GateSeq64 : Module {
 
 	
 	void onReset() override final {
+		clockBusSubscriber.init();
 		autoseq = false;
 		seqCVmethod = 0;
-		pulsesPerStep = 1;
 		running = true;
-		runModeSong = MODE_FWD;
 		stepIndexEdit = 0;
 		phraseIndexEdit = 0;
 		sequence = 0;
-		phrases = 4;
-		for (int i = 0; i < MAX_SEQS; i++) {
-			for (int s = 0; s < 64; s++) {
-				attributes[i][s].init();
-			}
-			sequences[i].init(16 * getStepConfig(), MODE_FWD);
-		}
-		for (int i = 0; i < 64; i++) {
-			phrase[i] = 0;
-		}
+		GateSeq64Data::init(16 * getStepConfig());
 		resetOnRun = false;
 		stopAtEndOfSong = false;
 		lock = false;
-		resetNonJson(false);
+		resetNonJson();
 	}
-	void resetNonJson(bool delayed) {// delay thread sensitive parts (i.e. schedule them so that process() will do them)
+	void resetNonJson() {
 		displayState = DISP_GATE;
 		seqAttribCPbuffer.init(16, MODE_FWD);
 		for (int i = 0; i < 64; i++) {
@@ -256,13 +240,8 @@ struct GateSeq64 : Module {
 		blinkCount = 0l;
 		blinkNum = blinkNumInit;
 		editingPhraseSongRunning = 0l;
-		if (delayed) {
-			stepConfigSync = 1;// signal a sync from dataFromJson so that step will get lengths from seqAttribBuffer			
-		}
-		else {
-			stepConfig = getStepConfig();
-			initRun();
-		}
+		stepConfig = getStepConfig();
+		initRun();
 	}
 	void initRun() {// run button activated, or run edge in run input jack, or stepConfig switch changed, or fromJson()
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
@@ -293,12 +272,19 @@ struct GateSeq64 : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// steps and song are those loaded by dataFromJson() when process() has not adopted them yet
+		GateSeq64Data* pendingData = jsonHandoff.peekPending();
+		GateSeq64Data* sd = (pendingData != nullptr ? pendingData : this);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
 		// panelContrast
 		json_object_set_new(rootJ, "panelContrast", json_real(panelContrast));
 
+		// packedPatchData
+		json_object_set_new(rootJ, "packedPatchData", json_boolean(packedPatchData));
+
 		// autoseq
 		json_object_set_new(rootJ, "autoseq", json_boolean(autoseq));
 		
@@ -306,13 +292,13 @@ struct GateSeq64 : Module {
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
 
 		// pulsesPerStep
-		json_object_set_new(rootJ, "pulsesPerStep", json_integer(pulsesPerStep));
+		json_object_set_new(rootJ, "pulsesPerStep", json_integer(sd->pulsesPerStep));
 
 		// running
 		json_object_set_new(rootJ, "running", json_boolean(running));
 		
 		// runModeSong
-		json_object_set_new(rootJ, "runModeSong3", json_integer(runModeSong));
+		json_object_set_new(rootJ, "runModeSong3", json_integer(sd->runModeSong));
 
 		// stepIndexEdit
 		json_object_set_new(rootJ, "stepIndexEdit", json_integer(stepIndexEdit));
@@ -324,26 +310,37 @@ struct GateSeq64 : Module {
 		json_object_set_new(rootJ, "sequence", json_integer(sequence));
 
 		// phrases
-		json_object_set_new(rootJ, "phrases", json_integer(phrases));
+		json_object_set_new(rootJ, "phrases", json_integer(sd->phrases));
 
 		// attributes
-		json_t *attributesJ = json_array();
-		for (int i = 0; i < MAX_SEQS; i++)
-			for (int s = 0; s < 64; s++) {
-				json_array_insert_new(attributesJ, s + (i * 64), json_integer(attributes[i][s].getAttribute()));
-			}
-		json_object_set_new(rootJ, "attributes2", attributesJ);// "2" appended so no break patches
+		if (packedPatchData) {
+			PackedWriter writer;
+			writer.bytes.reserve(MAX_SEQS * 64 * 2);
+			for (int i = 0; i < MAX_SEQS; i++)
+				for (int s = 0; s < 64; s++) {
+					writer.u16(sd->attributes[i][s].getAttribute());
+				}
+			packedToJson(rootJ, "stepData", packedVersion, writer);
+		}
+		else {
+			json_t *attributesJ = json_array();
+			for (int i = 0; i < MAX_SEQS; i++)
+				for (int s = 0; s < 64; s++) {
+					json_array_insert_new(attributesJ, s + (i * 64), json_integer(sd->attributes[i][s].getAttribute()));
+				}
+			json_object_set_new(rootJ, "attributes2", attributesJ);// "2" appended so no break patches
+		}
 		
 		// sequences
 		json_t *sequencesJ = json_array();
 		for (int i = 0; i < MAX_SEQS; i++)
-			json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
+			json_array_insert_new(sequencesJ, i, json_integer(sd->sequences[i].getSeqAttrib()));
 		json_object_set_new(rootJ, "sequences", sequencesJ);
 
 		// phrase 
 		json_t *phraseJ = json_array();
 		for (int i = 0; i < 64; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
+			json_array_insert_new(phraseJ, i, json_integer(sd->phrase[i]));
 		json_object_set_new(rootJ, "phrase2", phraseJ);// "2" appended so no break patches
 
 		// resetOnRun
@@ -355,11 +352,21 @@ struct GateSeq64 : Module {
 		// lock
 		json_object_set_new(rootJ, "lock", json_boolean(lock));
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
+		// clockBusSource
+		clockBusSubscriber.dataToJson(rootJ);
+
 		return rootJ;
 	}
 
 	
 	void dataFromJson(json_t *rootJ) override {
+		// steps and song are parsed into the handoff buffer, process() adopts them when they are all there
+		GateSeq64Data* sd = jsonHandoff.beginWrite();
+		sd->init(16 * getStepConfig());
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -370,11 +377,19 @@ struct GateSeq64 : Module {
 		if (panelContrastJ)
 			panelContrast = json_number_value(panelContrastJ);
 
+		// packedPatchData
+		json_t *packedPatchDataJ = json_object_get(rootJ, "packedPatchData");
+		if (packedPatchDataJ)
+			packedPatchData = json_is_true(packedPatchDataJ);
+
 		// autoseq
 		json_t *autoseqJ = json_object_get(rootJ, "autoseq");
 		if (autoseqJ)
 			autoseq = json_is_true(autoseqJ);
 
+		// clockBusSource
+		clockBusSubscriber.dataFromJson(rootJ);
+
 		// seqCVmethod
 		json_t *seqCVmethodJ = json_object_get(rootJ, "seqCVmethod");
 		if (seqCVmethodJ)
@@ -383,7 +398,7 @@ struct GateSeq64 : Module {
 		// pulsesPerStep
 		json_t *pulsesPerStepJ = json_object_get(rootJ, "pulsesPerStep");
 		if (pulsesPerStepJ)
-			pulsesPerStep = json_integer_value(pulsesPerStepJ);
+			sd->pulsesPerStep = json_integer_value(pulsesPerStepJ);
 
 		// running
 		json_t *runningJ = json_object_get(rootJ, "running");
@@ -393,13 +408,13 @@ struct GateSeq64 : Module {
 		// runModeSong
 		json_t *runModeSongJ = json_object_get(rootJ, "runModeSong3");
 		if (runModeSongJ)
-			runModeSong = json_integer_value(runModeSongJ);
+			sd->runModeSong = json_integer_value(runModeSongJ);
 		else {// legacy
 			runModeSongJ = json_object_get(rootJ, "runModeSong");
 			if (runModeSongJ) {
-				runModeSong = json_integer_value(runModeSongJ);
-				if (runModeSong >= MODE_PEN)// this mode was not present in original version
-					runModeSong++;
+				sd->runModeSong = json_integer_value(runModeSongJ);
+				if (sd->runModeSong >= MODE_PEN)// this mode was not present in original version
+					sd->runModeSong++;
 			}
 		}
 		
@@ -421,16 +436,24 @@ struct GateSeq64 : Module {
 		// phrases
 		json_t *phrasesJ = json_object_get(rootJ, "phrases");
 		if (phrasesJ)
-			phrases = json_integer_value(phrasesJ);
+			sd->phrases = json_integer_value(phrasesJ);
 	
-		// attributes
+		// attributes (legacy arrays when there is no valid packed blob)
+		std::vector<uint8_t> payload;
 		json_t *attributesJ = json_object_get(rootJ, "attributes2");
-		if (attributesJ) {
+		if (packedFromJson(rootJ, "stepData", packedVersion, &payload) && payload.size() == MAX_SEQS * 64 * 2) {
+			PackedReader reader(payload);
+			for (int i = 0; i < MAX_SEQS; i++)
+				for (int s = 0; s < 64; s++) {
+					sd->attributes[i][s].setAttribute(reader.u16());
+				}
+		}
+		else if (attributesJ) {
 			for (int i = 0; i < MAX_SEQS; i++)
 				for (int s = 0; s < 64; s++) {
 					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 64));
 					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
+						sd->attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
 				}
 		}
 		else {
@@ -440,12 +463,12 @@ struct GateSeq64 : Module {
 					for (int s = 0; s < 64; s++) {
 						json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 64));
 						if (attributesArrayJ)
-							attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
+							sd->attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
 					}
 				}
 				for (int i = 16; i < MAX_SEQS; i++) {
 					for (int s = 0; s < 64; s++)
-						attributes[i][s].init();
+						sd->attributes[i][s].init();
 				}
 			}
 		}
@@ -457,7 +480,7 @@ struct GateSeq64 : Module {
 			{
 				json_t *sequencesArrayJ = json_array_get(sequencesJ, i);
 				if (sequencesArrayJ)
-					seqAttribBuffer[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
+					sd->sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
 			}			
 		}
 		else {// legacy
@@ -501,9 +524,9 @@ struct GateSeq64 : Module {
 			
 			// now write into new object
 			for (int i = 0; i < 16; i++) 
-					seqAttribBuffer[i].init(lengths[i], runModeSeq[i]);
+					sd->sequences[i].init(lengths[i], runModeSeq[i]);
 			for (int i = 16; i < MAX_SEQS; i++)
-					seqAttribBuffer[i].init(16, MODE_FWD);
+					sd->sequences[i].init(16, MODE_FWD);
 		}
 		
 		
@@ -514,7 +537,7 @@ struct GateSeq64 : Module {
 			{
 				json_t *phraseArrayJ = json_array_get(phraseJ, i);
 				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
+					sd->phrase[i] = json_integer_value(phraseArrayJ);
 			}
 		}
 		else {// legacy
@@ -524,10 +547,10 @@ struct GateSeq64 : Module {
 				{
 					json_t *phraseArrayJ = json_array_get(phraseJ, i);
 					if (phraseArrayJ)
-						phrase[i] = json_integer_value(phraseArrayJ);
+						sd->phrase[i] = json_integer_value(phraseArrayJ);
 				}
 				for (int i = 16; i < 64; i++)
-					phrase[i] = 0;
+					sd->phrase[i] = 0;
 			}
 		}
 		
@@ -546,7 +569,7 @@ struct GateSeq64 : Module {
 		if (lockJ)
 			lock = json_is_true(lockJ);
 		
-		resetNonJson(true);
+		jsonHandoff.endWrite();// process() adopts the steps and song, then calls resetNonJson()
 	}
 
 	
@@ -558,14 +581,22 @@ struct GateSeq64 : Module {
 		float sampleRate = args.sampleRate;
 		
 
+		// Steps and song loaded by dataFromJson()
+		if (jsonHandoff.adopt(this)) {
+			resetNonJson();
+		}
+
 		
 		//********** Buttons, knobs, switches and inputs **********
+		
+		// Clock bus, read by the run, clock and reset inputs
+		clockBusSubscriber.update(id, args.frame);
 
 		// Edit mode		
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
 		
 		// Run state button
-		if (runningTrigger.process(params[RUN_PARAM].getValue() + inputs[RUNCV_INPUT].getVoltage())) {// no input refresh here, don't want to introduce startup skew
+		if (runningTrigger.process(params[RUN_PARAM].getValue() + clockBusSubscriber.getRun(inputs[RUNCV_INPUT]))) {// no input refresh here, don't want to introduce startup skew
 			running = !running;
 			if (running) {
 				if (resetOnRun) {
@@ -583,18 +614,11 @@ struct GateSeq64 : Module {
 				blinkNum = blinkNumInit;
 
 			// Config switch
-			// switch may move in the pre-fromJson, but no problem, it will trigger the init lenght below, but then when
-			//    the lengths are loaded and we see the stepConfigSync request later,
-			//    they will get overwritten anyways. Is simultaneous, also ok.
+			// the switch is loaded before dataFromJson(), the lengths it loaded are kept since resetNonJson() reads the
+			//    switch when the steps and song are adopted
 			int oldStepConfig = stepConfig;
 			stepConfig = getStepConfig();
-			if (stepConfigSync != 0) {// sync from dataFromJson, so read lengths from seqAttribBuffer
-				for (int i = 0; i < MAX_SEQS; i++)
-					sequences[i].setSeqAttrib(seqAttribBuffer[i].getSeqAttrib());
-				initRun();	
-				stepConfigSync = 0;
-			}
-			else if (stepConfig != oldStepConfig) {// switch moved, so init lengths
+			if (stepConfig != oldStepConfig) {// switch moved, so init lengths
 				for (int i = 0; i < MAX_SEQS; i++)
 					sequences[i].setLength(16 * stepConfig);
 				initRun();
@@ -943,7 +967,7 @@ struct GateSeq64 : Module {
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
-			if (clockTrigger.process(inputs[CLOCK_INPUT].getVoltage())) {
+			if (clockTrigger.process(clockBusSubscriber.getClock(inputs[CLOCK_INPUT]))) {
 				ppqnCount++;
 				if (ppqnCount >= pulsesPerStep)
 					ppqnCount = 0;
@@ -986,7 +1010,7 @@ struct GateSeq64 : Module {
 		}	
 		
 		// Reset
-		if (resetTrigger.process(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue())) {
+		if (resetTrigger.process(clockBusSubscriber.getReset(inputs[RESET_INPUT]) + params[RESET_PARAM].getValue())) {
 			initRun();// must be before SEQCV_INPUT below
 			resetLight = 1.0f;
 			displayState = DISP_GATE;
@@ -1384,9 +1408,13 @@ struct GateSeq64Widget : ModuleWidget {
 		}));			
 		
 		menu->addChild(createBoolPtrMenuItem("AutoSeq when writing via CV inputs", "", &module->autoseq));
+
+		createClockBusMenu(menu, &module->clockBusSubscriber);
 		
 		menu->addChild(createBoolPtrMenuItem("Lock steps, gates and gate p", "", &module->lock));
 
+		menu->addChild(createBoolPtrMenuItem("Compact patch data", "", &module->packedPatchData));
+
 		menu->addChild(new MenuSeparator());
 		menu->addChild(createMenuLabel("Actions"));
 		
@@ -64,6 +64,36 @@ class SeqAttributesGS {
 };// class SeqAttributesGS
 
 
+// Steps and song of GateSeq64, i.e. what dataFromJson() loads
+struct GateSeq64Data {
+	static const int MAX_SEQS = 32;
+
+	// Need to save, with reset
+	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
+	int runModeSong;
+	int phrases;// 1 to 64
+	StepAttributesGS attributes[MAX_SEQS][64];
+	SeqAttributesGS sequences[MAX_SEQS];
+	int phrase[64];// This is the song (series of phases; a phrase is a patten number)
+
+
+	void init(int length) {
+		pulsesPerStep = 1;
+		runModeSong = MODE_FWD;
+		phrases = 4;
+		for (int i = 0; i < MAX_SEQS; i++) {
+			for (int s = 0; s < 64; s++) {
+				attributes[i][s].init();
+			}
+			sequences[i].init(length, MODE_FWD);
+		}
+		for (int i = 0; i < 64; i++) {
+			phrase[i] = 0;
+		}
+	}
+};
+
+
 //*****************************************************************************
 
 /*
@@ -153,12 +183,12 @@ inline bool calcGate(int gateCode, Trigger clockTrigger) {
 }		
 
 
-//										1/4		DUO			D2			TR1		TR2		TR3 		TR23	   TRI
-const uint32_t advGateHitMaskGS[8] = {0x00003F, 0x03F03F, 0x03F000, 0x00000F, 0x000F00, 0x0F0000, 0x0F0F00, 0x0F0F0F};
+const int gateModeToGateTypeGS[8] = {// 1/4, DUO, D2, TR1, TR2, TR3, TR23, TRI
+	GATETYPE_25, GATETYPE_DUO, GATETYPE_D2, GATETYPE_TR1, GATETYPE_TR2, GATETYPE_TR3, GATETYPE_T23, GATETYPE_TRI
+};
 
-int getAdvGateGS(int ppqnCount, int pulsesPerStep, int gateMode) { 
-	uint32_t shiftAmt = ppqnCount * (24 / pulsesPerStep);
-	return (int)((advGateHitMaskGS[gateMode] >> shiftAmt) & (uint32_t)0x1);
+inline int getAdvGateGS(int ppqnCount, int pulsesPerStep, int gateMode) { 
+	return gatePatterns24.isHigh(gateModeToGateTypeGS[gateMode], pulsesPerStep, ppqnCount) ? 1 : 0;
 }	
 
 
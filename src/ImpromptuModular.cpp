@@ -56,6 +56,7 @@ void init(Plugin *p) {
 // General objects
 
 ClockMaster clockMaster;  
+ClockBus clockBus;
 
 
 
@@ -221,4 +222,17 @@ void NormalizedFloat12Paste(float* float12) {
 			}
 		}	
 	}	
-}
\ No newline at end of file
+}
+
+void createClockBusMenu(ui::Menu* menu, ClockBusSubscriber* subscriber) {
+	static const std::string sourceNames[5] = {"Off", "Master clock", "Clock 1", "Clock 2", "Clock 3"};
+	menu->addChild(createSubmenuItem("Clock bus", sourceNames[subscriber->source + 1], [=](Menu* menu) {
+		menu->addChild(createMenuLabel("Unpatched clock, reset and run inputs follow the clock master"));
+		for (int i = -1; i < 4; i++) {
+			menu->addChild(createCheckMenuItem(sourceNames[i + 1], "",
+				[=]() {return subscriber->source == i;},
+				[=]() {subscriber->source = i;}
+			));
+		}
+	}));
+}
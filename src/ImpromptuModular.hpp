@@ -104,6 +104,90 @@ struct ClockMaster {// should not need to have mutex since only menu driven
 extern ClockMaster clockMaster;
 
 
+struct ClockBusFrame {
+	int64_t moduleId = -1;// publisher
+	int64_t frame = -1;// engine frame on which the voltages were output
+	float clocks[4];// master clock output, then clock outputs 1 to 3
+	float reset;
+	float run;
+	float bpm;// BPM CV of the master clock (0V = 120 BPM), even when the master follows an external clock
+};
+
+struct ClockBus {
+	// Outputs of the clock master (Clocked or Clkd), published on every sample so that subscribed modules can read them
+	//   on their unpatched clock, reset, run and BPM inputs instead of through cables, with no cable hops between them.
+	// The master publishes frame n into slot n % 2, and a subscriber reads slot (n - 1) % 2 on frame n: the latency is 
+	//   one sample from the master for every subscriber (as a direct cable from the master), and since the engine 
+	//   waits for all modules between frames, the slot being read is never the one being written, so no lock is 
+	//   needed and the result does not depend on the order or threads in which modules are processed.
+	ClockBusFrame slots[2];
+
+	void publish(int64_t _moduleId, int64_t _frame, Output* clockOutputs, float _reset, float _run, float _bpm) {
+		ClockBusFrame* slot = &slots[_frame & 0x1];
+		slot->moduleId = _moduleId;
+		slot->frame = _frame;
+		for (int i = 0; i < 4; i++) {
+			slot->clocks[i] = clockOutputs[i].getVoltage();
+		}
+		slot->reset = _reset;
+		slot->run = _run;
+		slot->bpm = _bpm;
+	}
+	bool read(int64_t readerId, int64_t _frame, ClockBusFrame* dest) {// false when no master published on the previous frame
+		const ClockBusFrame* slot = &slots[(_frame - 1) & 0x1];
+		if (slot->frame != _frame - 1 || slot->moduleId == readerId) {
+			return false;
+		}
+		*dest = *slot;
+		return true;
+	}
+};
+extern ClockBus clockBus;
+
+
+struct ClockBusSubscriber {
+	// Need to save
+	int source;// -1 when not subscribed, else the output of the master that is read as the clock (0 = master clock, 1 to 3 = clocks 1 to 3)
+	
+	// No need to save
+	bool valid = false;
+	ClockBusFrame busFrame;
+	
+	void init() {
+		source = -1;
+		valid = false;
+	}
+	
+	void update(int64_t moduleId, int64_t frame) {// once per sample, before the get methods
+		valid = (source >= 0) && clockBus.read(moduleId, frame, &busFrame);
+	}
+	bool follows(Input& input) {// true when the input reads the bus
+		return valid && !input.isConnected();
+	}
+	float getClock(Input& input) {
+		return follows(input) ? busFrame.clocks[source] : input.getVoltage();
+	}
+	float getReset(Input& input) {
+		return follows(input) ? busFrame.reset : input.getVoltage();
+	}
+	float getRun(Input& input) {
+		return follows(input) ? busFrame.run : input.getVoltage();
+	}
+	float getBpm(Input& input) {
+		return follows(input) ? busFrame.bpm : input.getVoltage();
+	}
+	
+	void dataToJson(json_t *rootJ) {
+		json_object_set_new(rootJ, "clockBusSource", json_integer(source));
+	}
+	void dataFromJson(json_t *rootJ) {
+		json_t *sourceJ = json_object_get(rootJ, "clockBusSource");
+		if (sourceJ)
+			source = clamp((int)json_integer_value(sourceJ), -1, 3);
+	}
+};
+
+
 struct VecPx : Vec {
 	// temporary method to avoid having to convert all px coordinates to mm; no use when making a new module (since mm is the standard)
 	static constexpr float scl = 5.08f / 15.0f;
@@ -167,6 +251,28 @@ struct Trigger {
 };	
 
 
+// Four poly channels at once, with the same thresholds and initial state as Trigger (lanes are simd masks)
+struct TriggerSimd {
+	simd::float_4 state = simd::float_4::mask();
+
+	void reset() {
+		state = simd::float_4::mask();
+	}
+	
+	bool isHigh(int lane) {
+		return (simd::movemask(state) & (1 << lane)) != 0;
+	}
+	
+	simd::float_4 process(simd::float_4 in, simd::float_4 active) {
+		// lanes not set in active are left untouched, returns the mask of the lanes that went LOW to HIGH
+		simd::float_4 rising = ~state & (in >= 1.0f) & active;
+		simd::float_4 falling = state & (in <= 0.1f) & active;
+		state = (state & ~falling) | rising;
+		return rising;
+	}	
+};	
+
+
 struct TriggerRiseFall {
 	bool state = false;
 
@@ -254,3 +360,4 @@ struct InstantiateExpanderItem : MenuItem {
 
 void NormalizedFloat12Copy(float* float12);
 void NormalizedFloat12Paste(float* float12);
+void createClockBusMenu(ui::Menu* menu, ClockBusSubscriber* subscriber);
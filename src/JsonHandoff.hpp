@@ -0,0 +1,99 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Lock-free handoff of patch data from dataFromJson() to process(), see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+
+// dataFromJson() runs on the UI thread (patch and preset loads, undo) while process() keeps running on the engine
+// thread, so a sequencer that parses its steps straight into the arrays that process() plays can be heard, or
+// crash, half way through a load. With a JsonHandoff, dataFromJson() parses into a second copy of the data and
+// publishes it, and process() adopts it on its next call with one copy, before it reads any step, then does the
+// resets that follow a load. The engine thread never waits: if the UI thread holds the buffer it just tries again
+// on the next sample. The UI thread only waits while an adopt copy is under way.
+//
+// Until it is adopted, the published data is what the module holds as far as the patch is concerned, so
+// dataToJson() must save it instead of the live data (see peekPending()).
+//
+// T must be copy-assignable without allocating (plain arrays and values).
+
+template <typename T>
+class JsonHandoff {
+	static const int EMPTY = 0;// nothing published, or already adopted
+	static const int PENDING = 1;// published, not adopted yet
+	static const int BUSY = 2;// the buffer is being written, peeked or adopted
+
+	std::atomic<int> state;
+	T data;
+
+
+	int acquire() {// UI thread, returns the state the buffer was in
+		while (true) {
+			int expected = state.load(std::memory_order_relaxed);
+			if (expected != BUSY && state.compare_exchange_weak(expected, BUSY, std::memory_order_acquire)) {
+				return expected;
+			}
+			std::this_thread::yield();// process() is adopting, that's one copy of T
+		}
+	}
+
+
+	public:
+
+	JsonHandoff() : state(EMPTY) {}
+
+
+	// UI thread
+
+	T* beginWrite() {// buffer to parse into, its contents are those of the last write
+		acquire();
+		return &data;
+	}
+	void endWrite() {
+		state.store(PENDING, std::memory_order_release);
+	}
+
+	T* peekPending() {// published data that process() has not adopted yet, nullptr if none; call endPeek() when done
+		int previous = acquire();
+		if (previous != PENDING) {
+			state.store(previous, std::memory_order_release);
+			return nullptr;
+		}
+		return &data;
+	}
+	void endPeek() {// only when peekPending() did not return nullptr
+		state.store(PENDING, std::memory_order_release);
+	}
+
+
+	// Engine thread
+
+	const T* beginAdopt() {// published data to copy from, nullptr if none; call endAdopt() when done
+		if (state.load(std::memory_order_relaxed) != PENDING) {
+			return nullptr;
+		}
+		int expected = PENDING;
+		if (!state.compare_exchange_strong(expected, BUSY, std::memory_order_acquire)) {
+			return nullptr;// UI thread is rewriting or peeking it, try again next time
+		}
+		return &data;
+	}
+	void endAdopt() {// only when beginAdopt() did not return nullptr
+		state.store(EMPTY, std::memory_order_release);
+	}
+
+	bool adopt(T* dest) {// copies the published data into dest and returns true, if any
+		const T* src = beginAdopt();
+		if (src == nullptr) {
+			return false;
+		}
+		*dest = *src;
+		endAdopt();
+		return true;
+	}
+};
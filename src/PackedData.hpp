@@ -0,0 +1,147 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Packed binary step data for patch files, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include "rack.hpp"
+
+using namespace rack;
+
+
+// Large step arrays (cv and attributes) are written as one base64 string instead of one json value per step, which
+// makes autosave and patch loading much faster on big sequencers. Blob layout, all values little-endian:
+//   [version u8][payload size u32][payload][checksum u32]
+// where the checksum is FNV-1a over everything before it. A blob that is missing, of another version or that fails
+// the checksum is ignored by packedFromJson(), and the module then reads its legacy json arrays instead.
+
+struct PackedWriter {
+	std::vector<uint8_t> bytes;
+
+	void u8(uint8_t v) {
+		bytes.push_back(v);
+	}
+	void u16(uint16_t v) {
+		bytes.push_back((uint8_t)v);
+		bytes.push_back((uint8_t)(v >> 8));
+	}
+	void u32(uint32_t v) {
+		for (int i = 0; i < 4; i++) {
+			bytes.push_back((uint8_t)(v >> (i * 8)));
+		}
+	}
+	void f32(float v) {
+		uint32_t bits;
+		std::memcpy(&bits, &v, 4);
+		u32(bits);
+	}
+};
+
+
+struct PackedReader {
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+	bool ok = true;// false as soon as a read goes past the end, reads then return 0
+
+	PackedReader(const std::vector<uint8_t>& payload) {
+		data = payload.data();
+		size = payload.size();
+	}
+
+	uint8_t u8() {
+		if (pos + 1 > size) {
+			ok = false;
+			return 0;
+		}
+		return data[pos++];
+	}
+	uint16_t u16() {
+		if (pos + 2 > size) {
+			ok = false;
+			return 0;
+		}
+		uint16_t v = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+		pos += 2;
+		return v;
+	}
+	uint32_t u32() {
+		if (pos + 4 > size) {
+			ok = false;
+			return 0;
+		}
+		uint32_t v = 0;
+		for (int i = 0; i < 4; i++) {
+			v |= ((uint32_t)data[pos++]) << (i * 8);
+		}
+		return v;
+	}
+	float f32() {
+		uint32_t bits = u32();
+		float v;
+		std::memcpy(&v, &bits, 4);
+		return v;
+	}
+	bool isComplete() {
+		// all reads were valid and the whole payload was consumed
+		return ok && pos == size;
+	}
+};
+
+
+inline uint32_t packedChecksum(const uint8_t* data, size_t size) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+
+inline void packedToJson(json_t *rootJ, const std::string& key, uint8_t version, const PackedWriter& writer) {
+	PackedWriter blob;
+	blob.bytes.reserve(writer.bytes.size() + 9);
+	blob.u8(version);
+	blob.u32((uint32_t)writer.bytes.size());
+	blob.bytes.insert(blob.bytes.end(), writer.bytes.begin(), writer.bytes.end());
+	blob.u32(packedChecksum(blob.bytes.data(), blob.bytes.size()));
+	json_object_set_new(rootJ, key.c_str(), json_string(string::toBase64(blob.bytes).c_str()));
+}
+
+
+inline bool packedFromJson(json_t *rootJ, const std::string& key, uint8_t version, std::vector<uint8_t>* payload) {
+	// returns false when the caller should fall back to the legacy json arrays
+	json_t *packedJ = json_object_get(rootJ, key.c_str());
+	if (!packedJ || !json_is_string(packedJ))
+		return false;
+	std::vector<uint8_t> blob;
+	try {
+		blob = string::fromBase64(std::string(json_string_value(packedJ), json_string_length(packedJ)));
+	}
+	catch (std::exception& e) {
+		WARN("Packed data \"%s\" is not valid base64, using legacy data", key.c_str());
+		return false;
+	}
+	if (blob.size() < 9 || blob[0] != version) {
+		WARN("Packed data \"%s\" has an unknown version, using legacy data", key.c_str());
+		return false;
+	}
+	PackedReader reader(blob);
+	reader.u8();
+	uint32_t payloadSize = reader.u32();
+	if ((size_t)payloadSize != blob.size() - 9) {
+		WARN("Packed data \"%s\" has a bad size, using legacy data", key.c_str());
+		return false;
+	}
+	reader.pos = blob.size() - 4;
+	if (reader.u32() != packedChecksum(blob.data(), blob.size() - 4)) {
+		WARN("Packed data \"%s\" has a bad checksum, using legacy data", key.c_str());
+		return false;
+	}
+	payload->assign(blob.begin() + 5, blob.end() - 4);
+	return true;
+}
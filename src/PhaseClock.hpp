@@ -0,0 +1,240 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Fixed point clock engine shared by Clocked and Clkd, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+
+// The phase and lengths of a PhaseClock are in ticks of 2^-32 sample (samples in fixed point with 32 fractional
+// bits), so the phase advances by exactly ONE_SAMPLE per sample and the master's remainder is carried exactly from
+// one frame to the next: no rounding error accumulates, however long the clock runs.
+// The -1 phase is used as a reset state every frame so that lengths can be re-computed; it will stay at -1 when
+// a clock is inactive. A clock frame is defined as "length * iterations + syncWait", and for master, syncWait does
+// not apply and iterations = 1.
+// The frame of a sub-clock is the exact multiple of the master length that its ratio gives (x1.5 is three
+// iterations over two master lengths), and iteration n of a frame ends on tick frameLength * n / iterations, so the
+// iterations of odd ratios don't round to a length that drifts from the master within the frame.
+// The output edges are ticks computed by the derived clocks when a length or a pulse setting changes. The clock
+// keeps the phase of its next event (the next edge, the end of the iteration or the start of the sync region), so
+// a sample without an event is one add and one compare, and the output level only changes on events.
+
+class PhaseClock {
+	static constexpr double guardTime = 0.0005;// in seconds, region for sync to occur right before end of length of last iteration; sub clocks must be low during this period
+
+	int64_t phase = -1;// -1 when stopped, [0 to length[ for clock steps
+	int64_t remainder = 0;
+	int64_t frameLength = 0;// length * iterations (without syncWait)
+	int iterations = 0;// iterations left in the frame, go into sync after the last one if sub-clock
+	int frameIterations = 0;
+	int64_t guard = 0;
+	PhaseClock* syncSrc = nullptr;// only subclocks will have this set to master clock
+	int64_t edges[4] = {NO_EDGE, NO_EDGE, NO_EDGE, NO_EDGE};// high (1) in [0 : edges[0][, high (2) in [edges[1] : edges[2][, edges[3] is a sentinel
+	int64_t nextEvent = 0;// phase at which stepClock() must re-evaluate the clock
+	int level = 0;// 0 when low, else 1 or 2 for the first or second pulse
+
+	int64_t iterationEnd(int n) {// end of iteration n (from 1) of the frame, without overflowing frameLength * n
+		return (frameLength / frameIterations) * n + (frameLength % frameIterations) * n / frameIterations;
+	}
+
+	void scheduleNextEvent() {// passes the edges that the phase reached, and finds the next event
+		static const int levels[4] = {1, 0, 2, 0};
+		int nextEdge = 0;
+		while (phase >= edges[nextEdge])
+			nextEdge++;
+		level = levels[nextEdge];
+		nextEvent = ( (syncSrc != nullptr) && (iterations == 1) ) ? (length - guard + 1) : length;
+		if (edges[nextEdge] < nextEvent)
+			nextEvent = edges[nextEdge];
+	}
+
+	void processEvent() {
+		if ( (syncSrc != nullptr) && (iterations == 1) && (phase > (length - guard)) ) {// if in sync region
+			if (syncSrc->isReset()) {
+				reset();
+			}
+			else {// wait, and check again on the next sample
+				nextEvent = phase + ONE_SAMPLE;
+			}
+			return;
+		}
+		if (phase >= length) {// reached end iteration
+			iterations--;
+			phase -= length;
+			if (iterations <= 0) {
+				reset(syncSrc == nullptr ? phase : 0);// frame done; don't calc remainders for subclocks since they sync to master
+				return;
+			}
+			int n = frameIterations - iterations;
+			length = iterationEnd(n + 1) - iterationEnd(n);
+		}
+		scheduleNextEvent();
+	}
+
+
+	protected:
+
+	static constexpr int64_t NO_EDGE = INT64_MAX;
+
+	int64_t length = 0;// of the current iteration
+	double ticksPerSecond = 0.0;
+	bool *resetClockOutputsHigh = nullptr;
+	bool edgesChanged = true;// the derived clock must call setEdges() before the next getLevel()
+
+	int64_t ticksFloor(double seconds) {
+		return (int64_t)(seconds * ticksPerSecond);
+	}
+	int64_t ticksCeil(double seconds) {
+		return (int64_t)std::ceil(seconds * ticksPerSecond);
+	}
+
+	void setEdges(int64_t fall1, int64_t rise2, int64_t fall2) {// rise2 = fall2 = NO_EDGE when a single pulse
+		edges[0] = fall1;
+		edges[1] = rise2;
+		edges[2] = fall2;
+		edgesChanged = false;
+		if (phase != -1)
+			scheduleNextEvent();
+	}
+	int getLevel() {
+		return level;
+	}
+
+
+	public:
+
+	static constexpr int64_t ONE_SAMPLE = ((int64_t)1) << 32;
+
+	static int64_t toTicks(double seconds, double sampleRate) {
+		return (int64_t)(seconds * sampleRate * (double)ONE_SAMPLE + 0.5);
+	}
+
+	PhaseClock(PhaseClock* clkGiven, bool *resetClockOutputsHighPtr) {
+		syncSrc = clkGiven;
+		resetClockOutputsHigh = resetClockOutputsHighPtr;
+		reset();
+	}
+
+	void reset(int64_t _remainder = 0) {
+		phase = -1;
+		remainder = _remainder;
+	}
+	bool isReset() {
+		return phase == -1;
+	}
+	double getStep() {// in seconds, -1.0 when reset
+		return phase == -1 ? -1.0 : (double)phase / ticksPerSecond;
+	}
+	void start() {
+		phase = remainder;
+		scheduleNextEvent();
+	}
+
+	void setup(int64_t frameLengthGiven, int iterationsGiven, double sampleRate) {// must call setup before start
+		frameLength = frameLengthGiven;
+		iterations = iterationsGiven;
+		frameIterations = iterationsGiven;
+		length = iterationEnd(1);
+		ticksPerSecond = sampleRate * (double)ONE_SAMPLE;
+		guard = ticksFloor(guardTime);
+		edgesChanged = true;
+	}
+	void setupRatio(int64_t masterLength, int ratioDoubled, double sampleRate) {// sub-clocks
+		if (ratioDoubled < 0) {// if div
+			ratioDoubled *= -1;
+			int divIterations = 1 + (ratioDoubled % 2);
+			setup(masterLength * ratioDoubled / (3 - divIterations), divIterations, sampleRate);// frame is master * ratio, two iterations when ratio is a half
+		}
+		else {// mult
+			int multDenominator = 2 - (ratioDoubled % 2);
+			setup(masterLength * (3 - multDenominator), ratioDoubled / multDenominator, sampleRate);// frame is two master lengths when ratio is a half
+		}
+	}
+
+	void stepClock() {// here the clock was output on phase "phase", this function is called near end of module::process()
+		if (phase >= 0) {// if active clock
+			phase += ONE_SAMPLE;
+			if (phase >= nextEvent)
+				processEvent();
+		}
+	}
+
+	void applyNewLength(double lengthStretchFactor) {
+		if (phase != -1)
+			phase = (int64_t)((double)phase * lengthStretchFactor);
+		length = (int64_t)((double)length * lengthStretchFactor);
+		frameLength = (int64_t)((double)frameLength * lengthStretchFactor);
+		edgesChanged = true;
+		nextEvent = 0;// re-evaluate on next step, edges may have moved before the phase
+	}
+};
+
+
+// Delayed output of a clock: each level change that write() sees is scheduled at the sample that its delay gives,
+// and read() plays the schedule back, one compare per sample. The delay is taken when the edge is written, so a
+// delay change moves the edges that follow it, not the pending ones. When the delay shrinks, a new edge would land
+// before edges already pending; it is then played one sample after the last pending edge instead, so the schedule
+// stays in order and every level lasts at least one sample (a pulse can be shortened this way, never dropped).
+// Delays are shorter than a double period, so at most four edges (two pulses) are pending; should the schedule
+// ever be full, its oldest edge is played right away to make room rather than losing the new one.
+
+class ClockEdgeSchedule {
+	static const int SIZE = 8;// power of 2
+
+	int64_t sampleCounter;// 64 bits, does not wrap
+	int64_t edgeSamples[SIZE];
+	bool edgeStates[SIZE];
+	int head;// next edge to play
+	int count;
+	int lastWriteValue;
+	bool readState;
+
+	public:
+
+	ClockEdgeSchedule() {
+		reset(true);
+	}
+
+	void reset(bool resetClockOutputsHigh) {
+		sampleCounter = 0;
+		head = 0;
+		count = 0;
+		lastWriteValue = 0;
+		readState = resetClockOutputsHigh;
+	}
+
+	void write(int value, int64_t delaySamples) {// value is a clock level (0 when low, else 1 or 2 for the first or second pulse)
+		if (value != lastWriteValue) {
+			int64_t edgeSample = sampleCounter + delaySamples;
+			if (count > 0) {
+				int lastTail = (head + count - 1) & (SIZE - 1);
+				edgeSample = std::max(edgeSample, edgeSamples[lastTail] + 1);
+			}
+			if (count == SIZE) {
+				readState = edgeStates[head];
+				head = (head + 1) & (SIZE - 1);
+				count--;
+			}
+			int tail = (head + count) & (SIZE - 1);
+			edgeSamples[tail] = edgeSample;
+			edgeStates[tail] = (value != 0);
+			count++;
+			lastWriteValue = value;
+		}
+	}
+
+	bool read() {
+		while (count > 0 && edgeSamples[head] <= sampleCounter) {
+			readState = edgeStates[head];
+			head = (head + 1) & (SIZE - 1);
+			count--;
+		}
+		sampleCounter++;
+		return readState;
+	}
+};
@@ -12,7 +12,8 @@
 //***********************************************************************************************
 
 
-#include "PhraseSeqUtil.hpp"
+#include "PhraseSeqKernel.hpp"
+#include "JsonHandoff.hpp"
 #include "comp/PianoKey.hpp"
 
 
@@ -104,20 +105,15 @@ struct PhraseSeq16 : Module {
 	bool autostepLen;
 	bool holdTiedNotes;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-D5#, 2 is TrigIncr
-	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
 	bool running;
-	int runModeSong;
 	int stepIndexEdit;
 	int seqIndexEdit;
 	int phraseIndexEdit;
-	int phrases;//1 to 16
-	SeqAttributes sequences[16];
-	int phrase[16];// This is the song (series of phases; a phrase is a patten number)
-	float cv[16][16];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
-	StepAttributes attributes[16][16];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
+	PhraseSeqKernel<16, 16, 1> sek;// steps, song and run state
 	bool resetOnRun;
 	bool attached;
 	bool stopAtEndOfSong;
+	ClockBusSubscriber clockBusSubscriber;// unpatched run, clock and reset inputs can follow the clock master
 
 	// No need to save, with reset
 	int displayState;
@@ -131,7 +127,6 @@ struct PhraseSeq16 : Module {
 	unsigned long editingGate;// 0 when no edit gate, downward step counter timer when edit gate
 	unsigned long editingType;// similar to editingGate, but just for showing remanent gate type (nothing played); uses editingGateKeyLight
 	long infoCopyPaste;// 0 when no info, positive downward step counter timer when copy, negative upward when paste
-	unsigned long clockPeriod;// counts number of step() calls upward from last clock (reset after clock processed)
 	long tiedWarning;// 0 when no warning, positive downward step counter timer when warning
 	long attachedWarning;// 0 when no warning, positive downward step counter timer when warning
 	long revertDisplay;
@@ -139,20 +134,11 @@ struct PhraseSeq16 : Module {
 	long lastGateEdit;
 	long editingPpqn;// 0 when no info, positive downward step counter timer when editing ppqn
 	long clockIgnoreOnReset;
-	int phraseIndexRun;
-	unsigned long phraseIndexRunHistory;
-	int stepIndexRun;
-	unsigned long stepIndexRunHistory;
-	int ppqnCount;
-	int gate1Code;
-	int gate2Code;
-	bool lastProbGate1Enable;
-	unsigned long slideStepsRemain;// 0 when no slide under way, downward step counter when sliding
 
 
 	// No need to save, no reset
 	RefreshCounter refresh;
-	float slideCVdelta;// no need to initialize, this goes with slideStepsRemain
+	JsonHandoff<PhraseSeqData<16, 16>> jsonHandoff;// steps and song loaded by dataFromJson(), adopted by process()
 	float editingGateCV;// no need to initialize, this goes with editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight;// no need to initialize, this goes with editingGate (use this only when editingGate > 0)
 	float resetLight = 0.0f;
@@ -253,25 +239,16 @@ struct PhraseSeq16 : Module {
 	
 
 	void onReset() override final {
+		clockBusSubscriber.init();
 		autoseq = false;
 		autostepLen = false;
 		holdTiedNotes = true;
 		seqCVmethod = 0;
-		pulsesPerStep = 1;
 		running = true;
-		runModeSong = MODE_FWD;
 		stepIndexEdit = 0;
 		seqIndexEdit = 0;
 		phraseIndexEdit = 0;
-		phrases = 4;
-		for (int i = 0; i < 16; i++) {
-			sequences[i].init(16, MODE_FWD);
-			phrase[i] = 0;
-			for (int s = 0; s < 16; s++) {
-				cv[i][s] = 0.0f;
-				attributes[i][s].init();
-			}
-		}
+		sek.onReset(16);
 		resetOnRun = false;
 		attached = false;
 		stopAtEndOfSong = false;
@@ -291,7 +268,7 @@ struct PhraseSeq16 : Module {
 		editingGate = 0ul;
 		editingType = 0ul;
 		infoCopyPaste = 0l;
-		clockPeriod = 0ul;
+		sek.clockPeriod = 0ul;
 		tiedWarning = 0ul;
 		attachedWarning = 0l;
 		revertDisplay = 0l;
@@ -302,28 +279,17 @@ struct PhraseSeq16 : Module {
 	}
 	void initRun() {// run button activated or run edge in run input jack
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
-		phraseIndexRunHistory = 0;
-
-		int seq = (isEditingSequence() ? seqIndexEdit : phrase[phraseIndexRun]);
-		stepIndexRun = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
-		stepIndexRunHistory = 0;
-
-		ppqnCount = 0;
-		lastProbGate1Enable = true;
-		calcGate1Code(attributes[seq][stepIndexRun]);
-		gate2Code = calcGate2Code(attributes[seq][stepIndexRun], 0, pulsesPerStep);
-		slideStepsRemain = 0ul;
+		sek.initRun(isEditingSequence(), seqIndexEdit, params[GATE1_KNOB_PARAM].getValue());
 	}
 	
 	
 	void onRandomize() override {
 		if (isEditingSequence()) {
 			for (int s = 0; s < 16; s++) {
-				cv[seqIndexEdit][s] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
-				attributes[seqIndexEdit][s].randomize();
+				sek.cv[seqIndexEdit][s] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
+				sek.attributes[seqIndexEdit][s].randomize();
 			}
-			sequences[seqIndexEdit].randomize(16, NUM_MODES - 1);
+			sek.sequences[seqIndexEdit].randomize(16, NUM_MODES - 1);
 		}
 	}
 	
@@ -331,6 +297,10 @@ struct PhraseSeq16 : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// steps and song are those loaded by dataFromJson() when process() has not adopted them yet
+		PhraseSeqData<16, 16>* pendingData = jsonHandoff.peekPending();
+		PhraseSeqData<16, 16>* sd = (pendingData != nullptr ? pendingData : &sek);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
@@ -350,13 +320,13 @@ struct PhraseSeq16 : Module {
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
 
 		// pulsesPerStep
-		json_object_set_new(rootJ, "pulsesPerStep", json_integer(pulsesPerStep));
+		json_object_set_new(rootJ, "pulsesPerStep", json_integer(sd->pulsesPerStep));
 
 		// running
 		json_object_set_new(rootJ, "running", json_boolean(running));
 		
 		// runModeSong
-		json_object_set_new(rootJ, "runModeSong3", json_integer(runModeSong));
+		json_object_set_new(rootJ, "runModeSong3", json_integer(sd->runModeSong));
 
 		// stepIndexEdit
 		json_object_set_new(rootJ, "stepIndexEdit", json_integer(stepIndexEdit));
@@ -368,25 +338,25 @@ struct PhraseSeq16 : Module {
 		json_object_set_new(rootJ, "phraseIndexEdit", json_integer(phraseIndexEdit));
 
 		// phrases
-		json_object_set_new(rootJ, "phrases", json_integer(phrases));
+		json_object_set_new(rootJ, "phrases", json_integer(sd->phrases));
 
 		// sequences
 		json_t *sequencesJ = json_array();
 		for (int i = 0; i < 16; i++)
-			json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
+			json_array_insert_new(sequencesJ, i, json_integer(sd->sequences[i].getSeqAttrib()));
 		json_object_set_new(rootJ, "sequences", sequencesJ);
 		
 		// phrase 
 		json_t *phraseJ = json_array();
 		for (int i = 0; i < 16; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
+			json_array_insert_new(phraseJ, i, json_integer(sd->phrase[i]));
 		json_object_set_new(rootJ, "phrase", phraseJ);
 
 		// CV
 		json_t *cvJ = json_array();
 		for (int i = 0; i < 16; i++)
 			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(cvJ, s + (i * 16), json_real(cv[i][s]));
+				json_array_insert_new(cvJ, s + (i * 16), json_real(sd->cv[i][s]));
 			}
 		json_object_set_new(rootJ, "cv", cvJ);
 
@@ -394,7 +364,7 @@ struct PhraseSeq16 : Module {
 		json_t *attributesJ = json_array();
 		for (int i = 0; i < 16; i++)
 			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(attributesJ, s + (i * 16), json_integer(attributes[i][s].getAttribute()));
+				json_array_insert_new(attributesJ, s + (i * 16), json_integer(sd->attributes[i][s].getAttribute()));
 			}
 		json_object_set_new(rootJ, "attributes", attributesJ);
 
@@ -407,10 +377,20 @@ struct PhraseSeq16 : Module {
 		// stopAtEndOfSong
 		json_object_set_new(rootJ, "stopAtEndOfSong", json_boolean(stopAtEndOfSong));
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
+		// clockBusSource
+		clockBusSubscriber.dataToJson(rootJ);
+
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		// steps and song are parsed into the handoff buffer, process() adopts them when they are all there
+		PhraseSeqData<16, 16>* sd = jsonHandoff.beginWrite();
+		sd->init(16);
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -426,6 +406,9 @@ struct PhraseSeq16 : Module {
 		if (autoseqJ)
 			autoseq = json_is_true(autoseqJ);
 
+		// clockBusSource
+		clockBusSubscriber.dataFromJson(rootJ);
+
 		// autostepLen
 		json_t *autostepLenJ = json_object_get(rootJ, "autostepLen");
 		if (autostepLenJ)
@@ -446,7 +429,7 @@ struct PhraseSeq16 : Module {
 		// pulsesPerStep
 		json_t *pulsesPerStepJ = json_object_get(rootJ, "pulsesPerStep");
 		if (pulsesPerStepJ)
-			pulsesPerStep = json_integer_value(pulsesPerStepJ);
+			sd->pulsesPerStep = json_integer_value(pulsesPerStepJ);
 
 		// running
 		json_t *runningJ = json_object_get(rootJ, "running");
@@ -456,13 +439,13 @@ struct PhraseSeq16 : Module {
 		// runModeSong
 		json_t *runModeSongJ = json_object_get(rootJ, "runModeSong3");
 		if (runModeSongJ)
-			runModeSong = json_integer_value(runModeSongJ);
+			sd->runModeSong = json_integer_value(runModeSongJ);
 		else {// legacy
 			runModeSongJ = json_object_get(rootJ, "runModeSong");
 			if (runModeSongJ) {
-				runModeSong = json_integer_value(runModeSongJ);
-				if (runModeSong >= MODE_PEN)// this mode was not present in original version
-					runModeSong++;
+				sd->runModeSong = json_integer_value(runModeSongJ);
+				if (sd->runModeSong >= MODE_PEN)// this mode was not present in original version
+					sd->runModeSong++;
 			}
 		}
 		
@@ -484,7 +467,7 @@ struct PhraseSeq16 : Module {
 		// phrases
 		json_t *phrasesJ = json_object_get(rootJ, "phrases");
 		if (phrasesJ)
-			phrases = json_integer_value(phrasesJ);
+			sd->phrases = json_integer_value(phrasesJ);
 		
 		// sequences
 		json_t *sequencesJ = json_object_get(rootJ, "sequences");
@@ -493,7 +476,7 @@ struct PhraseSeq16 : Module {
 			{
 				json_t *sequencesArrayJ = json_array_get(sequencesJ, i);
 				if (sequencesArrayJ)
-					sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
+					sd->sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
 			}			
 		}
 		else {// legacy
@@ -568,8 +551,8 @@ struct PhraseSeq16 : Module {
 			
 			// now write into new object
 			for (int i = 0; i < 16; i++) {
-				sequences[i].init(lengths[i], runModeSeq[i]);
-				sequences[i].setTranspose(transposeOffsets[i]);
+				sd->sequences[i].init(lengths[i], runModeSeq[i]);
+				sd->sequences[i].setTranspose(transposeOffsets[i]);
 			}
 		}
 		
@@ -580,7 +563,7 @@ struct PhraseSeq16 : Module {
 			{
 				json_t *phraseArrayJ = json_array_get(phraseJ, i);
 				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
+					sd->phrase[i] = json_integer_value(phraseArrayJ);
 			}
 			
 		// CV
@@ -590,7 +573,7 @@ struct PhraseSeq16 : Module {
 				for (int s = 0; s < 16; s++) {
 					json_t *cvArrayJ = json_array_get(cvJ, s + (i * 16));
 					if (cvArrayJ)
-						cv[i][s] = json_number_value(cvArrayJ);
+						sd->cv[i][s] = json_number_value(cvArrayJ);
 				}
 		}
 
@@ -601,13 +584,13 @@ struct PhraseSeq16 : Module {
 				for (int s = 0; s < 16; s++) {
 					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 16));
 					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
+						sd->attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
 				}
 		}
 		else {// legacy
 			for (int i = 0; i < 16; i++)
 				for (int s = 0; s < 16; s++)
-					attributes[i][s].setAttribute(0u);
+					sd->attributes[i][s].setAttribute(0u);
 			// gate1
 			json_t *gate1J = json_object_get(rootJ, "gate1");
 			if (gate1J) {
@@ -615,7 +598,7 @@ struct PhraseSeq16 : Module {
 					for (int s = 0; s < 16; s++) {
 						json_t *gate1arrayJ = json_array_get(gate1J, s + (i * 16));
 						if (gate1arrayJ)
-							if (!!json_integer_value(gate1arrayJ)) attributes[i][s].setGate1(true);
+							if (!!json_integer_value(gate1arrayJ)) sd->attributes[i][s].setGate1(true);
 					}
 			}
 			// gate1Prob
@@ -625,7 +608,7 @@ struct PhraseSeq16 : Module {
 					for (int s = 0; s < 16; s++) {
 						json_t *gate1ProbarrayJ = json_array_get(gate1ProbJ, s + (i * 16));
 						if (gate1ProbarrayJ)
-							if (!!json_integer_value(gate1ProbarrayJ)) attributes[i][s].setGate1P(true);
+							if (!!json_integer_value(gate1ProbarrayJ)) sd->attributes[i][s].setGate1P(true);
 					}
 			}
 			// gate2
@@ -635,7 +618,7 @@ struct PhraseSeq16 : Module {
 					for (int s = 0; s < 16; s++) {
 						json_t *gate2arrayJ = json_array_get(gate2J, s + (i * 16));
 						if (gate2arrayJ)
-							if (!!json_integer_value(gate2arrayJ)) attributes[i][s].setGate2(true);
+							if (!!json_integer_value(gate2arrayJ)) sd->attributes[i][s].setGate2(true);
 					}
 			}
 			// slide
@@ -645,7 +628,7 @@ struct PhraseSeq16 : Module {
 					for (int s = 0; s < 16; s++) {
 						json_t *slideArrayJ = json_array_get(slideJ, s + (i * 16));
 						if (slideArrayJ)
-							if (!!json_integer_value(slideArrayJ)) attributes[i][s].setSlide(true);
+							if (!!json_integer_value(slideArrayJ)) sd->attributes[i][s].setSlide(true);
 					}
 			}
 			// tied
@@ -655,7 +638,7 @@ struct PhraseSeq16 : Module {
 					for (int s = 0; s < 16; s++) {
 						json_t *tiedArrayJ = json_array_get(tiedJ, s + (i * 16));
 						if (tiedArrayJ)
-							if (!!json_integer_value(tiedArrayJ)) attributes[i][s].setTied(true);
+							if (!!json_integer_value(tiedArrayJ)) sd->attributes[i][s].setTied(true);
 					}
 			}
 		}
@@ -675,23 +658,16 @@ struct PhraseSeq16 : Module {
 		if (stopAtEndOfSongJ)
 			stopAtEndOfSong = json_is_true(stopAtEndOfSongJ);
 		
-		resetNonJson();
+		jsonHandoff.endWrite();// process() adopts the steps and song, then calls resetNonJson()
 	}
 
 
 	IoStep* fillIoSteps(int *seqLenPtr) {// caller must delete return array
-		int seqLen = sequences[seqIndexEdit].getLength();
+		int seqLen = sek.sequences[seqIndexEdit].getLength();
 		IoStep* ioSteps = new IoStep[seqLen];
 		
 		// populate ioSteps array
-		for (int i = 0; i < seqLen; i++) {
-			ioSteps[i].pitch = cv[seqIndexEdit][i];
-			StepAttributes stepAttrib = attributes[seqIndexEdit][i];
-			ioSteps[i].gate = stepAttrib.getGate1();
-			ioSteps[i].tied = stepAttrib.getTied();
-			ioSteps[i].vel = -1.0f;// no concept of velocity in PhraseSequencers
-			ioSteps[i].prob = stepAttrib.getGate1P() ? params[GATE1_KNOB_PARAM].getValue() : -1.0f;// negative means prob is not on for this note
-		}
+		sek.fillIoSteps(ioSteps, seqIndexEdit, 0, seqLen, params[GATE1_KNOB_PARAM].getValue());
 		
 		// return values 
 		*seqLenPtr = seqLen;
@@ -700,75 +676,13 @@ struct PhraseSeq16 : Module {
 	
 	
 	void emptyIoSteps(IoStep* ioSteps, int seqLen) {
-		sequences[seqIndexEdit].setLength(seqLen);
+		sek.sequences[seqIndexEdit].setLength(seqLen);
 		
 		// populate steps in the sequencer
-		// first pass is done without ties
-		for (int i = 0; i < seqLen; i++) {
-			cv[seqIndexEdit][i] = ioSteps[i].pitch;
-			
- 			StepAttributes stepAttrib;
-			stepAttrib.init();
-			stepAttrib.setGate1(ioSteps[i].gate);
-			stepAttrib.setGate1P(ioSteps[i].prob >= 0.0f);
-			attributes[seqIndexEdit][i] = stepAttrib;
-		}
-		// now do ties, has to be done in a separate pass such that non tied that follows tied can be 
-		//   there in advance for proper gate types
-		for (int i = 0; i < seqLen; i++) {
-			if (ioSteps[i].tied) {
-				activateTiedStep(seqIndexEdit, i);
-			}
-		}
+		sek.emptyIoSteps(ioSteps, seqIndexEdit, 0, seqLen, holdTiedNotes);
 	}
 	
 	
-	void rotateSeq(int seqNum, bool directionRight, int seqLength) {
-		float rotCV;
-		StepAttributes rotAttributes;
-		int iStart = 0;
-		int iEnd = seqLength - 1;
-		int iRot = iStart;
-		int iDelta = 1;
-		if (directionRight) {
-			iRot = iEnd;
-			iDelta = -1;
-		}
-		rotCV = cv[seqNum][iRot];
-		rotAttributes = attributes[seqNum][iRot];
-		for ( ; ; iRot += iDelta) {
-			if (iDelta == 1 && iRot >= iEnd) break;
-			if (iDelta == -1 && iRot <= iStart) break;
-			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
-			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
-		}
-		cv[seqNum][iRot] = rotCV;
-		attributes[seqNum][iRot] = rotAttributes;
-	}
-	
-	
-	void calcGate1Code(StepAttributes attribute) {
-		int gateType = attribute.getGate1Mode();
-		
-		if (ppqnCount == 0 && !attribute.getTied()) {
-			lastProbGate1Enable = !attribute.getGate1P() || (random::uniform() < params[GATE1_KNOB_PARAM].getValue()); // random::uniform is [0.0, 1.0), see include/util/common.hpp
-		}
-			
-		if (!attribute.getGate1() || !lastProbGate1Enable) {
-			gate1Code = 0;
-		}
-		else if (pulsesPerStep == 1 && gateType == 0) {
-			gate1Code = 2;// clock high
-		}
-		else { 
-			if (gateType == 11) {
-				gate1Code = (ppqnCount == 0 ? 3 : 0);
-			}
-			else {
-				gate1Code = getAdvGate(ppqnCount, pulsesPerStep, gateType);
-			}
-		}
-	}
 	
 
 	void process(const ProcessArgs &args) override {
@@ -783,13 +697,22 @@ struct PhraseSeq16 : Module {
 		float *messagesFromExpander = static_cast<float*>(rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
 		
 		
+		// Steps and song loaded by dataFromJson()
+		if (jsonHandoff.adopt(&sek)) {
+			resetNonJson();
+		}
+
+
 		//********** Buttons, knobs, switches and inputs **********
 		
+		// Clock bus, read by the run, clock and reset inputs
+		clockBusSubscriber.update(id, args.frame);
+		
 		// Edit mode
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
 		
 		// Run button
-		if (runningTrigger.process(params[RUN_PARAM].getValue() + inputs[RUNCV_INPUT].getVoltage())) {// no input refresh here, don't want to introduce startup skew
+		if (runningTrigger.process(params[RUN_PARAM].getValue() + clockBusSubscriber.getRun(inputs[RUNCV_INPUT]))) {// no input refresh here, don't want to introduce startup skew
 			running = !running;
 			if (running) {
 				if (resetOnRun) {
@@ -804,7 +727,7 @@ struct PhraseSeq16 : Module {
 			if (expanderPresent && editingSequence) {
 				float modeCVin = messagesFromExpander[4];
 				if (!std::isnan(modeCVin))
-					sequences[seqIndexEdit].setRunMode((int) clamp( std::round(modeCVin * ((float)NUM_MODES - 1.0f - 1.0f) / 10.0f), 0.0f, (float)NUM_MODES - 1.0f - 1.0f ));
+					sek.sequences[seqIndexEdit].setRunMode((int) clamp( std::round(modeCVin * ((float)NUM_MODES - 1.0f - 1.0f) / 10.0f), 0.0f, (float)NUM_MODES - 1.0f - 1.0f ));
 			}
 			
 			// Attach button
@@ -814,9 +737,9 @@ struct PhraseSeq16 : Module {
 			}
 			if (running && attached) {
 				if (editingSequence)
-					stepIndexEdit = stepIndexRun;
+					stepIndexEdit = sek.stepIndexRun[0];
 				else
-					phraseIndexEdit = phraseIndexRun;
+					phraseIndexEdit = sek.phraseIndexRun;
 			}
 			
 			// Copy button
@@ -832,15 +755,15 @@ struct PhraseSeq16 : Module {
 						countCP = std::min(8, 16 - startCP);
 					if (editingSequence) {
 						for (int i = 0, s = startCP; i < countCP; i++, s++) {
-							cvCPbuffer[i] = cv[seqIndexEdit][s];
-							attribCPbuffer[i] = attributes[seqIndexEdit][s];
+							cvCPbuffer[i] = sek.cv[seqIndexEdit][s];
+							attribCPbuffer[i] = sek.attributes[seqIndexEdit][s];
 						}
-						seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
+						seqAttribCPbuffer.setSeqAttrib(sek.sequences[seqIndexEdit].getSeqAttrib());
 						seqCopied = true;
 					}
 					else {
 						for (int i = 0, p = startCP; i < countCP; i++, p++)
-							phraseCPbuffer[i] = phrase[p];
+							phraseCPbuffer[i] = sek.phrase[p];
 						seqCopied = false;// so that a cross paste can be detected
 					}
 					infoCopyPaste = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
@@ -863,11 +786,11 @@ struct PhraseSeq16 : Module {
 					if (editingSequence) {
 						if (seqCopied) {// non-crossed paste (seq vs song)
 							for (int i = 0, s = startCP; i < countCP; i++, s++) {
-								cv[seqIndexEdit][s] = cvCPbuffer[i];
-								attributes[seqIndexEdit][s] = attribCPbuffer[i];
+								sek.cv[seqIndexEdit][s] = cvCPbuffer[i];
+								sek.attributes[seqIndexEdit][s] = attribCPbuffer[i];
 							}
 							if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
-								sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
+								sek.sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
 							}
 						}
 						else {// crossed paste to seq (seq vs song)
@@ -875,21 +798,21 @@ struct PhraseSeq16 : Module {
 								for (int s = 0; s < 16; s++) {
 									//cv[seqIndexEdit][s] = 0.0f;
 									//attributes[seqIndexEdit][s].init();
-									attributes[seqIndexEdit][s].toggleGate1();
+									sek.attributes[seqIndexEdit][s].toggleGate1();
 								}
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
+								sek.sequences[seqIndexEdit].setTranspose(0);
+								sek.sequences[seqIndexEdit].setRotate(0);
 							}
 							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize CVs)
 								for (int s = 0; s < 16; s++)
-									cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
+									sek.cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
+								sek.sequences[seqIndexEdit].setTranspose(0);
+								sek.sequences[seqIndexEdit].setRotate(0);
 							}
 							else {// 8 (randomize gate 1)
 								for (int s = 0; s < 16; s++)
 									if ( (random::u32() & 0x1) != 0)
-										attributes[seqIndexEdit][s].toggleGate1();
+										sek.attributes[seqIndexEdit][s].toggleGate1();
 							}
 							startCP = 0;
 							countCP = 16;
@@ -899,20 +822,20 @@ struct PhraseSeq16 : Module {
 					else {
 						if (!seqCopied) {// non-crossed paste (seq vs song)
 							for (int i = 0, p = startCP; i < countCP; i++, p++)
-								phrase[p] = phraseCPbuffer[i];
+								sek.phrase[p] = phraseCPbuffer[i];
 						}
 						else {// crossed paste to song (seq vs song)
 							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init phrases)
 								for (int p = 0; p < 16; p++)
-									phrase[p] = 0;
+									sek.phrase[p] = 0;
 							}
 							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (phrases increase from 1 to 16)
 								for (int p = 0; p < 16; p++)
-									phrase[p] = p;						
+									sek.phrase[p] = p;						
 							}
 							else {// 8 (randomize phrases)
 								for (int p = 0; p < 16; p++)
-									phrase[p] = random::u32() % 16;
+									sek.phrase[p] = random::u32() % 16;
 							}
 							startCP = 0;
 							countCP = 16;
@@ -930,16 +853,16 @@ struct PhraseSeq16 : Module {
 			bool writeTrig = writeTrigger.process(inputs[WRITE_INPUT].getVoltage());
 			if (writeTrig) {
 				if (editingSequence) {
-					if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {
-						cv[seqIndexEdit][stepIndexEdit] = inputs[CV_INPUT].getVoltage();
-						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+					if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+						sek.cv[seqIndexEdit][stepIndexEdit] = inputs[CV_INPUT].getVoltage();
+						sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 					}
 					editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					editingGateCV = inputs[CV_INPUT].getVoltage();// cv[seqIndexEdit][stepIndexEdit];
 					editingGateKeyLight = -1;
 					// Autostep (after grab all active inputs)
 					if (params[AUTOSTEP_PARAM].getValue() > 0.5f) {
-						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, autostepLen ? sequences[seqIndexEdit].getLength() : 16);
+						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, autostepLen ? sek.sequences[seqIndexEdit].getLength() : 16);
 						if (stepIndexEdit == 0 && autoseq && !inputs[SEQCV_INPUT].isConnected())
 							seqIndexEdit = moveIndex(seqIndexEdit, seqIndexEdit + 1, 16);
 					}
@@ -960,10 +883,10 @@ struct PhraseSeq16 : Module {
 				if (!running || !attached) {// don't move heads when attach and running
 					if (editingSequence) {
 						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, 16);
-						if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
+						if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
 							if (!writeTrig) {// in case autostep when simultaneous writeCV and stepCV (keep what was done in Write Input block above)
 								editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-								editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+								editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 								editingGateKeyLight = -1;
 							}
 						}
@@ -971,7 +894,7 @@ struct PhraseSeq16 : Module {
 					else {
 						phraseIndexEdit = moveIndex(phraseIndexEdit, phraseIndexEdit + delta, 16);
 						if (!running)
-							phraseIndexRun = phraseIndexEdit;
+							sek.phraseIndexRun = phraseIndexEdit;
 					}
 				}
 			}
@@ -985,25 +908,25 @@ struct PhraseSeq16 : Module {
 			if (stepPressed != -1) {
 				if (displayState == DISP_LENGTH) {
 					if (editingSequence)
-						sequences[seqIndexEdit].setLength(stepPressed + 1);
+						sek.sequences[seqIndexEdit].setLength(stepPressed + 1);
 					else
-						phrases = stepPressed + 1;
+						sek.phrases = stepPressed + 1;
 					revertDisplay = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 				else {
 					if (!running || !attached) {// not running or detached
 						if (editingSequence) {
 							stepIndexEdit = stepPressed;
-							if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
+							if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
 								editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-								editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+								editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 								editingGateKeyLight = -1;
 							}
 						}
 						else {
 							phraseIndexEdit = stepPressed;
 							if (!running)
-								phraseIndexRun = phraseIndexEdit;
+								sek.phraseIndexRun = phraseIndexEdit;
 						}
 					}
 					else {// attached and running
@@ -1055,50 +978,50 @@ struct PhraseSeq16 : Module {
 				if (abs(deltaKnob) <= 3) {// avoid discontinuous step (initialize for example)
 					// any changes in here should may also require right click behavior to be updated in the knob's onMouseDown()
 					if (editingPpqn != 0) {
-						pulsesPerStep = indexToPps(ppsToIndex(pulsesPerStep) + deltaKnob);// indexToPps() does clamping
+						sek.pulsesPerStep = indexToPps(ppsToIndex(sek.pulsesPerStep) + deltaKnob);// indexToPps() does clamping
 						editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 					else if (displayState == DISP_MODE) {
 						if (editingSequence) {
 							if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
-								sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_MODES - 1 - 1)));
+								sek.sequences[seqIndexEdit].setRunMode(clamp(sek.sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_MODES - 1 - 1)));
 							}
 						}
 						else {
-							runModeSong = clamp(runModeSong + deltaKnob, 0, 6 - 1);
+							sek.runModeSong = clamp(sek.runModeSong + deltaKnob, 0, 6 - 1);
 						}
 					}
 					else if (displayState == DISP_LENGTH) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setLength(clamp(sequences[seqIndexEdit].getLength() + deltaKnob, 1, 16));
+							sek.sequences[seqIndexEdit].setLength(clamp(sek.sequences[seqIndexEdit].getLength() + deltaKnob, 1, 16));
 						}
 						else {
-							phrases = clamp(phrases + deltaKnob, 1, 16);
+							sek.phrases = clamp(sek.phrases + deltaKnob, 1, 16);
 						}
 					}
 					else if (displayState == DISP_TRANSPOSE) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setTranspose(clamp(sequences[seqIndexEdit].getTranspose() + deltaKnob, -99, 99));
+							sek.sequences[seqIndexEdit].setTranspose(clamp(sek.sequences[seqIndexEdit].getTranspose() + deltaKnob, -99, 99));
 							float transposeOffsetCV = ((float)(deltaKnob))/12.0f;// Tranpose by deltaKnob number of semi-tones
 							for (int s = 0; s < 16; s++) {
-								cv[seqIndexEdit][s] += transposeOffsetCV;
+								sek.cv[seqIndexEdit][s] += transposeOffsetCV;
 							}
 						}
 					}
 					else if (displayState == DISP_ROTATE) {
 						if (editingSequence) {
-							int slength = sequences[seqIndexEdit].getLength();
-							sequences[seqIndexEdit].setRotate(clamp(sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
+							int slength = sek.sequences[seqIndexEdit].getLength();
+							sek.sequences[seqIndexEdit].setRotate(clamp(sek.sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
 							if (deltaKnob > 0 && deltaKnob < 201) {// Rotate right, 201 is safety
 								for (int i = deltaKnob; i > 0; i--) {
-									rotateSeq(seqIndexEdit, true, slength);
+									sek.rotateSeq(seqIndexEdit, true, slength, 0);
 									if (stepIndexEdit < slength)
 										stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, slength);
 								}
 							}
 							if (deltaKnob < 0 && deltaKnob > -201) {// Rotate left, 201 is safety
 								for (int i = deltaKnob; i < 0; i++) {
-									rotateSeq(seqIndexEdit, false, slength);
+									sek.rotateSeq(seqIndexEdit, false, slength, 0);
 									if (stepIndexEdit < slength)
 										stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit - 1, slength);
 								}
@@ -1113,7 +1036,7 @@ struct PhraseSeq16 : Module {
 						}
 						else {
 							if (!attached || !running)
-								phrase[phraseIndexEdit] = clamp(phrase[phraseIndexEdit] + deltaKnob, 0, 16 - 1);
+								sek.phrase[phraseIndexEdit] = clamp(sek.phrase[phraseIndexEdit] + deltaKnob, 0, 16 - 1);
 							else
 								attachedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 							
@@ -1128,13 +1051,13 @@ struct PhraseSeq16 : Module {
 				if (octTriggers[i].process(params[OCTAVE_PARAM + i].getValue())) {
 					if (editingSequence) {
 						displayState = DISP_NORMAL;
-						if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+						if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 						else {			
-							cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 3 - i);
-							propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+							sek.cv[seqIndexEdit][stepIndexEdit] = applyNewOct(sek.cv[seqIndexEdit][stepIndexEdit], 3 - i);
+							sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 							editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-							editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+							editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 							editingGateKeyLight = -1;
 						}
 					}
@@ -1146,39 +1069,39 @@ struct PhraseSeq16 : Module {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					if (editingGateLength != 0l) {
-						int newMode = keyIndexToGateMode(pkInfo.key, pulsesPerStep);
+						int newMode = keyIndexToGateMode(pkInfo.key, sek.pulsesPerStep, (APP->window->getMods() & GLFW_MOD_ALT) != 0);
 						if (newMode != -1) {
 							editingPpqn = 0l;
-							attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
+							sek.attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
 							if (pkInfo.isRightClick) {
 								stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 16);
 								editingType = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 								editingGateKeyLight = pkInfo.key;
 								if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL)
-									attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
+									sek.attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
 							}
 						}
 						else
 							editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
-					else if (attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+					else if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
 						if (pkInfo.isRightClick)
 							stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 16);
 						else
 							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 					else {	
-						float newCV = std::floor(cv[seqIndexEdit][stepIndexEdit]) + ((float) pkInfo.key) / 12.0f;
-						cv[seqIndexEdit][stepIndexEdit] = newCV;
-						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+						float newCV = std::floor(sek.cv[seqIndexEdit][stepIndexEdit]) + ((float) pkInfo.key) / 12.0f;
+						sek.cv[seqIndexEdit][stepIndexEdit] = newCV;
+						sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 						editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+						editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 						editingGateKeyLight = -1;
 						if (pkInfo.isRightClick) {
 							stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 16);
 							editingGateKeyLight = pkInfo.key;
 							if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL)
-								cv[seqIndexEdit][stepIndexEdit] = newCV;
+								sek.cv[seqIndexEdit][stepIndexEdit] = newCV;
 						}
 					}						
 				}
@@ -1202,41 +1125,41 @@ struct PhraseSeq16 : Module {
 			if (gate1Trigger.process(params[GATE1_PARAM].getValue() + (expanderPresent ? messagesFromExpander[0] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					attributes[seqIndexEdit][stepIndexEdit].toggleGate1();
+					sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate1();
 				}
 			}		
 			if (gate1ProbTrigger.process(params[GATE1_PROB_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					else
-						attributes[seqIndexEdit][stepIndexEdit].toggleGate1P();
+						sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate1P();
 				}
 			}		
 			if (gate2Trigger.process(params[GATE2_PARAM].getValue() + (expanderPresent ? messagesFromExpander[1] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					attributes[seqIndexEdit][stepIndexEdit].toggleGate2();
+					sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate2();
 				}
 			}		
 			if (slideTrigger.process(params[SLIDE_BTN_PARAM].getValue() + (expanderPresent ? messagesFromExpander[3] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					else
-						attributes[seqIndexEdit][stepIndexEdit].toggleSlide();
+						sek.attributes[seqIndexEdit][stepIndexEdit].toggleSlide();
 				}
 			}		
 			if (tiedTrigger.process(params[TIE_PARAM].getValue() + (expanderPresent ? messagesFromExpander[2] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied()) {
-						deactivateTiedStep(seqIndexEdit, stepIndexEdit);
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+						sek.deactivateTiedStep(seqIndexEdit, stepIndexEdit, holdTiedNotes);
 					}
 					else {
-						activateTiedStep(seqIndexEdit, stepIndexEdit);
+						sek.activateTiedStep(seqIndexEdit, stepIndexEdit, holdTiedNotes);
 					}
 				}
 			}
@@ -1264,67 +1187,15 @@ struct PhraseSeq16 : Module {
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
-			if (clockTrigger.process(inputs[CLOCK_INPUT].getVoltage())) {
-				ppqnCount++;
-				if (ppqnCount >= pulsesPerStep)
-					ppqnCount = 0;
-
-				int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
-				if (ppqnCount == 0) {
-					float slideFromCV = 0.0f;
-					int oldStepIndexRun = stepIndexRun;
-					if (editingSequence) {
-						slideFromCV = cv[seqIndexEdit][stepIndexRun];
-						//bool seqLoopOver = 
-						moveIndexRunMode(&stepIndexRun, sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
-						// if (seqLoopOver && stopAtEndOfSong) {
-							// running = false;
-							// stepIndexRun = oldStepIndexRun;
-						// }
-					}
-					else {
-						slideFromCV = cv[phrase[phraseIndexRun]][stepIndexRun];
-						
-						if (moveIndexRunMode(&stepIndexRun, sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
-							int oldPhraseIndexRun = phraseIndexRun;
-							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
-							// check for end of song if needed
-							if (songLoopOver && stopAtEndOfSong) {
-								running = false;
-								stepIndexRun = oldStepIndexRun;
-								phraseIndexRun = oldPhraseIndexRun;
-							}
-							else {
-								stepIndexRun = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
-							}
-						}
-						newSeq = phrase[phraseIndexRun];
-					}
-					
-					// Slide
-					if (attributes[newSeq][stepIndexRun].getSlide()) {
-						slideStepsRemain =   (unsigned long) (((float)clockPeriod * pulsesPerStep) * params[SLIDE_KNOB_PARAM].getValue() / 2.0f);
-						if (slideStepsRemain != 0ul) {
-							float slideToCV = cv[newSeq][stepIndexRun];
-							slideCVdelta = (slideToCV - slideFromCV)/(float)slideStepsRemain;
-						}
-					}
-					else
-						slideStepsRemain = 0ul;
-				}
-				else {
-					if (!editingSequence)
-						newSeq = phrase[phraseIndexRun];
-				}
-				calcGate1Code(attributes[newSeq][stepIndexRun]);
-				gate2Code = calcGate2Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep);
-				clockPeriod = 0ul;				
+			if (clockTrigger.process(clockBusSubscriber.getClock(inputs[CLOCK_INPUT]))) {
+				if (sek.clockStep(editingSequence, seqIndexEdit, stopAtEndOfSong, params[GATE1_KNOB_PARAM].getValue(), params[SLIDE_KNOB_PARAM].getValue()))
+					running = false;// end of song
 			}
-			clockPeriod++;
+			sek.process();
 		}	
 		
 		// Reset
-		if (resetTrigger.process(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue())) {
+		if (resetTrigger.process(clockBusSubscriber.getReset(inputs[RESET_INPUT]) + params[RESET_PARAM].getValue())) {
 			initRun();// must be after sequence reset
 			resetLight = 1.0f;
 			displayState = DISP_NORMAL;
@@ -1337,24 +1208,22 @@ struct PhraseSeq16 : Module {
 		//********** Outputs and lights **********
 				
 		// CV and gates outputs
-		int seq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
-		int step = (editingSequence && !running) ? stepIndexEdit : stepIndexRun;
+		int seq = editingSequence ? seqIndexEdit : sek.phrase[sek.phraseIndexRun];
+		int step = (editingSequence && !running) ? stepIndexEdit : sek.stepIndexRun[0];
 		if (running) {
 			bool muteGate1 = !editingSequence && ((params[GATE1_PARAM].getValue() + (expanderPresent ? messagesFromExpander[0] : 0.0f)) > 0.5f);// live mute
 			bool muteGate2 = !editingSequence && ((params[GATE2_PARAM].getValue() + (expanderPresent ? messagesFromExpander[1] : 0.0f)) > 0.5f);// live mute
-			float slideOffset = (slideStepsRemain > 0ul ? (slideCVdelta * (float)slideStepsRemain) : 0.0f);
-			outputs[CV_OUTPUT].setVoltage(cv[seq][step] - slideOffset);
+			outputs[CV_OUTPUT].setVoltage(sek.calcCvOutput(seq, 0));
 			bool retriggingOnReset = (clockIgnoreOnReset != 0l && retrigGatesOnReset);
-			outputs[GATE1_OUTPUT].setVoltage((calcGate(gate1Code, clockTrigger, clockPeriod, sampleRate) && !muteGate1 && !retriggingOnReset) ? 10.0f : 0.0f);
-			outputs[GATE2_OUTPUT].setVoltage((calcGate(gate2Code, clockTrigger, clockPeriod, sampleRate) && !muteGate2 && !retriggingOnReset) ? 10.0f : 0.0f);
+			outputs[GATE1_OUTPUT].setVoltage((sek.calcGate1Output(0, clockTrigger, sampleRate) && !muteGate1 && !retriggingOnReset) ? 10.0f : 0.0f);
+			outputs[GATE2_OUTPUT].setVoltage((sek.calcGate2Output(0, clockTrigger, sampleRate) && !muteGate2 && !retriggingOnReset) ? 10.0f : 0.0f);
 		}
 		else {// not running
-			outputs[CV_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : cv[seq][step]);
+			outputs[CV_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : sek.cv[seq][step]);
 			outputs[GATE1_OUTPUT].setVoltage((editingGate > 0ul) ? 10.0f : 0.0f);
 			outputs[GATE2_OUTPUT].setVoltage((editingGate > 0ul) ? 10.0f : 0.0f);
 		}
-		if (slideStepsRemain > 0ul)
-			slideStepsRemain--;
+		sek.decSlideStepsRemain();
 		
 		// lights
 		if (refresh.processLights()) {
@@ -1369,31 +1238,31 @@ struct PhraseSeq16 : Module {
 				}
 				else if (displayState == DISP_LENGTH) {
 					if (editingSequence) {
-						if (i < (sequences[seqIndexEdit].getLength() - 1))
+						if (i < (sek.sequences[seqIndexEdit].getLength() - 1))
 							green = 0.32f;
-						else if (i == (sequences[seqIndexEdit].getLength() - 1))
+						else if (i == (sek.sequences[seqIndexEdit].getLength() - 1))
 							green = 1.0f;
 					}
 					else {
-						if (i < phrases - 1)
+						if (i < sek.phrases - 1)
 							green = 0.32f;
 						else
-							green = (i == phrases - 1) ? 1.0f : 0.0f;
+							green = (i == sek.phrases - 1) ? 1.0f : 0.0f;
 					}					
 				}
 				else if (displayState == DISP_TRANSPOSE) {
 					red = 0.71f;
 				}
 				else if (displayState == DISP_ROTATE) {
-					red = (i == stepIndexEdit ? 1.0f : (i < sequences[seqIndexEdit].getLength() ? 0.45f : 0.0f));
+					red = (i == stepIndexEdit ? 1.0f : (i < sek.sequences[seqIndexEdit].getLength() ? 0.45f : 0.0f));
 				}
 				else {// normal led display (i.e. not length)
 					// Run cursor (green)
 					if (editingSequence)
-						green = ((running && (i == stepIndexRun)) ? 1.0f : 0.0f);
+						green = ((running && (i == sek.stepIndexRun[0])) ? 1.0f : 0.0f);
 					else {
-						green = ((running && (i == phraseIndexRun)) ? 1.0f : 0.0f);
-						green += ((running && (i == stepIndexRun) && i != phraseIndexEdit) ? 0.42f : 0.0f);
+						green = ((running && (i == sek.phraseIndexRun)) ? 1.0f : 0.0f);
+						green += ((running && (i == sek.stepIndexRun[0]) && i != phraseIndexEdit) ? 0.42f : 0.0f);
 						green = std::min(green, 1.0f);
 					}
 					// Edit cursor (red)
@@ -1403,9 +1272,9 @@ struct PhraseSeq16 : Module {
 						red = (i == phraseIndexEdit ? 1.0f : 0.0f);						
 					bool gate = false;
 					if (editingSequence)
-						gate = attributes[seqIndexEdit][i].getGate1();
+						gate = sek.attributes[seqIndexEdit][i].getGate1();
 					else if (!editingSequence && (attached && running))
-						gate = attributes[phrase[phraseIndexRun]][i].getGate1();
+						gate = sek.attributes[sek.phrase[sek.phraseIndexRun]][i].getGate1();
 					white = ((green == 0.0f && red == 0.0f && gate && displayState != DISP_MODE) ? 0.15f : 0.0f);
 					if (editingSequence && white != 0.0f) {
 						green = 0.14f; white = 0.0f;
@@ -1416,7 +1285,7 @@ struct PhraseSeq16 : Module {
 			}
 		
 			// Octave lights
-			float cvVal = editingSequence ? cv[seqIndexEdit][stepIndexEdit] : cv[phrase[phraseIndexEdit]][stepIndexRun];
+			float cvVal = editingSequence ? sek.cv[seqIndexEdit][stepIndexEdit] : sek.cv[sek.phrase[phraseIndexEdit]][sek.stepIndexRun[0]];
 			int keyLightIndex;
 			int octLightIndex;
 			calcNoteAndOct(cvVal, &keyLightIndex, &octLightIndex);
@@ -1439,7 +1308,7 @@ struct PhraseSeq16 : Module {
 			// Keyboard lights
 			if (editingPpqn != 0) {
 				for (int i = 0; i < 12; i++) {
-					if (keyIndexToGateMode(i, pulsesPerStep) != -1) {
+					if (keyIndexToGateMode(i, sek.pulsesPerStep) != -1) {
 						setGreenRed(KEY_LIGHTS + i * 2, 1.0f, 1.0f);
 					}
 					else {
@@ -1448,7 +1317,8 @@ struct PhraseSeq16 : Module {
 				}
 			} 
 			else if (editingGateLength != 0l && editingSequence) {
-				int modeLightIndex = gateModeToKeyLightIndex(attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
+				int modeLightIndex = gateModeToKeyLightIndex(sek.attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
+				float modeLightDim = gateModeToKeyLightDim(sek.attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
 				for (int i = 0; i < 12; i++) {
 					float green = editingGateLength > 0l ? 1.0f : 0.45f;
 					float red = editingGateLength > 0l ? 0.45f : 1.0f;
@@ -1462,7 +1332,7 @@ struct PhraseSeq16 : Module {
 					}
 					else {
 						if (i == modeLightIndex) {
-							setGreenRed(KEY_LIGHTS + i * 2, green, red);
+							setGreenRed(KEY_LIGHTS + i * 2, green * modeLightDim, red * modeLightDim);
 						}
 						else { // show dim note if gatetype is different than note
 							setGreenRed(KEY_LIGHTS + i * 2, 0.0f, (i == keyLightIndex ? 0.32f : 0.0f));
@@ -1512,9 +1382,9 @@ struct PhraseSeq16 : Module {
 				lights[TIE_LIGHT].setBrightness(0.0f);
 			}
 			else {
-				StepAttributes attributesVal = attributes[seqIndexEdit][stepIndexEdit];
+				StepAttributes attributesVal = sek.attributes[seqIndexEdit][stepIndexEdit];
 				if (!editingSequence)
-					attributesVal = attributes[phrase[phraseIndexEdit]][stepIndexRun];
+					attributesVal = sek.attributes[sek.phrase[phraseIndexEdit]][sek.stepIndexRun[0]];
 				//
 				setGateLight(attributesVal.getGate1(), GATE1_LIGHT);
 				setGateLight(attributesVal.getGate2(), GATE2_LIGHT);
@@ -1588,47 +1458,6 @@ struct PhraseSeq16 : Module {
 		lights[id + 1].setBrightness(red);
 	}
 
-	inline void propagateCVtoTied(int seqn, int stepn) {
-		for (int i = stepn + 1; i < 16; i++) {
-			if (!attributes[seqn][i].getTied())
-				break;
-			cv[seqn][i] = cv[seqn][i - 1];
-		}	
-	}
-
-	void activateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(true);
-		if (stepn > 0) {
-			propagateCVtoTied(seqn, stepn - 1);
-		
-			if (holdTiedNotes) {// new method
-				attributes[seqn][stepn].setGate1(true);
-				for (int i = stepn; i < 16 && attributes[seqn][i].getTied(); i++) {
-					attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
-					attributes[seqn][i - 1].setGate1Mode(5);
-					attributes[seqn][i - 1].setGate1(true);
-				}
-			}
-			else {// old method
-				//if (stepn > 0) {
-					attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-					attributes[seqn][stepn].setTied(true);
-				//}
-			}
-		}
-	}
-	
-	void deactivateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(false);
-		if (holdTiedNotes && stepn != 0) {// new method
-			int lastGateType = attributes[seqn][stepn].getGate1Mode();
-			for (int i = stepn + 1; i < 16 && attributes[seqn][i].getTied(); i++)
-				lastGateType = attributes[seqn][i].getGate1Mode();
-			attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
-		}
-		//else old method, nothing to do
-	}
-	
 	inline void setGateLight(bool gateOn, int lightIndex) {
 		if (!gateOn) {
 			lights[lightIndex + 0].setBrightness(0.0f);
@@ -1683,7 +1512,7 @@ struct PhraseSeq16Widget : ModuleWidget {
 					if ((!module->running || !module->attached) && !module->isEditingSequence()) {
 						module->phraseIndexEdit = moveIndex(module->phraseIndexEdit, module->phraseIndexEdit + 1, 16);
 						if (!module->running)
-							module->phraseIndexRun = module->phraseIndexEdit;
+							module->sek.phraseIndexRun = module->phraseIndexEdit;
 					}
 				}
 				if (num != -1) {
@@ -1702,9 +1531,9 @@ struct PhraseSeq16Widget : ModuleWidget {
 					else if (module->displayState == PhraseSeq16::DISP_LENGTH) {
 						totalNum = clamp(totalNum, 1, 16);
 						if (editingSequence)
-							module->sequences[module->seqIndexEdit].setLength(totalNum);
+							module->sek.sequences[module->seqIndexEdit].setLength(totalNum);
 						else
-							module->phrases = totalNum;
+							module->sek.phrases = totalNum;
 					}
 					else if (module->displayState == PhraseSeq16::DISP_TRANSPOSE) {
 					}
@@ -1718,7 +1547,7 @@ struct PhraseSeq16Widget : ModuleWidget {
 						}
 						else {
 							if (!module->attached || !module->running)
-								module->phrase[module->phraseIndexEdit] = totalNum - 1;
+								module->sek.phrase[module->phraseIndexEdit] = totalNum - 1;
 						}
 
 					}
@@ -1778,33 +1607,33 @@ struct PhraseSeq16Widget : ModuleWidget {
 						}
 					}
 					else if (module->editingPpqn != 0ul) {
-						snprintf(displayStr, 16, "x%2u", (unsigned) module->pulsesPerStep);
+						snprintf(displayStr, 16, "x%2u", (unsigned) module->sek.pulsesPerStep);
 					}
 					else if (module->displayState == PhraseSeq16::DISP_MODE) {
 						if (editingSequence)
-							runModeToStr(module->sequences[module->seqIndexEdit].getRunMode());
+							runModeToStr(module->sek.sequences[module->seqIndexEdit].getRunMode());
 						else
-							runModeToStr(module->runModeSong);
+							runModeToStr(module->sek.runModeSong);
 					}
 					else if (module->displayState == PhraseSeq16::DISP_LENGTH) {
 						if (editingSequence)
-							snprintf(displayStr, 16, "L%2u", (unsigned) module->sequences[module->seqIndexEdit].getLength());
+							snprintf(displayStr, 16, "L%2u", (unsigned) module->sek.sequences[module->seqIndexEdit].getLength());
 						else
-							snprintf(displayStr, 16, "L%2u", (unsigned) module->phrases);
+							snprintf(displayStr, 16, "L%2u", (unsigned) module->sek.phrases);
 					}
 					else if (module->displayState == PhraseSeq16::DISP_TRANSPOSE) {
-						snprintf(displayStr, 16, "+%2u", (unsigned) abs(module->sequences[module->seqIndexEdit].getTranspose()));
-						if (module->sequences[module->seqIndexEdit].getTranspose() < 0)
+						snprintf(displayStr, 16, "+%2u", (unsigned) abs(module->sek.sequences[module->seqIndexEdit].getTranspose()));
+						if (module->sek.sequences[module->seqIndexEdit].getTranspose() < 0)
 							displayStr[0] = '-';
 					}
 					else if (module->displayState == PhraseSeq16::DISP_ROTATE) {
-						snprintf(displayStr, 16, ")%2u", (unsigned) abs(module->sequences[module->seqIndexEdit].getRotate()));
-						if (module->sequences[module->seqIndexEdit].getRotate() < 0)
+						snprintf(displayStr, 16, ")%2u", (unsigned) abs(module->sek.sequences[module->seqIndexEdit].getRotate()));
+						if (module->sek.sequences[module->seqIndexEdit].getRotate() < 0)
 							displayStr[0] = '(';
 					}
 					else {// DISP_NORMAL
 						snprintf(displayStr, 16, " %2u", (unsigned) (editingSequence ? 
-							module->seqIndexEdit : module->phrase[module->phraseIndexEdit]) + 1 );
+							module->seqIndexEdit : module->sek.phrase[module->phraseIndexEdit]) + 1 );
 					}
 				}
 				nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
@@ -1892,6 +1721,8 @@ struct PhraseSeq16Widget : ModuleWidget {
 
 		menu->addChild(createBoolPtrMenuItem("AutoSeq when writing via CV inputs", "", &module->autoseq));
 
+		createClockBusMenu(menu, &module->clockBusSubscriber);
+
 		menu->addChild(new MenuSeparator());
 		menu->addChild(createMenuLabel("Actions"));
 		
@@ -1910,7 +1741,7 @@ struct PhraseSeq16Widget : ModuleWidget {
 				PhraseSeq16* module = static_cast<PhraseSeq16*>(paramQuantity->module);
 				// same code structure below as in sequence knob in main step()
 				if (module->editingPpqn != 0) {
-					module->pulsesPerStep = 1;
+					module->sek.pulsesPerStep = 1;
 					//editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 				else if (module->displayState == PhraseSeq16::DISP_MODE) {
@@ -1918,19 +1749,19 @@ struct PhraseSeq16Widget : ModuleWidget {
 						bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelPhraseSeqExpander);
 						const float *messagesFromExpander = static_cast<float*>(module->rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent						
 						if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
-							module->sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
+							module->sek.sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
 						}
 					}
 					else {
-						module->runModeSong = MODE_FWD;
+						module->sek.runModeSong = MODE_FWD;
 					}
 				}
 				else if (module->displayState == PhraseSeq16::DISP_LENGTH) {
 					if (module->isEditingSequence()) {
-						module->sequences[module->seqIndexEdit].setLength(16);
+						module->sek.sequences[module->seqIndexEdit].setLength(16);
 					}
 					else {
-						module->phrases = 4;
+						module->sek.phrases = 4;
 					}
 				}
 				else if (module->displayState == PhraseSeq16::DISP_TRANSPOSE) {
@@ -1946,7 +1777,7 @@ struct PhraseSeq16Widget : ModuleWidget {
 						}
 					}
 					else {
-						module->phrase[module->phraseIndexEdit] = 0;
+						module->sek.phrase[module->phraseIndexEdit] = 0;
 					}
 				}
 			}
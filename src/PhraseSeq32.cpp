@@ -12,7 +12,9 @@
 //***********************************************************************************************
 
 
-#include "PhraseSeqUtil.hpp"
+#include "PhraseSeqKernel.hpp"
+#include "JsonHandoff.hpp"
+#include "PackedData.hpp"
 #include "comp/PianoKey.hpp"
 
 
@@ -92,31 +94,28 @@ struct PhraseSeq32 : Module {
 
 	// Constants
 	enum DisplayStateIds {DISP_NORMAL, DISP_MODE, DISP_LENGTH, DISP_TRANSPOSE, DISP_ROTATE};
+	static const uint8_t packedVersion = 1;// format of the packed "stepData" blob
 
 
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	bool packedPatchData = false;// steps saved as one packed blob instead of json arrays
 	
 	// Need to save, with reset
 	bool autoseq;
 	bool autostepLen;
 	bool holdTiedNotes;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-G6, 2 is TrigIncr
-	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
+	PhraseSeqKernel<32, 32, 2> sek;// steps, song and run state
 	bool running;
-	int runModeSong;
 	int stepIndexEdit;
 	int seqIndexEdit;
 	int phraseIndexEdit;
-	int phrases;//1 to 32
-	SeqAttributes sequences[32];
-	int phrase[32];// This is the song (series of phases; a phrase is a patten number)
-	float cv[32][32];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
-	StepAttributes attributes[32][32];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
 	bool resetOnRun;
 	bool attached;
 	bool stopAtEndOfSong;
+	ClockBusSubscriber clockBusSubscriber;// unpatched run, clock and reset inputs can follow the clock master
 
 	// No need to save, with reset
 	int displayState;
@@ -130,7 +129,6 @@ struct PhraseSeq32 : Module {
 	unsigned long editingGate;// 0 when no edit gate, downward step counter timer when edit gate
 	unsigned long editingType;// similar to editingGate, but just for showing remanent gate type (nothing played); uses editingGateKeyLight
 	long infoCopyPaste;// 0 when no info, positive downward step counter timer when copy, negative upward when paste
-	unsigned long clockPeriod;// counts number of step() calls upward from last clock (reset after clock processed)
 	long tiedWarning;// 0 when no warning, positive downward step counter timer when warning
 	long attachedWarning;// 0 when no warning, positive downward step counter timer when warning
 	long revertDisplay;
@@ -139,20 +137,10 @@ struct PhraseSeq32 : Module {
 	long editingPpqn;// 0 when no info, positive downward step counter timer when editing ppqn
 	int stepConfig;
 	long clockIgnoreOnReset;
-	int phraseIndexRun;	
-	unsigned long phraseIndexRunHistory;
-	int stepIndexRun[2];
-	unsigned long stepIndexRunHistory;
-	int ppqnCount;
-	int gate1Code[2];
-	int gate2Code[2];
-	bool lastProbGate1Enable[2];	
-	unsigned long slideStepsRemain[2];// 0 when no slide under way, downward step counter when sliding
 	
 	// No need to save, no reset
-	int stepConfigSync = 0;// 0 means no sync requested, 1 means synchronous read of lengths requested
 	RefreshCounter refresh;
-	float slideCVdelta[2];// no need to initialize, this is a companion to slideStepsRemain	
+	JsonHandoff<PhraseSeqData<32, 32>> jsonHandoff;// steps and song loaded by dataFromJson(), adopted by process()
 	float editingGateCV;// no need to initialize, this is a companion to editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight;// no need to initialize, this is a companion to editingGate (use this only when editingGate > 0)
 	int editingChannel;// 0 means channel A, 1 means channel B. no need to initialize, this is a companion to editingGate
@@ -181,7 +169,6 @@ struct PhraseSeq32 : Module {
 	Trigger keyGateTrigger;
 	Trigger seqCVTrigger;
 	HoldDetect modeHoldDetect;
-	SeqAttributes seqAttribBuffer[32];// buffer from Json for thread safety
 	PianoKeyInfo pkInfo;
 
 
@@ -191,23 +178,16 @@ struct PhraseSeq32 : Module {
 	}
 
 	
-	void fillStepIndexRunVector(int runMode, int len) {
-		if (runMode != MODE_RN2) 
-			stepIndexRun[1] = stepIndexRun[0];
-		else
-			stepIndexRun[1] = random::u32() % len;
-	}
-	
 	void moveStepIndexEdit(int delta, bool _autostepLen) {// 2nd param is for rotate that uses this method also
 		if (stepConfig == 2 || !_autostepLen) // 32
-			stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, _autostepLen ? sequences[seqIndexEdit].getLength() : 32);
+			stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, _autostepLen ? sek.sequences[seqIndexEdit].getLength() : 32);
 		else {// here 1x16 and _autostepLen limit wanted
 			if (stepIndexEdit < 16) {
-				stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, sequences[seqIndexEdit].getLength());
+				stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, sek.sequences[seqIndexEdit].getLength());
 				if (stepIndexEdit == 0) stepIndexEdit = 16;
 			}
 			else
-				stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, sequences[seqIndexEdit].getLength() + 16);
+				stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, sek.sequences[seqIndexEdit].getLength() + 16);
 		}
 	}
 	
@@ -279,9 +259,6 @@ struct PhraseSeq32 : Module {
 		configOutput(GATE1B_OUTPUT, "Track B Gate 1");
 		configOutput(GATE2B_OUTPUT, "Track B Gate 2");
 
-		for (int i = 0; i < 32; i++) {
-			seqAttribBuffer[i].init(16, MODE_FWD);
-		}
 		onReset();
 		
 		loadThemeAndContrastFromDefault(&panelTheme, &panelContrast);
@@ -289,31 +266,22 @@ struct PhraseSeq32 : Module {
 
 	
 	void onReset() override final {
+		clockBusSubscriber.init();
 		autoseq = false;
 		autostepLen = false;
 		holdTiedNotes = true;
 		seqCVmethod = 0;// 0 is 0-10V, 1 is C4-G6, 2 is TrigIncr
-		pulsesPerStep = 1;
 		running = true;
-		runModeSong = MODE_FWD;
 		stepIndexEdit = 0;
 		seqIndexEdit = 0;
 		phraseIndexEdit = 0;
-		phrases = 4;
-		for (int i = 0; i < 32; i++) {
-			sequences[i].init(16 * getStepConfig(), MODE_FWD);
-			phrase[i] = 0;
-			for (int s = 0; s < 32; s++) {
-				cv[i][s] = 0.0f;
-				attributes[i][s].init();
-			}
-		}
+		sek.onReset(16 * getStepConfig());
 		resetOnRun = false;
 		attached = false;
 		stopAtEndOfSong = false;
-		resetNonJson(false);
+		resetNonJson();
 	}
-	void resetNonJson(bool delayed) {// delay thread sensitive parts (i.e. schedule them so that process() will do them)
+	void resetNonJson() {
 		displayState = DISP_NORMAL;
 		for (int i = 0; i < 32; i++) {
 			cvCPbuffer[i] = 0.0f;
@@ -327,49 +295,30 @@ struct PhraseSeq32 : Module {
 		editingGate = 0ul;
 		editingType = 0ul;
 		infoCopyPaste = 0l;
-		clockPeriod = 0ul;
+		sek.clockPeriod = 0ul;
 		tiedWarning = 0ul;
 		attachedWarning = 0l;
 		revertDisplay = 0l;
 		editingGateLength = 0l;
 		lastGateEdit = 1l;
 		editingPpqn = 0l;
-		if (delayed) {
-			stepConfigSync = 1;// signal a sync from dataFromJson so that step will get lengths from seqAttribBuffer
-		}
-		else {
-			stepConfig = getStepConfig();
-			initRun();
-		}
+		stepConfig = getStepConfig();
+		sek.rows = (stepConfig == 1 ? 2 : 1);
+		initRun();
 	}
 	void initRun() {// run button activated, or run edge in run input jack, or stepConfig switch changed, or fromJson()
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
-		phraseIndexRunHistory = 0;
-
-		int seq = (isEditingSequence() ? seqIndexEdit : phrase[phraseIndexRun]);
-		stepIndexRun[0] = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
-		fillStepIndexRunVector(sequences[seq].getRunMode(), sequences[seq].getLength());
-		stepIndexRunHistory = 0;
-
-		ppqnCount = 0;
-		for (int i = 0; i < 2; i += stepConfig) {
-			lastProbGate1Enable[i] = true;
-			calcGate1Code(attributes[seq][(i * 16) + stepIndexRun[i]], i);
-			gate2Code[i] = calcGate2Code(attributes[seq][(i * 16) + stepIndexRun[i]], 0, pulsesPerStep);
-		}
-		slideStepsRemain[0] = 0ul;
-		slideStepsRemain[1] = 0ul;
+		sek.initRun(isEditingSequence(), seqIndexEdit, params[GATE1_KNOB_PARAM].getValue());
 	}	
 
 	
 	void onRandomize() override {
 		if (isEditingSequence()) {
 			for (int s = 0; s < 32; s++) {
-				cv[seqIndexEdit][s] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
-				attributes[seqIndexEdit][s].randomize();
+				sek.cv[seqIndexEdit][s] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
+				sek.attributes[seqIndexEdit][s].randomize();
 			}
-			sequences[seqIndexEdit].randomize(16 * stepConfig, NUM_MODES);// ok to use stepConfig since CONFIG_PARAM is not randomizable		
+			sek.sequences[seqIndexEdit].randomize(16 * stepConfig, NUM_MODES);// ok to use stepConfig since CONFIG_PARAM is not randomizable		
 		}
 	}
 	
@@ -377,12 +326,19 @@ struct PhraseSeq32 : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// steps and song are those loaded by dataFromJson() when process() has not adopted them yet
+		PhraseSeqData<32, 32>* pendingData = jsonHandoff.peekPending();
+		PhraseSeqData<32, 32>* sd = (pendingData != nullptr ? pendingData : &sek);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
 		// panelContrast
 		json_object_set_new(rootJ, "panelContrast", json_real(panelContrast));
 
+		// packedPatchData
+		json_object_set_new(rootJ, "packedPatchData", json_boolean(packedPatchData));
+
 		// autostepLen
 		json_object_set_new(rootJ, "autostepLen", json_boolean(autostepLen));
 		
@@ -396,13 +352,13 @@ struct PhraseSeq32 : Module {
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
 
 		// pulsesPerStep
-		json_object_set_new(rootJ, "pulsesPerStep", json_integer(pulsesPerStep));
+		json_object_set_new(rootJ, "pulsesPerStep", json_integer(sd->pulsesPerStep));
 
 		// running
 		json_object_set_new(rootJ, "running", json_boolean(running));
 		
 		// runModeSong
-		json_object_set_new(rootJ, "runModeSong3", json_integer(runModeSong));
+		json_object_set_new(rootJ, "runModeSong3", json_integer(sd->runModeSong));
 
 		// seqIndexEdit
 		json_object_set_new(rootJ, "sequence", json_integer(seqIndexEdit));
@@ -410,27 +366,40 @@ struct PhraseSeq32 : Module {
 		// phrase 
 		json_t *phraseJ = json_array();
 		for (int i = 0; i < 32; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
+			json_array_insert_new(phraseJ, i, json_integer(sd->phrase[i]));
 		json_object_set_new(rootJ, "phrase", phraseJ);
 
 		// phrases
-		json_object_set_new(rootJ, "phrases", json_integer(phrases));
+		json_object_set_new(rootJ, "phrases", json_integer(sd->phrases));
 
-		// CV
-		json_t *cvJ = json_array();
-		for (int i = 0; i < 32; i++)
-			for (int s = 0; s < 32; s++) {
-				json_array_insert_new(cvJ, s + (i * 32), json_real(cv[i][s]));
-			}
-		json_object_set_new(rootJ, "cv", cvJ);
+		if (packedPatchData) {
+			// CV and attributes
+			PackedWriter writer;
+			writer.bytes.reserve(32 * 32 * 6);
+			for (int i = 0; i < 32; i++)
+				for (int s = 0; s < 32; s++) {
+					writer.f32(sd->cv[i][s]);
+					writer.u16(sd->attributes[i][s].getAttribute());
+				}
+			packedToJson(rootJ, "stepData", packedVersion, writer);
+		}
+		else {
+			// CV
+			json_t *cvJ = json_array();
+			for (int i = 0; i < 32; i++)
+				for (int s = 0; s < 32; s++) {
+					json_array_insert_new(cvJ, s + (i * 32), json_real(sd->cv[i][s]));
+				}
+			json_object_set_new(rootJ, "cv", cvJ);
 
-		// attributes
-		json_t *attributesJ = json_array();
-		for (int i = 0; i < 32; i++)
-			for (int s = 0; s < 32; s++) {
-				json_array_insert_new(attributesJ, s + (i * 32), json_integer(attributes[i][s].getAttribute()));
-			}
-		json_object_set_new(rootJ, "attributes", attributesJ);
+			// attributes
+			json_t *attributesJ = json_array();
+			for (int i = 0; i < 32; i++)
+				for (int s = 0; s < 32; s++) {
+					json_array_insert_new(attributesJ, s + (i * 32), json_integer(sd->attributes[i][s].getAttribute()));
+				}
+			json_object_set_new(rootJ, "attributes", attributesJ);
+		}
 
 		// attached
 		json_object_set_new(rootJ, "attached", json_boolean(attached));
@@ -450,14 +419,24 @@ struct PhraseSeq32 : Module {
 		// sequences
 		json_t *sequencesJ = json_array();
 		for (int i = 0; i < 32; i++)
-			json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
+			json_array_insert_new(sequencesJ, i, json_integer(sd->sequences[i].getSeqAttrib()));
 		json_object_set_new(rootJ, "sequences", sequencesJ);
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
+		// clockBusSource
+		clockBusSubscriber.dataToJson(rootJ);
+
 		return rootJ;
 	}
 
 	
 	void dataFromJson(json_t *rootJ) override {
+		// steps and song are parsed into the handoff buffer, process() adopts them when they are all there
+		PhraseSeqData<32, 32>* sd = jsonHandoff.beginWrite();
+		sd->init(16 * getStepConfig());
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -468,6 +447,11 @@ struct PhraseSeq32 : Module {
 		if (panelContrastJ)
 			panelContrast = json_number_value(panelContrastJ);
 
+		// packedPatchData
+		json_t *packedPatchDataJ = json_object_get(rootJ, "packedPatchData");
+		if (packedPatchDataJ)
+			packedPatchData = json_is_true(packedPatchDataJ);
+
 		// autostepLen
 		json_t *autostepLenJ = json_object_get(rootJ, "autostepLen");
 		if (autostepLenJ)
@@ -478,6 +462,9 @@ struct PhraseSeq32 : Module {
 		if (autoseqJ)
 			autoseq = json_is_true(autoseqJ);
 
+		// clockBusSource
+		clockBusSubscriber.dataFromJson(rootJ);
+
 		// holdTiedNotes
 		json_t *holdTiedNotesJ = json_object_get(rootJ, "holdTiedNotes");
 		if (holdTiedNotesJ)
@@ -493,7 +480,7 @@ struct PhraseSeq32 : Module {
 		// pulsesPerStep
 		json_t *pulsesPerStepJ = json_object_get(rootJ, "pulsesPerStep");
 		if (pulsesPerStepJ)
-			pulsesPerStep = json_integer_value(pulsesPerStepJ);
+			sd->pulsesPerStep = json_integer_value(pulsesPerStepJ);
 
 		// running
 		json_t *runningJ = json_object_get(rootJ, "running");
@@ -507,7 +494,7 @@ struct PhraseSeq32 : Module {
 			{
 				json_t *sequencesArrayJ = json_array_get(sequencesJ, i);
 				if (sequencesArrayJ)
-					seqAttribBuffer[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
+					sd->sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
 			}			
 		}
 		else {// legacy
@@ -561,21 +548,21 @@ struct PhraseSeq32 : Module {
 			
 			// now write into new object
 			for (int i = 0; i < 32; i++) {
-				seqAttribBuffer[i].init(lengths[i], runModeSeq[i]);
-				seqAttribBuffer[i].setTranspose(transposeOffsets[i]);
+				sd->sequences[i].init(lengths[i], runModeSeq[i]);
+				sd->sequences[i].setTranspose(transposeOffsets[i]);
 			}
 		}
 		
 		// runModeSong
 		json_t *runModeSongJ = json_object_get(rootJ, "runModeSong3");
 		if (runModeSongJ)
-			runModeSong = json_integer_value(runModeSongJ);
+			sd->runModeSong = json_integer_value(runModeSongJ);
 		else {// legacy
 			runModeSongJ = json_object_get(rootJ, "runModeSong");
 			if (runModeSongJ) {
-				runModeSong = json_integer_value(runModeSongJ);
-				if (runModeSong >= MODE_PEN)// this mode was not present in original version
-					runModeSong++;
+				sd->runModeSong = json_integer_value(runModeSongJ);
+				if (sd->runModeSong >= MODE_PEN)// this mode was not present in original version
+					sd->runModeSong++;
 			}
 		}
 		
@@ -591,34 +578,46 @@ struct PhraseSeq32 : Module {
 			{
 				json_t *phraseArrayJ = json_array_get(phraseJ, i);
 				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
+					sd->phrase[i] = json_integer_value(phraseArrayJ);
 			}
 		
 		// phrases
 		json_t *phrasesJ = json_object_get(rootJ, "phrases");
 		if (phrasesJ)
-			phrases = json_integer_value(phrasesJ);
+			sd->phrases = json_integer_value(phrasesJ);
 		
-		// CV
-		json_t *cvJ = json_object_get(rootJ, "cv");
-		if (cvJ) {
+		std::vector<uint8_t> payload;
+		if (packedFromJson(rootJ, "stepData", packedVersion, &payload) && payload.size() == 32 * 32 * 6) {
+			// CV and attributes
+			PackedReader reader(payload);
 			for (int i = 0; i < 32; i++)
 				for (int s = 0; s < 32; s++) {
-					json_t *cvArrayJ = json_array_get(cvJ, s + (i * 32));
-					if (cvArrayJ)
-						cv[i][s] = json_number_value(cvArrayJ);
+					sd->cv[i][s] = reader.f32();
+					sd->attributes[i][s].setAttribute(reader.u16());
 				}
 		}
-		
-		// attributes
-		json_t *attributesJ = json_object_get(rootJ, "attributes");
-		if (attributesJ) {
-			for (int i = 0; i < 32; i++)
-				for (int s = 0; s < 32; s++) {
-					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 32));
-					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
-				}
+		else {// no valid packed blob, use the legacy arrays
+			// CV
+			json_t *cvJ = json_object_get(rootJ, "cv");
+			if (cvJ) {
+				for (int i = 0; i < 32; i++)
+					for (int s = 0; s < 32; s++) {
+						json_t *cvArrayJ = json_array_get(cvJ, s + (i * 32));
+						if (cvArrayJ)
+							sd->cv[i][s] = json_number_value(cvArrayJ);
+					}
+			}
+			
+			// attributes
+			json_t *attributesJ = json_object_get(rootJ, "attributes");
+			if (attributesJ) {
+				for (int i = 0; i < 32; i++)
+					for (int s = 0; s < 32; s++) {
+						json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 32));
+						if (attributesArrayJ)
+							sd->attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
+					}
+			}
 		}
 		
 		// attached
@@ -646,25 +645,18 @@ struct PhraseSeq32 : Module {
 		if (phraseIndexEditJ)
 			phraseIndexEdit = json_integer_value(phraseIndexEditJ);
 		
-		resetNonJson(true);
+		jsonHandoff.endWrite();// process() adopts the steps and song, then calls resetNonJson()
 	}
 	
 	
 	IoStep* fillIoSteps(int *seqLenPtr) {// caller must delete return array
-		int seqLen = sequences[seqIndexEdit].getLength();
+		int seqLen = sek.sequences[seqIndexEdit].getLength();
 		IoStep* ioSteps = new IoStep[seqLen];
 		
 		int ofs16 = (stepIndexEdit >= 16 && stepConfig == 1 && seqLen <= 16) ? 16 : 0;// offset needed to grab correct seq when in 2x16  (last condition is safety)
 		
 		// populate ioSteps array
-		for (int i = 0; i < seqLen; i++) {
-			ioSteps[i].pitch = cv[seqIndexEdit][i + ofs16];
-			StepAttributes stepAttrib = attributes[seqIndexEdit][i + ofs16];
-			ioSteps[i].gate = stepAttrib.getGate1();
-			ioSteps[i].tied = stepAttrib.getTied();
-			ioSteps[i].vel = -1.0f;// no concept of velocity in PhraseSequencers
-			ioSteps[i].prob = stepAttrib.getGate1P() ? params[GATE1_KNOB_PARAM].getValue() : -1.0f;// negative means prob is not on for this note
-		}
+		sek.fillIoSteps(ioSteps, seqIndexEdit, ofs16, seqLen, params[GATE1_KNOB_PARAM].getValue());
 		
 		// return values 
 		*seqLenPtr = seqLen;
@@ -673,78 +665,12 @@ struct PhraseSeq32 : Module {
 	
 	
 	void emptyIoSteps(IoStep* ioSteps, int seqLen) {// seqLen is max 32 when in 1x32 and max 16 when in 2x16
-		sequences[seqIndexEdit].setLength(seqLen);
+		sek.sequences[seqIndexEdit].setLength(seqLen);
 		
 		int ofs16 = (stepIndexEdit >= 16 && stepConfig == 1 && seqLen <= 16) ? 16 : 0;// offset needed to put correct seq when in 2x16  (last condition is safety)
 		
 		// populate steps in the sequencer
-		// first pass is done without ties
-		for (int i = 0; i < seqLen; i++) {
-			cv[seqIndexEdit][i + ofs16] = ioSteps[i].pitch;
-			
- 			StepAttributes stepAttrib;
-			stepAttrib.init();
-			stepAttrib.setGate1(ioSteps[i].gate);
-			stepAttrib.setGate1P(ioSteps[i].prob >= 0.0f);
-			attributes[seqIndexEdit][i + ofs16] = stepAttrib;
-		}
-		// now do ties, has to be done in a separate pass such that non tied that follows tied can be 
-		//   there in advance for proper gate types
-		for (int i = 0; i < seqLen; i++) {
-			if (ioSteps[i].tied) {
-				activateTiedStep(seqIndexEdit, i);
-			}
-		}
-	}
-	
-
-	void rotateSeq(int seqNum, bool directionRight, int seqLength, bool chanB_16) {
-		// set chanB_16 to false to rotate chan A in 2x16 config (length will be <= 16) or single chan in 1x32 config (length will be <= 32)
-		// set chanB_16 to true  to rotate chan B in 2x16 config (length must be <= 16)
-		float rotCV;
-		StepAttributes rotAttributes;
-		int iStart = chanB_16 ? 16 : 0;
-		int iEnd = iStart + seqLength - 1;
-		int iRot = iStart;
-		int iDelta = 1;
-		if (directionRight) {
-			iRot = iEnd;
-			iDelta = -1;
-		}
-		rotCV = cv[seqNum][iRot];
-		rotAttributes = attributes[seqNum][iRot];
-		for ( ; ; iRot += iDelta) {
-			if (iDelta == 1 && iRot >= iEnd) break;
-			if (iDelta == -1 && iRot <= iStart) break;
-			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
-			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
-		}
-		cv[seqNum][iRot] = rotCV;
-		attributes[seqNum][iRot] = rotAttributes;
-	}
-	
-
-	void calcGate1Code(StepAttributes attribute, int index) {
-		int gateType = attribute.getGate1Mode();
-		
-		if (ppqnCount == 0 && !attribute.getTied()) {
-			lastProbGate1Enable[index] = !attribute.getGate1P() || (random::uniform() < params[GATE1_KNOB_PARAM].getValue()); // random::uniform is [0.0, 1.0), see include/util/common.hpp
-		}
-			
-		if (!attribute.getGate1() || !lastProbGate1Enable[index]) {
-			gate1Code[index] = 0;
-		}
-		else if (pulsesPerStep == 1 && gateType == 0) {
-			gate1Code[index] = 2;// clock high
-		}
-		else { 
-			if (gateType == 11) {
-				gate1Code[index] = (ppqnCount == 0 ? 3 : 0);
-			}
-			else {
-				gate1Code[index] = getAdvGate(ppqnCount, pulsesPerStep, gateType);
-			}
-		}
+		sek.emptyIoSteps(ioSteps, seqIndexEdit, ofs16, seqLen, holdTiedNotes);
 	}
 	
 
@@ -760,13 +686,22 @@ struct PhraseSeq32 : Module {
 		float *messagesFromExpander = static_cast<float*>(rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent
 
 		
+		// Steps and song loaded by dataFromJson()
+		if (jsonHandoff.adopt(&sek)) {
+			resetNonJson();
+		}
+
+
 		//********** Buttons, knobs, switches and inputs **********
 		
+		// Clock bus, read by the run, clock and reset inputs
+		clockBusSubscriber.update(id, args.frame);
+		
 		// Edit mode
 		bool editingSequence = isEditingSequence();// true = editing sequence, false = editing song
 		
 		// Run button
-		if (runningTrigger.process(params[RUN_PARAM].getValue() + inputs[RUNCV_INPUT].getVoltage())) {// no input refresh here, don't want to introduce startup skew
+		if (runningTrigger.process(params[RUN_PARAM].getValue() + clockBusSubscriber.getRun(inputs[RUNCV_INPUT]))) {// no input refresh here, don't want to introduce startup skew
 			running = !running;
 			if (running) {
 				if (resetOnRun) {
@@ -778,20 +713,14 @@ struct PhraseSeq32 : Module {
 
 		if (refresh.processInputs()) {
 			// Config switch
-			// switch may move in the pre-fromJson, but no problem, it will trigger the init lenght below, but then when
-			//    the lengths are loaded and we see the stepConfigSync request later,
-			//    they will get overwritten anyways. Is simultaneous, also ok.
+			// the switch is loaded before dataFromJson(), the lengths it loaded are kept since resetNonJson() reads the
+			//    switch when the steps and song are adopted
 			int oldStepConfig = stepConfig;
 			stepConfig = getStepConfig();
-			if (stepConfigSync != 0) {// sync from dataFromJson, so read lengths from seqAttribBuffer
-				for (int i = 0; i < 32; i++)
-					sequences[i].setSeqAttrib(seqAttribBuffer[i].getSeqAttrib());
-				initRun();			
-				stepConfigSync = 0;
-			}
-			else if (stepConfig != oldStepConfig) {// switch moved, so init lengths
+			sek.rows = (stepConfig == 1 ? 2 : 1);
+			if (stepConfig != oldStepConfig) {// switch moved, so init lengths
 				for (int i = 0; i < 32; i++)
-					sequences[i].setLength(16 * stepConfig);
+					sek.sequences[i].setLength(16 * stepConfig);
 				initRun();			
 			}				
 			
@@ -799,7 +728,7 @@ struct PhraseSeq32 : Module {
 			if (expanderPresent && editingSequence) {
 				float modeCVin = messagesFromExpander[4];
 				if (!std::isnan(modeCVin))
-					sequences[seqIndexEdit].setRunMode((int) clamp( std::round(modeCVin * ((float)NUM_MODES - 1.0f) / 10.0f), 0.0f, (float)NUM_MODES - 1.0f ));
+					sek.sequences[seqIndexEdit].setRunMode((int) clamp( std::round(modeCVin * ((float)NUM_MODES - 1.0f) / 10.0f), 0.0f, (float)NUM_MODES - 1.0f ));
 			}
 			
 			// Attach button
@@ -810,12 +739,12 @@ struct PhraseSeq32 : Module {
 			if (running && attached) {
 				if (editingSequence) {
 					if (stepIndexEdit >= 16 && stepConfig == 1)
-						stepIndexEdit = stepIndexRun[1] + 16;
+						stepIndexEdit = sek.stepIndexRun[1] + 16;
 					else
-						stepIndexEdit = stepIndexRun[0] + 0;
+						stepIndexEdit = sek.stepIndexRun[0] + 0;
 				}
 				else
-					phraseIndexEdit = phraseIndexRun;
+					phraseIndexEdit = sek.phraseIndexRun;
 			}
 			
 			// Copy button
@@ -831,15 +760,15 @@ struct PhraseSeq32 : Module {
 						countCP = std::min(8, 32 - startCP);
 					if (editingSequence) {
 						for (int i = 0, s = startCP; i < countCP; i++, s++) {
-							cvCPbuffer[i] = cv[seqIndexEdit][s];
-							attribCPbuffer[i] = attributes[seqIndexEdit][s];
+							cvCPbuffer[i] = sek.cv[seqIndexEdit][s];
+							attribCPbuffer[i] = sek.attributes[seqIndexEdit][s];
 						}
-						seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
+						seqAttribCPbuffer.setSeqAttrib(sek.sequences[seqIndexEdit].getSeqAttrib());
 						seqCopied = true;
 					}
 					else {
 						for (int i = 0, p = startCP; i < countCP; i++, p++)
-							phraseCPbuffer[i] = phrase[p];
+							phraseCPbuffer[i] = sek.phrase[p];
 						seqCopied = false;// so that a cross paste can be detected
 					}
 					infoCopyPaste = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
@@ -862,13 +791,13 @@ struct PhraseSeq32 : Module {
 					if (editingSequence) {
 						if (seqCopied) {// non-crossed paste (seq vs song)
 							for (int i = 0, s = startCP; i < countCP; i++, s++) {
-								cv[seqIndexEdit][s] = cvCPbuffer[i];
-								attributes[seqIndexEdit][s] = attribCPbuffer[i];
+								sek.cv[seqIndexEdit][s] = cvCPbuffer[i];
+								sek.attributes[seqIndexEdit][s] = attribCPbuffer[i];
 							}
 							if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
-								sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
-								if (sequences[seqIndexEdit].getLength() > 16 * stepConfig)
-									sequences[seqIndexEdit].setLength(16 * stepConfig);
+								sek.sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
+								if (sek.sequences[seqIndexEdit].getLength() > 16 * stepConfig)
+									sek.sequences[seqIndexEdit].setLength(16 * stepConfig);
 							}
 						}
 						else {// crossed paste to seq (seq vs song)
@@ -876,21 +805,21 @@ struct PhraseSeq32 : Module {
 								for (int s = 0; s < 32; s++) {
 									//cv[seqIndexEdit][s] = 0.0f;
 									//attributes[seqIndexEdit][s].init();
-									attributes[seqIndexEdit][s].toggleGate1();
+									sek.attributes[seqIndexEdit][s].toggleGate1();
 								}
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
+								sek.sequences[seqIndexEdit].setTranspose(0);
+								sek.sequences[seqIndexEdit].setRotate(0);
 							}
 							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize CVs)
 								for (int s = 0; s < 32; s++)
-									cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
+									sek.cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
+								sek.sequences[seqIndexEdit].setTranspose(0);
+								sek.sequences[seqIndexEdit].setRotate(0);
 							}
 							else {// 8 (randomize gate 1)
 								for (int s = 0; s < 32; s++)
 									if ( (random::u32() & 0x1) != 0)
-										attributes[seqIndexEdit][s].toggleGate1();
+										sek.attributes[seqIndexEdit][s].toggleGate1();
 							}
 							startCP = 0;
 							countCP = 32;
@@ -900,20 +829,20 @@ struct PhraseSeq32 : Module {
 					else {
 						if (!seqCopied) {// non-crossed paste (seq vs song)
 							for (int i = 0, p = startCP; i < countCP; i++, p++)
-								phrase[p] = phraseCPbuffer[i];
+								sek.phrase[p] = phraseCPbuffer[i];
 						}
 						else {// crossed paste to song (seq vs song)
 							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init phrases)
 								for (int p = 0; p < 32; p++)
-									phrase[p] = 0;
+									sek.phrase[p] = 0;
 							}
 							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (phrases increase from 1 to 32)
 								for (int p = 0; p < 32; p++)
-									phrase[p] = p;						
+									sek.phrase[p] = p;						
 							}
 							else {// 8 (randomize phrases)
 								for (int p = 0; p < 32; p++)
-									phrase[p] = random::u32() % 32;
+									sek.phrase[p] = random::u32() % 32;
 							}
 							startCP = 0;
 							countCP = 32;
@@ -931,9 +860,9 @@ struct PhraseSeq32 : Module {
 			bool writeTrig = writeTrigger.process(inputs[WRITE_INPUT].getVoltage());
 			if (writeTrig) {
 				if (editingSequence) {
-					if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {
-						cv[seqIndexEdit][stepIndexEdit] = inputs[CV_INPUT].getVoltage();
-						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+					if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+						sek.cv[seqIndexEdit][stepIndexEdit] = inputs[CV_INPUT].getVoltage();
+						sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 					}
 					editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					editingGateCV = inputs[CV_INPUT].getVoltage();// cv[seqIndexEdit][stepIndexEdit];
@@ -962,10 +891,10 @@ struct PhraseSeq32 : Module {
 				if (!running || !attached) {// don't move heads when attach and running
 					if (editingSequence) {
 						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, 32);
-						if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
+						if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
 							if (!writeTrig) {// in case autostep when simultaneous writeCV and stepCV (keep what was done in Write Input block above)
 								editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-								editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+								editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 								editingGateKeyLight = -1;
 								editingChannel = (stepIndexEdit >= 16 * stepConfig) ? 1 : 0;
 							}
@@ -974,7 +903,7 @@ struct PhraseSeq32 : Module {
 					else {
 						phraseIndexEdit = moveIndex(phraseIndexEdit, phraseIndexEdit + delta, 32);
 						if (!running)
-							phraseIndexRun = phraseIndexEdit;	
+							sek.phraseIndexRun = phraseIndexEdit;	
 					}						
 				}
 			}
@@ -988,18 +917,18 @@ struct PhraseSeq32 : Module {
 			if (stepPressed != -1) {
 				if (displayState == DISP_LENGTH) {
 					if (editingSequence)
-						sequences[seqIndexEdit].setLength((stepPressed % (16 * stepConfig)) + 1);
+						sek.sequences[seqIndexEdit].setLength((stepPressed % (16 * stepConfig)) + 1);
 					else
-						phrases = stepPressed + 1;
+						sek.phrases = stepPressed + 1;
 					revertDisplay = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 				else {
 					if (!running || !attached) {// not running or detached
 						if (editingSequence) {
 							stepIndexEdit = stepPressed;
-							if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
+							if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
 								editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-								editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+								editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 								editingGateKeyLight = -1;
 								editingChannel = (stepIndexEdit >= 16 * stepConfig) ? 1 : 0;
 							}
@@ -1007,16 +936,16 @@ struct PhraseSeq32 : Module {
 						else {
 							phraseIndexEdit = stepPressed;
 							if (!running)
-								phraseIndexRun = phraseIndexEdit;
+								sek.phraseIndexRun = phraseIndexEdit;
 						}
 					}
 					else {// attached and running
 						attachedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 						if (editingSequence) {
 							if (stepPressed >= 16 && stepConfig == 1)
-								stepIndexEdit = stepIndexRun[1] + 16;
+								stepIndexEdit = sek.stepIndexRun[1] + 16;
 							else
-								stepIndexEdit = stepIndexRun[0] + 0;
+								stepIndexEdit = sek.stepIndexRun[0] + 0;
 						}
 					}
 					displayState = DISP_NORMAL;
@@ -1065,50 +994,50 @@ struct PhraseSeq32 : Module {
 				if (abs(deltaKnob) <= 3) {// avoid discontinuous step (initialize for example)
 					// any changes in here should may also require right click behavior to be updated in the knob's onMouseDown()
 					if (editingPpqn != 0) {
-						pulsesPerStep = indexToPps(ppsToIndex(pulsesPerStep) + deltaKnob);// indexToPps() does clamping
+						sek.pulsesPerStep = indexToPps(ppsToIndex(sek.pulsesPerStep) + deltaKnob);// indexToPps() does clamping
 						editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 					else if (displayState == DISP_MODE) {
 						if (editingSequence) {
 							if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
-								sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, NUM_MODES - 1));
+								sek.sequences[seqIndexEdit].setRunMode(clamp(sek.sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, NUM_MODES - 1));
 							}
 						}
 						else {
-							runModeSong = clamp(runModeSong + deltaKnob, 0, 6 - 1);
+							sek.runModeSong = clamp(sek.runModeSong + deltaKnob, 0, 6 - 1);
 						}
 					}
 					else if (displayState == DISP_LENGTH) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setLength(clamp(sequences[seqIndexEdit].getLength() + deltaKnob, 1, (16 * stepConfig)));
+							sek.sequences[seqIndexEdit].setLength(clamp(sek.sequences[seqIndexEdit].getLength() + deltaKnob, 1, (16 * stepConfig)));
 						}
 						else {
-							phrases = clamp(phrases + deltaKnob, 1, 32);
+							sek.phrases = clamp(sek.phrases + deltaKnob, 1, 32);
 						}
 					}
 					else if (displayState == DISP_TRANSPOSE) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setTranspose(clamp(sequences[seqIndexEdit].getTranspose() + deltaKnob, -99, 99));
+							sek.sequences[seqIndexEdit].setTranspose(clamp(sek.sequences[seqIndexEdit].getTranspose() + deltaKnob, -99, 99));
 							float transposeOffsetCV = ((float)(deltaKnob))/12.0f;// Tranpose by deltaKnob number of semi-tones
 							if (stepConfig == 1){ // 2x16 (transpose only the 16 steps corresponding to row where stepIndexEdit is located)
 								int offset = stepIndexEdit < 16 ? 0 : 16;
 								for (int s = offset; s < offset + 16; s++) 
-									cv[seqIndexEdit][s] += transposeOffsetCV;
+									sek.cv[seqIndexEdit][s] += transposeOffsetCV;
 							}
 							else { // 1x32 (transpose all 32 steps)
 								for (int s = 0; s < 32; s++) 
-									cv[seqIndexEdit][s] += transposeOffsetCV;
+									sek.cv[seqIndexEdit][s] += transposeOffsetCV;
 							}
 						}
 					}
 					else if (displayState == DISP_ROTATE) {
 						if (editingSequence) {
-							int slength = sequences[seqIndexEdit].getLength();
+							int slength = sek.sequences[seqIndexEdit].getLength();
 							bool rotChanB = (stepConfig == 1 && stepIndexEdit >= 16);
-							sequences[seqIndexEdit].setRotate(clamp(sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
+							sek.sequences[seqIndexEdit].setRotate(clamp(sek.sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
 							if (deltaKnob > 0 && deltaKnob < 201) {// Rotate right, 201 is safety
 								for (int i = deltaKnob; i > 0; i--) {
-									rotateSeq(seqIndexEdit, true, slength, rotChanB);
+									sek.rotateSeq(seqIndexEdit, true, slength, rotChanB ? 1 : 0);
 									if ((stepConfig == 2 || !rotChanB ) && (stepIndexEdit < slength))
 										stepIndexEdit = (stepIndexEdit + 1) % slength;
 									if (rotChanB && (stepIndexEdit < (slength + 16)) && (stepIndexEdit >= 16))
@@ -1117,7 +1046,7 @@ struct PhraseSeq32 : Module {
 							}
 							if (deltaKnob < 0 && deltaKnob > -201) {// Rotate left, 201 is safety
 								for (int i = deltaKnob; i < 0; i++) {
-									rotateSeq(seqIndexEdit, false, slength, rotChanB);
+									sek.rotateSeq(seqIndexEdit, false, slength, rotChanB ? 1 : 0);
 									if ((stepConfig == 2 || !rotChanB ) && (stepIndexEdit < slength))
 										stepIndexEdit = (stepIndexEdit + (stepConfig * 16 - 1) ) % slength;
 									if (rotChanB && (stepIndexEdit < (slength + 16)) && (stepIndexEdit >= 16))
@@ -1134,11 +1063,11 @@ struct PhraseSeq32 : Module {
 						}
 						else {
 							if (!attached || !running) {
-								int newPhrase = phrase[phraseIndexEdit] + deltaKnob;
+								int newPhrase = sek.phrase[phraseIndexEdit] + deltaKnob;
 								if (newPhrase < 0)
 									newPhrase += (1 - newPhrase / 32) * 32;// newPhrase now positive
 								newPhrase = newPhrase % 32;
-								phrase[phraseIndexEdit] = newPhrase;
+								sek.phrase[phraseIndexEdit] = newPhrase;
 							}
 							else 
 								attachedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
@@ -1153,13 +1082,13 @@ struct PhraseSeq32 : Module {
 				if (octTriggers[i].process(params[OCTAVE_PARAM + i].getValue())) {
 					if (editingSequence) {
 						displayState = DISP_NORMAL;
-						if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+						if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 						else {			
-							cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 3 - i);
-							propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+							sek.cv[seqIndexEdit][stepIndexEdit] = applyNewOct(sek.cv[seqIndexEdit][stepIndexEdit], 3 - i);
+							sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 							editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-							editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+							editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 							editingGateKeyLight = -1;
 							editingChannel = (stepIndexEdit >= 16 * stepConfig) ? 1 : 0;
 						}
@@ -1172,40 +1101,40 @@ struct PhraseSeq32 : Module {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					if (editingGateLength != 0l) {
-						int newMode = keyIndexToGateMode(pkInfo.key, pulsesPerStep);
+						int newMode = keyIndexToGateMode(pkInfo.key, sek.pulsesPerStep, (APP->window->getMods() & GLFW_MOD_ALT) != 0);
 						if (newMode != -1) {
 							editingPpqn = 0l;
-							attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
+							sek.attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
 							if (pkInfo.isRightClick) {
 								stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 32);
 								editingType = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 								editingGateKeyLight = pkInfo.key;
 								if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL)
-									attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
+									sek.attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
 							}
 						}
 						else
 							editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
-					else if (attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+					else if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
 						if (pkInfo.isRightClick)
 							stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 32);
 						else
 							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 					else {			
-						float newCV = std::floor(cv[seqIndexEdit][stepIndexEdit]) + ((float) pkInfo.key) / 12.0f;
-						cv[seqIndexEdit][stepIndexEdit] = newCV;
-						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+						float newCV = std::floor(sek.cv[seqIndexEdit][stepIndexEdit]) + ((float) pkInfo.key) / 12.0f;
+						sek.cv[seqIndexEdit][stepIndexEdit] = newCV;
+						sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 						editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+						editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 						editingGateKeyLight = -1;
 						editingChannel = (stepIndexEdit >= 16 * stepConfig) ? 1 : 0;
 						if (pkInfo.isRightClick) {
 							stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 32);
 							editingGateKeyLight = pkInfo.key;
 							if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL)
-								cv[seqIndexEdit][stepIndexEdit] = newCV;
+								sek.cv[seqIndexEdit][stepIndexEdit] = newCV;
 						}
 					}						
 				}
@@ -1229,41 +1158,41 @@ struct PhraseSeq32 : Module {
 			if (gate1Trigger.process(params[GATE1_PARAM].getValue() + (expanderPresent ? messagesFromExpander[0] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					attributes[seqIndexEdit][stepIndexEdit].toggleGate1();
+					sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate1();
 				}
 			}		
 			if (gate1ProbTrigger.process(params[GATE1_PROB_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					else
-						attributes[seqIndexEdit][stepIndexEdit].toggleGate1P();
+						sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate1P();
 				}
 			}		
 			if (gate2Trigger.process(params[GATE2_PARAM].getValue() + (expanderPresent ? messagesFromExpander[1] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					attributes[seqIndexEdit][stepIndexEdit].toggleGate2();
+					sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate2();
 				}
 			}		
 			if (slideTrigger.process(params[SLIDE_BTN_PARAM].getValue() + (expanderPresent ? messagesFromExpander[3] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					else
-						attributes[seqIndexEdit][stepIndexEdit].toggleSlide();
+						sek.attributes[seqIndexEdit][stepIndexEdit].toggleSlide();
 				}
 			}		
 			if (tiedTrigger.process(params[TIE_PARAM].getValue() + (expanderPresent ? messagesFromExpander[2] : 0.0f))) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied()) {
-						deactivateTiedStep(seqIndexEdit, stepIndexEdit);
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+						sek.deactivateTiedStep(seqIndexEdit, stepIndexEdit, holdTiedNotes);
 					}
 					else {
-						activateTiedStep(seqIndexEdit, stepIndexEdit);
+						sek.activateTiedStep(seqIndexEdit, stepIndexEdit, holdTiedNotes);
 					}
 				}
 			}		
@@ -1291,77 +1220,15 @@ struct PhraseSeq32 : Module {
 		
 		// Clock
 		if (running && clockIgnoreOnReset == 0l) {
-			if (clockTrigger.process(inputs[CLOCK_INPUT].getVoltage())) {
-				ppqnCount++;
-				if (ppqnCount >= pulsesPerStep)
-					ppqnCount = 0;
-
-				int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
-				if (ppqnCount == 0) {
-					float slideFromCV[2] = {0.0f, 0.0f};
-					int oldStepIndexRun0 = stepIndexRun[0];
-					int oldStepIndexRun1 = stepIndexRun[1];
-					if (editingSequence) {
-						for (int i = 0; i < 2; i += stepConfig)
-							slideFromCV[i] = cv[seqIndexEdit][(i * 16) + stepIndexRun[i]];
-						//bool seqLoopOver = 
-						moveIndexRunMode(&stepIndexRun[0], sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
-						// if (seqLoopOver && stopAtEndOfSong) {
-							// running = false;
-							// stepIndexRun[0] = oldStepIndexRun0;
-							// stepIndexRun[1] = oldStepIndexRun1;
-						// }
-					}
-					else {
-						for (int i = 0; i < 2; i += stepConfig)
-							slideFromCV[i] = cv[phrase[phraseIndexRun]][(i * 16) + stepIndexRun[i]];
-						if (moveIndexRunMode(&stepIndexRun[0], sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
-							int oldPhraseIndexRun = phraseIndexRun;
-							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
-							// check for end of song if needed
-							if (songLoopOver && stopAtEndOfSong) {
-								running = false;
-								stepIndexRun[0] = oldStepIndexRun0;
-								stepIndexRun[1] = oldStepIndexRun1;
-								phraseIndexRun = oldPhraseIndexRun;
-							}
-							else {
-								stepIndexRun[0] = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
-							}
-						}
-						newSeq = phrase[phraseIndexRun];
-					}
-					if (running)// end of song may have stopped it
-						fillStepIndexRunVector(sequences[newSeq].getRunMode(), sequences[newSeq].getLength());
-
-					// Slide
-					for (int i = 0; i < 2; i += stepConfig) {
-						if (attributes[newSeq][(i * 16) + stepIndexRun[i]].getSlide()) {
-							slideStepsRemain[i] = (unsigned long) (((float)clockPeriod  * pulsesPerStep) * params[SLIDE_KNOB_PARAM].getValue() / 2.0f);
-							if (slideStepsRemain[i] != 0ul) {
-								float slideToCV = cv[newSeq][(i * 16) + stepIndexRun[i]];
-								slideCVdelta[i] = (slideToCV - slideFromCV[i])/(float)slideStepsRemain[i];
-							}
-						}
-						else
-							slideStepsRemain[i] = 0ul;
-					}
-				}
-				else {
-					if (!editingSequence)
-						newSeq = phrase[phraseIndexRun];
-				}
-				for (int i = 0; i < 2; i += stepConfig) {
-					calcGate1Code(attributes[newSeq][(i * 16) + stepIndexRun[i]], i);
-					gate2Code[i] = calcGate2Code(attributes[newSeq][(i * 16) + stepIndexRun[i]], ppqnCount, pulsesPerStep);	
-				}
-				clockPeriod = 0ul;
+			if (clockTrigger.process(clockBusSubscriber.getClock(inputs[CLOCK_INPUT]))) {
+				if (sek.clockStep(editingSequence, seqIndexEdit, stopAtEndOfSong, params[GATE1_KNOB_PARAM].getValue(), params[SLIDE_KNOB_PARAM].getValue()))
+					running = false;// end of song
 			}
-			clockPeriod++;
+			sek.process();
 		}
 		
 		// Reset
-		if (resetTrigger.process(inputs[RESET_INPUT].getVoltage() + params[RESET_PARAM].getValue())) {
+		if (resetTrigger.process(clockBusSubscriber.getReset(inputs[RESET_INPUT]) + params[RESET_PARAM].getValue())) {
 			initRun();// must be before SEQCV_INPUT below
 			resetLight = 1.0f;
 			displayState = DISP_NORMAL;
@@ -1374,8 +1241,8 @@ struct PhraseSeq32 : Module {
 		//********** Outputs and lights **********
 				
 		// CV and gates outputs
-		int seq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
-		int step0 = (editingSequence && !running) ? stepIndexEdit : stepIndexRun[0];
+		int seq = editingSequence ? seqIndexEdit : sek.phrase[sek.phraseIndexRun];
+		int step0 = (editingSequence && !running) ? stepIndexEdit : sek.stepIndexRun[0];
 		if (running) {
 			bool muteGate1A = !editingSequence && ((params[GATE1_PARAM].getValue() + (expanderPresent ? messagesFromExpander[0] : 0.0f)) > 0.5f);// live mute
 			bool muteGate1B = muteGate1A;
@@ -1392,18 +1259,14 @@ struct PhraseSeq32 : Module {
 					muteGate2A = false;
 				}
 			}
-			float slideOffset[2];
-			for (int i = 0; i < 2; i += stepConfig)
-				slideOffset[i] = (slideStepsRemain[i] > 0ul ? (slideCVdelta[i] * (float)slideStepsRemain[i]) : 0.0f);
-			outputs[CVA_OUTPUT].setVoltage(cv[seq][step0] - slideOffset[0]);
+			outputs[CVA_OUTPUT].setVoltage(sek.calcCvOutput(seq, 0));
 			bool retriggingOnReset = (clockIgnoreOnReset != 0l && retrigGatesOnReset);
-			outputs[GATE1A_OUTPUT].setVoltage((calcGate(gate1Code[0], clockTrigger, clockPeriod, sampleRate) && !muteGate1A && !retriggingOnReset) ? 10.0f : 0.0f);
-			outputs[GATE2A_OUTPUT].setVoltage((calcGate(gate2Code[0], clockTrigger, clockPeriod, sampleRate) && !muteGate2A && !retriggingOnReset) ? 10.0f : 0.0f);
+			outputs[GATE1A_OUTPUT].setVoltage((sek.calcGate1Output(0, clockTrigger, sampleRate) && !muteGate1A && !retriggingOnReset) ? 10.0f : 0.0f);
+			outputs[GATE2A_OUTPUT].setVoltage((sek.calcGate2Output(0, clockTrigger, sampleRate) && !muteGate2A && !retriggingOnReset) ? 10.0f : 0.0f);
 			if (stepConfig == 1) {// 2x16
-				int step1 = (editingSequence && !running) ? stepIndexEdit : stepIndexRun[1];
-				outputs[CVB_OUTPUT].setVoltage(cv[seq][16 + step1] - slideOffset[1]);
-				outputs[GATE1B_OUTPUT].setVoltage((calcGate(gate1Code[1], clockTrigger, clockPeriod, sampleRate) && !muteGate1B && !retriggingOnReset) ? 10.0f : 0.0f);
-				outputs[GATE2B_OUTPUT].setVoltage((calcGate(gate2Code[1], clockTrigger, clockPeriod, sampleRate) && !muteGate2B && !retriggingOnReset) ? 10.0f : 0.0f);
+				outputs[CVB_OUTPUT].setVoltage(sek.calcCvOutput(seq, 1));
+				outputs[GATE1B_OUTPUT].setVoltage((sek.calcGate1Output(1, clockTrigger, sampleRate) && !muteGate1B && !retriggingOnReset) ? 10.0f : 0.0f);
+				outputs[GATE2B_OUTPUT].setVoltage((sek.calcGate2Output(1, clockTrigger, sampleRate) && !muteGate2B && !retriggingOnReset) ? 10.0f : 0.0f);
 			} 
 			else {// 1x32
 				outputs[CVB_OUTPUT].setVoltage(0.0f);
@@ -1413,7 +1276,7 @@ struct PhraseSeq32 : Module {
 		}
 		else {// not running 
 			if (stepConfig > 1) {// 1x32
-				outputs[CVA_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : cv[seq][step0]);
+				outputs[CVA_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : sek.cv[seq][step0]);
 				outputs[GATE1A_OUTPUT].setVoltage((editingGate > 0ul) ? 10.0f : 0.0f);
 				outputs[GATE2A_OUTPUT].setVoltage((editingGate > 0ul) ? 10.0f : 0.0f);
 				outputs[CVB_OUTPUT].setVoltage(0.0f);
@@ -1424,12 +1287,12 @@ struct PhraseSeq32 : Module {
 				float cvA = 0.0f;
 				float cvB = 0.0f;
 				if (editingSequence) {
-					cvA = (step0 >= 16 ? cv[seq][step0 - 16] : cv[seq][step0]);
-					cvB = (step0 >= 16 ? cv[seq][step0] : cv[seq][step0 + 16]);
+					cvA = (step0 >= 16 ? sek.cv[seq][step0 - 16] : sek.cv[seq][step0]);
+					cvB = (step0 >= 16 ? sek.cv[seq][step0] : sek.cv[seq][step0 + 16]);
 				}
 				else {
-					cvA = cv[seq][step0];
-					cvB = cv[seq][stepIndexRun[1]];
+					cvA = sek.cv[seq][step0];
+					cvB = sek.cv[seq][sek.stepIndexRun[1]];
 				}
 				if (editingChannel == 0) {
 					outputs[CVA_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : cvA);
@@ -1449,9 +1312,7 @@ struct PhraseSeq32 : Module {
 				}
 			}	
 		}
-		for (int i = 0; i < 2; i++)
-			if (slideStepsRemain[i] > 0ul)
-				slideStepsRemain[i]--;
+		sek.decSlideStepsRemain();
 
 		
 		// lights
@@ -1468,32 +1329,32 @@ struct PhraseSeq32 : Module {
 				}
 				else if (displayState == DISP_LENGTH) {
 					if (editingSequence) {
-						if (col < (sequences[seqIndexEdit].getLength() - 1))
+						if (col < (sek.sequences[seqIndexEdit].getLength() - 1))
 							green = 0.32f;
-						else if (col == (sequences[seqIndexEdit].getLength() - 1))
+						else if (col == (sek.sequences[seqIndexEdit].getLength() - 1))
 							green = 1.0f;
 					}
 					else {
-						if (i < phrases - 1)
+						if (i < sek.phrases - 1)
 							green = 0.32f;
 						else
-							green = (i == phrases - 1) ? 1.0f : 0.0f;
+							green = (i == sek.phrases - 1) ? 1.0f : 0.0f;
 					}
 				}
 				else if (displayState == DISP_TRANSPOSE) {
 					red = 0.71f;
 				}
 				else if (displayState == DISP_ROTATE) {
-					red = (i == stepIndexEdit ? 1.0f : (col < sequences[seqIndexEdit].getLength() ? 0.45f : 0.0f));
+					red = (i == stepIndexEdit ? 1.0f : (col < sek.sequences[seqIndexEdit].getLength() ? 0.45f : 0.0f));
 				}
 				else {// normal led display (i.e. not length)
 					int row = i >> (3 + stepConfig);//i / (16 * stepConfig);// optimized (not equivalent code, but in this case has same effect)
 					// Run cursor (green)
 					if (editingSequence)
-						green = ((running && (col == stepIndexRun[row])) ? 1.0f : 0.0f);
+						green = ((running && (col == sek.stepIndexRun[row])) ? 1.0f : 0.0f);
 					else {
-						green = ((running && (i == phraseIndexRun)) ? 1.0f : 0.0f);
-						green += ((running && (col == stepIndexRun[row]) && i != phraseIndexEdit) ? 0.42f : 0.0f);
+						green = ((running && (i == sek.phraseIndexRun)) ? 1.0f : 0.0f);
+						green += ((running && (col == sek.stepIndexRun[row]) && i != phraseIndexEdit) ? 0.42f : 0.0f);
 						green = std::min(green, 1.0f);
 					}
 					// Edit cursor (red)
@@ -1503,9 +1364,9 @@ struct PhraseSeq32 : Module {
 						red = (i == phraseIndexEdit ? 1.0f : 0.0f);
 					bool gate = false;
 					if (editingSequence)
-						gate = attributes[seqIndexEdit][i].getGate1();
+						gate = sek.attributes[seqIndexEdit][i].getGate1();
 					else if (!editingSequence && (attached && running))
-						gate = attributes[phrase[phraseIndexRun]][i].getGate1();
+						gate = sek.attributes[sek.phrase[sek.phraseIndexRun]][i].getGate1();
 					white = ((green == 0.0f && red == 0.0f && gate && displayState != DISP_MODE) ? 0.15f : 0.0f);
 					if (editingSequence && white != 0.0f) {
 						green = 0.14f; white = 0.0f;
@@ -1516,7 +1377,7 @@ struct PhraseSeq32 : Module {
 			}
 		
 			// Octave lights
-			float cvVal = editingSequence ? cv[seqIndexEdit][stepIndexEdit] : cv[phrase[phraseIndexEdit]][stepIndexRun[0]];
+			float cvVal = editingSequence ? sek.cv[seqIndexEdit][stepIndexEdit] : sek.cv[sek.phrase[phraseIndexEdit]][sek.stepIndexRun[0]];
 			int keyLightIndex;
 			int octLightIndex;
 			calcNoteAndOct(cvVal, &keyLightIndex, &octLightIndex);
@@ -1540,7 +1401,7 @@ struct PhraseSeq32 : Module {
 			// Keyboard lights (can only show channel A when running attached in 1x16 mode, does not pose problem for all other situations)
 			if (editingPpqn != 0) {
 				for (int i = 0; i < 12; i++) {
-					if (keyIndexToGateMode(i, pulsesPerStep) != -1) {
+					if (keyIndexToGateMode(i, sek.pulsesPerStep) != -1) {
 						setGreenRed(KEY_LIGHTS + i * 2, 1.0f, 1.0f);
 					}
 					else {
@@ -1549,7 +1410,8 @@ struct PhraseSeq32 : Module {
 				}
 			} 
 			else if (editingGateLength != 0l && editingSequence) {
-				int modeLightIndex = gateModeToKeyLightIndex(attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
+				int modeLightIndex = gateModeToKeyLightIndex(sek.attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
+				float modeLightDim = gateModeToKeyLightDim(sek.attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
 				for (int i = 0; i < 12; i++) {
 					float green = editingGateLength > 0l ? 1.0f : 0.45f;
 					float red = editingGateLength > 0l ? 0.45f : 1.0f;
@@ -1563,7 +1425,7 @@ struct PhraseSeq32 : Module {
 					}
 					else {
 						if (i == modeLightIndex) {
-							setGreenRed(KEY_LIGHTS + i * 2, green, red);
+							setGreenRed(KEY_LIGHTS + i * 2, green * modeLightDim, red * modeLightDim);
 						}
 						else { // show dim note if gatetype is different than note
 							setGreenRed(KEY_LIGHTS + i * 2, 0.0f, (i == keyLightIndex ? 0.32f : 0.0f));
@@ -1615,9 +1477,9 @@ struct PhraseSeq32 : Module {
 				lights[TIE_LIGHT].setBrightness(0.0f);
 			}
 			else {
-				StepAttributes attributesVal = attributes[seqIndexEdit][stepIndexEdit];
+				StepAttributes attributesVal = sek.attributes[seqIndexEdit][stepIndexEdit];
 				if (!editingSequence)
-					attributesVal = attributes[phrase[phraseIndexEdit]][stepIndexRun[0]];
+					attributesVal = sek.attributes[sek.phrase[phraseIndexEdit]][sek.stepIndexRun[0]];
 				//
 				setGateLight(attributesVal.getGate1(), GATE1_LIGHT);
 				setGateLight(attributesVal.getGate2(), GATE2_LIGHT);
@@ -1691,47 +1553,6 @@ struct PhraseSeq32 : Module {
 		lights[id + 1].setBrightness(red);
 	}
 
-	inline void propagateCVtoTied(int seqn, int stepn) {
-		for (int i = stepn + 1; i < 32; i++) {
-			if (!attributes[seqn][i].getTied())
-				break;
-			cv[seqn][i] = cv[seqn][i - 1];
-		}	
-	}
-
-	void activateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(true);
-		if (stepn > 0) {
-			propagateCVtoTied(seqn, stepn - 1);
-		
-			if (holdTiedNotes) {// new method
-				attributes[seqn][stepn].setGate1(true);
-				for (int i = stepn; i < 32 && attributes[seqn][i].getTied(); i++) {
-					attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
-					attributes[seqn][i - 1].setGate1Mode(5);
-					attributes[seqn][i - 1].setGate1(true);
-				}
-			}
-			else {// old method
-				//if (stepn > 0) {
-					attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-					attributes[seqn][stepn].setTied(true);
-				//}
-			}
-		}
-	}
-	
-	void deactivateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(false);
-		if (holdTiedNotes && stepn != 0) {// new method
-			int lastGateType = attributes[seqn][stepn].getGate1Mode();
-			for (int i = stepn + 1; i < 32 && attributes[seqn][i].getTied(); i++)
-				lastGateType = attributes[seqn][i].getGate1Mode();
-			attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
-		}
-		//else old method, nothing to do
-	}
-	
 	inline void setGateLight(bool gateOn, int lightIndex) {
 		if (!gateOn) {
 			lights[lightIndex + 0].setBrightness(0.0f);
@@ -1787,7 +1608,7 @@ struct PhraseSeq32Widget : ModuleWidget {
 					if ((!module->running || !module->attached) && !module->isEditingSequence()) {
 						module->phraseIndexEdit = moveIndex(module->phraseIndexEdit, module->phraseIndexEdit + 1, 32);
 						if (!module->running)
-							module->phraseIndexRun = module->phraseIndexEdit;
+							module->sek.phraseIndexRun = module->phraseIndexEdit;
 					}
 				}
 				if (num != -1) {
@@ -1805,9 +1626,9 @@ struct PhraseSeq32Widget : ModuleWidget {
 					}
 					else if (module->displayState == PhraseSeq32::DISP_LENGTH) {
 						if (editingSequence)
-							module->sequences[module->seqIndexEdit].setLength(clamp(totalNum, 1, (16 * module->stepConfig)));
+							module->sek.sequences[module->seqIndexEdit].setLength(clamp(totalNum, 1, (16 * module->stepConfig)));
 						else
-							module->phrases = clamp(totalNum, 1, 32);
+							module->sek.phrases = clamp(totalNum, 1, 32);
 					}
 					else if (module->displayState == PhraseSeq32::DISP_TRANSPOSE) {
 					}
@@ -1821,7 +1642,7 @@ struct PhraseSeq32Widget : ModuleWidget {
 						}
 						else {
 							if (!module->attached || !module->running)
-								module->phrase[module->phraseIndexEdit] = totalNum - 1;
+								module->sek.phrase[module->phraseIndexEdit] = totalNum - 1;
 						}
 
 					}
@@ -1881,33 +1702,33 @@ struct PhraseSeq32Widget : ModuleWidget {
 						}
 					}
 					else if (module->editingPpqn != 0ul) {
-						snprintf(displayStr, 16, "x%2u", (unsigned) module->pulsesPerStep);
+						snprintf(displayStr, 16, "x%2u", (unsigned) module->sek.pulsesPerStep);
 					}
 					else if (module->displayState == PhraseSeq32::DISP_MODE) {
 						if (editingSequence)
-							runModeToStr(module->sequences[module->seqIndexEdit].getRunMode());
+							runModeToStr(module->sek.sequences[module->seqIndexEdit].getRunMode());
 						else
-							runModeToStr(module->runModeSong);
+							runModeToStr(module->sek.runModeSong);
 					}
 					else if (module->displayState == PhraseSeq32::DISP_LENGTH) {
 						if (editingSequence)
-							snprintf(displayStr, 16, "L%2u", (unsigned) module->sequences[module->seqIndexEdit].getLength());
+							snprintf(displayStr, 16, "L%2u", (unsigned) module->sek.sequences[module->seqIndexEdit].getLength());
 						else
-							snprintf(displayStr, 16, "L%2u", (unsigned) module->phrases);
+							snprintf(displayStr, 16, "L%2u", (unsigned) module->sek.phrases);
 					}
 					else if (module->displayState == PhraseSeq32::DISP_TRANSPOSE) {
-						snprintf(displayStr, 16, "+%2u", (unsigned) abs(module->sequences[module->seqIndexEdit].getTranspose()));
-						if (module->sequences[module->seqIndexEdit].getTranspose() < 0)
+						snprintf(displayStr, 16, "+%2u", (unsigned) abs(module->sek.sequences[module->seqIndexEdit].getTranspose()));
+						if (module->sek.sequences[module->seqIndexEdit].getTranspose() < 0)
 							displayStr[0] = '-';
 					}
 					else if (module->displayState == PhraseSeq32::DISP_ROTATE) {
-						snprintf(displayStr, 16, ")%2u", (unsigned) abs(module->sequences[module->seqIndexEdit].getRotate()));
-						if (module->sequences[module->seqIndexEdit].getRotate() < 0)
+						snprintf(displayStr, 16, ")%2u", (unsigned) abs(module->sek.sequences[module->seqIndexEdit].getRotate()));
+						if (module->sek.sequences[module->seqIndexEdit].getRotate() < 0)
 							displayStr[0] = '(';
 					}
 					else {// DISP_NORMAL
 						snprintf(displayStr, 16, " %2u", (unsigned) (editingSequence ? 
-							module->seqIndexEdit : module->phrase[module->phraseIndexEdit]) + 1 );
+							module->seqIndexEdit : module->sek.phrase[module->phraseIndexEdit]) + 1 );
 					}
 				}
 				nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
@@ -1995,6 +1816,10 @@ struct PhraseSeq32Widget : ModuleWidget {
 
 		menu->addChild(createBoolPtrMenuItem("AutoSeq when writing via CV inputs", "", &module->autoseq));
 
+		createClockBusMenu(menu, &module->clockBusSubscriber);
+
+		menu->addChild(createBoolPtrMenuItem("Compact patch data", "", &module->packedPatchData));
+
 		menu->addChild(new MenuSeparator());
 		menu->addChild(createMenuLabel("Actions"));
 
@@ -2014,7 +1839,7 @@ struct PhraseSeq32Widget : ModuleWidget {
 				PhraseSeq32* module = static_cast<PhraseSeq32*>(paramQuantity->module);
 				// same code structure below as in sequence knob in main step()
 				if (module->editingPpqn != 0) {
-					module->pulsesPerStep = 1;
+					module->sek.pulsesPerStep = 1;
 					//editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 				else if (module->displayState == PhraseSeq32::DISP_MODE) {
@@ -2022,19 +1847,19 @@ struct PhraseSeq32Widget : ModuleWidget {
 						bool expanderPresent = (module->rightExpander.module && module->rightExpander.module->model == modelPhraseSeqExpander);
 						const float *messagesFromExpander = static_cast<float*>(module->rightExpander.consumerMessage);// could be invalid pointer when !expanderPresent, so read it only when expanderPresent						
 						if (!expanderPresent || std::isnan(messagesFromExpander[4])) {
-							module->sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
+							module->sek.sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
 						}
 					}
 					else {
-						module->runModeSong = MODE_FWD;
+						module->sek.runModeSong = MODE_FWD;
 					}
 				}
 				else if (module->displayState == PhraseSeq32::DISP_LENGTH) {
 					if (module->isEditingSequence()) {
-						module->sequences[module->seqIndexEdit].setLength(16 * module->stepConfig);
+						module->sek.sequences[module->seqIndexEdit].setLength(16 * module->stepConfig);
 					}
 					else {
-						module->phrases = 4;
+						module->sek.phrases = 4;
 					}
 				}
 				else if (module->displayState == PhraseSeq32::DISP_TRANSPOSE) {
@@ -2050,7 +1875,7 @@ struct PhraseSeq32Widget : ModuleWidget {
 						}
 					}
 					else {
-						module->phrase[module->phraseIndexEdit] = 0;
+						module->sek.phrase[module->phraseIndexEdit] = 0;
 					}
 				}
 			}
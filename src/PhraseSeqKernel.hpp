@@ -0,0 +1,318 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//***********************************************************************************************
+
+#pragma once
+
+#include "PhraseSeqUtil.hpp"
+
+
+// Steps and song of PhraseSeq16, PhraseSeq32 and SemiModularSynth, i.e. what dataFromJson() loads
+//   STEPS: steps per sequence
+//   SEQS: number of sequences, and of phrases in the song
+
+template <int STEPS, int SEQS>
+struct PhraseSeqData {
+	// Need to save, with reset
+	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
+	int runModeSong;
+	int phrases;// 1 to SEQS
+	SeqAttributes sequences[SEQS];
+	int phrase[SEQS];// This is the song (series of phases; a phrase is a patten number)
+	float cv[SEQS][STEPS];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
+	StepAttributes attributes[SEQS][STEPS];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
+
+
+	void init(int length) {
+		pulsesPerStep = 1;
+		runModeSong = MODE_FWD;
+		phrases = 4;
+		for (int seqn = 0; seqn < SEQS; seqn++) {
+			sequences[seqn].init(length, MODE_FWD);
+			phrase[seqn] = 0;
+			for (int stepn = 0; stepn < STEPS; stepn++) {
+				cv[seqn][stepn] = 0.0f;
+				attributes[seqn][stepn].init();
+			}
+		}
+	}
+};
+
+
+// Sequencing core shared by PhraseSeq16, PhraseSeq32 and SemiModularSynth: the steps and song above, and the run
+// state with its gate and slide engine. The modules keep their panel, copy-paste and json code, and reach in the
+// public members below as they used to with their own.
+//   ROWS: number of rows of STEPS / ROWS steps that can play in parallel (2 for PhraseSeq32's 2x16 config),
+//         they all follow the run position of the first row, except in RN2 run mode
+
+template <int STEPS, int SEQS, int ROWS>
+class PhraseSeqKernel : public PhraseSeqData<STEPS, SEQS> {
+	public:
+
+	static const int ROW_STEPS = STEPS / ROWS;// steps in a row when all rows are played
+
+	using PhraseSeqData<STEPS, SEQS>::pulsesPerStep;
+	using PhraseSeqData<STEPS, SEQS>::runModeSong;
+	using PhraseSeqData<STEPS, SEQS>::phrases;
+	using PhraseSeqData<STEPS, SEQS>::sequences;
+	using PhraseSeqData<STEPS, SEQS>::phrase;
+	using PhraseSeqData<STEPS, SEQS>::cv;
+	using PhraseSeqData<STEPS, SEQS>::attributes;
+
+
+	// No need to save, with reset
+	int rows;// rows that are played, ROWS or 1 (PhraseSeq32's 1x32 config plays its 32 steps as one row)
+	unsigned long clockPeriod;// counts number of step() calls upward from last clock (reset after clock processed)
+	int phraseIndexRun;
+	unsigned long phraseIndexRunHistory;
+	int stepIndexRun[ROWS];// index in the row
+	unsigned long stepIndexRunHistory;
+	int ppqnCount;
+	int gate1Code[ROWS];
+	int gate2Code[ROWS];
+	bool lastProbGate1Enable[ROWS];
+	unsigned long slideStepsRemain[ROWS];// 0 when no slide under way, downward step counter when sliding
+
+	// No need to save, no reset
+	float slideCVdelta[ROWS];// no need to initialize, this is a companion to slideStepsRemain
+	RandomStream* rng = nullptr;// for the random run modes and gate probabilities, set by modules that have their own stream
+
+
+	void onReset(int length) {
+		this->init(length);
+		rows = ROWS;
+	}
+
+
+	void initRun(bool editingSequence, int seqIndexEdit, float gate1Prob) {
+		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
+		phraseIndexRunHistory = 0;
+
+		int seqn = (editingSequence ? seqIndexEdit : phrase[phraseIndexRun]);
+		stepIndexRun[0] = (sequences[seqn].getRunMode() == MODE_REV ? sequences[seqn].getLength() - 1 : 0);
+		fillStepIndexRunVector(sequences[seqn].getRunMode(), sequences[seqn].getLength());
+		stepIndexRunHistory = 0;
+
+		ppqnCount = 0;
+		for (int rown = 0; rown < rows; rown++) {
+			lastProbGate1Enable[rown] = true;
+			calcGate1Code(attributes[seqn][rown * ROW_STEPS + stepIndexRun[rown]], rown, gate1Prob);
+			gate2Code[rown] = calcGate2Code(attributes[seqn][rown * ROW_STEPS + stepIndexRun[rown]], 0, pulsesPerStep);
+		}
+		for (int rown = 0; rown < ROWS; rown++) {
+			slideStepsRemain[rown] = 0ul;
+		}
+	}
+
+
+	// Called on clock edges when running; returns true when the end of the song was reached and stopAtEndOfSong is set,
+	// in which case the run position is left on the last step and the module should stop running
+	bool clockStep(bool editingSequence, int seqIndexEdit, bool stopAtEndOfSong, float gate1Prob, float slideKnob) {
+		bool stopRequested = false;
+		ppqnCount++;
+		if (ppqnCount >= pulsesPerStep)
+			ppqnCount = 0;
+
+		int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
+		if (ppqnCount == 0) {
+			float slideFromCV[ROWS];
+			int oldStepIndexRun[ROWS];
+			for (int rown = 0; rown < ROWS; rown++) {
+				slideFromCV[rown] = 0.0f;
+				oldStepIndexRun[rown] = stepIndexRun[rown];
+			}
+			if (editingSequence) {
+				for (int rown = 0; rown < rows; rown++)
+					slideFromCV[rown] = cv[seqIndexEdit][rown * ROW_STEPS + stepIndexRun[rown]];
+				moveIndexRunMode(&stepIndexRun[0], sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory, rng);
+			}
+			else {
+				for (int rown = 0; rown < rows; rown++)
+					slideFromCV[rown] = cv[phrase[phraseIndexRun]][rown * ROW_STEPS + stepIndexRun[rown]];
+				if (moveIndexRunMode(&stepIndexRun[0], sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory, rng)) {
+					int oldPhraseIndexRun = phraseIndexRun;
+					bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory, rng);
+					// check for end of song if needed
+					if (songLoopOver && stopAtEndOfSong) {
+						stopRequested = true;
+						for (int rown = 0; rown < ROWS; rown++)
+							stepIndexRun[rown] = oldStepIndexRun[rown];
+						phraseIndexRun = oldPhraseIndexRun;
+					}
+					else {
+						stepIndexRun[0] = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
+					}
+				}
+				newSeq = phrase[phraseIndexRun];
+			}
+			if (!stopRequested)
+				fillStepIndexRunVector(sequences[newSeq].getRunMode(), sequences[newSeq].getLength());
+
+			// Slide
+			for (int rown = 0; rown < rows; rown++) {
+				if (attributes[newSeq][rown * ROW_STEPS + stepIndexRun[rown]].getSlide()) {
+					slideStepsRemain[rown] = (unsigned long) (((float)clockPeriod * pulsesPerStep) * slideKnob / 2.0f);
+					if (slideStepsRemain[rown] != 0ul) {
+						float slideToCV = cv[newSeq][rown * ROW_STEPS + stepIndexRun[rown]];
+						slideCVdelta[rown] = (slideToCV - slideFromCV[rown])/(float)slideStepsRemain[rown];
+					}
+				}
+				else
+					slideStepsRemain[rown] = 0ul;
+			}
+		}
+		else {
+			if (!editingSequence)
+				newSeq = phrase[phraseIndexRun];
+		}
+		for (int rown = 0; rown < rows; rown++) {
+			calcGate1Code(attributes[newSeq][rown * ROW_STEPS + stepIndexRun[rown]], rown, gate1Prob);
+			gate2Code[rown] = calcGate2Code(attributes[newSeq][rown * ROW_STEPS + stepIndexRun[rown]], ppqnCount, pulsesPerStep);
+		}
+		clockPeriod = 0ul;
+		return stopRequested;
+	}
+
+
+	void process() {// once per sample when running, after the clock edge has been processed
+		clockPeriod++;
+	}
+
+
+	// Outputs when running
+	float calcCvOutput(int seqn, int rown) {
+		float slideOffset = (slideStepsRemain[rown] > 0ul ? (slideCVdelta[rown] * (float)slideStepsRemain[rown]) : 0.0f);
+		return cv[seqn][rown * ROW_STEPS + stepIndexRun[rown]] - slideOffset;
+	}
+	bool calcGate1Output(int rown, Trigger clockTrigger, float sampleRate) {
+		return calcGate(gate1Code[rown], clockTrigger, clockPeriod, sampleRate);
+	}
+	bool calcGate2Output(int rown, Trigger clockTrigger, float sampleRate) {
+		return calcGate(gate2Code[rown], clockTrigger, clockPeriod, sampleRate);
+	}
+	void decSlideStepsRemain() {// once per sample, after the outputs
+		for (int rown = 0; rown < ROWS; rown++) {
+			if (slideStepsRemain[rown] > 0ul)
+				slideStepsRemain[rown]--;
+		}
+	}
+
+
+	// Step edits
+	void propagateCVtoTied(int seqn, int stepn) {
+		for (int i = stepn + 1; i < STEPS; i++) {
+			if (!attributes[seqn][i].getTied())
+				break;
+			cv[seqn][i] = cv[seqn][i - 1];
+		}
+	}
+
+	void activateTiedStep(int seqn, int stepn, bool holdTiedNotes) {
+		attributes[seqn][stepn].setTied(true);
+		if (stepn > 0) {
+			propagateCVtoTied(seqn, stepn - 1);
+
+			if (holdTiedNotes) {// new method
+				attributes[seqn][stepn].setGate1(true);
+				for (int i = stepn; i < STEPS && attributes[seqn][i].getTied(); i++) {
+					attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
+					attributes[seqn][i - 1].setGate1Mode(5);
+					attributes[seqn][i - 1].setGate1(true);
+				}
+			}
+			else {// old method
+				attributes[seqn][stepn] = attributes[seqn][stepn - 1];
+				attributes[seqn][stepn].setTied(true);
+			}
+		}
+	}
+
+	void deactivateTiedStep(int seqn, int stepn, bool holdTiedNotes) {
+		attributes[seqn][stepn].setTied(false);
+		if (holdTiedNotes && stepn != 0) {// new method
+			int lastGateType = attributes[seqn][stepn].getGate1Mode();
+			for (int i = stepn + 1; i < STEPS && attributes[seqn][i].getTied(); i++)
+				lastGateType = attributes[seqn][i].getGate1Mode();
+			attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
+		}
+		//else old method, nothing to do
+	}
+
+	void rotateSeq(int seqn, bool directionRight, int seqLength, int rown) {
+		// rown is 0 to rotate the first row or a sequence that is played as one row (seqLength <= STEPS),
+		//   else seqLength must be <= ROW_STEPS
+		int iStart = rown * ROW_STEPS;
+		int iEnd = iStart + seqLength - 1;
+		if (directionRight) {
+			std::rotate(&cv[seqn][iStart], &cv[seqn][iEnd], &cv[seqn][iEnd + 1]);
+			std::rotate(&attributes[seqn][iStart], &attributes[seqn][iEnd], &attributes[seqn][iEnd + 1]);
+		}
+		else {
+			std::rotate(&cv[seqn][iStart], &cv[seqn][iStart + 1], &cv[seqn][iEnd + 1]);
+			std::rotate(&attributes[seqn][iStart], &attributes[seqn][iStart + 1], &attributes[seqn][iEnd + 1]);
+		}
+	}
+
+
+	// Portable sequence, from and to the seqLen steps starting at step ofs
+	void fillIoSteps(IoStep* ioSteps, int seqn, int ofs, int seqLen, float gate1Prob) {
+		for (int i = 0; i < seqLen; i++) {
+			ioSteps[i].pitch = cv[seqn][i + ofs];
+			StepAttributes stepAttrib = attributes[seqn][i + ofs];
+			ioSteps[i].gate = stepAttrib.getGate1();
+			ioSteps[i].tied = stepAttrib.getTied();
+			ioSteps[i].vel = -1.0f;// no concept of velocity in PhraseSequencers
+			ioSteps[i].prob = stepAttrib.getGate1P() ? gate1Prob : -1.0f;// negative means prob is not on for this note
+		}
+	}
+
+	void emptyIoSteps(IoStep* ioSteps, int seqn, int ofs, int seqLen, bool holdTiedNotes) {
+		// first pass is done without ties
+		for (int i = 0; i < seqLen; i++) {
+			cv[seqn][i + ofs] = ioSteps[i].pitch;
+
+			StepAttributes stepAttrib;
+			stepAttrib.init();
+			stepAttrib.setGate1(ioSteps[i].gate);
+			stepAttrib.setGate1P(ioSteps[i].prob >= 0.0f);
+			attributes[seqn][i + ofs] = stepAttrib;
+		}
+		// now do ties, has to be done in a separate pass such that non tied that follows tied can be
+		//   there in advance for proper gate types
+		for (int i = 0; i < seqLen; i++) {
+			if (ioSteps[i].tied) {
+				activateTiedStep(seqn, i + ofs, holdTiedNotes);
+			}
+		}
+	}
+
+
+	private:
+
+	void fillStepIndexRunVector(int runMode, int len) {// the other rows follow the first one, except in RN2 run mode
+		for (int rown = 1; rown < ROWS; rown++) {
+			if (runMode != MODE_RN2)
+				stepIndexRun[rown] = stepIndexRun[0];
+			else
+				stepIndexRun[rown] = randomU32(rng) % len;
+		}
+	}
+
+	void calcGate1Code(StepAttributes attribute, int rown, float gate1Prob) {
+		int gateType = attribute.getGate1Mode();
+
+		if (ppqnCount == 0 && !attribute.getTied()) {
+			lastProbGate1Enable[rown] = !attribute.getGate1P() || ((rng != nullptr ? rng->uniform() : random::uniform()) < gate1Prob); // uniform is [0.0, 1.0)
+		}
+
+		if (!attribute.getGate1() || !lastProbGate1Enable[rown]) {
+			gate1Code[rown] = 0;
+		}
+		else if (pulsesPerStep == 1 && gateType == 0) {
+			gate1Code[rown] = 2;// clock high
+		}
+		else {
+			gate1Code[rown] = getAdvGate(ppqnCount, pulsesPerStep, gateType);// trigger or gate pattern
+		}
+	}
+};// class PhraseSeqKernel
@@ -6,19 +6,6 @@
 #include "PhraseSeqUtil.hpp"
 
 
-static const uint32_t advGateHitMask[NUM_GATES] = 
-{0x00003F, 0x0F0F0F, 0x000FFF, 0x0F0F00, 0x03FFFF, 0xFFFFFF, 0x00000F, 0x03F03F, 0x000F00, 0x03F000, 0x0F0000, 0};
-//	  25%		TRI		  50%		T23		  75%		FUL		  TR1 		DUO		  TR2 	     D2		  TR3  TRIG		
-
-
-int getAdvGate(int ppqnCount, int pulsesPerStep, int gateMode) { 
-	if (gateMode == 11)
-		return ppqnCount == 0 ? 3 : 0;
-	uint32_t shiftAmt = ppqnCount * (24 / pulsesPerStep);
-	return (int)((advGateHitMask[gateMode] >> shiftAmt) & (uint32_t)0x1);
-}
-
-
 int calcGate2Code(StepAttributes attribute, int ppqnCount, int pulsesPerStep) {
 	// 0 = gate off, 1 = clock high, 2 = trigger, 3 = gate on
 	if (!attribute.getGate2())
@@ -26,12 +13,10 @@ int calcGate2Code(StepAttributes attribute, int ppqnCount, int pulsesPerStep) {
 	int gateType = attribute.getGate2Mode();
 	if (pulsesPerStep == 1 && gateType == 0)
 		return 2;// clock high
-	if (gateType == 11)
-		return (ppqnCount == 0 ? 3 : 0);
 	return getAdvGate(ppqnCount, pulsesPerStep, gateType);
 }
 
-bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* history) {// some of this code if from PS32EX)
+bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* history, RandomStream* rng) {// some of this code if from PS32EX)
 	int reps = 1;
 	// assert((reps * numSteps) <= 0xFFF); // for BRN and RND run modes, history is not a span count but a step count
 	
@@ -104,7 +89,7 @@ bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* hist
 		case MODE_BRN :// brownian random; history base is 0x5000
 			if ((*history) < 0x5001 || (*history) > 0x5FFF) 
 				(*history) = 0x5000 + numSteps * reps;
-			(*index) += (random::u32() % 3) - 1;
+			(*index) += (randomU32(rng) % 3) - 1;
 			if ((*index) >= numSteps) {
 				(*index) = 0;
 			}
@@ -121,7 +106,7 @@ bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* hist
 		case MODE_RN2 :
 			if ((*history) < 0x6001 || (*history) > 0x6FFF) 
 				(*history) = 0x6000 + numSteps * reps;
-			(*index) = (random::u32() % numSteps) ;
+			(*index) = (randomU32(rng) % numSteps) ;
 			(*history)--;
 			if ((*history) <= 0x6000) {
 				crossBoundary = true;
@@ -150,7 +135,9 @@ bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* hist
 }
 
 
-int keyIndexToGateMode(int keyIndex, int pulsesPerStep) {
+int keyIndexToGateMode(int keyIndex, int pulsesPerStep, bool extended) {// extended is an alt-click, for the ratchet and Euclidean gate modes
+	if (extended)
+		return gatePatterns24.keyIndexToExtGateType(keyIndex, pulsesPerStep);
 	int ret = keyIndex;
 	
 	if (keyIndex == 1 || keyIndex == 3 || keyIndex == 6 || keyIndex == 8 || keyIndex == 10) {// black keys
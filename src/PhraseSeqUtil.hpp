@@ -7,6 +7,8 @@
 #include "ImpromptuModular.hpp"
 #include <time.h>
 #include "Interop.hpp"
+#include "GatePatterns.hpp"
+#include "RandomStream.hpp"
 
 
 // General constants
@@ -177,15 +179,28 @@ inline bool calcGate(int gateCode, Trigger clockTrigger, unsigned long clockStep
 	return clockStep < (unsigned long) (sampleRate * 0.01f);
 }
 
+inline int getAdvGate(int ppqnCount, int pulsesPerStep, int gateMode) {// 0 = gate off, 1 = gate on, 3 = trigger
+	if (gateMode == GATETYPE_TRIG)
+		return ppqnCount == 0 ? 3 : 0;
+	return gatePatterns24.isHigh(gateMode, pulsesPerStep, ppqnCount) ? 1 : 0;
+}
+
+inline uint32_t randomU32(RandomStream* rng) {// modules without their own stream pass nullptr and use the global generator
+	return rng != nullptr ? rng->u32() : random::u32();
+}
+
 inline int gateModeToKeyLightIndex(StepAttributes attribute, bool isGate1) {// keyLight index now matches gate modes, so no mapping table needed anymore
-	return isGate1 ? attribute.getGate1Mode() : attribute.getGate2Mode();
+	return gateTypeToKeyIndex(isGate1 ? attribute.getGate1Mode() : attribute.getGate2Mode());
+}
+
+inline float gateModeToKeyLightDim(StepAttributes attribute, bool isGate1) {// ratchet and Euclidean gate modes show dimmed on their key
+	return isExtGateType(isGate1 ? attribute.getGate1Mode() : attribute.getGate2Mode()) ? 0.4f : 1.0f;
 }
 
 
 
 // Other methods (code in PhraseSeqUtil.cpp)	
 
-int getAdvGate(int ppqnCount, int pulsesPerStep, int gateMode);
 int calcGate2Code(StepAttributes attribute, int ppqnCount, int pulsesPerStep);
-bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* history);
-int keyIndexToGateMode(int keyIndex, int pulsesPerStep);
+bool moveIndexRunMode(int* index, int numSteps, int runMode, unsigned long* history, RandomStream* rng = nullptr);
+int keyIndexToGateMode(int keyIndex, int pulsesPerStep, bool extended = false);
@@ -12,9 +12,32 @@
 
 #include "comp/PianoKey.hpp"
 #include "Interop.hpp"
+#include "RandomStream.hpp"
 
 
 
+class ProbKernel;
+
+// Cached sampling distributions of a ProbKernel for one poly channel, rebuilt only when the kernel
+// (its probabilities or ranges) or the offset, squash or overlap that shape the octave ranges change
+struct ProbDistribution {
+	const ProbKernel* kernel = nullptr;// kernel the CDFs were built from, nullptr when never built
+	uint32_t kernelVersion = 0;
+	float offset = 0.0f;
+	float squash = 0.0f;
+	float overlap = 0.0f;
+	float noteCdf[12] = {};
+	float noteDiceScale = 1.0f;
+	bool rangeValid = false;// range CDF is only built on the first note that needs it
+	float rangeCdf[7] = {};
+	
+	static int sample(const float* cdf, int size, float dice) {
+		// index of the first cdf entry above dice (size when none), same result as a linear scan of a non decreasing cdf
+		return (int)(std::upper_bound(cdf, cdf + size, dice) - cdf);
+	}
+};
+
+
 class ProbKernel {
 	public: 
 	
@@ -26,6 +49,7 @@ class ProbKernel {
 	float noteProbs[12] = {};// [0.0f : 1.0f]
 	float noteAnchors[12] = {};// [0.0f : 1.0f];  0.5f=oct"4"=0V, 1.0f=oct"4+MAX_ANCHOR_DELTA"; not quantized
 	float noteRanges[7] = {};// [0] is -3, [6] is +3
+	uint32_t version = 0;// bumped whenever noteProbs[] or noteRanges[] change, invalidates the ProbDistribution caches
 	
 	
 	public:
@@ -43,6 +67,7 @@ class ProbKernel {
 			noteRanges[i] = 0.0f;
 		}
 		noteRanges[3] = 1.0f;
+		version++;
 	}
 	
 	
@@ -112,6 +137,7 @@ class ProbKernel {
 				}
 			}
 		}
+		version++;
 	}
 	
 	
@@ -120,6 +146,7 @@ class ProbKernel {
 		return noteProbs[note];
 	}
 	float* getNoteProbArray() {
+		// caller must call invalidateDistributions() after writing into the array
 		return noteProbs;
 	}
 	float getNoteAnchor(int note) {
@@ -140,6 +167,7 @@ class ProbKernel {
 				}
 			}
 		}
+		version++;
 	}
 	void setNoteAnchor(int note, float anch, bool withSymmetry) {
 		if (withSymmetry) {
@@ -161,6 +189,10 @@ class ProbKernel {
 		if (withSymmetry) {
 			noteRanges[6 - note7] = range;
 		}
+		version++;
+	}
+	void invalidateDistributions() {
+		version++;
 	}
 	
 	
@@ -212,27 +244,52 @@ class ProbKernel {
 	}
 	
 	
-	float calcRandomCv(float offset, float squash, float density, float overlap) {
-		// not optimized for audio rate
-		// returns a cv value or IDEM_CV when a note gets randomly skipped (only possible when sum of probs < 1)
-		
-		// generate a (base) note according to noteProbs (base note only, C4=0 to B4)
-		float cumulProbs[12];
-		cumulProbs[0] = noteProbs[0];
-		for (int i = 1; i < 12; i++) {
-			cumulProbs[i] = cumulProbs[i - 1] + noteProbs[i];
+	void updateDistribution(ProbDistribution* dist, float offset, float squash, float overlap) {
+		if (dist->kernel == this && dist->kernelVersion == version) {
+			if (dist->offset != offset || dist->squash != squash || dist->overlap != overlap) {
+				dist->rangeValid = false;
+			}
 		}
-		
-		float diceNote = random::uniform() * std::max(cumulProbs[11], 1.0f);		
-		int note = 0;
-		for (; note < 12; note++) {
-			if (diceNote < cumulProbs[note]) {
-				break;
+		else {
+			// cumulative note probabilities (base note only, C4=0 to B4)
+			dist->noteCdf[0] = noteProbs[0];
+			for (int i = 1; i < 12; i++) {
+				dist->noteCdf[i] = dist->noteCdf[i - 1] + noteProbs[i];
 			}
+			dist->noteDiceScale = std::max(dist->noteCdf[11], 1.0f);
+			dist->kernel = this;
+			dist->kernelVersion = version;
+			dist->rangeValid = false;
 		}
+		dist->offset = offset;
+		dist->squash = squash;
+		dist->overlap = overlap;
+	}
+	
+	
+	void updateRangeDistribution(ProbDistribution* dist) {
+		// cumulative octave ranges after offset and squash
+		float noteRangesMod[7] = {};
+		calcOffsetAndSquash(noteRangesMod, dist->offset, dist->squash, dist->overlap);
+		dist->rangeCdf[0] = noteRangesMod[0];
+		for (int i = 1; i < 7; i++) {
+			dist->rangeCdf[i] = dist->rangeCdf[i - 1] + noteRangesMod[i];
+		}
+		dist->rangeValid = true;
+	}
+	
+	
+	float calcRandomCv(ProbDistribution* dist, RandomStream* rng, float offset, float squash, float density, float overlap) {
+		// returns a cv value or IDEM_CV when a note gets randomly skipped (only possible when sum of probs < 1)
+		// the CDFs in dist are only rebuilt when needed, so this is cheap enough for audio rate gates
+		updateDistribution(dist, offset, squash, overlap);
+		
+		// generate a (base) note according to noteProbs (base note only, C4=0 to B4)
+		float diceNote = rng->uniform() * dist->noteDiceScale;
+		int note = ProbDistribution::sample(dist->noteCdf, 12, diceNote);
 		
 		float cv;
-		float diceDensity = random::uniform();
+		float diceDensity = rng->uniform();
 		if (note < 12 && diceDensity < density) {
 			// base note
 			cv = ((float)note) / 12.0f;
@@ -240,24 +297,12 @@ class ProbKernel {
 			// anchor
 			cv += anchorToOct(noteAnchors[note]);
 			
-			// offset and squash
-			float noteRangesMod[7] = {};
-			calcOffsetAndSquash(noteRangesMod, offset, squash, overlap);
-			
-			// probabilistically transpose note according to octave ranges
-			float cumulRanges[7];
-			cumulRanges[0] = noteRangesMod[0];
-			for (int i = 1; i < 7; i++) {
-				cumulRanges[i] = cumulRanges[i - 1] + noteRangesMod[i];
-			}
-			
-			float diceOct = random::uniform() * cumulRanges[6];
-			int oct = 0;
-			for (; oct < 7; oct++) {
-				if (diceOct < cumulRanges[oct]) {
-					break;
-				}
+			// probabilistically transpose note according to octave ranges (with offset and squash)
+			if (!dist->rangeValid) {
+				updateRangeDistribution(dist);
 			}
+			float diceOct = rng->uniform() * dist->rangeCdf[6];
+			int oct = ProbDistribution::sample(dist->rangeCdf, 7, diceOct);
 			if (oct < 7) {
 				oct -= 3;
 				cv += (float)oct;
@@ -284,6 +329,7 @@ class ProbKernel {
 			}
 			noteProbs[0] = noteProbB;
 			noteAnchors[0] = noteAnchorB;
+			version++;
 		}
 	}
 	
@@ -300,6 +346,7 @@ class ProbKernel {
 			}
 			noteProbs[11] = noteProbC;
 			noteAnchors[11] = noteAnchorC;
+			version++;
 		}
 	}
 	
@@ -580,6 +627,7 @@ struct ProbKey : Module {
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	RandomStream rng;
 	
 	// Need to save, with reset
 	int editMode;
@@ -593,6 +641,9 @@ struct ProbKey : Module {
 	ProbKernel probKernels[NUM_INDEXES];
 	OutputKernel outputKernels[PORT_MAX_CHANNELS];
 	
+	// No need to save, no reset
+	ProbDistribution probDists[PORT_MAX_CHANNELS];// self invalidating, see ProbKernel::version
+	
 	// No need to save, with reset
 	DisplayManager dispManager;
 	long infoTracer;
@@ -602,7 +653,7 @@ struct ProbKey : Module {
 	RefreshCounter refresh;
 	PianoKeyInfo pkInfo;
 	Trigger modeTriggers[3];
-	Trigger gateInTriggers[PORT_MAX_CHANNELS];
+	TriggerSimd gateInTriggers[PORT_MAX_CHANNELS / 4];
 	Trigger copyTrigger;
 	Trigger pasteTrigger;
 	Trigger tranUpTrigger;
@@ -643,6 +694,38 @@ struct ProbKey : Module {
 		}
 		return squash;
 	}
+	void getPolyCvs(float* dest, int numChan, int paramId, int inputId, float cvScale, float minVal, float maxVal) {
+		// batched getDensity(), getOffset() and getSquash() for poly chans 0 to numChan - 1, dest[] must hold PORT_MAX_CHANNELS
+		simd::float_4 knob = params[paramId].getValue();
+		if (!inputs[inputId].isConnected()) {
+			for (int c = 0; c < numChan; c += 4) {
+				knob.store(&dest[c]);
+			}
+			return;
+		}
+		int lastChan = inputs[inputId].getChannels() - 1;// getChannels() is >= 1
+		for (int c = 0; c < numChan; c += 4) {
+			simd::float_4 cv;
+			if (c + 3 <= lastChan) {
+				cv = inputs[inputId].getVoltageSimd<simd::float_4>(c);
+			}
+			else {
+				for (int i = 0; i < 4; i++) {
+					cv[i] = inputs[inputId].getVoltage(std::min(c + i, lastChan));
+				}
+			}
+			simd::clamp(knob + cv * cvScale, minVal, maxVal).store(&dest[c]);
+		}
+	}
+	void getPolyDensities(float* dest, int numChan) {
+		getPolyCvs(dest, numChan, DENSITY_PARAM, DENSITY_INPUT, 0.1f, 0.0f, 1.0f);
+	}
+	void getPolyOffsets(float* dest, int numChan) {
+		getPolyCvs(dest, numChan, OFFSET_PARAM, OFFSET_INPUT, 0.3f, -3.0f, 3.0f);
+	}
+	void getPolySquashes(float* dest, int numChan) {
+		getPolyCvs(dest, numChan, SQUASH_PARAM, SQUASH_INPUT, 0.1f, 0.0f, 1.0f);
+	}
 	float getLock() {
 		float lock = params[LOCK_KNOB_PARAM].getValue();
 		if (params[LOCK_BUTTON_PARAM].getValue() >= 0.5f) {
@@ -747,6 +830,7 @@ struct ProbKey : Module {
 		indexCvCap12 = 0;
 		showTracer = 1;
 		perIndexManualLocks = 0;
+		rng.deterministic = false;
 		clearStepLock(); // this is stepLock;
 		for (int i = 0; i < NUM_INDEXES; i++) {
 			probKernels[i].reset();
@@ -773,12 +857,16 @@ struct ProbKey : Module {
 		// only randomize the lock buffers
 		int index = getIndex();
 
-		for (int c = 0; c < inputs[GATE_INPUT].getChannels(); c ++) {
-			float offset = getOffset(c);
-			float squash = getSquash(c);
-			float density = getDensity(c);
+		int numChan = inputs[GATE_INPUT].getChannels();
+		float offsets[PORT_MAX_CHANNELS];
+		float squashes[PORT_MAX_CHANNELS];
+		float densities[PORT_MAX_CHANNELS];
+		getPolyOffsets(offsets, numChan);
+		getPolySquashes(squashes, numChan);
+		getPolyDensities(densities, numChan);
+		for (int c = 0; c < numChan; c ++) {
 			for (int i = 0; i < OutputKernel::MAX_LENGTH; i++) {
-				float newCv = probKernels[index].calcRandomCv(offset, squash, density, overlap);
+				float newCv = probKernels[index].calcRandomCv(&probDists[c], &rng, offsets[c], squashes[c], densities[c], overlap);
 				outputKernels[c].stepWithInsertNew(newCv, OutputKernel::MAX_LENGTH - 1);
 			}
 		}
@@ -845,6 +933,9 @@ struct ProbKey : Module {
 			outputKernels[i].dataToJson(rootJ, i);
 		}
 		
+		// rng
+		json_object_set_new(rootJ, "rng", rng.dataToJson());
+		
 		return rootJ;
 	}
 
@@ -946,6 +1037,12 @@ struct ProbKey : Module {
 			outputKernels[i].dataFromJson(rootJ, i);
 		}
 
+		// rng
+		json_t *rngJ = json_object_get(rootJ, "rng");
+		if (rngJ) {
+			rng.dataFromJson(rngJ);
+		}
+
 		resetNonJson();
 	}
 		
@@ -1096,10 +1193,32 @@ struct ProbKey : Module {
 		
 		//********** Outputs and lights **********
 		
-		for (int c = 0; c < inputs[GATE_INPUT].getChannels(); c ++) {
-			// gate input triggers
-			if (gateInTriggers[c].process(inputs[GATE_INPUT].getVoltage(c))) {
-				// got rising edge on gate input poly channel c
+		int numChan = inputs[GATE_INPUT].getChannels();
+		
+		// gate input triggers, four poly channels at a time
+		uint32_t risingMask = 0;// bit c is set when got rising edge on gate input poly channel c
+		uint32_t gateHighMask = 0;
+		for (int c = 0; c < numChan; c += 4) {
+			simd::float_4 active = simd::float_4(c, c + 1, c + 2, c + 3) < (float)numChan;
+			simd::float_4 rising = gateInTriggers[c >> 2].process(inputs[GATE_INPUT].getVoltageSimd<simd::float_4>(c), active);
+			risingMask |= simd::movemask(rising) << c;
+			gateHighMask |= simd::movemask(gateInTriggers[c >> 2].state) << c;
+		}
+		
+		if (risingMask != 0) {
+			// poly CVs are only needed when at least one channel steps
+			float offsets[PORT_MAX_CHANNELS];
+			float squashes[PORT_MAX_CHANNELS];
+			float densities[PORT_MAX_CHANNELS];
+			getPolyOffsets(offsets, numChan);
+			getPolySquashes(squashes, numChan);
+			getPolyDensities(densities, numChan);
+			float lock = getLock();
+			
+			for (int c = 0; c < numChan; c ++) {
+				if ((risingMask & (1 << c)) == 0) {
+					continue;
+				}
 				
 				// mannual lock has higher precedence, since will use manual lock memory; but works only for poly chan 0
 				bool isLockedStep = false;
@@ -1117,7 +1236,7 @@ struct ProbKey : Module {
 					isLockedStep = true;
 				}
 				// knob lock has lower precedence, since it has no special lock memory (it uses the output register)	
-				else if (getLock() > random::uniform()) {
+				else if (lock > rng.uniform()) {
 					// recycle CV
 					outputKernels[c].stepWithKeepOld(length);
 					isLockedStep = true;
@@ -1129,7 +1248,7 @@ struct ProbKey : Module {
 						outputKernels[c].stepWithCopy(length);
 					}
 					else {
-						float newCv = probKernels[index].calcRandomCv(getOffset(c), getSquash(c), getDensity(c), overlap);
+						float newCv = probKernels[index].calcRandomCv(&probDists[c], &rng, offsets[c], squashes[c], densities[c], overlap);
 						outputKernels[c].stepWithInsertNew(newCv, length);
 					}
 				}
@@ -1139,11 +1258,12 @@ struct ProbKey : Module {
 					infoTracerLockedStep = isLockedStep;
 				}					
 			}
-			
-			
-			// output CV and gate
+		}
+		
+		// output CV and gate
+		for (int c = 0; c < numChan; c ++) {
 			outputs[CV_OUTPUT].setVoltage(outputKernels[c].getCv(), c);
-			float gateOut = outputKernels[c].getGateEnable() && gateInTriggers[c].state ? inputs[GATE_INPUT].getVoltage(c) : 0.0f;
+			float gateOut = outputKernels[c].getGateEnable() && (gateHighMask & (1 << c)) != 0 ? inputs[GATE_INPUT].getVoltage(c) : 0.0f;
 			outputs[GATE_OUTPUT].setVoltage(gateOut, c);
 		}
 
@@ -1394,9 +1514,10 @@ struct ProbKeyWidget : ModuleWidget {
 			// }
 		// };
 		struct NormalizedFloat12PasteItem : MenuItem {
-			float* floats12;
+			ProbKernel* probKernel;
 			void onAction(const event::Action &e) override {
-				NormalizedFloat12Paste(floats12);
+				NormalizedFloat12Paste(probKernel->getNoteProbArray());
+				probKernel->invalidateDistributions();
 			}
 		};
 		// float* floats12;
@@ -1448,7 +1569,7 @@ struct ProbKeyWidget : ModuleWidget {
 		menu->addChild(interopSeqItem);
 
 		NormalizedFloat12Item::NormalizedFloat12PasteItem *float12PasteItem = createMenuItem<NormalizedFloat12Item::NormalizedFloat12PasteItem>("Paste weights from Adaptive Quantizer", "");
-		float12PasteItem->floats12 = module->probKernels[module->getIndex()].getNoteProbArray();
+		float12PasteItem->probKernel = &(module->probKernels[module->getIndex()]);
 		menu->addChild(float12PasteItem);		
 
 		// NormalizedFloat12Item *probs12Item = createMenuItem<NormalizedFloat12Item>("To/From Adaptive Quantizer", RIGHT_ARROW);
@@ -1523,6 +1644,8 @@ struct ProbKeyWidget : ModuleWidget {
 			[=]() {return module->showTracer;},
 			[=]() {module->showTracer ^= 0x1;}
 		));
+
+		menu->addChild(createBoolPtrMenuItem("Same random values on every load", "", &module->rng.deterministic));
 	}
 
 
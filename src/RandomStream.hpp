@@ -0,0 +1,187 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Counter-based random number streams, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include "rack.hpp"
+
+using namespace rack;
+
+
+// Counter-based generator: value n of a stream is a hash of (key, n), where the key is derived from a seed and a
+// stream id. The whole state is thus (seed, stream, counter). When deterministic is set (an opt-in module setting),
+// it is saved in the patch so that a render from a given patch file is the same on every load; otherwise each module
+// keeps the random seed given at construction, so that duplicates and presets play their own values. Streams from
+// the same seed with different ids are independent, so one seed can feed many tracks or voices. The hash is the
+// SplitMix64 output function; values need no serial dependency, which lets the normals be produced four at a time
+// with SIMD (Box-Muller, both the cos and the sin halves are kept).
+struct RandomStream {
+	private:
+
+	static const uint64_t GAMMA = 0x9E3779B97F4A7C15ull;
+
+	uint64_t seed = 0;
+	uint64_t stream = 0;
+	uint64_t key = 0;
+	uint64_t counter = 0;// number of 64-bit values consumed so far
+	float normals[8] = {};// batch of normals, consumed from the top
+	int normalsLeft = 0;
+
+
+	static uint64_t mix64(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	void refillNormals() {
+		simd::float_4 u1 = 1.0f - uniform4();// (0, 1] so that the log is finite
+		simd::float_4 u2 = uniform4();
+		simd::float_4 r = simd::sqrt(-2.0f * simd::log(u1));
+		simd::float_4 theta = (2.0f * float(M_PI)) * u2;
+		(r * simd::cos(theta)).store(&normals[0]);
+		(r * simd::sin(theta)).store(&normals[4]);
+		normalsLeft = 8;
+	}
+
+
+	public:
+
+	bool deterministic = false;// saved, the seed and position are only saved and restored when set
+
+	RandomStream() {
+		setSeed(random::u64());
+	}
+
+	void setSeed(uint64_t _seed, uint64_t _stream = 0) {
+		seed = _seed;
+		stream = _stream;
+		key = mix64(seed ^ mix64(stream + GAMMA));
+		counter = 0;
+		normalsLeft = 0;
+	}
+	void setStream(uint64_t _stream) {
+		// keeps the seed, restarts the stream
+		setSeed(seed, _stream);
+	}
+	uint64_t getSeed() {
+		return seed;
+	}
+
+
+	// Saved state of a stream, so that dataFromJson() can parse it on the UI thread into a JsonHandoff buffer
+	// and process() can apply it with setState() on the engine thread, along with the steps it goes with
+	struct State {
+		bool loaded = false;// false when there was no saved stream, setState() then leaves the stream as is
+		bool deterministic = false;
+		bool hasPosition = false;// seed, stream and counter are only saved when deterministic
+		uint64_t seed = 0;
+		uint64_t stream = 0;
+		uint64_t counter = 0;
+	};
+
+	State getState() {
+		State s;
+		s.loaded = true;
+		s.deterministic = deterministic;
+		s.hasPosition = deterministic;
+		s.seed = seed;
+		s.stream = stream;
+		s.counter = counter;
+		return s;
+	}
+
+	void setState(const State& s) {
+		// when not deterministic, or in patches without a saved stream, the random seed given at construction is kept
+		if (!s.loaded)
+			return;
+		deterministic = s.deterministic;
+		if (deterministic && s.hasPosition) {
+			setSeed(s.seed, s.stream);
+			counter = s.counter;
+		}
+	}
+
+
+	static json_t* stateToJson(const State& s) {
+		// 64-bit values are stored as json integers (json_int_t is 64 bits), bit-cast back in stateFromJson()
+		json_t* rngJ = json_object();
+		json_object_set_new(rngJ, "deterministic", json_boolean(s.deterministic));
+		if (s.deterministic && s.hasPosition) {
+			json_object_set_new(rngJ, "seed", json_integer((json_int_t)s.seed));
+			json_object_set_new(rngJ, "stream", json_integer((json_int_t)s.stream));
+			json_object_set_new(rngJ, "counter", json_integer((json_int_t)s.counter));
+		}
+		return rngJ;
+	}
+
+	static State stateFromJson(json_t* rngJ) {// rngJ can be nullptr
+		State s;
+		if (!rngJ)
+			return s;
+		s.loaded = true;
+		json_t *deterministicJ = json_object_get(rngJ, "deterministic");
+		s.deterministic = deterministicJ && json_is_true(deterministicJ);
+		if (!s.deterministic)
+			return s;
+		json_t *seedJ = json_object_get(rngJ, "seed");
+		json_t *streamJ = json_object_get(rngJ, "stream");
+		if (seedJ && streamJ) {
+			s.hasPosition = true;
+			s.seed = (uint64_t)json_integer_value(seedJ);
+			s.stream = (uint64_t)json_integer_value(streamJ);
+			json_t *counterJ = json_object_get(rngJ, "counter");
+			if (counterJ) {
+				s.counter = (uint64_t)json_integer_value(counterJ);
+			}
+		}
+		return s;
+	}
+
+
+	json_t* dataToJson() {
+		return stateToJson(getState());
+	}
+
+	void dataFromJson(json_t* rngJ) {// modules with a JsonHandoff use stateFromJson() and setState() instead
+		setState(stateFromJson(rngJ));
+	}
+
+
+	uint64_t u64() {
+		counter++;
+		return mix64(key + counter * GAMMA);
+	}
+	uint32_t u32() {
+		return (uint32_t)(u64() >> 32);
+	}
+	float uniform() {
+		// [0.0, 1.0), same resolution as random::uniform()
+		return (float)(u64() >> 40) * (1.0f / 16777216.0f);
+	}
+	simd::float_4 uniform4() {
+		// four uniforms in [0.0, 1.0) from two hashes
+		uint64_t a = u64();
+		uint64_t b = u64();
+		simd::float_4 ints((float)(a >> 40), (float)((a >> 8) & 0xFFFFFF), (float)(b >> 40), (float)((b >> 8) & 0xFFFFFF));
+		return ints * (1.0f / 16777216.0f);
+	}
+	float normal() {
+		// mean 0, standard deviation 1
+		if (normalsLeft == 0) {
+			refillNormals();
+		}
+		normalsLeft--;
+		return normals[normalsLeft];
+	}
+	simd::float_4 normal4() {
+		if (normalsLeft < 4) {
+			refillNormals();
+		}
+		normalsLeft -= 4;
+		return simd::float_4::load(&normals[normalsLeft]);
+	}
+};
@@ -14,10 +14,17 @@
 
 
 #include "FundamentalUtil.hpp"
-#include "PhraseSeqUtil.hpp"
+#include "PhraseSeqKernel.hpp"
+#include "JsonHandoff.hpp"
 #include "comp/PianoKey.hpp"
 
 
+struct SemiModularSynthData {// what dataFromJson() loads for process() to adopt (see JsonHandoff.hpp)
+	PhraseSeqData<16, 16> seq;
+	RandomStream::State rngState;
+};
+
+
 struct SemiModularSynth : Module {
 	enum ParamIds {
 		// SEQUENCER
@@ -183,21 +190,16 @@ struct SemiModularSynth : Module {
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	RandomStream rng;// sequencer random run modes and gate probabilities, analog VCO drift and VCF noise
 	
 	// Need to save, with reset
 	bool autoseq;
 	bool autostepLen;
 	bool holdTiedNotes;
 	int seqCVmethod;// 0 is 0-10V, 1 is C4-D5#, 2 is TrigIncr
-	int pulsesPerStep;// 1 means normal gate mode, alt choices are 4, 6, 12, 24 PPS (Pulses per step)
 	bool running;
-	SeqAttributes sequences[16];
-	int runModeSong; 
+	PhraseSeqKernel<16, 16, 1> sek;// steps, song and run state
 	int seqIndexEdit;
-	int phrase[16];// This is the song (series of phases; a phrase is a patten number)
-	int phrases;//1 to 16
-	float cv[16][16];// [-3.0 : 3.917]. First index is patten number, 2nd index is step
-	StepAttributes attributes[16][16];// First index is patten number, 2nd index is step (see enum AttributeBitMasks for details)
 	int stepIndexEdit;
 	int phraseIndexEdit;
 	bool resetOnRun;
@@ -216,7 +218,6 @@ struct SemiModularSynth : Module {
 	unsigned long editingGate;// 0 when no edit gate, downward step counter timer when edit gate
 	unsigned long editingType;// similar to editingGate, but just for showing remanent gate type (nothing played); uses editingGateKeyLight
 	long infoCopyPaste;// 0 when no info, positive downward step counter timer when copy, negative upward when paste
-	unsigned long clockPeriod;// counts number of step() calls upward from last clock (reset after clock processed)
 	long tiedWarning;// 0 when no warning, positive downward step counter timer when warning
 	long attachedWarning;// 0 when no warning, positive downward step counter timer when warning
 	long revertDisplay;
@@ -224,15 +225,6 @@ struct SemiModularSynth : Module {
 	long lastGateEdit;
 	long editingPpqn;// 0 when no info, positive downward step counter timer when editing ppqn
 	long clockIgnoreOnReset;
-	int phraseIndexRun;
-	unsigned long phraseIndexRunHistory;
-	int stepIndexRun;
-	unsigned long stepIndexRunHistory;
-	int ppqnCount;
-	int gate1Code;
-	int gate2Code;
-	bool lastProbGate1Enable;	
-	unsigned long slideStepsRemain;// 0 when no slide under way, downward step counter when sliding
 	
 	// VCO
 	// none
@@ -246,13 +238,22 @@ struct SemiModularSynth : Module {
 	// ADSR
 	bool decaying = false;
 	float env = 0.0f;
+	// control rate, see updateAdsrRates()
+	float adsrAttack = 0.0f;
+	float adsrDecay = 0.0f;
+	float adsrSustain = 0.0f;
+	float adsrRelease = 0.0f;
+	float adsrAttackRate = 0.0f;
+	float adsrDecayRate = 0.0f;
+	float adsrReleaseRate = 0.0f;
 	
 	// VCF
-	LadderFilter filter;
+	LadderFilter<simd::float_4> filters[4];// 16 channels, four per filter bank
+	simd::float_4 vcfPitches[4];// cutoff is only recomputed when the pitch changes
 	
 	// No need to save, no reset
 	RefreshCounter refresh;
-	float slideCVdelta;// no need to initialize, this goes with slideStepsRemain
+	JsonHandoff<SemiModularSynthData> jsonHandoff;// steps, song and random stream loaded by dataFromJson(), adopted by process()
 	float editingGateCV;// no need to initialize, this goes with editingGate (output this only when editingGate > 0)
 	int editingGateKeyLight;// no need to initialize, this goes with editingGate (use this only when editingGate > 0)
 	float resetLight = 0.0f;
@@ -288,7 +289,7 @@ struct SemiModularSynth : Module {
 	
 	LowFrequencyOscillator oscillatorClk;
 	LowFrequencyOscillator oscillatorLfo;
-	VoltageControlledOscillator oscillatorVco;
+	VoltageControlledOscillator oscillatorVcos[4];// 16 channels, four per oscillator bank
 
 
 	SemiModularSynth() {
@@ -446,10 +447,15 @@ struct SemiModularSynth : Module {
 		configOutput(LFO_TRI_OUTPUT, "LFO triangle");
 		
 
+		sek.rng = &rng;
 		onReset();
+		updateAdsrRates();
 		
 		// VCO
-		oscillatorVco.soft = false;
+		for (int i = 0; i < 4; i++) {
+			oscillatorVcos[i].soft = false;
+			oscillatorVcos[i].rng = &rng;
+		}
 		
 		// CLK 
 		oscillatorClk.offset = true;
@@ -470,24 +476,15 @@ struct SemiModularSynth : Module {
 		autostepLen = false;
 		holdTiedNotes = true;
 		seqCVmethod = 0;
-		pulsesPerStep = 1;
 		running = true;
-		runModeSong = MODE_FWD;
 		stepIndexEdit = 0;
 		seqIndexEdit = 0;
 		phraseIndexEdit = 0;
-		phrases = 4;
-		for (int i = 0; i < 16; i++) {
-			sequences[i].init(16, MODE_FWD);
-			phrase[i] = 0;
-			for (int s = 0; s < 16; s++) {
-				cv[i][s] = 0.0f;
-				attributes[i][s].init();
-			}
-		}
+		sek.onReset(16);
 		resetOnRun = false;
 		attached = false;
 		stopAtEndOfSong = false;
+		rng.deterministic = false;
 		resetNonJson();
 		
 		// VCO
@@ -497,7 +494,22 @@ struct SemiModularSynth : Module {
 		clkValue = 0.0f;
 		
 		// VCF
-		filter.reset();
+		for (int i = 0; i < 4; i++) {
+			filters[i].reset();
+			vcfPitches[i] = -1000.0f;// forces cutoff computation
+		}
+	}
+	void updateAdsrRates() {
+		// the exponential rates only depend on the knobs, so they are computed at control rate
+		const float base = 20000.0f;
+		const float maxTime = 10.0f;
+		adsrAttack = clamp(params[ADSR_ATTACK_PARAM].getValue(), 0.0f, 1.0f);
+		adsrDecay = clamp(params[ADSR_DECAY_PARAM].getValue(), 0.0f, 1.0f);
+		adsrSustain = clamp(params[ADSR_SUSTAIN_PARAM].getValue(), 0.0f, 1.0f);
+		adsrRelease = clamp(params[ADSR_RELEASE_PARAM].getValue(), 0.0f, 1.0f);
+		adsrAttackRate = std::pow(base, 1.0f - adsrAttack) / maxTime;
+		adsrDecayRate = std::pow(base, 1.0f - adsrDecay) / maxTime;
+		adsrReleaseRate = std::pow(base, 1.0f - adsrRelease) / maxTime;
 	}
 	void resetNonJson() {
 		displayState = DISP_NORMAL;
@@ -513,7 +525,7 @@ struct SemiModularSynth : Module {
 		editingGate = 0ul;
 		editingType = 0ul;
 		infoCopyPaste = 0l;
-		clockPeriod = 0ul;
+		sek.clockPeriod = 0ul;
 		tiedWarning = 0ul;
 		attachedWarning = 0l;
 		revertDisplay = 0l;
@@ -524,28 +536,17 @@ struct SemiModularSynth : Module {
 	}
 	void initRun() {// run button activated or run edge in run input jack
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		phraseIndexRun = (runModeSong == MODE_REV ? phrases - 1 : 0);
-		phraseIndexRunHistory = 0;
-
-		int seq = (isEditingSequence() ? seqIndexEdit : phrase[phraseIndexRun]);
-		stepIndexRun = (sequences[seq].getRunMode() == MODE_REV ? sequences[seq].getLength() - 1 : 0);
-		stepIndexRunHistory = 0;
-
-		ppqnCount = 0;
-		lastProbGate1Enable = true;
-		calcGate1Code(attributes[seq][stepIndexRun]);
-		gate2Code = calcGate2Code(attributes[seq][stepIndexRun], 0, pulsesPerStep);
-		slideStepsRemain = 0ul;
+		sek.initRun(isEditingSequence(), seqIndexEdit, params[GATE1_KNOB_PARAM].getValue());
 	}
 
 	
 	void onRandomize() override {
 		if (isEditingSequence()) {
 			for (int s = 0; s < 16; s++) {
-				cv[seqIndexEdit][s] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
-				attributes[seqIndexEdit][s].randomize();
+				sek.cv[seqIndexEdit][s] = ((float)(random::u32() % 5)) + ((float)(random::u32() % 12)) / 12.0f - 2.0f;
+				sek.attributes[seqIndexEdit][s].randomize();
 			}
-			sequences[seqIndexEdit].randomize(16, NUM_MODES - 1);
+			sek.sequences[seqIndexEdit].randomize(16, NUM_MODES - 1);
 		}
 	}
 	
@@ -553,6 +554,10 @@ struct SemiModularSynth : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// steps and song are those loaded by dataFromJson() when process() has not adopted them yet
+		SemiModularSynthData* pendingData = jsonHandoff.peekPending();
+		PhraseSeqData<16, 16>* sd = (pendingData != nullptr ? &pendingData->seq : &sek);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
@@ -572,13 +577,13 @@ struct SemiModularSynth : Module {
 		json_object_set_new(rootJ, "seqCVmethod", json_integer(seqCVmethod));
 
 		// pulsesPerStep
-		json_object_set_new(rootJ, "pulsesPerStep", json_integer(pulsesPerStep));
+		json_object_set_new(rootJ, "pulsesPerStep", json_integer(sd->pulsesPerStep));
 
 		// running
 		json_object_set_new(rootJ, "running", json_boolean(running));
 		
 		// runModeSong
-		json_object_set_new(rootJ, "runModeSong3", json_integer(runModeSong));
+		json_object_set_new(rootJ, "runModeSong3", json_integer(sd->runModeSong));
 
 		// stepIndexEdit
 		json_object_set_new(rootJ, "stepIndexEdit", json_integer(stepIndexEdit));
@@ -590,25 +595,25 @@ struct SemiModularSynth : Module {
 		json_object_set_new(rootJ, "phraseIndexEdit", json_integer(phraseIndexEdit));
 
 		// phrases
-		json_object_set_new(rootJ, "phrases", json_integer(phrases));
+		json_object_set_new(rootJ, "phrases", json_integer(sd->phrases));
 
 		// sequences
 		json_t *sequencesJ = json_array();
 		for (int i = 0; i < 16; i++)
-			json_array_insert_new(sequencesJ, i, json_integer(sequences[i].getSeqAttrib()));
+			json_array_insert_new(sequencesJ, i, json_integer(sd->sequences[i].getSeqAttrib()));
 		json_object_set_new(rootJ, "sequences", sequencesJ);
 		
 		// phrase 
 		json_t *phraseJ = json_array();
 		for (int i = 0; i < 16; i++)
-			json_array_insert_new(phraseJ, i, json_integer(phrase[i]));
+			json_array_insert_new(phraseJ, i, json_integer(sd->phrase[i]));
 		json_object_set_new(rootJ, "phrase", phraseJ);
 
 		// CV
 		json_t *cvJ = json_array();
 		for (int i = 0; i < 16; i++)
 			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(cvJ, s + (i * 16), json_real(cv[i][s]));
+				json_array_insert_new(cvJ, s + (i * 16), json_real(sd->cv[i][s]));
 			}
 		json_object_set_new(rootJ, "cv", cvJ);
 
@@ -616,7 +621,7 @@ struct SemiModularSynth : Module {
 		json_t *attributesJ = json_array();
 		for (int i = 0; i < 16; i++)
 			for (int s = 0; s < 16; s++) {
-				json_array_insert_new(attributesJ, s + (i * 16), json_integer(attributes[i][s].getAttribute()));
+				json_array_insert_new(attributesJ, s + (i * 16), json_integer(sd->attributes[i][s].getAttribute()));
 			}
 		json_object_set_new(rootJ, "attributes", attributesJ);
 
@@ -629,10 +634,22 @@ struct SemiModularSynth : Module {
 		// stopAtEndOfSong
 		json_object_set_new(rootJ, "stopAtEndOfSong", json_boolean(stopAtEndOfSong));
 
+		// rng
+		RandomStream::State savedRngState = (pendingData != nullptr && pendingData->rngState.loaded ? pendingData->rngState : rng.getState());
+		json_object_set_new(rootJ, "rng", RandomStream::stateToJson(savedRngState));
+
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		// steps, song and random stream are parsed into the handoff buffer, process() adopts them when they are all there
+		SemiModularSynthData* loadData = jsonHandoff.beginWrite();
+		PhraseSeqData<16, 16>* sd = &loadData->seq;
+		sd->init(16);
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ) {
@@ -670,7 +687,7 @@ struct SemiModularSynth : Module {
 		// pulsesPerStep
 		json_t *pulsesPerStepJ = json_object_get(rootJ, "pulsesPerStep");
 		if (pulsesPerStepJ)
-			pulsesPerStep = json_integer_value(pulsesPerStepJ);
+			sd->pulsesPerStep = json_integer_value(pulsesPerStepJ);
 
 		// running
 		json_t *runningJ = json_object_get(rootJ, "running");
@@ -680,13 +697,13 @@ struct SemiModularSynth : Module {
 		// runModeSong
 		json_t *runModeSongJ = json_object_get(rootJ, "runModeSong3");
 		if (runModeSongJ)
-			runModeSong = json_integer_value(runModeSongJ);
+			sd->runModeSong = json_integer_value(runModeSongJ);
 		else {// legacy
 			runModeSongJ = json_object_get(rootJ, "runModeSong");
 			if (runModeSongJ) {
-				runModeSong = json_integer_value(runModeSongJ);
-				if (runModeSong >= MODE_PEN)// this mode was not present in original version
-					runModeSong++;
+				sd->runModeSong = json_integer_value(runModeSongJ);
+				if (sd->runModeSong >= MODE_PEN)// this mode was not present in original version
+					sd->runModeSong++;
 			}
 		}
 		
@@ -708,7 +725,7 @@ struct SemiModularSynth : Module {
 		// phrases
 		json_t *phrasesJ = json_object_get(rootJ, "phrases");
 		if (phrasesJ)
-			phrases = json_integer_value(phrasesJ);
+			sd->phrases = json_integer_value(phrasesJ);
 		
 		// sequences
 		json_t *sequencesJ = json_object_get(rootJ, "sequences");
@@ -717,7 +734,7 @@ struct SemiModularSynth : Module {
 			{
 				json_t *sequencesArrayJ = json_array_get(sequencesJ, i);
 				if (sequencesArrayJ)
-					sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
+					sd->sequences[i].setSeqAttrib(json_integer_value(sequencesArrayJ));
 			}			
 		}
 		else {// legacy
@@ -775,8 +792,8 @@ struct SemiModularSynth : Module {
 			
 			// now write into new object
 			for (int i = 0; i < 16; i++) {
-				sequences[i].init(lengths[i], runModeSeq[i]);
-				sequences[i].setTranspose(transposeOffsets[i]);
+				sd->sequences[i].init(lengths[i], runModeSeq[i]);
+				sd->sequences[i].setTranspose(transposeOffsets[i]);
 			}
 		}
 
@@ -787,7 +804,7 @@ struct SemiModularSynth : Module {
 			{
 				json_t *phraseArrayJ = json_array_get(phraseJ, i);
 				if (phraseArrayJ)
-					phrase[i] = json_integer_value(phraseArrayJ);
+					sd->phrase[i] = json_integer_value(phraseArrayJ);
 			}
 			
 		// CV
@@ -797,7 +814,7 @@ struct SemiModularSynth : Module {
 				for (int s = 0; s < 16; s++) {
 					json_t *cvArrayJ = json_array_get(cvJ, s + (i * 16));
 					if (cvArrayJ)
-						cv[i][s] = json_number_value(cvArrayJ);
+						sd->cv[i][s] = json_number_value(cvArrayJ);
 				}
 		}
 
@@ -808,7 +825,7 @@ struct SemiModularSynth : Module {
 				for (int s = 0; s < 16; s++) {
 					json_t *attributesArrayJ = json_array_get(attributesJ, s + (i * 16));
 					if (attributesArrayJ)
-						attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
+						sd->attributes[i][s].setAttribute((unsigned short)json_integer_value(attributesArrayJ));
 				}
 		}
 	
@@ -827,23 +844,19 @@ struct SemiModularSynth : Module {
 		if (stopAtEndOfSongJ)
 			stopAtEndOfSong = json_is_true(stopAtEndOfSongJ);
 		
-		resetNonJson();
+		// rng
+		loadData->rngState = RandomStream::stateFromJson(json_object_get(rootJ, "rng"));
+		
+		jsonHandoff.endWrite();// process() adopts the steps, song and random stream, then calls resetNonJson()
 	}
 
 
 	IoStep* fillIoSteps(int *seqLenPtr) {// caller must delete return array
-		int seqLen = sequences[seqIndexEdit].getLength();
+		int seqLen = sek.sequences[seqIndexEdit].getLength();
 		IoStep* ioSteps = new IoStep[seqLen];
 		
 		// populate ioSteps array
-		for (int i = 0; i < seqLen; i++) {
-			ioSteps[i].pitch = cv[seqIndexEdit][i];
-			StepAttributes stepAttrib = attributes[seqIndexEdit][i];
-			ioSteps[i].gate = stepAttrib.getGate1();
-			ioSteps[i].tied = stepAttrib.getTied();
-			ioSteps[i].vel = -1.0f;// no concept of velocity in PhraseSequencers
-			ioSteps[i].prob = stepAttrib.getGate1P() ? params[GATE1_KNOB_PARAM].getValue() : -1.0f;// negative means prob is not on for this note
-		}
+		sek.fillIoSteps(ioSteps, seqIndexEdit, 0, seqLen, params[GATE1_KNOB_PARAM].getValue());
 		
 		// return values 
 		*seqLenPtr = seqLen;
@@ -852,75 +865,13 @@ struct SemiModularSynth : Module {
 	
 	
 	void emptyIoSteps(IoStep* ioSteps, int seqLen) {
-		sequences[seqIndexEdit].setLength(seqLen);
+		sek.sequences[seqIndexEdit].setLength(seqLen);
 		
 		// populate steps in the sequencer
-		// first pass is done without ties
-		for (int i = 0; i < seqLen; i++) {
-			cv[seqIndexEdit][i] = ioSteps[i].pitch;
-			
- 			StepAttributes stepAttrib;
-			stepAttrib.init();
-			stepAttrib.setGate1(ioSteps[i].gate);
-			stepAttrib.setGate1P(ioSteps[i].prob >= 0.0f);
-			attributes[seqIndexEdit][i] = stepAttrib;
-		}
-		// now do ties, has to be done in a separate pass such that non tied that follows tied can be 
-		//   there in advance for proper gate types
-		for (int i = 0; i < seqLen; i++) {
-			if (ioSteps[i].tied) {
-				activateTiedStep(seqIndexEdit, i);
-			}
-		}
+		sek.emptyIoSteps(ioSteps, seqIndexEdit, 0, seqLen, holdTiedNotes);
 	}
 
-
-	void rotateSeq(int seqNum, bool directionRight, int seqLength) {
-		float rotCV;
-		StepAttributes rotAttributes;
-		int iStart = 0;
-		int iEnd = seqLength - 1;
-		int iRot = iStart;
-		int iDelta = 1;
-		if (directionRight) {
-			iRot = iEnd;
-			iDelta = -1;
-		}
-		rotCV = cv[seqNum][iRot];
-		rotAttributes = attributes[seqNum][iRot];
-		for ( ; ; iRot += iDelta) {
-			if (iDelta == 1 && iRot >= iEnd) break;
-			if (iDelta == -1 && iRot <= iStart) break;
-			cv[seqNum][iRot] = cv[seqNum][iRot + iDelta];
-			attributes[seqNum][iRot] = attributes[seqNum][iRot + iDelta];
-		}
-		cv[seqNum][iRot] = rotCV;
-		attributes[seqNum][iRot] = rotAttributes;
-	}
-	
 	
-	void calcGate1Code(StepAttributes attribute) {
-		int gateType = attribute.getGate1Mode();
-		
-		if (ppqnCount == 0 && !attribute.getTied()) {
-			lastProbGate1Enable = !attribute.getGate1P() || (random::uniform() < params[GATE1_KNOB_PARAM].getValue()); // random::uniform is [0.0, 1.0), see include/util/common.hpp
-		}
-			
-		if (!attribute.getGate1() || !lastProbGate1Enable) {
-			gate1Code = 0;
-		}
-		else if (pulsesPerStep == 1 && gateType == 0) {
-			gate1Code = 2;// clock high
-		}
-		else { 
-			if (gateType == 11) {
-				gate1Code = (ppqnCount == 0 ? 3 : 0);
-			}
-			else {
-				gate1Code = getAdvGate(ppqnCount, pulsesPerStep, gateType);
-			}
-		}
-	}
 	
 
 	void process(const ProcessArgs &args) override {
@@ -935,6 +886,16 @@ struct SemiModularSynth : Module {
 		static const float editGateLengthTime = 3.5f;// seconds
 		
 		
+		// Steps, song and random stream loaded by dataFromJson()
+		const SemiModularSynthData* loaded = jsonHandoff.beginAdopt();
+		if (loaded != nullptr) {
+			*static_cast<PhraseSeqData<16, 16>*>(&sek) = loaded->seq;
+			rng.setState(loaded->rngState);
+			jsonHandoff.endAdopt();
+			resetNonJson();
+		}
+
+
 		//********** Buttons, knobs, switches and inputs **********
 		
 		// Edit mode
@@ -959,9 +920,9 @@ struct SemiModularSynth : Module {
 			}
 			if (running && attached) {
 				if (editingSequence)
-					stepIndexEdit = stepIndexRun;
+					stepIndexEdit = sek.stepIndexRun[0];
 				else
-					phraseIndexEdit = phraseIndexRun;
+					phraseIndexEdit = sek.phraseIndexRun;
 			}
 			
 			// Copy button
@@ -977,15 +938,15 @@ struct SemiModularSynth : Module {
 						countCP = std::min(8, 16 - startCP);
 					if (editingSequence) {
 						for (int i = 0, s = startCP; i < countCP; i++, s++) {
-							cvCPbuffer[i] = cv[seqIndexEdit][s];
-							attribCPbuffer[i] = attributes[seqIndexEdit][s];
+							cvCPbuffer[i] = sek.cv[seqIndexEdit][s];
+							attribCPbuffer[i] = sek.attributes[seqIndexEdit][s];
 						}
-						seqAttribCPbuffer.setSeqAttrib(sequences[seqIndexEdit].getSeqAttrib());
+						seqAttribCPbuffer.setSeqAttrib(sek.sequences[seqIndexEdit].getSeqAttrib());
 						seqCopied = true;
 					}
 					else {
 						for (int i = 0, p = startCP; i < countCP; i++, p++)
-							phraseCPbuffer[i] = phrase[p];
+							phraseCPbuffer[i] = sek.phrase[p];
 						seqCopied = false;// so that a cross paste can be detected
 					}
 					infoCopyPaste = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
@@ -1008,11 +969,11 @@ struct SemiModularSynth : Module {
 					if (editingSequence) {
 						if (seqCopied) {// non-crossed paste (seq vs song)
 							for (int i = 0, s = startCP; i < countCP; i++, s++) {
-								cv[seqIndexEdit][s] = cvCPbuffer[i];
-								attributes[seqIndexEdit][s] = attribCPbuffer[i];
+								sek.cv[seqIndexEdit][s] = cvCPbuffer[i];
+								sek.attributes[seqIndexEdit][s] = attribCPbuffer[i];
 							}
 							if (params[CPMODE_PARAM].getValue() > 1.5f) {// all
-								sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
+								sek.sequences[seqIndexEdit].setSeqAttrib(seqAttribCPbuffer.getSeqAttrib());
 							}
 						}
 						else {// crossed paste to seq (seq vs song)
@@ -1020,21 +981,21 @@ struct SemiModularSynth : Module {
 								for (int s = 0; s < 16; s++) {
 									//cv[seqIndexEdit][s] = 0.0f;
 									//attributes[seqIndexEdit][s].init();
-									attributes[seqIndexEdit][s].toggleGate1();
+									sek.attributes[seqIndexEdit][s].toggleGate1();
 								}
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
+								sek.sequences[seqIndexEdit].setTranspose(0);
+								sek.sequences[seqIndexEdit].setRotate(0);
 							}
 							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (randomize CVs)
 								for (int s = 0; s < 16; s++)
-									cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
-								sequences[seqIndexEdit].setTranspose(0);
-								sequences[seqIndexEdit].setRotate(0);
+									sek.cv[seqIndexEdit][s] = ((float)(random::u32() % 7)) + ((float)(random::u32() % 12)) / 12.0f - 3.0f;
+								sek.sequences[seqIndexEdit].setTranspose(0);
+								sek.sequences[seqIndexEdit].setRotate(0);
 							}
 							else {// 8 (randomize gate 1)
 								for (int s = 0; s < 16; s++)
 									if ( (random::u32() & 0x1) != 0)
-										attributes[seqIndexEdit][s].toggleGate1();
+										sek.attributes[seqIndexEdit][s].toggleGate1();
 							}
 							startCP = 0;
 							countCP = 16;
@@ -1044,20 +1005,20 @@ struct SemiModularSynth : Module {
 					else {
 						if (!seqCopied) {// non-crossed paste (seq vs song)
 							for (int i = 0, p = startCP; i < countCP; i++, p++)
-								phrase[p] = phraseCPbuffer[i];
+								sek.phrase[p] = phraseCPbuffer[i];
 						}
 						else {// crossed paste to song (seq vs song)
 							if (params[CPMODE_PARAM].getValue() > 1.5f) { // ALL (init phrases)
 								for (int p = 0; p < 16; p++)
-									phrase[p] = 0;
+									sek.phrase[p] = 0;
 							}
 							else if (params[CPMODE_PARAM].getValue() < 0.5f) {// 4 (phrases increase from 1 to 16)
 								for (int p = 0; p < 16; p++)
-									phrase[p] = p;						
+									sek.phrase[p] = p;						
 							}
 							else {// 8 (randomize phrases)
 								for (int p = 0; p < 16; p++)
-									phrase[p] = random::u32() % 16;
+									sek.phrase[p] = random::u32() % 16;
 							}
 							startCP = 0;
 							countCP = 16;
@@ -1075,16 +1036,16 @@ struct SemiModularSynth : Module {
 			bool writeTrig = writeTrigger.process(inputs[WRITE_INPUT].getVoltage());
 			if (writeTrig) {
 				if (editingSequence) {
-					if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {
-						cv[seqIndexEdit][stepIndexEdit] = inputs[CV_INPUT].getVoltage();
-						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+					if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+						sek.cv[seqIndexEdit][stepIndexEdit] = inputs[CV_INPUT].getVoltage();
+						sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 					}
 					editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					editingGateCV = inputs[CV_INPUT].getVoltage();// cv[seqIndexEdit][stepIndexEdit];
 					editingGateKeyLight = -1;
 					// Autostep (after grab all active inputs)
 					if (params[AUTOSTEP_PARAM].getValue() > 0.5f) {
-						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, autostepLen ? sequences[seqIndexEdit].getLength() : 16);
+						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, autostepLen ? sek.sequences[seqIndexEdit].getLength() : 16);
 						if (stepIndexEdit == 0 && autoseq)
 							seqIndexEdit = moveIndex(seqIndexEdit, seqIndexEdit + 1, 16);
 					}
@@ -1105,10 +1066,10 @@ struct SemiModularSynth : Module {
 				if (!running || !attached) {// don't move heads when attach and running
 					if (editingSequence) {
 						stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + delta, 16);
-						if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
+						if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
 							if (!writeTrig) {// in case autostep when simultaneous writeCV and stepCV (keep what was done in Write Input block above)
 								editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-								editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+								editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 								editingGateKeyLight = -1;
 							}
 						}
@@ -1116,7 +1077,7 @@ struct SemiModularSynth : Module {
 					else {
 						phraseIndexEdit = moveIndex(phraseIndexEdit, phraseIndexEdit + delta, 16);
 						if (!running)
-							phraseIndexRun = phraseIndexEdit;
+							sek.phraseIndexRun = phraseIndexEdit;
 					}
 				}
 			}
@@ -1130,25 +1091,25 @@ struct SemiModularSynth : Module {
 			if (stepPressed != -1) {
 				if (displayState == DISP_LENGTH) {
 					if (editingSequence)
-						sequences[seqIndexEdit].setLength(stepPressed + 1);
+						sek.sequences[seqIndexEdit].setLength(stepPressed + 1);
 					else
-						phrases = stepPressed + 1;
+						sek.phrases = stepPressed + 1;
 					revertDisplay = (long) (revertDisplayTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 				else {
 					if (!running || !attached) {// not running or detached
 						if (editingSequence) {
 							stepIndexEdit = stepPressed;
-							if (!attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
+							if (!sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {// play if non-tied step
 								editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-								editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+								editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 								editingGateKeyLight = -1;
 							}
 						}
 						else {
 							phraseIndexEdit = stepPressed;
 							if (!running)
-								phraseIndexRun = phraseIndexEdit;
+								sek.phraseIndexRun = phraseIndexEdit;
 						}
 					}
 					else {// attached and running
@@ -1200,48 +1161,48 @@ struct SemiModularSynth : Module {
 				if (abs(deltaKnob) <= 3) {// avoid discontinuous step (initialize for example)
 					// any changes in here should may also require right click behavior to be updated in the knob's onMouseDown()
 					if (editingPpqn != 0) {
-						pulsesPerStep = indexToPps(ppsToIndex(pulsesPerStep) + deltaKnob);// indexToPps() does clamping
+						sek.pulsesPerStep = indexToPps(ppsToIndex(sek.pulsesPerStep) + deltaKnob);// indexToPps() does clamping
 						editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 					else if (displayState == DISP_MODE) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setRunMode(clamp(sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_MODES - 1 - 1)));
+							sek.sequences[seqIndexEdit].setRunMode(clamp(sek.sequences[seqIndexEdit].getRunMode() + deltaKnob, 0, (NUM_MODES - 1 - 1)));
 						}
 						else {
-							runModeSong = clamp(runModeSong + deltaKnob, 0, 6 - 1);
+							sek.runModeSong = clamp(sek.runModeSong + deltaKnob, 0, 6 - 1);
 						}
 					}
 					else if (displayState == DISP_LENGTH) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setLength(clamp(sequences[seqIndexEdit].getLength() + deltaKnob, 1, 16));
+							sek.sequences[seqIndexEdit].setLength(clamp(sek.sequences[seqIndexEdit].getLength() + deltaKnob, 1, 16));
 						}
 						else {
-							phrases = clamp(phrases + deltaKnob, 1, 16);
+							sek.phrases = clamp(sek.phrases + deltaKnob, 1, 16);
 						}
 					}
 					else if (displayState == DISP_TRANSPOSE) {
 						if (editingSequence) {
-							sequences[seqIndexEdit].setTranspose(clamp(sequences[seqIndexEdit].getTranspose() + deltaKnob, -99, 99));
+							sek.sequences[seqIndexEdit].setTranspose(clamp(sek.sequences[seqIndexEdit].getTranspose() + deltaKnob, -99, 99));
 							float transposeOffsetCV = ((float)(deltaKnob))/12.0f;// Tranpose by deltaKnob number of semi-tones
 							for (int s = 0; s < 16; s++) {
-								cv[seqIndexEdit][s] += transposeOffsetCV;
+								sek.cv[seqIndexEdit][s] += transposeOffsetCV;
 							}
 						}
 					}
 					else if (displayState == DISP_ROTATE) {
 						if (editingSequence) {
-							int slength = sequences[seqIndexEdit].getLength();
-							sequences[seqIndexEdit].setRotate(clamp(sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
+							int slength = sek.sequences[seqIndexEdit].getLength();
+							sek.sequences[seqIndexEdit].setRotate(clamp(sek.sequences[seqIndexEdit].getRotate() + deltaKnob, -99, 99));
 							if (deltaKnob > 0 && deltaKnob < 201) {// Rotate right, 201 is safety
 								for (int i = deltaKnob; i > 0; i--) {
-									rotateSeq(seqIndexEdit, true, slength);
+									sek.rotateSeq(seqIndexEdit, true, slength, 0);
 									if (stepIndexEdit < slength)
 										stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, slength);
 								}
 							}
 							if (deltaKnob < 0 && deltaKnob > -201) {// Rotate left, 201 is safety
 								for (int i = deltaKnob; i < 0; i++) {
-									rotateSeq(seqIndexEdit, false, slength);
+									sek.rotateSeq(seqIndexEdit, false, slength, 0);
 									if (stepIndexEdit < slength)
 										stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit - 1, slength);
 								}
@@ -1256,7 +1217,7 @@ struct SemiModularSynth : Module {
 						}
 						else {
 							if (!attached || !running)
-								phrase[phraseIndexEdit] = clamp(phrase[phraseIndexEdit] + deltaKnob, 0, 16 - 1);
+								sek.phrase[phraseIndexEdit] = clamp(sek.phrase[phraseIndexEdit] + deltaKnob, 0, 16 - 1);
 							else
 								attachedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 						}
@@ -1270,13 +1231,13 @@ struct SemiModularSynth : Module {
 				if (octTriggers[i].process(params[OCTAVE_PARAM + i].getValue())) {
 					if (editingSequence) {
 						displayState = DISP_NORMAL;
-						if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+						if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 						else {			
-							cv[seqIndexEdit][stepIndexEdit] = applyNewOct(cv[seqIndexEdit][stepIndexEdit], 3 - i);
-							propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+							sek.cv[seqIndexEdit][stepIndexEdit] = applyNewOct(sek.cv[seqIndexEdit][stepIndexEdit], 3 - i);
+							sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 							editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-							editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+							editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 							editingGateKeyLight = -1;
 						}
 					}
@@ -1288,39 +1249,39 @@ struct SemiModularSynth : Module {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
 					if (editingGateLength != 0l) {
-						int newMode = keyIndexToGateMode(pkInfo.key, pulsesPerStep);
+						int newMode = keyIndexToGateMode(pkInfo.key, sek.pulsesPerStep, (APP->window->getMods() & GLFW_MOD_ALT) != 0);
 						if (newMode != -1) {
 							editingPpqn = 0l;
-							attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
+							sek.attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
 							if (pkInfo.isRightClick) {
 								stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 16);
 								editingType = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 								editingGateKeyLight = pkInfo.key;
 								if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL)
-									attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
+									sek.attributes[seqIndexEdit][stepIndexEdit].setGateMode(newMode, editingGateLength > 0l);
 							}
 						}
 						else
 							editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
-					else if (attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+					else if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
 						if (pkInfo.isRightClick)
 							stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 16);
 						else
 							tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					}
 					else {			
-						float newCV = std::floor(cv[seqIndexEdit][stepIndexEdit]) + ((float) pkInfo.key) / 12.0f;
-						cv[seqIndexEdit][stepIndexEdit] = newCV;
-						propagateCVtoTied(seqIndexEdit, stepIndexEdit);
+						float newCV = std::floor(sek.cv[seqIndexEdit][stepIndexEdit]) + ((float) pkInfo.key) / 12.0f;
+						sek.cv[seqIndexEdit][stepIndexEdit] = newCV;
+						sek.propagateCVtoTied(seqIndexEdit, stepIndexEdit);
 						editingGate = (unsigned long) (gateTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
-						editingGateCV = cv[seqIndexEdit][stepIndexEdit];
+						editingGateCV = sek.cv[seqIndexEdit][stepIndexEdit];
 						editingGateKeyLight = -1;
 						if (pkInfo.isRightClick) {
 							stepIndexEdit = moveIndex(stepIndexEdit, stepIndexEdit + 1, 16);
 							editingGateKeyLight = pkInfo.key;
 							if ((APP->window->getMods() & RACK_MOD_MASK) == RACK_MOD_CTRL)
-								cv[seqIndexEdit][stepIndexEdit] = newCV;
+								sek.cv[seqIndexEdit][stepIndexEdit] = newCV;
 						}
 					}						
 				}
@@ -1344,41 +1305,41 @@ struct SemiModularSynth : Module {
 			if (gate1Trigger.process(params[GATE1_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					attributes[seqIndexEdit][stepIndexEdit].toggleGate1();
+					sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate1();
 				}
 			}		
 			if (gate1ProbTrigger.process(params[GATE1_PROB_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					else
-						attributes[seqIndexEdit][stepIndexEdit].toggleGate1P();
+						sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate1P();
 				}
 			}		
 			if (gate2Trigger.process(params[GATE2_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					attributes[seqIndexEdit][stepIndexEdit].toggleGate2();
+					sek.attributes[seqIndexEdit][stepIndexEdit].toggleGate2();
 				}
 			}		
 			if (slideTrigger.process(params[SLIDE_BTN_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied())
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied())
 						tiedWarning = (long) (warningTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 					else
-						attributes[seqIndexEdit][stepIndexEdit].toggleSlide();
+						sek.attributes[seqIndexEdit][stepIndexEdit].toggleSlide();
 				}
 			}		
 			if (tiedTrigger.process(params[TIE_PARAM].getValue())) {
 				if (editingSequence) {
 					displayState = DISP_NORMAL;
-					if (attributes[seqIndexEdit][stepIndexEdit].getTied()) {
-						deactivateTiedStep(seqIndexEdit, stepIndexEdit);
+					if (sek.attributes[seqIndexEdit][stepIndexEdit].getTied()) {
+						sek.deactivateTiedStep(seqIndexEdit, stepIndexEdit, holdTiedNotes);
 					}
 					else {
-						activateTiedStep(seqIndexEdit, stepIndexEdit);
+						sek.activateTiedStep(seqIndexEdit, stepIndexEdit, holdTiedNotes);
 					}
 				}
 			}		
@@ -1408,61 +1369,10 @@ struct SemiModularSynth : Module {
 		float clockInput = inputs[CLOCK_INPUT].isConnected() ? inputs[CLOCK_INPUT].getVoltage() : clkValue;// Pre-patching
 		if (running && clockIgnoreOnReset == 0l) {
 			if (clockTrigger.process(clockInput)) {
-				ppqnCount++;
-				if (ppqnCount >= pulsesPerStep)
-					ppqnCount = 0;
-
-				int newSeq = seqIndexEdit;// good value when editingSequence, overwrite if not editingSequence
-				if (ppqnCount == 0) {
-					float slideFromCV = 0.0f;
-					int oldStepIndexRun = stepIndexRun;
-					if (editingSequence) {
-						slideFromCV = cv[seqIndexEdit][stepIndexRun];
-						//bool seqLoopOver = 
-						moveIndexRunMode(&stepIndexRun, sequences[seqIndexEdit].getLength(), sequences[seqIndexEdit].getRunMode(), &stepIndexRunHistory);
-						// if (seqLoopOver && stopAtEndOfSong) {
-							// running = false;
-							// stepIndexRun = oldStepIndexRun;
-						// }
-					}
-					else {
-						slideFromCV = cv[phrase[phraseIndexRun]][stepIndexRun];
-						if (moveIndexRunMode(&stepIndexRun, sequences[phrase[phraseIndexRun]].getLength(), sequences[phrase[phraseIndexRun]].getRunMode(), &stepIndexRunHistory)) {
-							int oldPhraseIndexRun = phraseIndexRun;
-							bool songLoopOver = moveIndexRunMode(&phraseIndexRun, phrases, runModeSong, &phraseIndexRunHistory);
-							// check for end of song if needed
-							if (songLoopOver && stopAtEndOfSong) {
-								running = false;
-								stepIndexRun = oldStepIndexRun;
-								phraseIndexRun = oldPhraseIndexRun;
-							}
-							else {
-								stepIndexRun = (sequences[phrase[phraseIndexRun]].getRunMode() == MODE_REV ? sequences[phrase[phraseIndexRun]].getLength() - 1 : 0);// must always refresh after phraseIndexRun has changed
-							}
-						}
-						newSeq = phrase[phraseIndexRun];
-					}
-					
-					// Slide
-					if (attributes[newSeq][stepIndexRun].getSlide()) {
-						slideStepsRemain =   (unsigned long) (((float)clockPeriod * pulsesPerStep) * params[SLIDE_KNOB_PARAM].getValue() / 2.0f);
-						if (slideStepsRemain != 0ul) {
-							float slideToCV = cv[newSeq][stepIndexRun];
-							slideCVdelta = (slideToCV - slideFromCV)/(float)slideStepsRemain;
-						}
-					}
-					else 
-						slideStepsRemain = 0ul;
-				}
-				else {
-					if (!editingSequence)
-						newSeq = phrase[phraseIndexRun];
-				}
-				calcGate1Code(attributes[newSeq][stepIndexRun]);
-				gate2Code = calcGate2Code(attributes[newSeq][stepIndexRun], ppqnCount, pulsesPerStep);
-				clockPeriod = 0ul;				
+				if (sek.clockStep(editingSequence, seqIndexEdit, stopAtEndOfSong, params[GATE1_KNOB_PARAM].getValue(), params[SLIDE_KNOB_PARAM].getValue()))
+					running = false;// end of song
 			}
-			clockPeriod++;
+			sek.process();
 		}	
 		
 		// Reset
@@ -1478,24 +1388,22 @@ struct SemiModularSynth : Module {
 		//********** Outputs and lights **********
 				
 		// CV and gates outputs
-		int seq = editingSequence ? seqIndexEdit : phrase[phraseIndexRun];
-		int step = (editingSequence && !running) ? stepIndexEdit : stepIndexRun;
+		int seq = editingSequence ? seqIndexEdit : sek.phrase[sek.phraseIndexRun];
+		int step = (editingSequence && !running) ? stepIndexEdit : sek.stepIndexRun[0];
 		if (running) {
 			bool muteGate1 = !editingSequence && (params[GATE1_PARAM].getValue() > 0.5f);// live mute
 			bool muteGate2 = !editingSequence && (params[GATE2_PARAM].getValue() > 0.5f);// live mute
-			float slideOffset = (slideStepsRemain > 0ul ? (slideCVdelta * (float)slideStepsRemain) : 0.0f);
-			outputs[CV_OUTPUT].setVoltage(cv[seq][step] - slideOffset);
+			outputs[CV_OUTPUT].setVoltage(sek.calcCvOutput(seq, 0));
 			bool retriggingOnReset = (clockIgnoreOnReset != 0l && retrigGatesOnReset);
-			outputs[GATE1_OUTPUT].setVoltage((calcGate(gate1Code, clockTrigger, clockPeriod, sampleRate) && !muteGate1 && !retriggingOnReset) ? 10.0f : 0.0f);
-			outputs[GATE2_OUTPUT].setVoltage((calcGate(gate2Code, clockTrigger, clockPeriod, sampleRate) && !muteGate2 && !retriggingOnReset) ? 10.0f : 0.0f);
+			outputs[GATE1_OUTPUT].setVoltage((sek.calcGate1Output(0, clockTrigger, sampleRate) && !muteGate1 && !retriggingOnReset) ? 10.0f : 0.0f);
+			outputs[GATE2_OUTPUT].setVoltage((sek.calcGate2Output(0, clockTrigger, sampleRate) && !muteGate2 && !retriggingOnReset) ? 10.0f : 0.0f);
 		}
 		else {// not running 
-			outputs[CV_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : cv[seq][step]);
+			outputs[CV_OUTPUT].setVoltage((editingGate > 0ul) ? editingGateCV : sek.cv[seq][step]);
 			outputs[GATE1_OUTPUT].setVoltage((editingGate > 0ul) ? 10.0f : 0.0f);
 			outputs[GATE2_OUTPUT].setVoltage((editingGate > 0ul) ? 10.0f : 0.0f);
 		}
-		if (slideStepsRemain > 0ul)
-			slideStepsRemain--;
+		sek.decSlideStepsRemain();
 		
 		// lights
 		if (refresh.processLights()) {
@@ -1510,31 +1418,31 @@ struct SemiModularSynth : Module {
 				}
 				else if (displayState == DISP_LENGTH) {
 					if (editingSequence) {
-						if (i < (sequences[seqIndexEdit].getLength() - 1))
+						if (i < (sek.sequences[seqIndexEdit].getLength() - 1))
 							green = 0.32f;
-						else if (i == (sequences[seqIndexEdit].getLength() - 1))
+						else if (i == (sek.sequences[seqIndexEdit].getLength() - 1))
 							green = 1.0f;
 					}
 					else {
-						if (i < phrases - 1)
+						if (i < sek.phrases - 1)
 							green = 0.32f;
 						else
-							green = (i == phrases - 1) ? 1.0f : 0.0f;
+							green = (i == sek.phrases - 1) ? 1.0f : 0.0f;
 					}					
 				}
 				else if (displayState == DISP_TRANSPOSE) {
 					red = 0.71f;
 				}
 				else if (displayState == DISP_ROTATE) {
-					red = (i == stepIndexEdit ? 1.0f : (i < sequences[seqIndexEdit].getLength() ? 0.45f : 0.0f));
+					red = (i == stepIndexEdit ? 1.0f : (i < sek.sequences[seqIndexEdit].getLength() ? 0.45f : 0.0f));
 				}
 				else {// normal led display (i.e. not length)
 					// Run cursor (green)
 					if (editingSequence)
-						green = ((running && (i == stepIndexRun)) ? 1.0f : 0.0f);
+						green = ((running && (i == sek.stepIndexRun[0])) ? 1.0f : 0.0f);
 					else {
-						green = ((running && (i == phraseIndexRun)) ? 1.0f : 0.0f);
-						green += ((running && (i == stepIndexRun) && i != phraseIndexEdit) ? 0.42f : 0.0f);
+						green = ((running && (i == sek.phraseIndexRun)) ? 1.0f : 0.0f);
+						green += ((running && (i == sek.stepIndexRun[0]) && i != phraseIndexEdit) ? 0.42f : 0.0f);
 						green = std::min(green, 1.0f);
 					}
 					// Edit cursor (red)
@@ -1544,9 +1452,9 @@ struct SemiModularSynth : Module {
 						red = (i == phraseIndexEdit ? 1.0f : 0.0f);
 					bool gate = false;
 					if (editingSequence)
-						gate = attributes[seqIndexEdit][i].getGate1();
+						gate = sek.attributes[seqIndexEdit][i].getGate1();
 					else if (!editingSequence && (attached && running))
-						gate = attributes[phrase[phraseIndexRun]][i].getGate1();
+						gate = sek.attributes[sek.phrase[sek.phraseIndexRun]][i].getGate1();
 					white = ((green == 0.0f && red == 0.0f && gate && displayState != DISP_MODE) ? 0.15f : 0.0f);
 					if (editingSequence && white != 0.0f) {
 						green = 0.14f; white = 0.0f;
@@ -1557,7 +1465,7 @@ struct SemiModularSynth : Module {
 			}
 		
 			// Octave lights
-			float cvVal = editingSequence ? cv[seqIndexEdit][stepIndexEdit] : cv[phrase[phraseIndexEdit]][stepIndexRun];
+			float cvVal = editingSequence ? sek.cv[seqIndexEdit][stepIndexEdit] : sek.cv[sek.phrase[phraseIndexEdit]][sek.stepIndexRun[0]];
 			int keyLightIndex;
 			int octLightIndex;
 			calcNoteAndOct(cvVal, &keyLightIndex, &octLightIndex);
@@ -1580,7 +1488,7 @@ struct SemiModularSynth : Module {
 			// Keyboard lights
 			if (editingPpqn != 0) {
 				for (int i = 0; i < 12; i++) {
-					if (keyIndexToGateMode(i, pulsesPerStep) != -1) {
+					if (keyIndexToGateMode(i, sek.pulsesPerStep) != -1) {
 						setGreenRed(KEY_LIGHTS + i * 2, 1.0f, 1.0f);
 					}
 					else {
@@ -1589,7 +1497,8 @@ struct SemiModularSynth : Module {
 				}
 			} 
 			else if (editingGateLength != 0l && editingSequence) {
-				int modeLightIndex = gateModeToKeyLightIndex(attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
+				int modeLightIndex = gateModeToKeyLightIndex(sek.attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
+				float modeLightDim = gateModeToKeyLightDim(sek.attributes[seqIndexEdit][stepIndexEdit], editingGateLength > 0l);
 				for (int i = 0; i < 12; i++) {
 					float green = editingGateLength > 0l ? 1.0f : 0.45f;
 					float red = editingGateLength > 0l ? 0.45f : 1.0f;
@@ -1603,7 +1512,7 @@ struct SemiModularSynth : Module {
 					}
 					else {
 						if (i == modeLightIndex) {
-							setGreenRed(KEY_LIGHTS + i * 2, green, red);
+							setGreenRed(KEY_LIGHTS + i * 2, green * modeLightDim, red * modeLightDim);
 						}
 						else { // show dim note if gatetype is different than note
 							setGreenRed(KEY_LIGHTS + i * 2, 0.0f, (i == keyLightIndex ? 0.32f : 0.0f));
@@ -1653,9 +1562,9 @@ struct SemiModularSynth : Module {
 				lights[TIE_LIGHT].setBrightness(0.0f);
 			}
 			else {
-				StepAttributes attributesVal = attributes[seqIndexEdit][stepIndexEdit];
+				StepAttributes attributesVal = sek.attributes[seqIndexEdit][stepIndexEdit];
 				if (!editingSequence)
-					attributesVal = attributes[phrase[phraseIndexEdit]][stepIndexRun];
+					attributesVal = sek.attributes[sek.phrase[phraseIndexEdit]][sek.stepIndexRun[0]];
 				//
 				setGateLight(attributesVal.getGate1(), GATE1_LIGHT);
 				setGateLight(attributesVal.getGate2(), GATE2_LIGHT);
@@ -1716,32 +1625,52 @@ struct SemiModularSynth : Module {
 
 		
 		// VCO
-		oscillatorVco.analog = params[VCO_MODE_PARAM].getValue() > 0.0f;
+		// polyphonic when the pitch input is, four voices per oscillator bank
+		int vcoChannels = std::max(1, inputs[VCO_PITCH_INPUT].getChannels());
+		bool vcoAnalog = params[VCO_MODE_PARAM].getValue() > 0.0f;
+		float pitchKnob = params[VCO_FREQ_PARAM].getValue();
 		float pitchFine = 3.0f * dsp::quadraticBipolar(params[VCO_FINE_PARAM].getValue());
-		float pitchCv = 12.0f * (inputs[VCO_PITCH_INPUT].isConnected() ? inputs[VCO_PITCH_INPUT].getVoltage() : outputs[CV_OUTPUT].getVoltage());// Pre-patching
 		float pitchOctOffset = 12.0f * params[VCO_OCT_PARAM].getValue();
-		if (inputs[VCO_FM_INPUT].isConnected()) {
-			pitchCv += dsp::quadraticBipolar(params[VCO_FM_PARAM].getValue()) * 12.0f * inputs[VCO_FM_INPUT].getVoltage();
-		}
-		oscillatorVco.setPitch(params[VCO_FREQ_PARAM].getValue(), pitchFine + pitchCv + pitchOctOffset);
-		oscillatorVco.setPulseWidth(params[VCO_PW_PARAM].getValue() + params[VCO_PWM_PARAM].getValue() * inputs[VCO_PW_INPUT].getVoltage() / 10.0f);
-		oscillatorVco.syncEnabled = inputs[VCO_SYNC_INPUT].isConnected();
-		oscillatorVco.process(args.sampleTime, inputs[VCO_SYNC_INPUT].getVoltage());
-		if (outputs[VCO_SIN_OUTPUT].isConnected()) {
-			outputs[VCO_SIN_OUTPUT].setVoltage(5.0f * oscillatorVco.sin());
-		}
-		if (outputs[VCO_TRI_OUTPUT].isConnected()) {
-			outputs[VCO_TRI_OUTPUT].setVoltage(5.0f * oscillatorVco.tri());
-		}
-		if (outputs[VCO_SAW_OUTPUT].isConnected()) {
-			outputs[VCO_SAW_OUTPUT].setVoltage(5.0f * oscillatorVco.saw());
+		float fmAmount = dsp::quadraticBipolar(params[VCO_FM_PARAM].getValue()) * 12.0f;
+		float pwKnob = params[VCO_PW_PARAM].getValue();
+		float pwmAmount = params[VCO_PWM_PARAM].getValue() / 10.0f;
+		bool sqrNeeded = outputs[VCO_SQR_OUTPUT].isConnected() || !inputs[VCA_IN1_INPUT].isConnected();// Pre-patching
+		for (int c = 0; c < vcoChannels; c += 4) {
+			VoltageControlledOscillator* vco = &oscillatorVcos[c >> 2];
+			vco->analog = vcoAnalog;
+			vco->channels = std::min(vcoChannels - c, 4);
+			vco->sinEnabled = outputs[VCO_SIN_OUTPUT].isConnected();
+			vco->triEnabled = outputs[VCO_TRI_OUTPUT].isConnected();
+			vco->sawEnabled = outputs[VCO_SAW_OUTPUT].isConnected();
+			vco->sqrEnabled = sqrNeeded;
+			simd::float_4 pitchCv = 12.0f * (inputs[VCO_PITCH_INPUT].isConnected() ? inputs[VCO_PITCH_INPUT].getPolyVoltageSimd<simd::float_4>(c) : simd::float_4(outputs[CV_OUTPUT].getVoltage()));// Pre-patching
+			if (inputs[VCO_FM_INPUT].isConnected()) {
+				pitchCv += fmAmount * inputs[VCO_FM_INPUT].getPolyVoltageSimd<simd::float_4>(c);
+			}
+			vco->setPitch(pitchKnob, pitchFine + pitchCv + pitchOctOffset);
+			vco->setPulseWidth(pwKnob + pwmAmount * inputs[VCO_PW_INPUT].getPolyVoltageSimd<simd::float_4>(c));
+			vco->syncEnabled = inputs[VCO_SYNC_INPUT].isConnected();
+			vco->process(args.sampleTime, inputs[VCO_SYNC_INPUT].getPolyVoltageSimd<simd::float_4>(c));
+			if (vco->sinEnabled) {
+				outputs[VCO_SIN_OUTPUT].setVoltageSimd(5.0f * vco->sinValue, c);
+			}
+			if (vco->triEnabled) {
+				outputs[VCO_TRI_OUTPUT].setVoltageSimd(5.0f * vco->triValue, c);
+			}
+			if (vco->sawEnabled) {
+				outputs[VCO_SAW_OUTPUT].setVoltageSimd(5.0f * vco->sawValue, c);
+			}
+			outputs[VCO_SQR_OUTPUT].setVoltageSimd(sqrNeeded ? 5.0f * vco->sqrValue : 0.0f, c);
 		}
-		outputs[VCO_SQR_OUTPUT].setVoltage(5.0f * oscillatorVco.sqr());		
+		outputs[VCO_SIN_OUTPUT].setChannels(vcoChannels);
+		outputs[VCO_TRI_OUTPUT].setChannels(vcoChannels);
+		outputs[VCO_SAW_OUTPUT].setChannels(vcoChannels);
+		outputs[VCO_SQR_OUTPUT].setChannels(vcoChannels);
 			
 			
 		// CLK
 		if (refresh.processInputs()) {
-			oscillatorClk.setPitch(params[CLK_FREQ_PARAM].getValue() + log2f(pulsesPerStep));
+			oscillatorClk.setPitch(params[CLK_FREQ_PARAM].getValue() + log2f(sek.pulsesPerStep));
 			oscillatorClk.setPulseWidth(params[CLK_PW_PARAM].getValue());
 		}	
 		oscillatorClk.step(args.sampleTime);
@@ -1759,15 +1688,16 @@ struct SemiModularSynth : Module {
 
 				
 		// ADSR
-		float attack = clamp(params[ADSR_ATTACK_PARAM].getValue(), 0.0f, 1.0f);
-		float decay = clamp(params[ADSR_DECAY_PARAM].getValue(), 0.0f, 1.0f);
-		float sustain = clamp(params[ADSR_SUSTAIN_PARAM].getValue(), 0.0f, 1.0f);
-		float release = clamp(params[ADSR_RELEASE_PARAM].getValue(), 0.0f, 1.0f);
+		if (refresh.processInputs()) {
+			updateAdsrRates();
+		}
+		float attack = adsrAttack;
+		float decay = adsrDecay;
+		float sustain = adsrSustain;
+		float release = adsrRelease;
 		// Gate
 		float adsrIn = inputs[ADSR_GATE_INPUT].isConnected() ? inputs[ADSR_GATE_INPUT].getVoltage() : outputs[GATE1_OUTPUT].getVoltage();// Pre-patching
 		bool gated = adsrIn >= 1.0f;
-		const float base = 20000.0f;
-		const float maxTime = 10.0f;
 		if (gated) {
 			if (decaying) {
 				// Decay
@@ -1775,7 +1705,7 @@ struct SemiModularSynth : Module {
 					env = sustain;
 				}
 				else {
-					env += std::pow(base, 1 - decay) / maxTime * (sustain - env) * args.sampleTime;
+					env += adsrDecayRate * (sustain - env) * args.sampleTime;
 				}
 			}
 			else {
@@ -1785,7 +1715,7 @@ struct SemiModularSynth : Module {
 					env = 1.0f;
 				}
 				else {
-					env += std::pow(base, 1 - attack) / maxTime * (1.01f - env) * args.sampleTime;
+					env += adsrAttackRate * (1.01f - env) * args.sampleTime;
 				}
 				if (env >= 1.0f) {
 					env = 1.0f;
@@ -1799,7 +1729,7 @@ struct SemiModularSynth : Module {
 				env = 0.0f;
 			}
 			else {
-				env += std::pow(base, 1 - release) / maxTime * (0.0f - env) * args.sampleTime;
+				env += adsrReleaseRate * (0.0f - env) * args.sampleTime;
 			}
 			decaying = false;
 		}
@@ -1808,28 +1738,41 @@ struct SemiModularSynth : Module {
 		
 		// VCF
 		if (outputs[VCF_LPF_OUTPUT].isConnected() || outputs[VCF_HPF_OUTPUT].isConnected()) {
-		
-			float input = (inputs[VCF_IN_INPUT].isConnected() ? inputs[VCF_IN_INPUT].getVoltage() : outputs[VCA_OUT1_OUTPUT].getVoltage()) / 5.0f;// Pre-patching
-			float drive = clamp(params[VCF_DRIVE_PARAM].getValue() + inputs[VCF_DRIVE_INPUT].getVoltage() / 10.0f, 0.f, 1.f);
-			float gain = std::pow(1.f + drive, 5);
-			input *= gain;
+			// polyphonic when the audio or cutoff inputs are, four voices per filter bank
+			int channels = std::max(1, std::max(inputs[VCF_IN_INPUT].getChannels(), inputs[VCF_FREQ_INPUT].getChannels()));
+			float freqCvAmount = dsp::quadraticBipolar(params[VCF_FREQ_CV_PARAM].getValue());
+			float pitchKnob = params[VCF_FREQ_PARAM].getValue() * 10.f - 5.f;
 			// Add -60dB noise to bootstrap self-oscillation
-			input += 1e-6f * (2.f * random::uniform() - 1.f);
-			// Set resonance
-			float res = clamp(params[VCF_RES_PARAM].getValue() + inputs[VCF_RES_INPUT].getVoltage() / 10.f, 0.f, 1.f);
-			filter.resonance = std::pow(res, 2) * 10.f;
-			// Set cutoff frequency
-			float pitch = 0.f;
-			if (inputs[VCF_FREQ_INPUT].isConnected())
-				pitch += inputs[VCF_FREQ_INPUT].getVoltage() * dsp::quadraticBipolar(params[VCF_FREQ_CV_PARAM].getValue());
-			pitch += params[VCF_FREQ_PARAM].getValue() * 10.f - 5.f;
-			//pitch += dsp::quadraticBipolar(params[FINE_PARAM].getValue() * 2.f - 1.f) * 7.f / 12.f;
-			float cutoff = 261.626f * std::pow(2.f, pitch);
-			cutoff = clamp(cutoff, 1.f, 8000.f);
-			filter.setCutoff(cutoff);
-			filter.process(input, args.sampleTime);
-			outputs[VCF_LPF_OUTPUT].setVoltage(5.f * filter.lowpass);
-			outputs[VCF_HPF_OUTPUT].setVoltage(5.f * filter.highpass);	
+			float noise = 1e-6f * (2.f * rng.uniform() - 1.f);
+			float prePatch = outputs[VCA_OUT1_OUTPUT].getVoltage();// used when VCF audio input is not connected
+			
+			for (int c = 0; c < channels; c += 4) {
+				LadderFilter<simd::float_4>* filter = &filters[c >> 2];
+				simd::float_4 input = (inputs[VCF_IN_INPUT].isConnected() ? inputs[VCF_IN_INPUT].getPolyVoltageSimd<simd::float_4>(c) : simd::float_4(prePatch)) / 5.0f;// Pre-patching
+				simd::float_4 drive = simd::clamp(params[VCF_DRIVE_PARAM].getValue() + inputs[VCF_DRIVE_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 10.0f, 0.f, 1.f);
+				simd::float_4 gain = 1.f + drive;
+				gain *= gain * gain * gain * gain;// (1 + drive) ^ 5
+				input *= gain;
+				input += noise;
+				// Set resonance
+				simd::float_4 res = simd::clamp(params[VCF_RES_PARAM].getValue() + inputs[VCF_RES_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 10.f, 0.f, 1.f);
+				filter->resonance = res * res * 10.f;
+				// Set cutoff frequency
+				simd::float_4 pitch = pitchKnob;
+				if (inputs[VCF_FREQ_INPUT].isConnected())
+					pitch += inputs[VCF_FREQ_INPUT].getPolyVoltageSimd<simd::float_4>(c) * freqCvAmount;
+				if (simd::movemask(pitch != vcfPitches[c >> 2])) {
+					vcfPitches[c >> 2] = pitch;
+					simd::float_4 cutoff = 261.626f * dsp::exp2_taylor5(pitch);
+					cutoff = simd::clamp(cutoff, 1.f, 8000.f);
+					filter->setCutoff(cutoff);
+				}
+				filter->process(input, args.sampleTime);
+				outputs[VCF_LPF_OUTPUT].setVoltageSimd(5.f * filter->lowpass, c);
+				outputs[VCF_HPF_OUTPUT].setVoltageSimd(5.f * filter->highpass, c);
+			}
+			outputs[VCF_LPF_OUTPUT].setChannels(channels);
+			outputs[VCF_HPF_OUTPUT].setChannels(channels);
 		}			
 		else {
 			outputs[VCF_LPF_OUTPUT].setVoltage(0.0f);
@@ -1861,47 +1804,6 @@ struct SemiModularSynth : Module {
 		lights[id + 1].setBrightness(red);
 	}
 	
-	inline void propagateCVtoTied(int seqn, int stepn) {
-		for (int i = stepn + 1; i < 16; i++) {
-			if (!attributes[seqn][i].getTied())
-				break;
-			cv[seqn][i] = cv[seqn][i - 1];
-		}	
-	}
-
-	void activateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(true);
-		if (stepn > 0) {
-			propagateCVtoTied(seqn, stepn - 1);
-		
-			if (holdTiedNotes) {// new method
-				attributes[seqn][stepn].setGate1(true);
-				for (int i = stepn; i < 16 && attributes[seqn][i].getTied(); i++) {
-					attributes[seqn][i].setGate1Mode(attributes[seqn][i - 1].getGate1Mode());
-					attributes[seqn][i - 1].setGate1Mode(5);
-					attributes[seqn][i - 1].setGate1(true);
-				}
-			}
-			else {// old method
-				// if (stepn > 0) {
-					attributes[seqn][stepn] = attributes[seqn][stepn - 1];
-					attributes[seqn][stepn].setTied(true);
-				// }
-			}
-		}
-	}
-	
-	void deactivateTiedStep(int seqn, int stepn) {
-		attributes[seqn][stepn].setTied(false);
-		if (holdTiedNotes && stepn != 0) {// new method
-			int lastGateType = attributes[seqn][stepn].getGate1Mode();
-			for (int i = stepn + 1; i < 16 && attributes[seqn][i].getTied(); i++)
-				lastGateType = attributes[seqn][i].getGate1Mode();
-			attributes[seqn][stepn - 1].setGate1Mode(lastGateType);
-		}
-		//else old method, nothing to do
-	}
-	
 	inline void setGateLight(bool gateOn, int lightIndex) {
 		if (!gateOn) {
 			lights[lightIndex + 0].setBrightness(0.0f);
@@ -1956,7 +1858,7 @@ struct SemiModularSynthWidget : ModuleWidget {
 					if ((!module->running || !module->attached) && !module->isEditingSequence()) {
 						module->phraseIndexEdit = moveIndex(module->phraseIndexEdit, module->phraseIndexEdit + 1, 16);
 						if (!module->running)
-							module->phraseIndexRun = module->phraseIndexEdit;
+							module->sek.phraseIndexRun = module->phraseIndexEdit;
 					}
 				}
 				if (num != -1) {
@@ -1975,9 +1877,9 @@ struct SemiModularSynthWidget : ModuleWidget {
 					else if (module->displayState == SemiModularSynth::DISP_LENGTH) {
 						totalNum = clamp(totalNum, 1, 16);
 						if (editingSequence)
-							module->sequences[module->seqIndexEdit].setLength(totalNum);
+							module->sek.sequences[module->seqIndexEdit].setLength(totalNum);
 						else
-							module->phrases = totalNum;
+							module->sek.phrases = totalNum;
 					}
 					else if (module->displayState == SemiModularSynth::DISP_TRANSPOSE) {
 					}
@@ -1991,7 +1893,7 @@ struct SemiModularSynthWidget : ModuleWidget {
 						}
 						else {
 							if (!module->attached || !module->running)
-								module->phrase[module->phraseIndexEdit] = totalNum - 1;
+								module->sek.phrase[module->phraseIndexEdit] = totalNum - 1;
 						}
 
 					}
@@ -2051,33 +1953,33 @@ struct SemiModularSynthWidget : ModuleWidget {
 						}
 					}
 					else if (module->editingPpqn != 0ul) {
-						snprintf(displayStr, 16, "x%2u", (unsigned) module->pulsesPerStep);
+						snprintf(displayStr, 16, "x%2u", (unsigned) module->sek.pulsesPerStep);
 					}
 					else if (module->displayState == SemiModularSynth::DISP_MODE) {
 						if (editingSequence)
-							runModeToStr(module->sequences[module->seqIndexEdit].getRunMode());
+							runModeToStr(module->sek.sequences[module->seqIndexEdit].getRunMode());
 						else
-							runModeToStr(module->runModeSong);
+							runModeToStr(module->sek.runModeSong);
 					}
 					else if (module->displayState == SemiModularSynth::DISP_LENGTH) {
 						if (editingSequence)
-							snprintf(displayStr, 16, "L%2u", (unsigned) module->sequences[module->seqIndexEdit].getLength());
+							snprintf(displayStr, 16, "L%2u", (unsigned) module->sek.sequences[module->seqIndexEdit].getLength());
 						else
-							snprintf(displayStr, 16, "L%2u", (unsigned) module->phrases);
+							snprintf(displayStr, 16, "L%2u", (unsigned) module->sek.phrases);
 					}
 					else if (module->displayState == SemiModularSynth::DISP_TRANSPOSE) {
-						snprintf(displayStr, 16, "+%2u", (unsigned) abs(module->sequences[module->seqIndexEdit].getTranspose()));
-						if (module->sequences[module->seqIndexEdit].getTranspose() < 0)
+						snprintf(displayStr, 16, "+%2u", (unsigned) abs(module->sek.sequences[module->seqIndexEdit].getTranspose()));
+						if (module->sek.sequences[module->seqIndexEdit].getTranspose() < 0)
 							displayStr[0] = '-';
 					}
 					else if (module->displayState == SemiModularSynth::DISP_ROTATE) {
-						snprintf(displayStr, 16, ")%2u", (unsigned) abs(module->sequences[module->seqIndexEdit].getRotate()));
-						if (module->sequences[module->seqIndexEdit].getRotate() < 0)
+						snprintf(displayStr, 16, ")%2u", (unsigned) abs(module->sek.sequences[module->seqIndexEdit].getRotate()));
+						if (module->sek.sequences[module->seqIndexEdit].getRotate() < 0)
 							displayStr[0] = '(';
 					}
 					else {// DISP_NORMAL
 						snprintf(displayStr, 16, " %2u", (unsigned) (editingSequence ? 
-							module->seqIndexEdit : module->phrase[module->phraseIndexEdit]) + 1 );
+							module->seqIndexEdit : module->sek.phrase[module->phraseIndexEdit]) + 1 );
 					}
 				}
 				nvgText(args.vg, textPos.x, textPos.y, displayStr, NULL);
@@ -2164,6 +2066,8 @@ struct SemiModularSynthWidget : ModuleWidget {
 		menu->addChild(createBoolPtrMenuItem("AutoStep write bounded by seq length", "", &module->autostepLen));
 
 		menu->addChild(createBoolPtrMenuItem("AutoSeq when writing via CV inputs", "", &module->autoseq));
+
+		menu->addChild(createBoolPtrMenuItem("Same random values on every load", "", &module->rng.deterministic));
 	}	
 	
 	struct SequenceKnob : IMBigKnobInf {
@@ -2174,23 +2078,23 @@ struct SemiModularSynthWidget : ModuleWidget {
 				SemiModularSynth* module = static_cast<SemiModularSynth*>(paramQuantity->module);
 				// same code structure below as in sequence knob in main step()
 				if (module->editingPpqn != 0) {
-					module->pulsesPerStep = 1;
+					module->sek.pulsesPerStep = 1;
 					//editingPpqn = (long) (editGateLengthTime * sampleRate / RefreshCounter::displayRefreshStepSkips);
 				}
 				else if (module->displayState == SemiModularSynth::DISP_MODE) {
 					if (module->isEditingSequence()) {
-						module->sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
+						module->sek.sequences[module->seqIndexEdit].setRunMode(MODE_FWD);
 					}
 					else {
-						module->runModeSong = MODE_FWD;
+						module->sek.runModeSong = MODE_FWD;
 					}
 				}
 				else if (module->displayState == SemiModularSynth::DISP_LENGTH) {
 					if (module->isEditingSequence()) {
-						module->sequences[module->seqIndexEdit].setLength(16);
+						module->sek.sequences[module->seqIndexEdit].setLength(16);
 					}
 					else {
-						module->phrases = 4;
+						module->sek.phrases = 4;
 					}
 				}
 				else if (module->displayState == SemiModularSynth::DISP_TRANSPOSE) {
@@ -2206,7 +2110,7 @@ struct SemiModularSynthWidget : ModuleWidget {
 						}
 					}
 					else {
-						module->phrase[module->phraseIndexEdit] = 0;
+						module->sek.phrase[module->phraseIndexEdit] = 0;
 					}
 				}
 			}
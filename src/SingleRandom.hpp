@@ -0,0 +1,86 @@
+//***********************************************************************************************
+//Impromptu Modular: Modules for VCV Rack by Marc Boulé
+//
+//Random order without repeats, see ./LICENSE.md for all licenses
+//***********************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+
+// Random order of the items [0 : length - 1] where no item is played twice before all were played (the RNS run
+// modes): each call picks uniformly among the items not played yet, and starts over when all were played. The
+// played items are a bit field of up to MAX_ITEMS bits, and the pick is the k-th unplayed bit, found with popcounts
+// (a portable select, no BMI2 pdep), so a call takes the same time whatever the length and allocates nothing.
+// Items are numbered from the lowest bit, so that a given random value picks the same item as a list of the
+// unplayed items in increasing order would.
+
+template <int MAX_ITEMS>
+class SingleRandom {
+	static_assert(MAX_ITEMS > 0 && MAX_ITEMS <= 256, "up to 256 items");
+	static const int NUM_WORDS = (MAX_ITEMS + 63) / 64;
+
+	uint64_t played[NUM_WORDS];
+
+	static int popcount(uint64_t word) {
+		return __builtin_popcountll(word);
+	}
+	static uint64_t lengthMask(int wordn, int length) {// bits of word wordn that are below length
+		int bits = length - wordn * 64;
+		if (bits <= 0)
+			return 0;
+		if (bits >= 64)
+			return ~((uint64_t)0);
+		return (((uint64_t)1) << bits) - 1;
+	}
+	static int selectBit(uint64_t word, int k) {// position of the k-th (from 0) set bit of word, which has more than k set bits
+		int pos = 0;
+		for (int width = 32; width > 0; width >>= 1) {
+			int lowCount = popcount(word & ((((uint64_t)1) << width) - 1));
+			if (k >= lowCount) {
+				k -= lowCount;
+				word >>= width;
+				pos += width;
+			}
+		}
+		return pos;
+	}
+
+
+	public:
+
+	SingleRandom() {init();}
+
+	void init() {// we always start on (reset to) the first item, so mark it as played
+		for (int w = 0; w < NUM_WORDS; w++)
+			played[w] = 0;
+		played[0] = 0x1;
+	}
+
+	int getNext(int length, uint32_t randomValue) {// length in [1 : MAX_ITEMS], randomValue is uniform over 32 bits
+		int counts[NUM_WORDS];
+		int count = 0;
+		for (int w = 0; w < NUM_WORDS; w++) {
+			counts[w] = popcount(~played[w] & lengthMask(w, length));
+			count += counts[w];
+		}
+
+		int item = 0;
+		if (count == 0) {// all played, start over
+			for (int w = 0; w < NUM_WORDS; w++)
+				played[w] = 0;
+			item = randomValue % length;
+		}
+		else {
+			int k = randomValue % count;
+			int w = 0;
+			for (; k >= counts[w]; w++)
+				k -= counts[w];
+			item = w * 64 + selectBit(~played[w] & lengthMask(w, length), k);
+		}
+		played[item >> 6] |= (((uint64_t)1) << (item & 63));
+
+		return item;
+	}
+};// class SingleRandom
@@ -13,6 +13,7 @@
 
 
 #include "ImpromptuModular.hpp"
+#include "RandomStream.hpp"
 
 struct Variations : Module {
 	enum ParamIds {
@@ -41,6 +42,7 @@ struct Variations : Module {
 	// Need to save, no reset
 	int panelTheme;
 	float panelContrast;
+	RandomStream rng;
 	
 	// Need to save, with reset
 	float cvHold[PORT_MAX_CHANNELS];
@@ -62,7 +64,7 @@ struct Variations : Module {
 	}
 	
 	float getNewNoise() {
-		float _noise = isNormalDist() ? (0.2f * random::normal()) : (random::uniform() * 2.0f - 1.0f);
+		float _noise = isNormalDist() ? (0.2f * rng.normal()) : (rng.uniform() * 2.0f - 1.0f);
 		// all calibrated for +-1 V noise
 		return _noise * 5.0f;
 		// returns a +- 5V noise without clamping
@@ -121,6 +123,7 @@ struct Variations : Module {
 		highClamp = 10.0f;
 		lowRangeSpread = false;
 		lowRangeOffset = false;
+		rng.deterministic = false;
 		resetNonJson();
 	}
 	void resetNonJson() {
@@ -160,6 +163,9 @@ struct Variations : Module {
 		// lowRangeOffset
 		json_object_set_new(rootJ, "lowRangeOffset", json_boolean(lowRangeOffset));
 		
+		// rng
+		json_object_set_new(rootJ, "rng", rng.dataToJson());
+		
 		return rootJ;
 	}
 
@@ -206,6 +212,11 @@ struct Variations : Module {
 		if (lowRangeOffsetJ)
 			lowRangeOffset = json_is_true(lowRangeOffsetJ);
 		
+		// rng
+		json_t *rngJ = json_object_get(rootJ, "rng");
+		if (rngJ)
+			rng.dataFromJson(rngJ);
+		
 		resetNonJson();
 	}
 
@@ -313,6 +324,7 @@ struct VariationsWidget : ModuleWidget {
 		minCvSlider->box.size.x = 200.0f;
 		menu->addChild(minCvSlider);
 
+		menu->addChild(createBoolPtrMenuItem("Same random values on every load", "", &module->rng.deterministic));
 	}	
 	
 	
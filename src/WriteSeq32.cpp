@@ -9,9 +9,28 @@
 
 
 #include "WriteSeqUtil.hpp"
+#include "JsonHandoff.hpp"
 
 
-struct WriteSeq32 : Module {
+// Steps of WriteSeq32, i.e. what dataFromJson() loads
+struct WriteSeq32Data {
+	// Need to save, with reset
+	float cv[4][32];
+	int gates[4][32];
+	
+	
+	void init() {
+		for (int s = 0; s < 32; s++) {
+			for (int c = 0; c < 4; c++) {
+				cv[c][s] = 0.0f;
+				gates[c][s] = 1;
+			}
+		}
+	}
+};
+
+
+struct WriteSeq32 : Module, WriteSeq32Data {// steps are in WriteSeq32Data
 	enum ParamIds {
 		SHARP_PARAM,
 		ENUMS(WINDOW_PARAM, 4),
@@ -70,8 +89,6 @@ struct WriteSeq32 : Module {
 	int indexStep;
 	int indexStepStage;
 	int indexChannel;
-	float cv[4][32];
-	int gates[4][32];
 	bool resetOnRun;
 	int stepRotates;
 
@@ -85,6 +102,7 @@ struct WriteSeq32 : Module {
 
 	// No need to save, no reset
 	RefreshCounter refresh;	
+	JsonHandoff<WriteSeq32Data> jsonHandoff;// steps loaded by dataFromJson(), adopted by process()
 	float editingGateCV;// no need to initialize, this goes with editingGate (output this only when editingGate > 0)
 	Trigger clockTrigger;
 	Trigger resetTrigger;
@@ -160,12 +178,7 @@ struct WriteSeq32 : Module {
 		indexStep = 0;
 		indexStepStage = 0;
 		indexChannel = 0;
-		for (int s = 0; s < 32; s++) {
-			for (int c = 0; c < 4; c++) {
-				cv[c][s] = 0.0f;
-				gates[c][s] = 1;
-			}
-		}
+		WriteSeq32Data::init();
 		resetOnRun = false;
 		stepRotates = 0;
 		resetNonJson();
@@ -197,6 +210,10 @@ struct WriteSeq32 : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// steps are those loaded by dataFromJson() when process() has not adopted them yet
+		WriteSeq32Data* pendingData = jsonHandoff.peekPending();
+		WriteSeq32Data* sd = (pendingData != nullptr ? pendingData : this);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
@@ -219,7 +236,7 @@ struct WriteSeq32 : Module {
 		json_t *cvJ = json_array();
 		for (int c = 0; c < 4; c++)
 			for (int s = 0; s < 32; s++) {
-				json_array_insert_new(cvJ, s + (c<<5), json_real(cv[c][s]));
+				json_array_insert_new(cvJ, s + (c<<5), json_real(sd->cv[c][s]));
 			}
 		json_object_set_new(rootJ, "cv", cvJ);
 
@@ -227,7 +244,7 @@ struct WriteSeq32 : Module {
 		json_t *gatesJ = json_array();
 		for (int c = 0; c < 4; c++)
 			for (int s = 0; s < 32; s++) {
-				json_array_insert_new(gatesJ, s + (c<<5), json_integer(gates[c][s]));
+				json_array_insert_new(gatesJ, s + (c<<5), json_integer(sd->gates[c][s]));
 			}
 		json_object_set_new(rootJ, "gates", gatesJ);
 
@@ -237,10 +254,17 @@ struct WriteSeq32 : Module {
 		// stepRotates
 		json_object_set_new(rootJ, "stepRotates", json_integer(stepRotates));
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
+		// steps are parsed into the handoff buffer, process() adopts them when they are all there
+		WriteSeq32Data* sd = jsonHandoff.beginWrite();
+		sd->init();
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -278,7 +302,7 @@ struct WriteSeq32 : Module {
 				for (int s = 0; s < 32; s++) {
 					json_t *cvArrayJ = json_array_get(cvJ, s + (c<<5));
 					if (cvArrayJ)
-						cv[c][s] = json_number_value(cvArrayJ);
+						sd->cv[c][s] = json_number_value(cvArrayJ);
 				}
 		}
 		
@@ -289,7 +313,7 @@ struct WriteSeq32 : Module {
 				for (int s = 0; s < 32; s++) {
 					json_t *gateJ = json_array_get(gatesJ, s + (c<<5));
 					if (gateJ)
-						gates[c][s] = json_integer_value(gateJ);
+						sd->gates[c][s] = json_integer_value(gateJ);
 				}
 		}
 		
@@ -303,7 +327,7 @@ struct WriteSeq32 : Module {
 		if (stepRotatesJ)
 			stepRotates = json_integer_value(stepRotatesJ);
 
-		resetNonJson();
+		jsonHandoff.endWrite();// process() adopts the steps, then calls resetNonJson()
 	}
 
 
@@ -376,6 +400,11 @@ struct WriteSeq32 : Module {
 		static const float copyPasteInfoTime = 0.7f;// seconds
 		static const float gateTime = 0.15f;// seconds
 		
+		// Steps loaded by dataFromJson()
+		if (jsonHandoff.adopt(this)) {
+			resetNonJson();
+		}
+		
 		
 		//********** Buttons, knobs, switches and inputs **********
 		
@@ -9,9 +9,32 @@
 
 
 #include "WriteSeqUtil.hpp"
+#include "JsonHandoff.hpp"
 
 
-struct WriteSeq64 : Module {
+// Steps of WriteSeq64, i.e. what dataFromJson() loads
+struct WriteSeq64Data {
+	// Need to save, with reset
+	int indexStep[5];// [0;63] each
+	int indexSteps[5];// [1;64] each
+	float cv[5][64];
+	int gates[5][64];
+	
+	
+	void init() {
+		for (int c = 0; c < 5; c++) {
+			indexStep[c] = 0;
+			indexSteps[c] = 64;
+			for (int s = 0; s < 64; s++) {
+				cv[c][s] = 0.0f;
+				gates[c][s] = 1;
+			}
+		}
+	}
+};
+
+
+struct WriteSeq64 : Module, WriteSeq64Data {// steps are in WriteSeq64Data
 	enum ParamIds {
 		SHARP_PARAM,
 		QUANTIZE_PARAM,
@@ -67,10 +90,6 @@ struct WriteSeq64 : Module {
 	
 	// Need to save, with reset
 	bool running;
-	int indexStep[5];// [0;63] each
-	int indexSteps[5];// [1;64] each
-	float cv[5][64];
-	int gates[5][64];
 	bool resetOnRun;
 	int stepRotates;
 
@@ -85,6 +104,7 @@ struct WriteSeq64 : Module {
 
 	// No need to save, no reset
 	RefreshCounter refresh;	
+	JsonHandoff<WriteSeq64Data> jsonHandoff;// steps loaded by dataFromJson(), adopted by process()
 	float editingGateCV;// no need to initialize, this goes with editingGate (output this only when editingGate > 0)
 	int stepKnob = 0;
 	int stepsKnob = 0;
@@ -157,14 +177,7 @@ struct WriteSeq64 : Module {
 	
 	void onReset() override final {
 		running = true;
-		for (int c = 0; c < 5; c++) {
-			indexStep[c] = 0;
-			indexSteps[c] = 64;
-			for (int s = 0; s < 64; s++) {
-				cv[c][s] = 0.0f;
-				gates[c][s] = 1;
-			}
-		}
+		WriteSeq64Data::init();
 		resetOnRun = false;
 		stepRotates = 0;
 		resetNonJson();
@@ -195,6 +208,10 @@ struct WriteSeq64 : Module {
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
+		// steps are those loaded by dataFromJson() when process() has not adopted them yet
+		WriteSeq64Data* pendingData = jsonHandoff.peekPending();
+		WriteSeq64Data* sd = (pendingData != nullptr ? pendingData : this);
+
 		// panelTheme
 		json_object_set_new(rootJ, "panelTheme", json_integer(panelTheme));
 
@@ -207,20 +224,20 @@ struct WriteSeq64 : Module {
 		// indexStep
 		json_t *indexStepJ = json_array();
 		for (int c = 0; c < 5; c++)
-			json_array_insert_new(indexStepJ, c, json_integer(indexStep[c]));
+			json_array_insert_new(indexStepJ, c, json_integer(sd->indexStep[c]));
 		json_object_set_new(rootJ, "indexStep", indexStepJ);
 
 		// indexSteps 
 		json_t *indexStepsJ = json_array();
 		for (int c = 0; c < 5; c++)
-			json_array_insert_new(indexStepsJ, c, json_integer(indexSteps[c]));
+			json_array_insert_new(indexStepsJ, c, json_integer(sd->indexSteps[c]));
 		json_object_set_new(rootJ, "indexSteps", indexStepsJ);
 
 		// CV
 		json_t *cvJ = json_array();
 		for (int c = 0; c < 5; c++)
 			for (int s = 0; s < 64; s++) {
-				json_array_insert_new(cvJ, s + (c<<6), json_real(cv[c][s]));
+				json_array_insert_new(cvJ, s + (c<<6), json_real(sd->cv[c][s]));
 			}
 		json_object_set_new(rootJ, "cv", cvJ);
 
@@ -228,7 +245,7 @@ struct WriteSeq64 : Module {
 		json_t *gatesJ = json_array();
 		for (int c = 0; c < 5; c++)
 			for (int s = 0; s < 64; s++) {
-				json_array_insert_new(gatesJ, s + (c<<6), json_integer(gates[c][s]));
+				json_array_insert_new(gatesJ, s + (c<<6), json_integer(sd->gates[c][s]));
 			}
 		json_object_set_new(rootJ, "gates", gatesJ);
 
@@ -238,11 +255,18 @@ struct WriteSeq64 : Module {
 		// stepRotates
 		json_object_set_new(rootJ, "stepRotates", json_integer(stepRotates));
 
+		if (pendingData != nullptr)
+			jsonHandoff.endPeek();
+
 		return rootJ;
 	}
 
 	
 	void dataFromJson(json_t *rootJ) override {
+		// steps are parsed into the handoff buffer, process() adopts them when they are all there
+		WriteSeq64Data* sd = jsonHandoff.beginWrite();
+		sd->init();
+
 		// panelTheme
 		json_t *panelThemeJ = json_object_get(rootJ, "panelTheme");
 		if (panelThemeJ)
@@ -265,7 +289,7 @@ struct WriteSeq64 : Module {
 			{
 				json_t *indexStepArrayJ = json_array_get(indexStepJ, c);
 				if (indexStepArrayJ)
-					indexStep[c] = json_integer_value(indexStepArrayJ);
+					sd->indexStep[c] = json_integer_value(indexStepArrayJ);
 			}
 
 		// indexSteps
@@ -275,7 +299,7 @@ struct WriteSeq64 : Module {
 			{
 				json_t *indexStepsArrayJ = json_array_get(indexStepsJ, c);
 				if (indexStepsArrayJ)
-					indexSteps[c] = json_integer_value(indexStepsArrayJ);
+					sd->indexSteps[c] = json_integer_value(indexStepsArrayJ);
 			}
 
 		// CV
@@ -285,7 +309,7 @@ struct WriteSeq64 : Module {
 				for (int i = 0; i < 64; i++) {
 					json_t *cvArrayJ = json_array_get(cvJ, i + (c<<6));
 					if (cvArrayJ)
-						cv[c][i] = json_number_value(cvArrayJ);
+						sd->cv[c][i] = json_number_value(cvArrayJ);
 				}
 		}
 		
@@ -296,7 +320,7 @@ struct WriteSeq64 : Module {
 				for (int i = 0; i < 64; i++) {
 					json_t *gateJ = json_array_get(gatesJ, i + (c<<6));
 					if (gateJ)
-						gates[c][i] = json_integer_value(gateJ);
+						sd->gates[c][i] = json_integer_value(gateJ);
 				}
 		}
 		
@@ -310,7 +334,7 @@ struct WriteSeq64 : Module {
 		if (stepRotatesJ)
 			stepRotates = json_integer_value(stepRotatesJ);
 
-		resetNonJson();
+		jsonHandoff.endWrite();// process() adopts the steps, then calls resetNonJson()
 	}
 	
 	
@@ -385,6 +409,11 @@ struct WriteSeq64 : Module {
 		static const float copyPasteInfoTime = 0.7f;// seconds
 		static const float gateTime = 0.15f;// seconds
 		
+		// Steps loaded by dataFromJson()
+		if (jsonHandoff.adopt(this)) {
+			resetNonJson();
+		}
+		
 		
 		//********** Buttons, knobs, switches and inputs **********
 		int indexChannel = calcChan();